@@ -39,7 +39,8 @@ langOpts="\
 -std=c11 -pedantic \
 -Wall -Wextra -Werror \
 -Wimplicit-fallthrough \
--Wno-type-limits"
+-Wno-type-limits \
+-pthread"
 if [ "$fast" == 0 ]; then optzOpts="-O2"; else optzOpts="-O0"; fi
 if [ "$debug" == 0 ]; then confOpts="-D NDEBUG"; else confOpts=""; fi
 
@@ -2,9 +2,17 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#ifndef __STDC_NO_THREADS__
+#include <stdatomic.h>
+#include <threads.h>
+#endif
 
 #include "common.h"
 #include "engine.h"
+#include "mapfile.h"
+#include "pool.h"
+#include "ring.h"
 
 
 struct eexpr_parserInternal {
@@ -16,6 +24,16 @@ struct eexpr_parserInternal {
     size_t warnings;
   } caps;
   enum eexpr_parsePauseAt resumeFrom;
+  bool restart; // set by `eexpr_parser_reset`: the next `eexpr_parse` starts on a new input, re-using this state
+  // the size of the last input lexed all at once, and how many tokens it made, to guess how many tokens the next input will need
+  size_t inputBytes;
+  size_t lexedTokens;
+  uint8_t* input; // the last input, whose text the output eexprs may borrow (see `eexpr_reparse`)
+  size_t lexWarnings; // how many of the warnings came from the lexer (they come first, before those of the postlexer)
+  // In event mode, the eexprs of a segment are built in the same arena as its tokens, which is reset once they have been reported.
+  // Tokens lexed past the end of a segment move to this spare arena, which is then used for lexing until the next segment.
+  eexpr_arena* spareArena;
+  bool feedStopped; // set when a segment-at-a-time parse stopped early, to carry on with `feedStep` (see `eexpr_parser.deadline`)
 };
 
 
@@ -29,6 +47,9 @@ void appendError(eexpr_parser* parser, const eexpr_error* err) {
   }
   parser->errors[parser->nErrors] = *err;
   parser->nErrors += 1;
+  if (parser->events != NULL && parser->events->error != NULL) {
+    parser->events->error(parser->events->ctx, err);
+  }
 }
 static
 void appendWarning(eexpr_parser* parser, const eexpr_error* err) {
@@ -42,31 +63,45 @@ void appendWarning(eexpr_parser* parser, const eexpr_error* err) {
   parser->nWarnings += 1;
 }
 
+// whether the error should be reported as an error rather than a warning
 static
-void drainErrors(eexpr_parser* parser) {
-  for (dllistNode_eexpr_error* err = parser->impl->st.errStream.start; err != NULL; err = err->next) {
-    bool isError;
-    switch (err->here.type) {
-      case EEXPR_ERR_MIXED_SPACE: { isError = parser->isError.mixedSpace; } break;
-      case EEXPR_ERR_MIXED_NEWLINES: { isError = parser->isError.mixedNewlines; } break;
-      case EEXPR_ERR_BAD_DIGIT_SEPARATOR: { isError = parser->isError.badDigitSeparator; } break;
-      case EEXPR_ERR_TRAILING_SPACE: { isError = parser->isError.trailingSpace; } break;
-      case EEXPR_ERR_NO_TRAILING_NEWLINE: { isError = parser->isError.noTrailingNewline; } break;
-      default: { isError = true; } break;
-    }
-    if (isError) {
+bool isError(const struct eexpr_parseErrorLevels* levels, const eexpr_error* err) {
+  switch (err->type) {
+    case EEXPR_ERR_MIXED_SPACE: return levels->mixedSpace;
+    case EEXPR_ERR_MIXED_NEWLINES: return levels->mixedNewlines;
+    case EEXPR_ERR_BAD_DIGIT_SEPARATOR: return levels->badDigitSeparator;
+    case EEXPR_ERR_TRAILING_SPACE: return levels->trailingSpace;
+    case EEXPR_ERR_NO_TRAILING_NEWLINE: return levels->noTrailingNewline;
+    default: return true;
+  }
+}
+
+static
+void drainErrors(eexpr_parser* parser, engine* st) {
+  for (dllistNode_eexpr_error* err = st->errStream.start; err != NULL; err = err->next) {
+    if (isError(&parser->isError, &err->here)) {
       appendError(parser, &err->here);
     }
     else {
       appendWarning(parser, &err->here);
     }
   }
-  dllist_del_eexpr_error(&parser->impl->st.errStream);
-  if (parser->impl->st.fatal.type != EEXPR_ERR_NOERROR) {
-    appendError(parser, &parser->impl->st.fatal);
+  dllist_del_eexpr_error(&st->errStream);
+  if (st->fatal.type != EEXPR_ERR_NOERROR) {
+    appendError(parser, &st->fatal);
   }
 }
 
+// whether the engine has found any problems that are to be reported as errors
+static
+bool anyErrors(const struct eexpr_parseErrorLevels* levels, const engine* st) {
+  if (st->fatal.type != EEXPR_ERR_NOERROR) { return true; }
+  for (const dllistNode_eexpr_error* err = st->errStream.start; err != NULL; err = err->next) {
+    if (isError(levels, &err->here)) { return true; }
+  }
+  return false;
+}
+
 static
 void appendToken(eexpr_parser* parser, eexpr_token* tok) {
   if (parser->nTokens == parser->impl->caps.tokens) {
@@ -82,8 +117,8 @@ static
 void drainTokens(eexpr_parser* parser) {
   if (parser->pauseAt < EEXPR_PAUSE_AFTER_PARSE) {
     parser->nTokens = 0;
-    for (dllistNode_eexpr_token* tok = parser->impl->st.tokStream.start; tok != NULL; tok = tok->next) {
-      appendToken(parser, &tok->here);
+    for (size_t i = 0; i < parser->impl->st.tokStream.len; ++i) {
+      appendToken(parser, &parser->impl->st.tokStream.data[i]);
     }
   }
   else {
@@ -95,20 +130,727 @@ void drainTokens(eexpr_parser* parser) {
   }
 
 }
+
+// In flat output mode, swap the output eexprs for a flat forest of them.
+// The arena they were built in is kept back from the caller, so it is freed along with the parser's internal state.
+static
+void flattenOutput(eexpr_parser* parser) {
+  eexpr_flat* flat = eexpr_flatten(parser->nEexprs, parser->eexprs);
+  if (flat == NULL) { return; } // too large, so they are left as eexprs
+  parser->flat = flat;
+  parser->arena = NULL;
+  // the array is given back to the engine, to be re-used or freed along with it
+  parser->impl->st.eexprStream.data = parser->eexprs;
+  parser->impl->st.eexprStream.cap = parser->impl->caps.eexprs;
+  parser->nEexprs = 0;
+  parser->eexprs = NULL;
+}
+
 static
 void drainEexprs(eexpr_parser* parser) {
+  parser->arena = parser->impl->st.arena;
   parser->nEexprs = parser->impl->st.eexprStream.len;
   parser->eexprs = parser->impl->st.eexprStream.data;
+  parser->impl->caps.eexprs = parser->impl->st.eexprStream.cap; // in case the array is given back (see `eexpr_parser_reset`)
   parser->impl->st.eexprStream.len = 0;
   parser->impl->st.eexprStream.cap = 0;
   parser->impl->st.eexprStream.data = NULL;
+  if (parser->flatOutput) { flattenOutput(parser); }
+}
+
+static
+eexpr_arena* newArena(size_t chunkSize) {
+  eexpr_arena* arena = malloc(sizeof(eexpr_arena));
+  checkOom(arena);
+  arena_init(&arena->mem, chunkSize);
+  return arena;
+}
+
+// apply the parser's options to the engine for a new input
+static
+void configureEngine(const eexpr_parser* parser, engine* st) {
+  if (parser->events != NULL) {
+    // text passed to events need only outlive the callback, so borrowing it from the input is always safe
+    st->borrowInput = true;
+  }
+  else {
+    st->borrowInput = parser->borrowInput;
+    st->lazyNumbers = parser->borrowInput && parser->lazyNumbers;
+  }
+}
+
+// save input capacities; initialize output lengths and the arena (if any)
+static
+void startInternals(eexpr_parser* parser, size_t nBytes) {
+  parser->impl->caps.eexprs = parser->nEexprs; parser->nEexprs = 0;
+  parser->impl->caps.tokens = parser->nTokens; parser->nTokens = 0;
+  parser->impl->caps.errors = parser->nErrors; parser->nErrors = 0;
+  parser->impl->caps.warnings = parser->nWarnings; parser->nWarnings = 0;
+  parser->arena = NULL;
+  parser->flat = NULL;
+  parser->impl->feedStopped = false;
+  // in flat output mode, the eexprs only need to last until they are flattened, so they may as well be freed all at once
+  bool flatten = parser->flatOutput && parser->onEexpr == NULL && !parser->impl->st.feed.active;
+  if (parser->events != NULL) {
+    parser->impl->st.arena = newArena(4096);
+    parser->impl->spareArena = newArena(4096);
+  }
+  else if (parser->useArena || flatten) {
+    // the output is usually several times larger than the input, so starting with an input-sized chunk is reasonable
+    parser->impl->st.arena = newArena(nBytes < 4096 ? 4096 : nBytes);
+  }
+}
+
+static
+void initInternals(eexpr_parser* parser, engine st, size_t nBytes) {
+  parser->impl = malloc(sizeof(eexpr_parserInternal));
+  checkOom(parser->impl);
+  parser->impl->st = st;
+  parser->impl->spareArena = NULL;
+  parser->impl->restart = false;
+  parser->impl->lexedTokens = 0;
+  startInternals(parser, nBytes);
+}
+
+// Set up a parser for a new input, keeping the buffers grown for the last one (see `eexpr_parser_reset`).
+static
+void restartInternals(eexpr_parser* parser, size_t nBytes, uint8_t* input, bool segments) {
+  eexpr_parserInternal* impl = parser->impl;
+  engine* st = &impl->st;
+  eexpr_arena* arena = st->arena;
+  engine_reuse(st, nBytes, input, segments);
+  // the arena is only ours to free if it was never handed over to the caller
+  if (arena != parser->arena) {
+    eexpr_arenaRelease(arena);
+  }
+  eexpr_arenaRelease(impl->spareArena);
+  impl->spareArena = NULL;
+  if (impl->lexedTokens != 0) {
+    size_t bytesPerToken = impl->inputBytes / impl->lexedTokens;
+    if (bytesPerToken == 0) { bytesPerToken = 1; }
+    size_t expected = nBytes / bytesPerToken + 1;
+    // leave a little room, since it is only a guess
+    dynarr_reserve_eexpr_token(&st->tokStream, expected + expected / 8);
+  }
+  configureEngine(parser, st);
+  impl->restart = false;
+  startInternals(parser, nBytes);
+}
+
+// Whether the parser has a budget of tokens to keep to (see `eexpr_parser.budget`).
+static
+bool budgeted(const eexpr_parser* parser) {
+  return parser->budget != 0;
+}
+
+// give the stages about to run a fresh budget
+static
+void startBudget(eexpr_parser* parser) {
+  engine_setBudget(&parser->impl->st, parser->budget, parser->deadline, parser->shouldStop, parser->shouldStopCtx);
+}
+
+// Bound an engine run on another thread (or a segment at a time) by the deadline and stop callback alone.
+static
+void startStopChecks(const eexpr_parser* parser, engine* st) {
+  engine_setBudget(st, 0, parser->deadline, parser->shouldStop, parser->shouldStopCtx);
+}
+
+// Whether the stage just run stopped early; if so, it is run again (from where it stopped) on the next `eexpr_parse`.
+static
+bool stoppedEarly(eexpr_parser* parser) {
+  parser->interrupted = parser->impl->st.budget.exhausted;
+  return parser->interrupted;
+}
+
+//////////////////////////////////// Segmented Parsing ////////////////////////////////////
+
+// report an eexpr (and everything in it) to the event callbacks
+static
+void emitEvents(const eexpr_events* ev, const eexpr* root);
+
+// the `onEexpr` callback for event mode
+static
+bool eexprToEvents(void* ctx, eexpr* expr) {
+  const eexpr_parser* parser = ctx;
+  emitEvents(parser->events, expr);
+  return true; // it lives in the arena, and will be freed along with the rest of its segment
+}
+
+// Cook and parse the first `cut` tokens lexed so far, appending the resulting eexprs to `out`.
+static
+void parseSegment(eexpr_parser* parser, size_t cut, dynarr_eexpr_p* out) {
+  engine* st = &parser->impl->st;
+  engine seg = engine_splitSegment(st, cut);
+  if (parser->events != NULL) {
+    seg.onEexpr = eexprToEvents;
+    seg.onEexprCtx = parser;
+    // move the tokens that are left over to the spare arena, so the segment's can be reset once it has been parsed
+    eexpr_arena* spare = parser->impl->spareArena;
+    parser->impl->spareArena = st->arena;
+    st->arena = spare;
+    for (size_t i = 0; i < st->tokStream.len; ++i) {
+      engine_tokRehome(st, &st->tokStream.data[i]);
+    }
+  }
+  else {
+    seg.onEexpr = parser->onEexpr;
+    seg.onEexprCtx = parser->onEexprCtx;
+  }
+  drainErrors(parser, &seg);
+  if (parser->nErrors == 0) {
+    engine_cookLex(&seg);
+    drainErrors(parser, &seg);
+  }
+  if (parser->nErrors == 0) {
+    engine_parse(&seg);
+    if (parser->events == NULL) { parser->arena = seg.arena; }
+    for (size_t i = 0; i < seg.eexprStream.len; ++i) {
+      dynarr_push_eexpr_p(out, &seg.eexprStream.data[i]);
+    }
+    seg.eexprStream.len = 0;
+    drainErrors(parser, &seg);
+  }
+  engine_deinit(&seg);
+  if (parser->events != NULL) {
+    arena_reset(&parser->impl->spareArena->mem);
+  }
+}
+
+// Lex what input has arrived, and parse whatever top-level eexprs are now complete.
+// Once all input has arrived, this goes a batch at a time all the way to the end,
+//   unless the deadline passes or the stop callback says so in between, setting `.interrupted` (and `feedStopped` to pick up from there).
+static
+bool feedStep(eexpr_parser* parser) {
+  engine* st = &parser->impl->st;
+  startStopChecks(parser, st);
+  parser->interrupted = false;
+  parser->impl->feedStopped = false;
+  dynarr_eexpr_p out;
+  dynarr_init_eexpr_p(&out, 16);
+  while (parser->nErrors == 0) {
+    engine_rawLexSome(st);
+    if (st->fatal.type != EEXPR_ERR_NOERROR) {
+      drainErrors(parser, st);
+      break;
+    }
+    bool atEof = st->tokStream.len != 0 && st->tokStream.data[st->tokStream.len - 1].type == EEXPR_TOK_EOF;
+    size_t cut = atEof ? st->tokStream.len : engine_findCut(st);
+    if (cut != 0) {
+      parseSegment(parser, cut, &out);
+    }
+    if (atEof || !st->feed.final) { break; }
+    if (parser->nErrors == 0 && engine_pollStop(st)) {
+      parser->interrupted = true;
+      parser->impl->feedStopped = true;
+      break;
+    }
+  }
+  if (out.len != 0) {
+    parser->nEexprs = out.len;
+    parser->eexprs = out.data;
+  }
+  else {
+    dynarr_deinit_eexpr_p(&out);
+  }
+  return parser->nErrors == 0;
+}
+
+//////////////////////////////////// Parallel Parsing ////////////////////////////////////
+
+// Whether a line beginning with this byte can only be the start of a top-level eexpr (if it is not inside one already).
+// The input is only ever split before such a line (see `engine_findCut`), both here and by `eexpr_reparse`.
+static
+bool canStartPiece(uint8_t lead) {
+  switch (leadClasses[lead]) {
+    case LEAD_SYMBOL: case LEAD_SIGN: case LEAD_DIGIT:
+    case LEAD_DQUOTE: case LEAD_BACKTICK: case LEAD_SQUOTE: {
+      return true;
+    }
+    case LEAD_WRAP: return isOpenWrap(lead);
+    default: return false;
+  }
+}
+
+#ifndef __STDC_NO_THREADS__
+
+// Inputs are not split into pieces smaller than this, since the threads would cost more than they save.
+#define PARALLEL_MIN_PIECE ((size_t)1 << 20)
+
+typedef struct parallelPiece {
+  const eexpr_parser* parser;
+  engine st;
+  size_t lines; // number of lines in the input before this piece
+  eexpr_arena* outArena; // where the output eexprs will end up, or NULL outside of arena mode
+  // errors from lexing and cooking, kept apart so they can be reported in the same order as they would be from a single thread
+  // (errors from parsing are left in the engine)
+  dllist_eexpr_error lexErrs;
+  dllist_eexpr_error cookErrs[ENGINE_N_COOK_STAGES];
+} parallelPiece;
+
+// Report errors kept apart from a piece's engine.
+static
+void drainApart(eexpr_parser* parser, parallelPiece* piece, dllist_eexpr_error* errs) {
+  engine* st = &piece->st;
+  dllist_eexpr_error laterErrs = st->errStream;
+  eexpr_error laterFatal = st->fatal;
+  st->errStream = *errs;
+  st->fatal.type = EEXPR_ERR_NOERROR;
+  *errs = dllist_empty_eexpr_error();
+  drainErrors(parser, st);
+  st->errStream = laterErrs;
+  st->fatal = laterFatal;
+}
+
+static
+int lexPiece(void* arg) {
+  parallelPiece* piece = arg;
+  engine_rawLex(&piece->st);
+  return 0;
+}
+
+static
+int parsePiece(void* arg) {
+  parallelPiece* piece = arg;
+  engine* st = &piece->st;
+  engine_shiftLines(st, piece->lines);
+  for (size_t i = 0; i < st->tokStream.len; ++i) {
+    eexpr_token* tok = &st->tokStream.data[i];
+    if (tok->type == EEXPR_TOK_NUMBER && tok->undecoded) {
+      // lazy numbers are decoded long after this piece's own arena has been merged away
+      tok->as.lazyNumber.arena = piece->outArena;
+    }
+  }
+  piece->lexErrs = st->errStream;
+  st->errStream = dllist_empty_eexpr_error();
+  engine_cookLexApart(st, piece->cookErrs);
+  if (st->budget.exhausted) { return 0; }
+  assert(st->fatal.type == EEXPR_ERR_NOERROR);
+  bool ok = true;
+  for (size_t k = 0; k < ENGINE_N_COOK_STAGES; ++k) {
+    st->errStream = piece->cookErrs[k];
+    ok = ok && !anyErrors(&piece->parser->isError, st);
+  }
+  st->errStream = dllist_empty_eexpr_error();
+  if (ok) { engine_parse(st); }
+  return 0;
+}
+
+// Run `stage` on every piece, each on its own thread (the first on the calling thread).
+static
+void runPieces(size_t n, parallelPiece* pieces, thrd_start_t stage) {
+  thrd_t* threads = malloc(n * sizeof(thrd_t));
+  checkOom(threads);
+  bool* started = malloc(n * sizeof(bool));
+  checkOom(started);
+  for (size_t i = 1; i < n; ++i) {
+    started[i] = thrd_create(&threads[i], stage, &pieces[i]) == thrd_success;
+    if (!started[i]) { stage(&pieces[i]); }
+  }
+  stage(&pieces[0]);
+  for (size_t i = 1; i < n; ++i) {
+    if (started[i]) { thrd_join(threads[i], NULL); }
+  }
+  free(started);
+  free(threads);
+}
+
+// Whether any piece stopped early (see `eexpr_parser.deadline`).
+static
+bool anyStopped(size_t n, const parallelPiece* pieces) {
+  for (size_t i = 0; i < n; ++i) {
+    if (pieces[i].st.budget.exhausted) { return true; }
+  }
+  return false;
+}
+
+// Return the offset of the first line at or after `from` which begins with a byte that can only start a top-level eexpr,
+//   or `nBytes` if there is none.
+// This is only a guess at where the token stream can be split; it is checked once the pieces are lexed.
+static
+size_t findPieceStart(size_t nBytes, const uint8_t* input, size_t from) {
+  while (from < nBytes) {
+    const uint8_t* nl = memchr(&input[from], '\n', nBytes - from);
+    if (nl == NULL) { break; }
+    size_t at = nl - input + 1;
+    if (at < nBytes && canStartPiece(input[at])) { return at; }
+    from = at;
+  }
+  return nBytes;
+}
+
+// Whether the pieces were split at points where the whole input would have been split (see `engine_findCut`),
+//   and would have lexed the same way as one whole.
+// If so, the kinds of newline and indentation they agree on are kept in `whole`, just as if it had lexed the input itself.
+static
+bool piecesAgree(size_t n, parallelPiece* pieces, engine* whole) {
+  static const struct eexpr_parseErrorLevels allWarnings = { false, false, false, false, false };
+  newlineType newline = NEWLINE_NONE;
+  eexpr_indentType indent = EEXPR_INDENT_NULL;
+  for (size_t i = 0; i < n; ++i) {
+    engine* st = &pieces[i].st;
+    // lexing errors might be down to a bad split (e.g. an unclosed heredoc), so let the whole input sort them out
+    // (the problems that can be demoted to warnings only depend on the line they are in, or on the kind of newline, checked below)
+    if (anyErrors(&allWarnings, st)) { return false; }
+    if (i != 0 && !engine_startsAtCut(st)) { return false; }
+    if (i != n - 1 && !engine_endsAtCut(st)) { return false; }
+    // the kind of newline/indentation is only established once per input, so the pieces must agree on it
+    if (st->discoveredNewline != NEWLINE_NONE) {
+      if (newline != NEWLINE_NONE && newline != st->discoveredNewline) { return false; }
+      newline = st->discoveredNewline;
+    }
+    if (st->indent.type != EEXPR_INDENT_NULL) {
+      if (indent != EEXPR_INDENT_NULL && indent != st->indent.type) { return false; }
+      indent = st->indent.type;
+    }
+  }
+  whole->discoveredNewline = newline;
+  whole->indent.type = indent;
+  return true;
+}
+
+/*
+Try to lex, cook and parse the input in pieces on separate threads.
+The input is split before lines that look like they can only begin a top-level eexpr,
+  and once the pieces are lexed, the split points are checked (see `piecesAgree`) before the pieces are cooked and parsed.
+Their output is then put back together, in the same order as it would have come from parsing the whole input on one thread.
+Returns false without any effect on the parser if the input is too small, or the split points turn out to be bad;
+  the input should then be parsed as usual.
+If a piece stops early (for the deadline or stop callback), the pieces cannot be picked up where they left off,
+  so it also returns false, but sets `.interrupted`, and the input should be parsed as usual on the next call.
+*/
+static
+bool parseParallel(eexpr_parser* parser, size_t nBytes, uint8_t* input) {
+  size_t n = nBytes / PARALLEL_MIN_PIECE;
+  if (n > parser->nThreads) { n = parser->nThreads; }
+  if (n < 2) { return false; }
+  size_t* starts = malloc((n + 1) * sizeof(size_t));
+  checkOom(starts);
+  { // find split points
+    size_t nStarts = 1;
+    starts[0] = 0;
+    for (size_t i = 1; i < n; ++i) {
+      size_t from = i * (nBytes / n);
+      if (from <= starts[nStarts - 1]) { from = starts[nStarts - 1] + 1; }
+      size_t at = findPieceStart(nBytes, input, from);
+      if (at == nBytes) { break; }
+      starts[nStarts++] = at;
+    }
+    n = nStarts;
+    starts[n] = nBytes;
+  }
+  if (n < 2) { free(starts); return false; }
+  engine* whole = &parser->impl->st;
+  parallelPiece* pieces = malloc(n * sizeof(parallelPiece));
+  checkOom(pieces);
+  for (size_t i = 0; i < n; ++i) {
+    parallelPiece* piece = &pieces[i];
+    size_t len = starts[i + 1] - starts[i];
+    piece->parser = parser;
+    piece->st = engine_newForPiece(len, &input[starts[i]], starts[i]);
+    piece->st.borrowInput = whole->borrowInput;
+    piece->st.lazyNumbers = whole->lazyNumbers;
+    startStopChecks(parser, &piece->st);
+    // the arena is not thread-safe, so each piece builds into its own, which are merged afterwards
+    piece->st.arena = whole->arena == NULL ? NULL : newArena(len < 4096 ? 4096 : len);
+    piece->lines = 0;
+    piece->outArena = whole->arena;
+    piece->lexErrs = dllist_empty_eexpr_error();
+    for (size_t k = 0; k < ENGINE_N_COOK_STAGES; ++k) {
+      piece->cookErrs[k] = dllist_empty_eexpr_error();
+    }
+  }
+  free(starts);
+
+  runPieces(n, pieces, lexPiece);
+  bool stopped = anyStopped(n, pieces);
+  bool ok = !stopped && piecesAgree(n, pieces, whole);
+  if (ok) {
+    for (size_t i = 1; i < n; ++i) {
+      // each piece but the last ends with a newline, so its EOF is at the start of the line after its last
+      pieces[i].lines = pieces[i - 1].lines + pieces[i - 1].st.loc.line;
+    }
+    runPieces(n, pieces, parsePiece);
+    stopped = anyStopped(n, pieces);
+    ok = !stopped;
+  }
+  if (ok) {
+    // report each stage's errors in order, stopping where a single thread would have
+    for (size_t i = 0; i < n; ++i) {
+      drainApart(parser, &pieces[i], &pieces[i].lexErrs);
+    }
+    parser->impl->lexWarnings = parser->nWarnings;
+    if (parser->nErrors == 0) {
+      // the postlexer reports errors stage by stage
+      for (size_t k = 0; k < ENGINE_N_COOK_STAGES; ++k) {
+        for (size_t i = 0; i < n; ++i) {
+          drainApart(parser, &pieces[i], &pieces[i].cookErrs[k]);
+        }
+      }
+    }
+    if (parser->nErrors == 0) {
+      if (parser->tokens != NULL) {
+        free(parser->tokens);
+        parser->nTokens = 0;
+        parser->tokens = NULL;
+      }
+      for (size_t i = 0; i < n; ++i) {
+        engine* st = &pieces[i].st;
+        for (size_t j = 0; j < st->eexprStream.len; ++j) {
+          dynarr_push_eexpr_p(&whole->eexprStream, &st->eexprStream.data[j]);
+        }
+        st->eexprStream.len = 0;
+        drainErrors(parser, st);
+        if (st->fatal.type != EEXPR_ERR_NOERROR) { break; }
+      }
+      drainEexprs(parser);
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    eexpr_arena* arena = pieces[i].st.arena;
+    engine_deinit(&pieces[i].st);
+    dllist_del_eexpr_error(&pieces[i].lexErrs);
+    for (size_t k = 0; k < ENGINE_N_COOK_STAGES; ++k) {
+      dllist_del_eexpr_error(&pieces[i].cookErrs[k]);
+    }
+    if (arena != NULL) {
+      if (ok) { arena_adopt(&whole->arena->mem, &arena->mem); }
+      eexpr_arenaRelease(arena);
+    }
+  }
+  free(pieces);
+  if (stopped) { parser->interrupted = true; }
+  return ok;
+}
+
+
+//////////////////////////////////// Pipelined Parsing ////////////////////////////////////
+
+/*
+The lexer thread lexes a batch of tokens at a time, splits off whatever segments it can (see `engine_findCut`),
+  and hands them to the cooking thread, which hands them on to the parsing thread (the calling thread) once cooked.
+Errors are held back until all threads are done, so they can be reported just as they would be from the stages run in turn:
+  * the lexer does not split errors off with the segments, but keeps them all together in the order they were found,
+  * once lexing has found an error, the lexer stops, and whatever has been cooked/parsed so far is thrown away,
+  * the postlexer reports errors stage by stage, so each segment's cooking errors are kept apart by stage (`engine_cookLexApart`),
+  * once cooking has found an error, the parser stops, and whatever it has parsed so far is thrown away.
+The lexer and parser would otherwise share an arena, which is not thread-safe, so the parser builds into an arena of its own,
+  which is merged into the output arena at the end.
+(The postlexer does not allocate.)
+Each stage also looks at the deadline and stop callback: the lexer between batches, and the others as they work through each segment.
+Once one stage stops, the others stop too, and since the segments in flight cannot be picked up where they left off,
+  all the work done so far is thrown away.
+*/
+
+typedef struct pipeSegment {
+  engine st;
+  dllist_eexpr_error cookErrs[ENGINE_N_COOK_STAGES];
+} pipeSegment;
+
+typedef struct pipeline {
+  const eexpr_parser* parser;
+  engine* lexer;
+  ring lexed; // segments from the lexer thread to the cooking thread, ended with NULL
+  ring cooked; // segments from the cooking thread to the parsing thread, ended with NULL
+  dllist_eexpr_error lexErrs;
+  atomic_bool stopped; // set once any stage has stopped early, after which segments are passed along untouched
+} pipeline;
+
+static
+int lexStage(void* arg) {
+  pipeline* pipe = arg;
+  engine* st = pipe->lexer;
+  while (true) {
+    engine_rawLexSome(st);
+    bool failed = anyErrors(&pipe->parser->isError, st);
+    pipe->lexErrs = dllist_cat_eexpr_error(&pipe->lexErrs, &st->errStream);
+    st->errStream = dllist_empty_eexpr_error();
+    if (failed) { break; }
+    bool atEof = st->tokStream.len != 0 && st->tokStream.data[st->tokStream.len - 1].type == EEXPR_TOK_EOF;
+    size_t cut = atEof ? st->tokStream.len : engine_findCut(st);
+    if (cut != 0) {
+      pipeSegment* seg = malloc(sizeof(pipeSegment));
+      checkOom(seg);
+      seg->st = engine_splitSegment(st, cut);
+      for (size_t k = 0; k < ENGINE_N_COOK_STAGES; ++k) {
+        seg->cookErrs[k] = dllist_empty_eexpr_error();
+      }
+      ring_push(&pipe->lexed, seg);
+    }
+    if (atEof) { break; }
+    if (engine_pollStop(st)) { atomic_store(&pipe->stopped, true); }
+    if (atomic_load(&pipe->stopped)) { break; }
+  }
+  ring_push(&pipe->lexed, NULL);
+  return 0;
+}
+
+static
+int cookStage(void* arg) {
+  pipeline* pipe = arg;
+  pipeSegment* seg;
+  while ((seg = ring_pop(&pipe->lexed)) != NULL) {
+    if (!atomic_load(&pipe->stopped)) {
+      startStopChecks(pipe->parser, &seg->st);
+      engine_cookLexApart(&seg->st, seg->cookErrs);
+      if (seg->st.budget.exhausted) { atomic_store(&pipe->stopped, true); }
+    }
+    ring_push(&pipe->cooked, seg);
+  }
+  ring_push(&pipe->cooked, NULL);
+  return 0;
+}
+
+// Run the stages of parsing on separate threads, returning false (with no effect on the parser) if the threads could not be started.
+// If a stage stops early (for the deadline or stop callback), it also returns false, but sets `.interrupted`;
+//   the input has then been partly lexed, so the parser must be restarted on it before it is parsed as usual.
+static
+bool parsePipelined(eexpr_parser* parser) {
+  engine* whole = &parser->impl->st;
+  pipeline pipe;
+  pipe.parser = parser;
+  pipe.lexer = whole;
+  ring_init(&pipe.lexed);
+  ring_init(&pipe.cooked);
+  pipe.lexErrs = dllist_empty_eexpr_error();
+  atomic_init(&pipe.stopped, false);
+  startStopChecks(parser, whole);
+  thrd_t lexer, cooker;
+  if (thrd_create(&lexer, lexStage, &pipe) != thrd_success) {
+    ring_deinit(&pipe.lexed);
+    ring_deinit(&pipe.cooked);
+    return false;
+  }
+  if (thrd_create(&cooker, cookStage, &pipe) != thrd_success) {
+    // nothing else will take the lexer's output, so it has to be drained here
+    for (pipeSegment* seg; (seg = ring_pop(&pipe.lexed)) != NULL; ) {
+      engine_deinit(&seg->st);
+      free(seg);
+    }
+    thrd_join(lexer, NULL);
+    dllist_del_eexpr_error(&pipe.lexErrs);
+    ring_deinit(&pipe.lexed);
+    ring_deinit(&pipe.cooked);
+    return false;
+  }
+
+  eexpr_arena* parseArena = whole->arena == NULL ? NULL : newArena(4096);
+  dllist_eexpr_error cookErrs[ENGINE_N_COOK_STAGES];
+  for (size_t k = 0; k < ENGINE_N_COOK_STAGES; ++k) {
+    cookErrs[k] = dllist_empty_eexpr_error();
+  }
+  bool cookFailed = false;
+  dllist_eexpr_error parseErrs = dllist_empty_eexpr_error();
+  eexpr_error parseFatal = {.type = EEXPR_ERR_NOERROR};
+  for (pipeSegment* seg; (seg = ring_pop(&pipe.cooked)) != NULL; ) {
+    engine* st = &seg->st;
+    if (atomic_load(&pipe.stopped)) {
+      engine_deinit(st);
+      free(seg);
+      continue;
+    }
+    for (size_t k = 0; k < ENGINE_N_COOK_STAGES; ++k) {
+      st->errStream = seg->cookErrs[k];
+      cookFailed = cookFailed || anyErrors(&parser->isError, st);
+      cookErrs[k] = dllist_cat_eexpr_error(&cookErrs[k], &st->errStream);
+    }
+    st->errStream = dllist_empty_eexpr_error();
+    if (!cookFailed && parseFatal.type == EEXPR_ERR_NOERROR) {
+      st->arena = parseArena;
+      startStopChecks(parser, st);
+      engine_parse(st);
+      if (st->budget.exhausted) { atomic_store(&pipe.stopped, true); }
+      for (size_t i = 0; i < st->eexprStream.len; ++i) {
+        dynarr_push_eexpr_p(&whole->eexprStream, &st->eexprStream.data[i]);
+      }
+      st->eexprStream.len = 0;
+      parseErrs = dllist_cat_eexpr_error(&parseErrs, &st->errStream);
+      st->errStream = dllist_empty_eexpr_error();
+      parseFatal = st->fatal;
+    }
+    engine_deinit(st);
+    free(seg);
+  }
+  thrd_join(lexer, NULL);
+  thrd_join(cooker, NULL);
+  ring_deinit(&pipe.lexed);
+  ring_deinit(&pipe.cooked);
+
+  if (atomic_load(&pipe.stopped)) {
+    dllist_del_eexpr_error(&pipe.lexErrs);
+    for (size_t k = 0; k < ENGINE_N_COOK_STAGES; ++k) {
+      dllist_del_eexpr_error(&cookErrs[k]);
+    }
+    dllist_del_eexpr_error(&parseErrs);
+    // the eexprs parsed so far are freed along with the engine's output when it is restarted, or else along with their arena
+    if (parseArena != NULL) { eexpr_arenaRelease(parseArena); }
+    parser->interrupted = true;
+    return false;
+  }
+
+  { // report each stage's errors, stopping where the stages run in turn would have
+    whole->errStream = pipe.lexErrs;
+    drainErrors(parser, whole);
+    parser->impl->lexWarnings = parser->nWarnings;
+    if (parser->nErrors == 0) {
+      for (size_t k = 0; k < ENGINE_N_COOK_STAGES; ++k) {
+        whole->errStream = cookErrs[k];
+        cookErrs[k] = dllist_empty_eexpr_error();
+        drainErrors(parser, whole);
+      }
+    }
+    if (parser->nErrors == 0) {
+      whole->errStream = parseErrs;
+      parseErrs = dllist_empty_eexpr_error();
+      whole->fatal = parseFatal;
+      drainErrors(parser, whole);
+      if (parser->tokens != NULL) {
+        free(parser->tokens);
+        parser->nTokens = 0;
+        parser->tokens = NULL;
+      }
+      drainEexprs(parser);
+    }
+    for (size_t k = 0; k < ENGINE_N_COOK_STAGES; ++k) {
+      dllist_del_eexpr_error(&cookErrs[k]);
+    }
+    dllist_del_eexpr_error(&parseErrs);
+  }
+  if (parseArena != NULL) {
+    arena_adopt(&whole->arena->mem, &parseArena->mem);
+    eexpr_arenaRelease(parseArena);
+  }
+  return true;
+}
+
+#else
+
+static
+bool parseParallel(eexpr_parser* parser, size_t nBytes, uint8_t* input) {
+  (void)parser; (void)nBytes; (void)input;
+  return false;
 }
 
+static
+bool parsePipelined(eexpr_parser* parser) {
+  (void)parser;
+  return false;
+}
+
+#endif
+
+
 bool eexpr_parse(eexpr_parser* parser, size_t nBytes, uint8_t* utf8Input) {
-  if (parser->impl == NULL) { goto start; }
+  parser->interrupted = false;
+  if (parser->impl == NULL || parser->impl->restart) { goto start; }
+  else if (parser->impl->feedStopped) {
+    assert(nBytes == 0);
+    assert(utf8Input == NULL);
+    return feedStep(parser);
+  }
   else {
     assert(nBytes == 0);
     assert(utf8Input == NULL);
+    startBudget(parser);
     switch(parser->impl->resumeFrom) {
       case EEXPR_PAUSE_AFTER_START: goto rawlex;
       case EEXPR_PAUSE_AFTER_RAWLEX: goto cooklex;
@@ -119,16 +861,50 @@ bool eexpr_parse(eexpr_parser* parser, size_t nBytes, uint8_t* utf8Input) {
   } assert(false);
 
   start: {
-    // initialize internals
-    parser->impl = malloc(sizeof(eexpr_parserInternal));
-    checkOom(parser->impl);
-    // save input capacities; initialize output lengths
-    parser->impl->caps.eexprs = parser->nEexprs; parser->nEexprs = 0;
-    parser->impl->caps.tokens = parser->nTokens; parser->nTokens = 0;
-    parser->impl->caps.errors = parser->nErrors; parser->nErrors = 0;
-    parser->impl->caps.warnings = parser->nWarnings; parser->nWarnings = 0;
-    // initialize the engine
-    parser->impl->st = engine_newFromStrn(nBytes, utf8Input);
+    bool segmented = parser->onEexpr != NULL || parser->events != NULL;
+    // parsing on several threads cannot pause partway, so it would overrun a budget
+    bool wholeOutput = !segmented && parser->pauseAt >= EEXPR_PAUSE_AFTER_PARSE && !budgeted(parser);
+    bool bySegment = segmented || (wholeOutput && parser->pipeline);
+    if (parser->impl != NULL) {
+      restartInternals(parser, nBytes, utf8Input, bySegment);
+    }
+    else {
+      engine st = bySegment
+                ? engine_newForSegments(nBytes, utf8Input)
+                : engine_newFromStrn(nBytes, utf8Input);
+      configureEngine(parser, &st);
+      initInternals(parser, st, nBytes);
+    }
+    parser->impl->input = utf8Input;
+    parser->impl->inputBytes = nBytes;
+    parser->impl->lexedTokens = 0;
+    parser->impl->lexWarnings = 0;
+    if (segmented) {
+      // the stages run a segment at a time, so there is nowhere to pause
+      parser->impl->resumeFrom = EEXPR_DO_NOT_PAUSE;
+      return feedStep(parser);
+    }
+    if ( wholeOutput
+      && ( (parser->nThreads > 1 && parseParallel(parser, nBytes, utf8Input))
+        || (parser->pipeline && !parser->interrupted && parsePipelined(parser))
+         )
+       ) {
+      // there were no tokens to output along the way, so only the end result can be paused at
+      parser->impl->resumeFrom = EEXPR_PAUSE_AFTER_PARSE;
+      goto finish;
+    }
+    if (parser->interrupted) {
+      // the threads were stopped, and their work thrown away, so the next call starts over on a single thread
+      if (bySegment) {
+        // restarting would take the capacities of the output arrays from their lengths, which are zero by now
+        struct outputCaps caps = parser->impl->caps;
+        restartInternals(parser, nBytes, utf8Input, false);
+        parser->impl->caps = caps;
+      }
+      parser->impl->resumeFrom = EEXPR_PAUSE_AFTER_START;
+      return true;
+    }
+    startBudget(parser);
     // save progress and possibly pause
     parser->impl->resumeFrom = EEXPR_PAUSE_AFTER_START;
     if (parser->pauseAt == EEXPR_PAUSE_AFTER_START) { return true; }
@@ -137,8 +913,11 @@ bool eexpr_parse(eexpr_parser* parser, size_t nBytes, uint8_t* utf8Input) {
   rawlex: {
     if (parser->nErrors != 0) { return false; }
     engine_rawLex(&parser->impl->st);
+    if (stoppedEarly(parser)) { return true; }
+    parser->impl->lexedTokens = parser->impl->st.tokStream.len;
     drainTokens(parser);
-    drainErrors(parser);
+    drainErrors(parser, &parser->impl->st);
+    parser->impl->lexWarnings = parser->nWarnings;
     // save progress and possibly pause
     parser->impl->resumeFrom = EEXPR_PAUSE_AFTER_RAWLEX;
     if (parser->pauseAt == EEXPR_PAUSE_AFTER_RAWLEX) { return true; }
@@ -147,9 +926,10 @@ bool eexpr_parse(eexpr_parser* parser, size_t nBytes, uint8_t* utf8Input) {
   cooklex: {
     if (parser->nErrors != 0) { return false; }
     engine_cookLex(&parser->impl->st);
+    if (stoppedEarly(parser)) { return true; }
     drainTokens(parser);
-    drainErrors(parser);
-    assert(parser->impl->st.tokStream.start != NULL);
+    drainErrors(parser, &parser->impl->st);
+    assert(parser->impl->st.tokStream.len != 0);
     // save progress and possibly pause
     parser->impl->resumeFrom = EEXPR_PAUSE_AFTER_COOKLEX;
     if (parser->pauseAt == EEXPR_PAUSE_AFTER_COOKLEX) { return true; }
@@ -163,8 +943,9 @@ bool eexpr_parse(eexpr_parser* parser, size_t nBytes, uint8_t* utf8Input) {
       parser->tokens = NULL;
     }
     engine_parse(&parser->impl->st);
+    if (stoppedEarly(parser)) { return true; }
     drainEexprs(parser);
-    drainErrors(parser);
+    drainErrors(parser, &parser->impl->st);
     // save progress and possibly pause
     parser->impl->resumeFrom = EEXPR_PAUSE_AFTER_PARSE;
     if (parser->pauseAt == EEXPR_PAUSE_AFTER_PARSE) { return true; }
@@ -177,6 +958,461 @@ bool eexpr_parse(eexpr_parser* parser, size_t nBytes, uint8_t* utf8Input) {
 }
 
 
+bool eexpr_parseFeed(eexpr_parser* parser, size_t nBytes, const uint8_t* chunk) {
+  if (parser->impl == NULL) {
+    initInternals(parser, engine_newForFeed(), 0);
+  }
+  assert(parser->impl->st.feed.active && !parser->impl->st.feed.final);
+  parser->nEexprs = 0;
+  parser->eexprs = NULL;
+  if (parser->nErrors != 0) { return false; }
+  str in = {.len = nBytes, .bytes = (uint8_t*)chunk};
+  engine_feed(&parser->impl->st, in);
+  return feedStep(parser);
+}
+
+bool eexpr_parseFinish(eexpr_parser* parser) {
+  if (parser->impl == NULL) {
+    initInternals(parser, engine_newForFeed(), 0);
+  }
+  // it is called again to carry on once it has stopped early
+  assert(parser->impl->st.feed.active && (!parser->impl->st.feed.final || parser->impl->feedStopped));
+  parser->nEexprs = 0;
+  parser->eexprs = NULL;
+  if (parser->nErrors != 0) { return false; }
+  if (!parser->impl->st.feed.final) { engine_feedEnd(&parser->impl->st); }
+  return feedStep(parser);
+}
+
+
+//////////////////////////////////// Batch Parsing ////////////////////////////////////
+
+typedef struct batch {
+  eexpr_parser* workers; // one parser per worker, each re-used for every input that worker parses
+  eexpr_batchDoc* docs;
+} batch;
+
+static
+void parseDoc(void* ctx, unsigned worker, size_t i) {
+  batch* b = ctx;
+  eexpr_parser* parser = &b->workers[worker];
+  eexpr_batchDoc* doc = &b->docs[i];
+  // the outputs of the last input now belong to the caller, so only the parser's internal buffers are kept
+  parser->eexprs = NULL;
+  parser->errors = NULL;
+  parser->warnings = NULL;
+  eexpr_parser_reset(parser);
+  doc->ok = eexpr_parse(parser, doc->nBytes, doc->utf8Input);
+  doc->nEexprs = parser->nEexprs; doc->eexprs = parser->eexprs;
+  doc->nErrors = parser->nErrors; doc->errors = parser->errors;
+  doc->nWarnings = parser->nWarnings; doc->warnings = parser->warnings;
+  doc->arena = parser->arena;
+}
+
+bool eexpr_parseBatch(const eexpr_parser* config, unsigned nWorkers, size_t nDocs, eexpr_batchDoc* docs) {
+  if (nWorkers == 0) { nWorkers = 1; }
+  if (nWorkers > nDocs) { nWorkers = nDocs == 0 ? 1 : nDocs; }
+  batch b = {.docs = docs};
+  b.workers = malloc(nWorkers * sizeof(eexpr_parser));
+  checkOom(b.workers);
+  for (unsigned w = 0; w < nWorkers; ++w) {
+    eexpr_parser* parser = &b.workers[w];
+    eexpr_parserInitDefault(parser);
+    parser->isError = config->isError;
+    parser->useArena = config->useArena;
+    parser->borrowInput = config->borrowInput;
+    parser->lazyNumbers = config->lazyNumbers;
+  }
+  for (size_t i = 0; i < nDocs; ++i) {
+    docs[i].ok = false;
+    docs[i].nEexprs = 0; docs[i].eexprs = NULL;
+    docs[i].nErrors = 0; docs[i].errors = NULL;
+    docs[i].nWarnings = 0; docs[i].warnings = NULL;
+    docs[i].arena = NULL;
+  }
+  pool_run(nDocs, nWorkers, parseDoc, &b);
+  for (unsigned w = 0; w < nWorkers; ++w) {
+    eexpr_parser_deinit(&b.workers[w]);
+  }
+  free(b.workers);
+  bool ok = true;
+  for (size_t i = 0; i < nDocs; ++i) {
+    ok = ok && docs[i].ok;
+  }
+  return ok;
+}
+
+
+//////////////////////////////////// Fragment Parsing ////////////////////////////////////
+
+// Fragments up to about this many bytes have their tokens lexed into a buffer on the stack.
+// Every token but the last takes up at least a byte of input, so a buffer of this many tokens is rarely outgrown.
+#define FRAGMENT_STACK_TOKENS 32
+
+// Look for an error among what the engine has reported so far, skipping over warnings, and failing that, take its fatal error.
+// Everything reported is dropped either way; returns whether an error was found.
+static
+bool takeFirstError(const struct eexpr_parseErrorLevels* levels, engine* st, eexpr_error* err) {
+  bool found = false;
+  for (dllistNode_eexpr_error* node = st->errStream.start; node != NULL && !found; node = node->next) {
+    if (isError(levels, &node->here)) {
+      if (err != NULL) { *err = node->here; }
+      found = true;
+    }
+  }
+  dllist_del_eexpr_error(&st->errStream);
+  if (!found && st->fatal.type != EEXPR_ERR_NOERROR) {
+    if (err != NULL) { *err = st->fatal; }
+    found = true;
+  }
+  return found;
+}
+
+bool eexpr_parseExpr(const eexpr_parser* config, size_t nBytes, uint8_t* utf8Input, eexpr** out, eexpr_error* err) {
+  eexpr_token toks[FRAGMENT_STACK_TOKENS];
+  engine st = engine_newForFragment(nBytes, utf8Input, toks, FRAGMENT_STACK_TOKENS);
+  st.borrowInput = config->borrowInput;
+  st.lazyNumbers = config->borrowInput && config->lazyNumbers;
+  *out = NULL;
+  bool ok = false;
+  engine_rawLex(&st);
+  if (takeFirstError(&config->isError, &st, err)) { goto finish; }
+  engine_cookLex(&st);
+  if (takeFirstError(&config->isError, &st, err)) { goto finish; }
+  eexpr* expr = engine_parseFragment(&st);
+  if (takeFirstError(&config->isError, &st, err)) {
+    if (expr != NULL) { eexpr_del(expr); }
+    goto finish;
+  }
+  *out = expr;
+  ok = true;
+  finish:
+  engine_deinit(&st);
+  return ok;
+}
+
+
+//////////////////////////////////// Reparsing ////////////////////////////////////
+
+/*
+After an edit, only a region of the input around it is lexed, cooked and parsed again.
+The region runs from the start of a top-level eexpr before the edit to the start of one after it,
+  both of which must be where the token stream can be split (see `engine_findCut`),
+  so that the region comes out the same on its own as it would as part of the whole input (just as the pieces of `parseParallel` do).
+Its eexprs take the place of the old ones from the region, and those after it are moved to their new locations.
+That takes a pass over their nodes, but no lexing or parsing.
+*/
+
+// How to move an eexpr from where it was in the old input to where it is in the new one.
+typedef struct relocation {
+  size_t lines; // added to line numbers, modulo `SIZE_MAX + 1` (so lines can also be taken away)
+  size_t bytes; // likewise added to byte offsets
+  // text borrowed from the old input is moved to the same place in the new one, plus `bytes`
+  uintptr_t oldInput;
+  size_t oldBytes;
+  uint8_t* newInput;
+} relocation;
+
+static
+void relocateLoc(const relocation* by, eexpr_loc* loc) {
+  loc->start.line += by->lines;
+  loc->start.byte += by->bytes;
+  loc->end.line += by->lines;
+  loc->end.byte += by->bytes;
+}
+
+static
+void relocateText(const relocation* by, uint8_t** text) {
+  uintptr_t at = (uintptr_t)*text;
+  if (*text == NULL || at < by->oldInput || at - by->oldInput > by->oldBytes) { return; }
+  *text = by->newInput + (at - by->oldInput) + by->bytes;
+}
+
+static inline
+void pushRelocation(dynarr_eexpr_p* todo, eexpr* expr) {
+  if (expr != NULL) { dynarr_push_eexpr_p(todo, &expr); }
+}
+
+// Relocate each of the eexprs, along with all their subexprs.
+static
+void relocateEexprs(const relocation* by, size_t n, eexpr** xs) {
+  if (n == 0) { return; }
+  dynarr_eexpr_p todo;
+  dynarr_init_eexpr_p(&todo, 32);
+  for (size_t i = 0; i < n; ++i) {
+    pushRelocation(&todo, xs[i]);
+  }
+  while (todo.len != 0) {
+    eexpr* self = todo.data[--todo.len];
+    relocateLoc(by, &self->loc);
+    switch (self->type) {
+      case EEXPR_SYMBOL: {
+        if (self->borrowedText) { relocateText(by, &self->as.symbol.text.bytes); }
+      }; break;
+      case EEXPR_NUMBER: {
+        if (self->undecoded) { relocateText(by, &self->as.lazyNumber.src.bytes); }
+      }; break;
+      case EEXPR_STRING: {
+        if (self->borrowedText) { relocateText(by, &self->as.string.text1.bytes); }
+        for (size_t i = 0; i < self->as.string.parts.len; ++i) {
+          strTemplPart* part = &self->as.string.parts.data[i];
+          if (self->borrowedText) { relocateText(by, &part->utf8str); }
+          pushRelocation(&todo, part->subexpr);
+        }
+      }; break;
+      case EEXPR_PAREN: case EEXPR_BRACK: case EEXPR_BRACE: case EEXPR_PREDOT: {
+        pushRelocation(&todo, self->as.wrap);
+      }; break;
+      case EEXPR_BLOCK: case EEXPR_CHAIN: case EEXPR_SPACE: case EEXPR_COMMA: case EEXPR_SEMICOLON: {
+        for (size_t i = 0; i < self->as.list.len; ++i) {
+          pushRelocation(&todo, self->as.list.data[i]);
+        }
+      }; break;
+      case EEXPR_ELLIPSIS: case EEXPR_COLON: {
+        pushRelocation(&todo, self->as.pair[0]);
+        pushRelocation(&todo, self->as.pair[1]);
+      }; break;
+    }
+  }
+  dynarr_deinit_eexpr_p(&todo);
+}
+
+// The bytes of the old input that were parsed again, and how to move everything after them.
+typedef struct reparsedRegion {
+  size_t start;
+  size_t end; // `SIZE_MAX` when the region runs to the end of the input, so that problems found at the very end are in it
+  relocation after;
+} reparsedRegion;
+
+// Append the warnings in `old` (skipping those of the other kind, depending on `noTrailingNewline`),
+//   except those from within the region, whose place is taken by the warnings in `fresh` (in order of position).
+static
+void spliceWarnings(const reparsedRegion* region, eexpr_error* out, size_t* len, size_t n, const eexpr_error* old, dllist_eexpr_error* fresh, bool noTrailingNewline) {
+  bool spliced = false;
+  for (size_t i = 0; i < n; ++i) {
+    if ((old[i].type == EEXPR_ERR_NO_TRAILING_NEWLINE) != noTrailingNewline) { continue; }
+    eexpr_error err = old[i];
+    if (err.loc.start.byte >= region->start) {
+      if (!spliced) {
+        for (dllistNode_eexpr_error* node = fresh->start; node != NULL; node = node->next) {
+          out[(*len)++] = node->here;
+        }
+        spliced = true;
+      }
+      if (err.loc.start.byte < region->end) { continue; }
+      relocateLoc(&region->after, &err.loc);
+    }
+    out[(*len)++] = err;
+  }
+  if (!spliced) {
+    for (dllistNode_eexpr_error* node = fresh->start; node != NULL; node = node->next) {
+      out[(*len)++] = node->here;
+    }
+  }
+  dllist_del_eexpr_error(fresh);
+}
+
+// Free the output of the last parse, then parse the whole (edited) input again.
+static
+bool reparseWhole(eexpr_parser* parser, size_t nBytes, uint8_t* utf8Input) {
+  if (parser->arena != NULL) {
+    // hand the arena back to the engine, which frees it once it has finished with anything of its own in there
+    parser->arena = NULL;
+  }
+  else {
+    for (size_t i = 0; i < parser->nEexprs; ++i) {
+      eexpr_del(parser->eexprs[i]);
+    }
+  }
+  eexpr_parser_reset(parser);
+  return eexpr_parse(parser, nBytes, utf8Input);
+}
+
+// Whether a top-level eexpr, starting `at` bytes into the input, begins where the token stream can be split.
+// (Every such place in an input that parsed without errors is one, so long as the input before it is unchanged.)
+static
+bool startsAtCut(const eexpr* expr, size_t at, size_t nBytes, const uint8_t* input) {
+  return expr->loc.start.col == 0 && at < nBytes && canStartPiece(input[at]);
+}
+
+bool eexpr_reparse(eexpr_parser* parser, size_t editStart, size_t oldLen, size_t newLen, size_t nBytes, uint8_t* utf8Input) {
+  eexpr_parserInternal* impl = parser->impl;
+  assert(impl != NULL && !impl->restart);
+  assert(impl->resumeFrom == EEXPR_PAUSE_AFTER_PARSE || parser->nErrors != 0);
+  assert(parser->pauseAt >= EEXPR_PAUSE_AFTER_PARSE);
+  assert(parser->onEexpr == NULL && parser->events == NULL && !parser->flatOutput);
+  engine* whole = &impl->st;
+  parser->interrupted = false;
+  // an edit that does not fit the last input gives nothing to go by, but the edited input is still whole
+  bool editFits = editStart <= impl->inputBytes
+               && oldLen <= impl->inputBytes - editStart
+               && newLen <= nBytes
+               && nBytes - newLen == impl->inputBytes - oldLen;
+  if (!editFits) { return reparseWhole(parser, nBytes, utf8Input); }
+  // with errors, there may be no eexprs to go by (and there is no telling how far the errors reach)
+  if (parser->nErrors != 0) { return reparseWhole(parser, nBytes, utf8Input); }
+
+  eexpr** xs = parser->eexprs;
+  size_t n = parser->nEexprs;
+  size_t delta = newLen - oldLen; // modulo `SIZE_MAX + 1`, like a `relocation`
+  // the region starts at the last top-level eexpr that starts before the edit and at a cut, or else at the start of the input
+  size_t first = 0;
+  size_t regionStart = 0;
+  size_t startLine = 0;
+  { // eexprs are in order of position, so binary search for the first one that starts at or after the edit
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (xs[mid]->loc.start.byte < editStart) { lo = mid + 1; }
+      else { hi = mid; }
+    }
+    for (size_t k = lo; k-- > 0;) {
+      if (startsAtCut(xs[k], xs[k]->loc.start.byte, nBytes, utf8Input)) {
+        first = k;
+        regionStart = xs[k]->loc.start.byte;
+        startLine = xs[k]->loc.start.line;
+        break;
+      }
+    }
+  }
+  // and it ends at the first top-level eexpr that starts after the edit and at a cut, or else at the end of the input
+  size_t last = n;
+  size_t regionEnd = impl->inputBytes;
+  {
+    size_t editEnd = editStart + oldLen;
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (xs[mid]->loc.start.byte <= editEnd) { lo = mid + 1; }
+      else { hi = mid; }
+    }
+    for (size_t k = lo; k < n; ++k) {
+      if (startsAtCut(xs[k], xs[k]->loc.start.byte + delta, nBytes, utf8Input)) {
+        last = k;
+        regionEnd = xs[k]->loc.start.byte;
+        break;
+      }
+    }
+  }
+
+  engine piece = engine_newForPiece(regionEnd + delta - regionStart, &utf8Input[regionStart], regionStart);
+  piece.borrowInput = whole->borrowInput;
+  piece.lazyNumbers = whole->lazyNumbers;
+  piece.arena = whole->arena;
+  dllist_eexpr_error lexWarns = dllist_empty_eexpr_error();
+  dllist_eexpr_error cookWarns = dllist_empty_eexpr_error();
+  newlineType newline = whole->discoveredNewline;
+  eexpr_indentType indent = whole->indent.type;
+  { // lex the region, and check that it lexed as it would have as part of the whole input
+    engine_rawLex(&piece);
+    // as with `piecesAgree`, errors might be down to a bad choice of region, so let the whole input sort them out
+    if (anyErrors(&parser->isError, &piece)) { goto fallback; }
+    if (regionStart != 0 && !engine_startsAtCut(&piece)) { goto fallback; }
+    if (last != n && !engine_endsAtCut(&piece)) { goto fallback; }
+    if (regionStart == 0 && last == n) {
+      // the region is the whole input, so it sets the kinds of newline and indentation by itself
+      newline = piece.discoveredNewline;
+      indent = piece.indent.type;
+    }
+    if (piece.discoveredNewline != NEWLINE_NONE) {
+      if (newline != NEWLINE_NONE && newline != piece.discoveredNewline) { goto fallback; }
+      newline = piece.discoveredNewline;
+    }
+    if (piece.indent.type != EEXPR_INDENT_NULL) {
+      if (indent != EEXPR_INDENT_NULL && indent != piece.indent.type) { goto fallback; }
+      indent = piece.indent.type;
+    }
+    engine_shiftLines(&piece, startLine);
+    lexWarns = piece.errStream;
+    piece.errStream = dllist_empty_eexpr_error();
+  }
+  { // cook and parse the region
+    engine_cookLex(&piece);
+    if (anyErrors(&parser->isError, &piece)) { goto fallback; }
+    cookWarns = piece.errStream;
+    piece.errStream = dllist_empty_eexpr_error();
+    engine_parse(&piece);
+    if (piece.fatal.type != EEXPR_ERR_NOERROR || piece.errStream.start != NULL) { goto fallback; }
+  }
+
+  reparsedRegion region =
+    { .start = regionStart
+    , .end = last == n ? SIZE_MAX : regionEnd
+    , .after =
+      { .lines = last == n ? 0 : piece.loc.line - xs[last]->loc.start.line
+      , .bytes = delta
+      , .oldInput = (uintptr_t)impl->input
+      , .oldBytes = impl->inputBytes
+      , .newInput = utf8Input
+      }
+    };
+  { // put the region's eexprs in place of the old ones, and move those after them
+    size_t nRegion = piece.eexprStream.len;
+    size_t newN = first + nRegion + (n - last);
+    if (whole->arena == NULL) {
+      // (in arena mode, the old eexprs are only freed along with the arena)
+      for (size_t i = first; i < last; ++i) {
+        eexpr_del(xs[i]);
+      }
+    }
+    relocateEexprs(&region.after, n - last, &xs[last]);
+    if (newN > impl->caps.eexprs) {
+      impl->caps.eexprs = newN < 2 * impl->caps.eexprs ? 2 * impl->caps.eexprs : newN;
+      xs = realloc(xs, impl->caps.eexprs * sizeof(eexpr*));
+      checkOom(xs);
+    }
+    memmove(&xs[first + nRegion], &xs[last], (n - last) * sizeof(eexpr*));
+    memcpy(&xs[first], piece.eexprStream.data, nRegion * sizeof(eexpr*));
+    piece.eexprStream.len = 0;
+    parser->eexprs = xs;
+    parser->nEexprs = newN;
+    if (whole->borrowInput && utf8Input != impl->input) {
+      // the eexprs before the region stay put, but the text they borrow may have moved along with the input
+      relocation moved = region.after;
+      moved.lines = 0;
+      moved.bytes = 0;
+      relocateEexprs(&moved, first, xs);
+    }
+  }
+  { // likewise for the warnings, which come out grouped by stage, and in order of position within each stage
+    size_t nFresh = 0;
+    for (dllistNode_eexpr_error* node = lexWarns.start; node != NULL; node = node->next) { nFresh += 1; }
+    for (dllistNode_eexpr_error* node = cookWarns.start; node != NULL; node = node->next) { nFresh += 1; }
+    size_t cap = parser->nWarnings + nFresh;
+    eexpr_error* out = malloc((cap == 0 ? 1 : cap) * sizeof(eexpr_error));
+    checkOom(out);
+    size_t len = 0;
+    const eexpr_error* old = parser->warnings;
+    size_t nLex = impl->lexWarnings;
+    spliceWarnings(&region, out, &len, nLex, old, &lexWarns, false);
+    impl->lexWarnings = len;
+    // the postlexer reports a missing trailing newline before anything else
+    dllist_eexpr_error missingNewline = dllist_empty_eexpr_error();
+    if (cookWarns.start != NULL && cookWarns.start->here.type == EEXPR_ERR_NO_TRAILING_NEWLINE) {
+      dllist_moveAfter_eexpr_error(&missingNewline, NULL, &cookWarns, cookWarns.start);
+    }
+    spliceWarnings(&region, out, &len, parser->nWarnings - nLex, &old[nLex], &missingNewline, true);
+    spliceWarnings(&region, out, &len, parser->nWarnings - nLex, &old[nLex], &cookWarns, false);
+    free(parser->warnings);
+    parser->warnings = out;
+    parser->nWarnings = len;
+    impl->caps.warnings = cap == 0 ? 1 : cap;
+  }
+  whole->discoveredNewline = newline;
+  whole->indent.type = indent;
+  impl->input = utf8Input;
+  impl->inputBytes = nBytes;
+  engine_deinit(&piece);
+  return true;
+
+  fallback: {
+    dllist_del_eexpr_error(&lexWarns);
+    dllist_del_eexpr_error(&cookWarns);
+    engine_deinit(&piece);
+    return reparseWhole(parser, nBytes, utf8Input);
+  }
+}
+
 
 void eexpr_parserInitDefault(eexpr_parser* parser) {
   parser->nEexprs = 0; parser->eexprs = NULL;
@@ -186,9 +1422,43 @@ void eexpr_parserInitDefault(eexpr_parser* parser) {
   struct eexpr_parseErrorLevels opts = { false, false, false, false, false };
   parser->isError = opts;
   parser->pauseAt = EEXPR_DO_NOT_PAUSE;
+  parser->useArena = false;
+  parser->arena = NULL;
+  parser->borrowInput = false;
+  parser->lazyNumbers = false;
+  parser->flatOutput = false;
+  parser->flat = NULL;
+  parser->onEexpr = NULL;
+  parser->onEexprCtx = NULL;
+  parser->events = NULL;
+  parser->nThreads = 1;
+  parser->pipeline = false;
+  parser->budget = 0;
+  parser->deadline.tv_sec = 0;
+  parser->deadline.tv_nsec = 0;
+  parser->shouldStop = NULL;
+  parser->shouldStopCtx = NULL;
+  parser->interrupted = false;
   parser->impl = NULL;
 }
 
+void eexpr_parser_reset(eexpr_parser* parser) {
+  if (parser->impl == NULL) { return; }
+  eexpr_parserInternal* impl = parser->impl;
+  if (impl->st.eexprStream.data == NULL && parser->eexprs != NULL) {
+    // take back the array handed over by the last parse
+    impl->st.eexprStream.data = parser->eexprs;
+    impl->st.eexprStream.cap = impl->caps.eexprs;
+  }
+  // the remaining output arrays are passed back in to be filled again
+  parser->nEexprs = 0;
+  parser->eexprs = NULL;
+  parser->nTokens = parser->tokens == NULL ? 0 : impl->caps.tokens;
+  parser->nErrors = parser->errors == NULL ? 0 : impl->caps.errors;
+  parser->nWarnings = parser->warnings == NULL ? 0 : impl->caps.warnings;
+  impl->restart = true;
+}
+
 void eexpr_parser_deinit(eexpr_parser* parser) {
   if (parser->impl == NULL) { return; }
   if (parser->tokens != NULL) { free(parser->tokens); }
@@ -198,7 +1468,13 @@ void eexpr_parser_deinit(eexpr_parser* parser) {
     parser->impl->st.eexprStream.cap = 0;
     parser->impl->st.eexprStream.data = NULL;
   }
+  // the arena is only ours to free if it was never handed over to the caller
+  eexpr_arena* arena = parser->impl->st.arena;
   engine_deinit(&parser->impl->st);
+  if (arena != parser->arena) {
+    eexpr_arenaRelease(arena);
+  }
+  eexpr_arenaRelease(parser->impl->spareArena);
   free(parser->impl); // free the internal state
   parser->impl = NULL;
 }
@@ -212,87 +1488,77 @@ void eexpr_del(eexpr* self) {
   free(self);
 }
 
-void eexpr_deinit(eexpr* self) {
-  if (self == NULL) { return; }
-  switch (self->type) {
-    case EEXPR_SYMBOL: {
-      if (self->as.symbol.text.bytes != NULL) { free(self->as.symbol.text.bytes); }
-    }; break;
-    case EEXPR_NUMBER: {
-      free(self->as.number.mantissa.buf);
-      free(self->as.number.exponent.buf);
-    }; break;
-    case EEXPR_STRING: {
-      free(self->as.string.text1.bytes);
-      for (size_t i = 0; i < self->as.string.parts.len; ++i) {
-        eexpr_del(self->as.string.parts.data[i].subexpr);
-        free(self->as.string.parts.data[i].utf8str);
-      }
-      dynarr_deinit_strTemplPart(&self->as.string.parts);
-    }; break;
-    case EEXPR_PAREN: {
-      if (self->as.wrap != NULL) {
-        eexpr_del(self->as.wrap);
-      }
-    }; break;
-    case EEXPR_BRACK: {
-      if (self->as.wrap != NULL) {
-        eexpr_del(self->as.wrap);
-      }
-    }; break;
-    case EEXPR_BRACE: {
-      if (self->as.wrap != NULL) {
-        eexpr_del(self->as.wrap);
-      }
-    }; break;
-    case EEXPR_BLOCK: {
-      for (size_t i = 0; i < self->as.list.len; ++i) {
-        eexpr_del(self->as.list.data[i]);
-      }
-      dynarr_deinit_eexpr_p(&self->as.list);
-    }; break;
-    case EEXPR_PREDOT: {
-      eexpr_del(self->as.wrap);
-    }; break;
-    case EEXPR_CHAIN: {
-      for (size_t i = 0; i < self->as.list.len; ++i) {
-        eexpr_del(self->as.list.data[i]);
-      }
-      dynarr_deinit_eexpr_p(&self->as.list);
+void eexpr_arenaRelease(eexpr_arena* arena) {
+  if (arena == NULL) { return; }
+  arena_deinit(&arena->mem);
+  free(arena);
+}
+
+// Free the data owned by an eexpr, except that its subexprs are pushed onto the `doomed` list to be freed later.
+// The list is threaded through the subexprs themselves, so freeing a whole tree needs neither recursion nor allocation.
+static
+void releaseData(eexpr* self, eexpr** doomed);
+
+static inline
+void doom(eexpr** doomed, eexpr* expr) {
+  if (expr == NULL) { return; }
+  if (expr->type == EEXPR_SYMBOL || expr->type == EEXPR_NUMBER) {
+    // most eexprs are leaves, which have no subexprs to wait for, so there is no point putting them on the list
+    releaseData(expr, doomed);
+    free(expr);
+    return;
+  }
+  expr->nextDoomed = *doomed;
+  *doomed = expr;
+}
+static
+void releaseData(eexpr* self, eexpr** doomed) {
+  switch (self->type) {
+    case EEXPR_SYMBOL: {
+      if (self->as.symbol.text.bytes != NULL && !self->borrowedText) { free(self->as.symbol.text.bytes); }
     }; break;
-    case EEXPR_SPACE: {
-      for (size_t i = 0; i < self->as.list.len; ++i) {
-        eexpr_del(self->as.list.data[i]);
-      }
-      dynarr_deinit_eexpr_p(&self->as.list);
+    case EEXPR_NUMBER: {
+      if (self->undecoded) { break; }
+      free(self->as.number.mantissa.buf);
+      free(self->as.number.exponent.buf);
     }; break;
-    case EEXPR_ELLIPSIS: {
-      if (self->as.ellipsis[0] != NULL) {
-        eexpr_del(self->as.ellipsis[0]);
-      }
-      if (self->as.ellipsis[1] != NULL) {
-        eexpr_del(self->as.ellipsis[1]);
+    case EEXPR_STRING: {
+      if (!self->borrowedText) { free(self->as.string.text1.bytes); }
+      for (size_t i = 0; i < self->as.string.parts.len; ++i) {
+        doom(doomed, self->as.string.parts.data[i].subexpr);
+        if (!self->borrowedText) { free(self->as.string.parts.data[i].utf8str); }
       }
+      dynarr_deinit_strTemplPart(&self->as.string.parts);
     }; break;
-    case EEXPR_COLON: {
-      eexpr_del(self->as.pair[0]);
-      eexpr_del(self->as.pair[1]);
+    case EEXPR_PAREN: case EEXPR_BRACK: case EEXPR_BRACE: case EEXPR_PREDOT: {
+      doom(doomed, self->as.wrap);
     }; break;
-    case EEXPR_COMMA: {
-      for (size_t i = 0; i < self->as.list.len; ++i) {
-        eexpr_del(self->as.list.data[i]);
+    case EEXPR_BLOCK: case EEXPR_CHAIN: case EEXPR_SPACE: case EEXPR_COMMA: case EEXPR_SEMICOLON: {
+      // doomed back-to-front, so that they are popped off the list (and freed) in source order
+      for (size_t i = self->as.list.len; i-- > 0;) {
+        doom(doomed, self->as.list.data[i]);
       }
       dynarr_deinit_eexpr_p(&self->as.list);
     }; break;
-    case EEXPR_SEMICOLON: {
-      for (size_t i = 0; i < self->as.list.len; ++i) {
-        eexpr_del(self->as.list.data[i]);
-      }
-      dynarr_deinit_eexpr_p(&self->as.list);
+    case EEXPR_ELLIPSIS: case EEXPR_COLON: {
+      doom(doomed, self->as.pair[0]);
+      doom(doomed, self->as.pair[1]);
     }; break;
   }
 }
 
+void eexpr_deinit(eexpr* self) {
+  if (self == NULL) { return; }
+  eexpr* doomed = NULL;
+  releaseData(self, &doomed);
+  while (doomed != NULL) {
+    eexpr* next = doomed;
+    doomed = next->nextDoomed;
+    releaseData(next, &doomed);
+    free(next);
+  }
+}
+
 
 eexpr_loc eexpr_locate(const eexpr* self) {
   return self->loc;
@@ -312,14 +1578,19 @@ bool eexpr_asSymbol(const eexpr* self, size_t* nBytes, uint8_t** utf8str) {
 
 bool eexpr_asNumber(const eexpr* self, eexpr_number* value) {
   if (self->type != EEXPR_NUMBER) { return false; }
+  if (self->undecoded) { // memoize the decoded number in place
+    eexpr* mut = (eexpr*)self;
+    mut->as.number = engine_forceNumber(mut->as.lazyNumber);
+    mut->undecoded = false;
+  }
   value->isPositive = self->as.number.mantissa.pos;
   value->nBigDigits = self->as.number.mantissa.len;
-  value->bigDigits = self->as.number.mantissa.buf;
+  value->bigDigits = self->as.number.mantissa.len == 0 ? NULL : (uint32_t*)bigint_digits(&self->as.number.mantissa);
   value->radix = self->as.number.radix;
   value->nFracDigits = self->as.number.fractionalDigits;
   value->isPositive_exp = self->as.number.exponent.pos;
   value->nBigDigits_exp = self->as.number.exponent.len;
-  value->bigDigits_exp = self->as.number.exponent.buf;
+  value->bigDigits_exp = self->as.number.exponent.len == 0 ? NULL : (uint32_t*)bigint_digits(&self->as.number.exponent);
   assert(value->nBigDigits == 0 ? (value->bigDigits == NULL && !value->isPositive) : true);
   assert(value->nBigDigits_exp == 0 ? (value->bigDigits_exp == NULL && !value->isPositive_exp) : true);
   return true;
@@ -412,6 +1683,825 @@ bool eexpr_asSemicolon(const eexpr* self, size_t* nSubexprs, eexpr*** subexprs)
 }
 
 
+//////////////////////////////////// Walking Eexprs ////////////////////////////////////
+
+// Walks up to this deep keep their stack in a buffer on the C stack.
+#define WALK_STACK_FRAMES 32
+
+typedef struct walkFrame {
+  const eexpr* self; // the depth of `self` is its index in the stack
+  eexpr* const* subexprs; // NULL for a string template, whose subexprs are spread through its parts
+  size_t nSubexprs;
+  size_t next; // index of the next subexpr to walk
+} walkFrame;
+
+// Where to find the subexprs of an eexpr, worked out once as the walk enters it.
+static
+void walkFrameInit(walkFrame* frame, const eexpr* self) {
+  frame->self = self;
+  frame->next = 0;
+  switch (self->type) {
+    case EEXPR_SYMBOL: case EEXPR_NUMBER: {
+      frame->subexprs = NULL;
+      frame->nSubexprs = 0;
+    }; break;
+    case EEXPR_STRING: {
+      frame->subexprs = NULL;
+      frame->nSubexprs = self->as.string.parts.len;
+    }; break;
+    case EEXPR_PAREN: case EEXPR_BRACK: case EEXPR_BRACE: case EEXPR_PREDOT: {
+      frame->subexprs = &self->as.wrap;
+      frame->nSubexprs = 1;
+    }; break;
+    case EEXPR_BLOCK: case EEXPR_CHAIN: case EEXPR_SPACE: case EEXPR_COMMA: case EEXPR_SEMICOLON: {
+      frame->subexprs = self->as.list.data;
+      frame->nSubexprs = self->as.list.len;
+    }; break;
+    case EEXPR_ELLIPSIS: case EEXPR_COLON: {
+      frame->subexprs = self->as.pair;
+      frame->nSubexprs = 2;
+    }; break;
+  }
+}
+
+// Make room for one more frame on top of the `len` in `*stack`, which starts out as `buf` and is moved to the heap once it outgrows it.
+static
+void walkStackReserve(walkFrame buf[WALK_STACK_FRAMES], walkFrame** stack, size_t* cap, size_t len) {
+  if (len < *cap) { return; }
+  *cap *= 2;
+  walkFrame* grown = *stack == buf ? malloc(*cap * sizeof(walkFrame)) : realloc(*stack, *cap * sizeof(walkFrame));
+  checkOom(grown);
+  if (*stack == buf) { memcpy(grown, buf, WALK_STACK_FRAMES * sizeof(walkFrame)); }
+  *stack = grown;
+}
+
+bool eexpr_walk(const eexpr* root, const eexpr_walker* walker) {
+  if (root == NULL) { return true; }
+  walkFrame buf[WALK_STACK_FRAMES];
+  walkFrame* stack = buf;
+  size_t cap = WALK_STACK_FRAMES;
+  size_t len = 0;
+  bool ok = false;
+  const eexpr* self = root;
+  while (true) {
+    { // enter `self`
+      eexpr_walkStep step = walker->enter == NULL ? EEXPR_WALK_CONTINUE : walker->enter(walker->ctx, self, len);
+      if (step == EEXPR_WALK_STOP) { goto finish; }
+      walkStackReserve(buf, &stack, &cap, len);
+      walkFrameInit(&stack[len], self);
+      if (step == EEXPR_WALK_SKIP) { stack[len].nSubexprs = 0; }
+      len += 1;
+    }
+    self = NULL;
+    while (self == NULL) { // find the next subexpr to enter, exiting every eexpr that has none left
+      walkFrame* top = &stack[len - 1];
+      if (top->next < top->nSubexprs) {
+        size_t i = top->next++;
+        self = top->subexprs != NULL ? top->subexprs[i] : top->self->as.string.parts.data[i].subexpr;
+        continue;
+      }
+      len -= 1;
+      eexpr_walkStep step = walker->exit == NULL ? EEXPR_WALK_CONTINUE : walker->exit(walker->ctx, top->self, len);
+      if (step == EEXPR_WALK_STOP) { goto finish; }
+      if (len == 0) {
+        ok = true;
+        goto finish;
+      }
+    }
+  }
+  finish: {
+    if (stack != buf) { free(stack); }
+    return ok;
+  }
+}
+
+// Like a walk, but the events need to know where the missing subexprs are, and the text in between the subexprs of a string,
+//   so it keeps its own stack of the same frames.
+static
+void emitEvents(const eexpr_events* ev, const eexpr* root) {
+  walkFrame buf[WALK_STACK_FRAMES];
+  walkFrame* stack = buf;
+  size_t cap = WALK_STACK_FRAMES;
+  size_t len = 0;
+  const eexpr* self = root;
+  while (true) {
+    // start `self`, which is NULL for a missing subexpr
+    if (self == NULL) {
+      if (ev->absent != NULL) { ev->absent(ev->ctx); }
+    }
+    else if (self->type == EEXPR_SYMBOL) {
+      if (ev->symbol != NULL) {
+        ev->symbol(ev->ctx, self->loc, self->as.symbol.text.len, self->as.symbol.text.bytes);
+      }
+    }
+    else if (self->type == EEXPR_NUMBER) {
+      if (ev->number != NULL) {
+        eexpr_number value;
+        eexpr_asNumber(self, &value);
+        ev->number(ev->ctx, self->loc, &value);
+      }
+    }
+    else {
+      if (ev->begin != NULL) { ev->begin(ev->ctx, self->type, self->loc); }
+      if (self->type == EEXPR_STRING && ev->stringPart != NULL) {
+        ev->stringPart(ev->ctx, self->as.string.text1.len, self->as.string.text1.bytes);
+      }
+      walkStackReserve(buf, &stack, &cap, len);
+      walkFrameInit(&stack[len], self);
+      len += 1;
+    }
+    // find the next subexpr to start, ending every eexpr that has none left
+    while (true) {
+      if (len == 0) {
+        if (stack != buf) { free(stack); }
+        return;
+      }
+      walkFrame* top = &stack[len - 1];
+      if (top->subexprs == NULL && top->next != 0 && ev->stringPart != NULL) {
+        // the text that follows the spliced subexpr just finished
+        const strTemplPart* part = &top->self->as.string.parts.data[top->next - 1];
+        ev->stringPart(ev->ctx, part->nBytes, part->utf8str);
+      }
+      if (top->next < top->nSubexprs) {
+        size_t i = top->next++;
+        self = top->subexprs != NULL ? top->subexprs[i] : top->self->as.string.parts.data[i].subexpr;
+        break;
+      }
+      len -= 1;
+      if (ev->end != NULL) { ev->end(ev->ctx, top->self->type, top->self->loc); }
+    }
+  }
+}
+
+
+//////////////////////////////////// Flat Eexprs ////////////////////////////////////
+
+// Locations are kept in 32 bits each wherever eexprs are stored flat (see `eexpr_flatNode.loc`).
+static inline
+void packLoc(uint32_t out[6], eexpr_loc loc) {
+  out[0] = loc.start.line; out[1] = loc.start.col; out[2] = loc.start.byte;
+  out[3] = loc.end.line; out[4] = loc.end.col; out[5] = loc.end.byte;
+}
+
+static inline
+eexpr_loc unpackLoc(const uint32_t in[6]) {
+  eexpr_loc loc =
+    { .start = {.line = in[0], .col = in[1], .byte = in[2]}
+    , .end = {.line = in[3], .col = in[4], .byte = in[5]}
+    };
+  return loc;
+}
+
+// The ancestors of the node being written, so that each can be finished off once its subtree is done.
+typedef struct flatFrame {
+  uint32_t node;
+  uint32_t part; // for strings: the last part whose subexpr has been written
+} flatFrame;
+#define TYPE flatFrame
+#include "dynarr.h"
+
+typedef struct flatWriter {
+  eexpr_flat* out;
+  uint8_t* data; // the side buffer
+  size_t nNodes; // how many nodes (and bytes of the side buffer) have been used so far
+  size_t nBytes;
+  bool tooBig; // set while measuring if the locations are too large to fit
+  dynarr_flatFrame stack;
+} flatWriter;
+
+// The size of the record an eexpr has in the side buffer, if any (see `eexpr_flatNode.data`).
+static
+size_t flatRecordSize(const eexpr* self) {
+  switch (self->type) {
+    case EEXPR_SYMBOL: {
+      return (sizeof(flatSymbol) + self->as.symbol.text.len + 3) & ~(size_t)3;
+    }; break;
+    case EEXPR_NUMBER: {
+      eexpr_number num; eexpr_asNumber(self, &num);
+      return sizeof(flatNumber) + (num.nBigDigits + num.nBigDigits_exp) * sizeof(uint32_t);
+    }; break;
+    case EEXPR_STRING: {
+      size_t size = sizeof(flatString) + (self->as.string.parts.len + 1) * sizeof(flatStrPart) + self->as.string.text1.len;
+      for (size_t i = 0; i < self->as.string.parts.len; ++i) {
+        size += self->as.string.parts.data[i].nBytes;
+      }
+      return (size + 3) & ~(size_t)3;
+    }; break;
+    default: return 0;
+  }
+}
+
+// Count up the space needed for a flat forest.
+static
+eexpr_walkStep flatMeasure(void* ctx, const eexpr* self, size_t depth) {
+  (void)depth;
+  flatWriter* w = ctx;
+  w->nNodes += 1;
+  w->nBytes += flatRecordSize(self);
+  // lines and columns are never more than byte offsets, and the start is never past the end
+  if (self->loc.end.byte > UINT32_MAX) { w->tooBig = true; }
+  return EEXPR_WALK_CONTINUE;
+}
+
+static
+eexpr_walkStep flatEnter(void* ctx, const eexpr* self, size_t depth) {
+  flatWriter* w = ctx;
+  uint32_t at = w->nNodes++;
+  eexpr_flatNode* node = &w->out->nodes[at];
+  if (depth != 0) {
+    flatFrame* parent = &w->stack.data[depth - 1];
+    eexpr_flatNode* up = &w->out->nodes[parent->node];
+    if (up->type == EEXPR_STRING) {
+      // the parts with subexprs were marked when the string was written, so this is the next marked part
+      flatString* string = (flatString*)((uint8_t*)up + up->data);
+      do { parent->part += 1; } while (string->parts[parent->part].subexpr == 0);
+      string->parts[parent->part].subexpr = at - parent->node;
+    }
+  }
+  node->type = self->type;
+  node->absent = 0;
+  node->nSubexprs = 0;
+  node->data = 0;
+  packLoc(node->loc, self->loc);
+  uint8_t* rec = &w->data[w->nBytes];
+  switch (self->type) {
+    case EEXPR_SYMBOL: {
+      flatSymbol* sym = (flatSymbol*)rec;
+      sym->nBytes = self->as.symbol.text.len;
+      if (sym->nBytes != 0) { memcpy(sym->text, self->as.symbol.text.bytes, sym->nBytes); }
+    }; break;
+    case EEXPR_NUMBER: {
+      eexpr_number num; eexpr_asNumber(self, &num);
+      flatNumber* out = (flatNumber*)rec;
+      out->radix = num.radix;
+      out->isPositive = num.isPositive;
+      out->isPositive_exp = num.isPositive_exp;
+      out->nFracDigits = num.nFracDigits;
+      out->nBigDigits = num.nBigDigits;
+      out->nBigDigits_exp = num.nBigDigits_exp;
+      if (num.nBigDigits != 0) { memcpy(out->digits, num.bigDigits, num.nBigDigits * sizeof(uint32_t)); }
+      if (num.nBigDigits_exp != 0) { memcpy(&out->digits[num.nBigDigits], num.bigDigits_exp, num.nBigDigits_exp * sizeof(uint32_t)); }
+    }; break;
+    case EEXPR_STRING: {
+      flatString* string = (flatString*)rec;
+      string->nSubexprs = self->as.string.parts.len;
+      uint32_t text = sizeof(flatString) + (string->nSubexprs + 1) * sizeof(flatStrPart);
+      string->parts[0] = (flatStrPart){.subexpr = 0, .text = text, .nBytes = self->as.string.text1.len};
+      if (string->parts[0].nBytes != 0) { memcpy(rec + text, self->as.string.text1.bytes, string->parts[0].nBytes); }
+      text += string->parts[0].nBytes;
+      for (size_t i = 0; i < string->nSubexprs; ++i) {
+        const strTemplPart* part = &self->as.string.parts.data[i];
+        // parts with subexprs are only marked for now, until the subexprs are written (see above)
+        string->parts[i + 1] = (flatStrPart){.subexpr = part->subexpr != NULL, .text = text, .nBytes = part->nBytes};
+        if (part->nBytes != 0) { memcpy(rec + text, part->utf8str, part->nBytes); }
+        text += part->nBytes;
+        node->nSubexprs += part->subexpr != NULL;
+      }
+    }; break;
+    case EEXPR_PAREN: case EEXPR_BRACK: case EEXPR_BRACE: case EEXPR_PREDOT: {
+      node->nSubexprs = self->as.wrap != NULL;
+    }; break;
+    case EEXPR_BLOCK: case EEXPR_CHAIN: case EEXPR_SPACE: case EEXPR_COMMA: case EEXPR_SEMICOLON: {
+      node->nSubexprs = self->as.list.len;
+    }; break;
+    case EEXPR_ELLIPSIS: case EEXPR_COLON: {
+      node->absent = (self->as.pair[0] == NULL) | (self->as.pair[1] == NULL) << 1;
+      node->nSubexprs = (self->as.pair[0] != NULL) + (self->as.pair[1] != NULL);
+    }; break;
+  }
+  size_t size = flatRecordSize(self);
+  if (size != 0) {
+    node->data = rec - (uint8_t*)node;
+    w->nBytes += size;
+  }
+  flatFrame frame = {.node = at, .part = 0};
+  dynarr_push_flatFrame(&w->stack, &frame);
+  return EEXPR_WALK_CONTINUE;
+}
+
+static
+eexpr_walkStep flatExit(void* ctx, const eexpr* self, size_t depth) {
+  (void)self; (void)depth;
+  flatWriter* w = ctx;
+  flatFrame* frame = dynarr_pop_flatFrame(&w->stack);
+  w->out->nodes[frame->node].next = w->nNodes - frame->node;
+  return EEXPR_WALK_CONTINUE;
+}
+
+eexpr_flat* eexpr_flatten(size_t nEexprs, eexpr* const* eexprs) {
+  // first find out how big the forest is, then write it all in one go
+  flatWriter w = {.out = NULL, .nNodes = 0, .nBytes = 0, .tooBig = false};
+  eexpr_walker measure = {.ctx = &w, .enter = flatMeasure, .exit = NULL};
+  for (size_t i = 0; i < nEexprs; ++i) {
+    assert(eexprs[i] != NULL);
+    eexpr_walk(eexprs[i], &measure);
+  }
+  size_t size = sizeof(eexpr_flat) + w.nNodes * sizeof(eexpr_flatNode) + w.nBytes;
+  if (w.tooBig || size > UINT32_MAX) { return NULL; }
+  // zeroed, so that the padding is the same from one run to the next (e.g. when the forest is written to a file)
+  w.out = calloc(1, size);
+  checkOom(w.out);
+  w.out->nRoots = nEexprs;
+  w.out->nNodes = w.nNodes;
+  w.out->nBytes = size;
+  w.data = (uint8_t*)&w.out->nodes[w.nNodes];
+  w.nNodes = 0;
+  w.nBytes = 0;
+  dynarr_init_flatFrame(&w.stack, 16);
+  eexpr_walker write = {.ctx = &w, .enter = flatEnter, .exit = flatExit};
+  for (size_t i = 0; i < nEexprs; ++i) {
+    eexpr_walk(eexprs[i], &write);
+  }
+  dynarr_deinit_flatFrame(&w.stack);
+  assert(w.nNodes == w.out->nNodes);
+  return w.out;
+}
+
+void eexpr_flatDel(eexpr_flat* flat) {
+  free(flat);
+}
+
+size_t eexpr_flatSize(const eexpr_flat* flat) {
+  return flat->nBytes;
+}
+
+size_t eexpr_flatCount(const eexpr_flat* flat) {
+  return flat->nRoots;
+}
+
+const eexpr_flatNode* eexpr_flatFirst(const eexpr_flat* flat) {
+  return flat->nRoots == 0 ? NULL : &flat->nodes[0];
+}
+
+const eexpr_flatNode* eexpr_flatNext(const eexpr_flatNode* self) {
+  return self + self->next;
+}
+
+
+eexpr_type eexpr_flatGetType(const eexpr_flatNode* self) {
+  return self->type;
+}
+
+eexpr_loc eexpr_flatLocate(const eexpr_flatNode* self) {
+  return unpackLoc(self->loc);
+}
+
+static inline
+const void* flatRecord(const eexpr_flatNode* self) {
+  return (const uint8_t*)self + self->data;
+}
+
+bool eexpr_flatAsSymbol(const eexpr_flatNode* self, size_t* nBytes, const uint8_t** utf8str) {
+  if (self->type != EEXPR_SYMBOL) { return false; }
+  const flatSymbol* sym = flatRecord(self);
+  *nBytes = sym->nBytes;
+  *utf8str = sym->text;
+  return true;
+}
+
+bool eexpr_flatAsNumber(const eexpr_flatNode* self, eexpr_number* value) {
+  if (self->type != EEXPR_NUMBER) { return false; }
+  const flatNumber* num = flatRecord(self);
+  // the digits are only ever read, despite the type of `eexpr_number`
+  uint32_t* digits = (uint32_t*)num->digits;
+  value->isPositive = num->isPositive;
+  value->nBigDigits = num->nBigDigits;
+  value->bigDigits = num->nBigDigits == 0 ? NULL : digits;
+  value->radix = num->radix;
+  value->nFracDigits = num->nFracDigits;
+  value->isPositive_exp = num->isPositive_exp;
+  value->nBigDigits_exp = num->nBigDigits_exp;
+  value->bigDigits_exp = num->nBigDigits_exp == 0 ? NULL : &digits[num->nBigDigits];
+  return true;
+}
+
+bool eexpr_flatAsString(const eexpr_flatNode* self, size_t* nBytes, const uint8_t** utf8str, size_t* nSubexprs) {
+  if (self->type != EEXPR_STRING) { return false; }
+  const flatString* string = flatRecord(self);
+  if (nBytes != NULL) { *nBytes = string->parts[0].nBytes; }
+  if (utf8str != NULL) { *utf8str = (const uint8_t*)string + string->parts[0].text; }
+  if (nSubexprs != NULL) { *nSubexprs = string->nSubexprs; }
+  return true;
+}
+
+void eexpr_flatStringPart(const eexpr_flatNode* self, size_t i, const eexpr_flatNode** subexpr, size_t* nBytes, const uint8_t** utf8str) {
+  assert(self->type == EEXPR_STRING);
+  const flatString* string = flatRecord(self);
+  assert(i < string->nSubexprs);
+  const flatStrPart* part = &string->parts[i + 1];
+  if (subexpr != NULL) { *subexpr = part->subexpr == 0 ? NULL : self + part->subexpr; }
+  if (nBytes != NULL) { *nBytes = part->nBytes; }
+  if (utf8str != NULL) { *utf8str = (const uint8_t*)string + part->text; }
+}
+
+// The subexpr of a paren, brack, brace or predot, if any.
+static inline
+const eexpr_flatNode* flatWrapped(const eexpr_flatNode* self) {
+  return self->nSubexprs == 0 ? NULL : self + 1;
+}
+
+bool eexpr_flatAsParen(const eexpr_flatNode* self, const eexpr_flatNode** subexpr) {
+  if (self->type != EEXPR_PAREN) { return false; }
+  if (subexpr != NULL) { *subexpr = flatWrapped(self); }
+  return true;
+}
+
+bool eexpr_flatAsBrack(const eexpr_flatNode* self, const eexpr_flatNode** subexpr) {
+  if (self->type != EEXPR_BRACK) { return false; }
+  if (subexpr != NULL) { *subexpr = flatWrapped(self); }
+  return true;
+}
+
+bool eexpr_flatAsBrace(const eexpr_flatNode* self, const eexpr_flatNode** subexpr) {
+  if (self->type != EEXPR_BRACE) { return false; }
+  if (subexpr != NULL) { *subexpr = flatWrapped(self); }
+  return true;
+}
+
+bool eexpr_flatAsBlock(const eexpr_flatNode* self, size_t* nSubexprs, const eexpr_flatNode** first) {
+  if (self->type != EEXPR_BLOCK) { return false; }
+  if (nSubexprs != NULL) { *nSubexprs = self->nSubexprs; }
+  if (first != NULL) { *first = self + 1; }
+  return true;
+}
+
+bool eexpr_flatAsPredot(const eexpr_flatNode* self, const eexpr_flatNode** subexpr) {
+  if (self->type != EEXPR_PREDOT) { return false; }
+  if (subexpr != NULL) { *subexpr = flatWrapped(self); }
+  return true;
+}
+
+bool eexpr_flatAsChain(const eexpr_flatNode* self, size_t* nSubexprs, const eexpr_flatNode** first) {
+  if (self->type != EEXPR_CHAIN) { return false; }
+  if (nSubexprs != NULL) { *nSubexprs = self->nSubexprs; }
+  if (first != NULL) { *first = self + 1; }
+  return true;
+}
+
+bool eexpr_flatAsSpace(const eexpr_flatNode* self, size_t* nSubexprs, const eexpr_flatNode** first) {
+  if (self->type != EEXPR_SPACE) { return false; }
+  if (nSubexprs != NULL) { *nSubexprs = self->nSubexprs; }
+  if (first != NULL) { *first = self + 1; }
+  return true;
+}
+
+bool eexpr_flatAsEllipsis(const eexpr_flatNode* self, const eexpr_flatNode** before, const eexpr_flatNode** after) {
+  if (self->type != EEXPR_ELLIPSIS) { return false; }
+  const eexpr_flatNode* first = self->absent & 1 ? NULL : self + 1;
+  if (before != NULL) { *before = first; }
+  if (after != NULL) { *after = self->absent & 2 ? NULL : first == NULL ? self + 1 : eexpr_flatNext(first); }
+  return true;
+}
+
+bool eexpr_flatAsColon(const eexpr_flatNode* self, const eexpr_flatNode** before, const eexpr_flatNode** after) {
+  if (self->type != EEXPR_COLON) { return false; }
+  assert(self->absent == 0);
+  if (before != NULL) { *before = self + 1; }
+  if (after != NULL) { *after = eexpr_flatNext(self + 1); }
+  return true;
+}
+
+bool eexpr_flatAsComma(const eexpr_flatNode* self, size_t* nSubexprs, const eexpr_flatNode** first) {
+  if (self->type != EEXPR_COMMA) { return false; }
+  if (nSubexprs != NULL) { *nSubexprs = self->nSubexprs; }
+  if (first != NULL) { *first = self + 1; }
+  return true;
+}
+
+bool eexpr_flatAsSemicolon(const eexpr_flatNode* self, size_t* nSubexprs, const eexpr_flatNode** first) {
+  if (self->type != EEXPR_SEMICOLON) { return false; }
+  if (nSubexprs != NULL) { *nSubexprs = self->nSubexprs; }
+  if (first != NULL) { *first = self + 1; }
+  return true;
+}
+
+
+//////////////////////////////////// Serialized Eexprs ////////////////////////////////////
+
+/*
+A serialized parse is laid out as:
+  * a `serialHeader`,
+  * a `serialError` for each error, then for each warning,
+  * the flat forest, exactly as it is in memory (starting 8-byte aligned, since the header and errors are multiples of 8 bytes).
+*/
+
+#define SERIAL_MAGIC "eexprs\0\x01"
+// written as a number, this reads as something else on a machine with the other byte order
+#define SERIAL_BYTE_ORDER 0x01020304
+
+typedef struct serialHeader {
+  uint8_t magic[8];
+  uint32_t version; // `EEXPR_SERIAL_VERSION`
+  uint32_t byteOrder; // `SERIAL_BYTE_ORDER`
+  uint32_t nodeSize; // `sizeof(eexpr_flatNode)`, in case it was laid out differently
+  uint32_t nErrors;
+  uint32_t nWarnings;
+  uint32_t forest; // offset in bytes of the flat forest from the start of the file
+} serialHeader;
+
+// An `eexpr_error` in a fixed size, whatever the size of `size_t`.
+typedef struct serialError {
+  uint32_t type;
+  uint32_t loc[6];
+  uint32_t info[7]; // the members of `.as` that go with the type
+} serialError;
+
+struct eexpr_mappingInternal {
+  mappedFile file;
+};
+
+// Returns false if a location is too large to fit in 32 bits.
+static
+bool packError(serialError* out, const eexpr_error* err) {
+  memset(out, 0, sizeof(serialError));
+  out->type = err->type;
+  packLoc(out->loc, err->loc);
+  size_t maxByte = err->loc.end.byte;
+  switch (err->type) {
+    case EEXPR_ERR_BAD_CHAR: { out->info[0] = err->as.badChar; }; break;
+    case EEXPR_ERR_BAD_ESCAPE_CHAR: { out->info[0] = err->as.badEscapeChar; }; break;
+    case EEXPR_ERR_BAD_ESCAPE_CODE: {
+      for (int i = 0; i < 6; ++i) { out->info[i] = err->as.badEscapeCode[i]; }
+    }; break;
+    case EEXPR_ERR_UNICODE_OVERFLOW: { out->info[0] = err->as.unicodeOverflow; }; break;
+    case EEXPR_ERR_BAD_STRING_CHAR: { out->info[0] = err->as.badStringChar; }; break;
+    case EEXPR_ERR_MIXED_INDENTATION: {
+      out->info[0] = err->as.mixedIndentation.establishedType;
+      packLoc(&out->info[1], err->as.mixedIndentation.establishedAt);
+      if (err->as.mixedIndentation.establishedAt.end.byte > maxByte) { maxByte = err->as.mixedIndentation.establishedAt.end.byte; }
+    }; break;
+    case EEXPR_ERR_UNBALANCED_WRAP: {
+      out->info[0] = err->as.unbalancedWrap.type;
+      // there is no location for a close wrap that was never opened
+      if (err->as.unbalancedWrap.type != EEXPR_WRAP_NULL) {
+        packLoc(&out->info[1], err->as.unbalancedWrap.loc);
+        if (err->as.unbalancedWrap.loc.end.byte > maxByte) { maxByte = err->as.unbalancedWrap.loc.end.byte; }
+      }
+    }; break;
+    default: break;
+  }
+  // as with eexprs, lines and columns are never more than byte offsets
+  return maxByte <= UINT32_MAX;
+}
+
+static
+eexpr_error unpackError(const serialError* in) {
+  eexpr_error err = {.type = in->type, .loc = unpackLoc(in->loc)};
+  switch (err.type) {
+    case EEXPR_ERR_BAD_CHAR: { err.as.badChar = in->info[0]; }; break;
+    case EEXPR_ERR_BAD_ESCAPE_CHAR: { err.as.badEscapeChar = in->info[0]; }; break;
+    case EEXPR_ERR_BAD_ESCAPE_CODE: {
+      for (int i = 0; i < 6; ++i) { err.as.badEscapeCode[i] = in->info[i]; }
+    }; break;
+    case EEXPR_ERR_UNICODE_OVERFLOW: { err.as.unicodeOverflow = in->info[0]; }; break;
+    case EEXPR_ERR_BAD_STRING_CHAR: { err.as.badStringChar = in->info[0]; }; break;
+    case EEXPR_ERR_MIXED_INDENTATION: {
+      err.as.mixedIndentation.establishedType = in->info[0];
+      err.as.mixedIndentation.establishedAt = unpackLoc(&in->info[1]);
+    }; break;
+    case EEXPR_ERR_UNBALANCED_WRAP: {
+      err.as.unbalancedWrap.type = in->info[0];
+      err.as.unbalancedWrap.loc = unpackLoc(&in->info[1]);
+    }; break;
+    default: break;
+  }
+  return err;
+}
+
+// Decode `n` errors into a fresh array (or `NULL` if there are none).
+static
+eexpr_error* unpackErrors(size_t n, const serialError* in) {
+  if (n == 0) { return NULL; }
+  eexpr_error* out = malloc(n * sizeof(eexpr_error));
+  checkOom(out);
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = unpackError(&in[i]);
+  }
+  return out;
+}
+
+uint8_t* eexpr_serialize
+  ( const eexpr_flat* flat
+  , size_t nErrors, const eexpr_error* errors
+  , size_t nWarnings, const eexpr_error* warnings
+  , size_t* nBytes
+  ) {
+  eexpr_flat empty = {.nRoots = 0, .nNodes = 0, .nBytes = sizeof(eexpr_flat)};
+  if (flat == NULL) { flat = &empty; }
+  size_t forest = sizeof(serialHeader) + (nErrors + nWarnings) * sizeof(serialError);
+  if (nErrors + nWarnings > UINT32_MAX || forest > UINT32_MAX) { return NULL; }
+  assert(forest % 8 == 0);
+  uint8_t* out = malloc(forest + flat->nBytes);
+  checkOom(out);
+  serialHeader header =
+    { .version = EEXPR_SERIAL_VERSION
+    , .byteOrder = SERIAL_BYTE_ORDER
+    , .nodeSize = sizeof(eexpr_flatNode)
+    , .nErrors = nErrors
+    , .nWarnings = nWarnings
+    , .forest = forest
+    };
+  memcpy(header.magic, SERIAL_MAGIC, sizeof(header.magic));
+  memcpy(out, &header, sizeof(serialHeader));
+  serialError* errs = (serialError*)(out + sizeof(serialHeader));
+  bool ok = true;
+  for (size_t i = 0; i < nErrors; ++i) {
+    ok = packError(&errs[i], &errors[i]) && ok;
+  }
+  for (size_t i = 0; i < nWarnings; ++i) {
+    ok = packError(&errs[nErrors + i], &warnings[i]) && ok;
+  }
+  if (!ok) {
+    free(out);
+    return NULL;
+  }
+  memcpy(out + forest, flat, flat->nBytes);
+  *nBytes = forest + flat->nBytes;
+  return out;
+}
+
+// Whether a serialized error is one that `packError` could have written: of a known type, with known types in its info.
+static
+bool validSerialError(const serialError* in) {
+  if (in->type == EEXPR_ERR_NOERROR || in->type > EEXPR_ERR_EXPECTING_END_OF_FRAGMENT) { return false; }
+  switch (in->type) {
+    case EEXPR_ERR_MIXED_INDENTATION: return in->info[0] == EEXPR_INDENT_SPACES || in->info[0] == EEXPR_INDENT_TABS;
+    case EEXPR_ERR_UNBALANCED_WRAP: return in->info[0] <= EEXPR_WRAP_BLOCK;
+    default: return true;
+  }
+}
+
+/*
+Check that the `len` bytes at `flat` hold a flat forest that is safe to read with the `eexpr_flat*` functions:
+  * every node has a known type, and the right number of subexprs for it,
+  * every node's subexprs (and the roots) exactly fill its subtree, one after another,
+  * every record lies within the side buffer, 4-byte aligned, and everything it refers to (text, digits, string parts) lies within the block,
+  * every string part with a subexpr points at that subexpr's node.
+This is a single pass over the nodes, in which each node is looked at once on its own and once as a subexpr of its parent.
+The text itself is not checked to be utf8, nor the locations to be in order, since neither can lead a reader out of bounds.
+*/
+static
+bool validFlat(const eexpr_flat* flat, size_t len) {
+  if (len < sizeof(eexpr_flat) || flat->nBytes != len) { return false; }
+  size_t nNodes = flat->nNodes;
+  if ((len - sizeof(eexpr_flat)) / sizeof(eexpr_flatNode) < nNodes || flat->nRoots > nNodes) { return false; }
+  const uint8_t* base = (const uint8_t*)flat;
+  uint64_t sideBuffer = sizeof(eexpr_flat) + nNodes * sizeof(eexpr_flatNode);
+  size_t at = 0;
+  for (size_t r = 0; r < flat->nRoots; ++r) {
+    if (at >= nNodes || flat->nodes[at].next == 0) { return false; }
+    at += flat->nodes[at].next;
+  }
+  if (at != nNodes) { return false; }
+  for (size_t i = 0; i < nNodes; ++i) {
+    const eexpr_flatNode* node = &flat->nodes[i];
+    if (node->type > EEXPR_SEMICOLON || node->next == 0 || node->next > nNodes - i) { return false; }
+    const flatString* string = NULL;
+    if (node->type == EEXPR_SYMBOL || node->type == EEXPR_NUMBER || node->type == EEXPR_STRING) {
+      uint64_t offset = sizeof(eexpr_flat) + i * sizeof(eexpr_flatNode) + (uint64_t)node->data;
+      if (offset < sideBuffer || offset >= len || offset % 4 != 0) { return false; }
+      const uint8_t* rec = base + offset;
+      uint64_t room = len - offset;
+      switch (node->type) {
+        case EEXPR_SYMBOL: {
+          const flatSymbol* sym = (const flatSymbol*)rec;
+          if (room < sizeof(flatSymbol) || sym->nBytes > room - sizeof(flatSymbol)) { return false; }
+          if (node->nSubexprs != 0) { return false; }
+        }; break;
+        case EEXPR_NUMBER: {
+          const flatNumber* num = (const flatNumber*)rec;
+          if (room < sizeof(flatNumber)) { return false; }
+          if ((uint64_t)num->nBigDigits + num->nBigDigits_exp > (room - sizeof(flatNumber)) / sizeof(uint32_t)) { return false; }
+          // the signs are read as bytes, since anything but 0 or 1 in a `bool` is undefined behavior
+          if (rec[offsetof(flatNumber, isPositive)] > 1 || rec[offsetof(flatNumber, isPositive_exp)] > 1) { return false; }
+          // as promised by `eexpr_number`, the top big digits are non-zero
+          if (num->nBigDigits != 0 && num->digits[num->nBigDigits - 1] == 0) { return false; }
+          if (num->nBigDigits_exp != 0 && num->digits[num->nBigDigits + num->nBigDigits_exp - 1] == 0) { return false; }
+          if (node->nSubexprs != 0) { return false; }
+        }; break;
+        default: {
+          string = (const flatString*)rec;
+          if (room < sizeof(flatString)) { return false; }
+          if ((uint64_t)string->nSubexprs + 1 > (room - sizeof(flatString)) / sizeof(flatStrPart)) { return false; }
+          uint64_t nPresent = 0;
+          for (size_t k = 0; k <= string->nSubexprs; ++k) {
+            const flatStrPart* part = &string->parts[k];
+            if ((uint64_t)part->text + part->nBytes > room) { return false; }
+            if (k == 0 && part->subexpr != 0) { return false; }
+            nPresent += part->subexpr != 0;
+          }
+          if (nPresent != node->nSubexprs) { return false; }
+        }; break;
+      }
+    }
+    switch (node->type) {
+      case EEXPR_PAREN: case EEXPR_BRACK: case EEXPR_BRACE: case EEXPR_PREDOT: {
+        if (node->nSubexprs > 1) { return false; }
+      }; break;
+      case EEXPR_ELLIPSIS: {
+        if (node->absent > 3 || node->nSubexprs != 2u - (node->absent & 1) - (node->absent >> 1)) { return false; }
+      }; break;
+      case EEXPR_COLON: {
+        if (node->absent != 0 || node->nSubexprs != 2) { return false; }
+      }; break;
+      default: break;
+    }
+    // the subexprs must fill the subtree exactly
+    size_t end = i + node->next;
+    size_t sub = i + 1;
+    size_t part = 0;
+    for (size_t k = 0; k < node->nSubexprs; ++k) {
+      if (sub >= end || flat->nodes[sub].next == 0) { return false; }
+      if (string != NULL) {
+        do { part += 1; } while (string->parts[part].subexpr == 0);
+        if (string->parts[part].subexpr != sub - i) { return false; }
+      }
+      sub += flat->nodes[sub].next;
+    }
+    if (sub != end) { return false; }
+  }
+  return true;
+}
+
+// Load a serialized parse, checking the whole of it first unless it is `trusted`.
+static
+bool mapSerial(const char* filename, bool trusted, eexpr_mapping* out) {
+  out->flat = NULL;
+  out->nErrors = 0; out->errors = NULL;
+  out->nWarnings = 0; out->warnings = NULL;
+  out->impl = NULL;
+  mappedFile file;
+  if (!mapFile(filename, &file)) { return false; }
+  const uint8_t* bytes = file.contents.bytes;
+  size_t len = file.contents.len;
+  serialHeader header;
+  if (len < sizeof(serialHeader)) { goto refuse; }
+  memcpy(&header, bytes, sizeof(serialHeader));
+  if ( memcmp(header.magic, SERIAL_MAGIC, sizeof(header.magic)) != 0
+    || header.version != EEXPR_SERIAL_VERSION
+    || header.byteOrder != SERIAL_BYTE_ORDER
+    || header.nodeSize != sizeof(eexpr_flatNode)
+    || header.forest != sizeof(serialHeader) + ((size_t)header.nErrors + header.nWarnings) * sizeof(serialError)
+    || header.forest % _Alignof(eexpr_flat) != 0
+    || (uintptr_t)bytes % _Alignof(eexpr_flat) != 0
+    || len < (size_t)header.forest + sizeof(eexpr_flat)
+     ) {
+    goto refuse;
+  }
+  const eexpr_flat* flat = (const eexpr_flat*)(bytes + header.forest);
+  const serialError* errs = (const serialError*)(bytes + sizeof(serialHeader));
+  if (trusted) {
+    // only what is needed to find the end of the forest
+    if ( flat->nBytes != len - header.forest
+      || flat->nBytes < sizeof(eexpr_flat) + (size_t)flat->nNodes * sizeof(eexpr_flatNode)
+       ) {
+      goto refuse;
+    }
+  }
+  else {
+    if (!validFlat(flat, len - header.forest)) { goto refuse; }
+    for (size_t i = 0; i < (size_t)header.nErrors + header.nWarnings; ++i) {
+      if (!validSerialError(&errs[i])) { goto refuse; }
+    }
+  }
+  out->flat = flat;
+  out->nErrors = header.nErrors;
+  out->errors = unpackErrors(header.nErrors, errs);
+  out->nWarnings = header.nWarnings;
+  out->warnings = unpackErrors(header.nWarnings, &errs[header.nErrors]);
+  out->impl = malloc(sizeof(eexpr_mappingInternal));
+  checkOom(out->impl);
+  out->impl->file = file;
+  return true;
+
+  refuse: {
+    unmapFile(&file);
+    return false;
+  }
+}
+
+bool eexpr_mapFile(const char* filename, eexpr_mapping* out) {
+  return mapSerial(filename, false, out);
+}
+
+bool eexpr_mapFileTrusted(const char* filename, eexpr_mapping* out) {
+  return mapSerial(filename, true, out);
+}
+
+void eexpr_unmapFile(eexpr_mapping* mapping) {
+  if (mapping->impl != NULL) {
+    unmapFile(&mapping->impl->file);
+    free(mapping->impl);
+  }
+  free(mapping->errors);
+  free(mapping->warnings);
+  mapping->flat = NULL;
+  mapping->nErrors = 0; mapping->errors = NULL;
+  mapping->nWarnings = 0; mapping->warnings = NULL;
+  mapping->impl = NULL;
+}
+
+
 //////////////////////////////////// `eexpr_tokenAs*` Functions ////////////////////////////////////
 
 eexpr_tokenType eexpr_getTokenType(const eexpr_token* self) {
@@ -436,6 +2526,11 @@ bool eexpr_tokenAsSymbol(const eexpr_token* self, size_t* nBytes, uint8_t** utf8
 
 bool eexpr_tokenAsNumber(const eexpr_token* self, eexpr_number* value) {
   if (self->type != EEXPR_TOK_NUMBER) { return false; }
+  if (self->undecoded) { // memoize the decoded number in place
+    eexpr_token* mut = (eexpr_token*)self;
+    mut->as.number = engine_forceNumber(mut->as.lazyNumber);
+    mut->undecoded = false;
+  }
   if (value != NULL) {
     assert(self->as.number.mantissa.len == 0
           ? (self->as.number.mantissa.buf == NULL && !self->as.number.mantissa.pos)
@@ -445,12 +2540,12 @@ bool eexpr_tokenAsNumber(const eexpr_token* self, eexpr_number* value) {
           : true);
     value->isPositive = self->as.number.mantissa.pos;
     value->nBigDigits = self->as.number.mantissa.len;
-    value->bigDigits = self->as.number.mantissa.buf;
+    value->bigDigits = self->as.number.mantissa.len == 0 ? NULL : (uint32_t*)bigint_digits(&self->as.number.mantissa);
     value->radix = self->as.number.radix;
     value->nFracDigits = self->as.number.fractionalDigits;
     value->isPositive_exp = self->as.number.exponent.pos;
     value->nBigDigits_exp = self->as.number.exponent.len;
-    value->bigDigits_exp = self->as.number.exponent.buf;
+    value->bigDigits_exp = self->as.number.exponent.len == 0 ? NULL : (uint32_t*)bigint_digits(&self->as.number.exponent);
   }
   return true;
 }
@@ -16,6 +16,8 @@ The `eexpr_as*` and `eexpr_tokenAs*` families of functions pull out the constitu
 Location data is obtained with `eexpr_locate` and `eexpr_tokenLocate`.
 
 When eexpr data is no longer needed, it can be easily cleaned up with `eexpr_del` or `eexpr_deinit`.
+Alternately, the parser can be put into arena mode, in which case all the eexprs from one parse are freed at once with `eexpr_arenaRelease`.
+For read-only uses, the eexprs can also be copied into a single flat block of memory with `eexpr_flatten` (or by the parser in flat output mode).
 Token data is inherently transient, and is cleaned up as soon as parsing completes.
 
 Every identifier in this interface begins with either `eexpr_` or `EXPR_` (with the obvious exception of the `eexpr` type).
@@ -24,6 +26,7 @@ Every identifier in this interface begins with either `eexpr_` or `EXPR_` (with
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <time.h>
 #include <uchar.h>
 
 
@@ -36,6 +39,11 @@ typedef struct eexpr_token eexpr_token;
 
 typedef struct eexpr eexpr;
 typedef struct eexpr_error eexpr_error;
+typedef struct eexpr_arena eexpr_arena;
+typedef struct eexpr_events eexpr_events;
+typedef struct eexpr_flat eexpr_flat;
+typedef struct eexpr_flatNode eexpr_flatNode;
+typedef struct eexpr_mappingInternal eexpr_mappingInternal;
 
 
 //////////////////////////////////// Producing Eexprs ////////////////////////////////////
@@ -61,7 +69,7 @@ typedef struct eexpr_parser {
   size_t nTokens;
   // Output member: An array holding (pointers to) tokens.
   // If non-null before parsing, this struct takes ownership of the array and will free it on `eexpr_deinit`.
-  // This array's contents alias internal data structures and become invalid during the parsing stage.
+  // This array's contents alias internal data structures and become invalid as soon as `eexpr_parse` is resumed.
   eexpr_token** tokens;
   // On input: the capacity of the `.errors` array in number of errors.
   // On output: The number of errors in the `.errors` array.
@@ -88,6 +96,64 @@ typedef struct eexpr_parser {
     bool badDigitSeparator;
     // NOTE if more fields are added here, remember to edit `eexpr_parserInitDefault`
   } isError;
+  // Input member: When true, the parser runs in arena mode.
+  // All the data of the output eexprs (nodes, subexpr arrays, symbol/string bytes, bignum digits) is then
+  //   allocated in large chunks that are freed all at once with `eexpr_arenaRelease(parser.arena)`.
+  // This is much cheaper than individually allocating and freeing every node of a large input.
+  // However, `eexpr_del` and `eexpr_deinit` must then never be called on the output eexprs.
+  // The `.eexprs` array itself is still `malloc`d as usual.
+  bool useArena;
+  // Output member: In arena mode, the arena holding the output eexprs, or `NULL` otherwise.
+  // This is only set once the parsing stage has begun, from which point it is owned by the owner of this struct
+  //   (`eexpr_parser_deinit` will not free it).
+  eexpr_arena* arena;
+  // Input member: When true, the parser runs in borrowed-input mode.
+  // The text of symbols, and of strings written without escapes, then points directly into the input buffer instead of being copied.
+  // The caller must keep the input alive and unchanged for as long as any of the output eexprs (or tokens) are in use.
+  // The eexprs can still be freed as usual (`eexpr_del`, `eexpr_deinit` or `eexpr_arenaRelease`); borrowed text is simply not freed.
+  bool borrowInput;
+  // Input member: When true (and also in borrowed-input mode), the digits of numbers are checked but not decoded during parsing.
+  // Instead, a number keeps its source text, and is decoded the first time it is accessed with `eexpr_asNumber` (or `eexpr_tokenAsNumber`).
+  // This saves the bignum arithmetic for numbers that are never looked at.
+  // Since the first access updates the eexpr in place, accessing the same number from multiple threads at once is then unsafe.
+  bool lazyNumbers;
+  // Input member: When true, the parser runs in flat output mode.
+  // The output eexprs are then flattened into `.flat` (see `eexpr_flatten`) as soon as they have been parsed,
+  //   and the eexprs themselves are not output, so `.nEexprs` is zero and `.eexprs` is `NULL`.
+  // The eexprs are built in an arena that the parser keeps to itself, and frees when it is reset or deinitialized,
+  //   so `.useArena` makes no difference.
+  // If the output is too large for a flat forest, it is left as eexprs instead (along with the arena they are in, see `.arena`).
+  // This does not apply with `.onEexpr` or `.events`, nor to `eexpr_parseFeed`.
+  bool flatOutput;
+  // Output member: In flat output mode, the flat forest of output eexprs, or `NULL` otherwise.
+  // It belongs to the owner of this struct, and is freed with `eexpr_flatDel`.
+  eexpr_flat* flat;
+  // Input member: When non-null, each top-level eexpr is passed to this callback (along with `.onEexprCtx`) as soon as it has been parsed,
+  //   instead of being collected into `.eexprs`.
+  // If the callback returns true, it takes ownership of the eexpr; otherwise, the eexpr is freed as soon as the callback returns
+  //   (except in arena mode, where it is only freed along with the arena, as usual).
+  // The input is then lexed and parsed a few top-level eexprs at a time, so outside of arena mode, memory use does not grow with the input.
+  // As with `eexpr_parseFeed`, parsing stops at the first top-level eexpr with errors, tokens are not output, and `.pauseAt` is ignored.
+  bool (*onEexpr)(void* ctx, eexpr* expr);
+  void* onEexprCtx;
+  // Input member: When non-null, the parser runs in event mode, and no eexprs are output at all.
+  // Instead, each top-level eexpr is reported to these callbacks as a sequence of events (see `eexpr_events`).
+  // This otherwise works like `.onEexpr` (which is then ignored), and like it works with both `eexpr_parse` and `eexpr_parseFeed`.
+  // `.useArena`, `.borrowInput` and `.lazyNumbers` are ignored.
+  const eexpr_events* events;
+  // Input member: When greater than one, a large input may be parsed on up to this many threads at once.
+  // The input is then split into pieces between top-level eexprs, and each piece is lexed, cooked and parsed on its own thread.
+  // The output is exactly the same as from a single thread; if a split turns out to be unsafe
+  //   (e.g. it falls inside a heredoc, or lexing finds errors), the whole input is parsed on a single thread after all.
+  // This only applies when `.pauseAt` is `EEXPR_PAUSE_AFTER_PARSE` or `EEXPR_DO_NOT_PAUSE`, and not with `.onEexpr` or `.events`.
+  unsigned nThreads;
+  // Input member: When true, the lexer, postlexer and parser each run on their own thread,
+  //   handing the token stream along a few top-level eexprs at a time, so that the stages overlap.
+  // The number of segments in flight between stages is bounded, so this does not hold more tokens in memory at once than usual.
+  // The output is exactly the same as when the stages run one after another.
+  // This only applies when `.pauseAt` is `EEXPR_PAUSE_AFTER_PARSE` or `EEXPR_DO_NOT_PAUSE`, and not with `.onEexpr` or `.events`;
+  //   if the input is also split up for `.nThreads`, that takes precedence.
+  bool pipeline;
   // Specify a stage of parsing to pause at.
   // Calling `eexpr_parse` on the same parser will resume the parsing from where it was left off.
   enum eexpr_parsePauseAt {
@@ -97,6 +163,33 @@ typedef struct eexpr_parser {
     EEXPR_PAUSE_AFTER_PARSE,
     EEXPR_DO_NOT_PAUSE
   } pauseAt;
+  // Input member: When non-zero, each call to `eexpr_parse` returns early once it has worked through about this many tokens
+  //   (counting each token once as it is lexed, again as it is postlexed, and again as it is parsed), setting `.interrupted`.
+  // This bounds how long a call can take on a large input, so that the caller can get on with other things in between.
+  // While this is set, `.nThreads` and `.pipeline` are ignored, and it does not apply with `.onEexpr` or `.events`.
+  size_t budget;
+  // Input member: When non-zero, `eexpr_parse` returns early once this time (as from `timespec_get(…, TIME_UTC)`) has passed, setting `.interrupted`.
+  // It is only checked every few hundred tokens, so a call may run a little past it.
+  // To carry on, set a later deadline (or zero) before calling `eexpr_parse` again.
+  // A parse split up for `.nThreads` or `.pipeline` cannot be picked up partway, so when it stops, its work is thrown away,
+  //   and the next call starts over on a single thread.
+  // With `.onEexpr` or `.events`, it is checked between batches of top-level eexprs, and the next call carries on from there;
+  //   `eexpr_parseFeed` does the same, but only checks it once all the input has arrived (in `eexpr_parseFinish`).
+  struct timespec deadline;
+  // Input member: When non-null, this is called (with `.shouldStopCtx`) whenever `.deadline` is checked,
+  //   and if it returns true, `eexpr_parse` returns early just as if the deadline had passed.
+  // To cancel a parse from another thread, have this read a flag that the other thread sets.
+  // While a parse is split up for `.nThreads` or `.pipeline`, it may be called from several threads at once.
+  // The parser keeps no state of its own about it: the caller can either give up on the parse
+  //   (`eexpr_parser_reset` or `eexpr_parser_deinit` as usual), or have it return false and call `eexpr_parse` again to carry on.
+  bool (*shouldStop)(void* ctx);
+  void* shouldStopCtx;
+  // Output member: Set when `eexpr_parse` has returned early (and true) because of `.budget`, `.deadline` or `.shouldStop`.
+  // The output members are then as they were at the end of the last stage to finish,
+  //   and calling `eexpr_parse(&parser, 0, NULL)` carries on from where it left off, just as if it had been paused.
+  // It is also set when `eexpr_parseFeed` or `eexpr_parseFinish` returns early because of `.deadline` or `.shouldStop`;
+  //   the eexprs completed so far are output as usual, and the next call to either carries on.
+  bool interrupted;
   // pointer to implementation
   eexpr_parserInternal* impl;
 } eexpr_parser;
@@ -112,6 +205,7 @@ void eexpr_parserInitDefault(eexpr_parser* parser);
 
 // Lexes and parses input, reporting warnings/errors, and stopping on errors.
 // It can be paused and resumed by appropriate configuration of `parser.pauseAt`, see the flowchart below.
+// Any stage can also stop early to stay within `parser.budget`, `parser.deadline` or `parser.shouldStop`, and is then resumed the same way.
 // Returns true if parsing (up to the specified pause point) was successful.
 /*
 `eexpr_parserInitDefault(&parser)`
@@ -143,6 +237,7 @@ finished  <_________________/
   V
 `eexpr_parser_deinit(&parser)`                        internal data structures are deinitialized
                                                       the parser can now be re-configured and re-used
+                                                      (alternately, `eexpr_parser_reset(&parser)` to re-use them)
 */
 bool eexpr_parse
   // Input configuration from and output parsed eexprs to this data structure
@@ -154,22 +249,129 @@ bool eexpr_parse
   , uint8_t* utf8Input
   );
 
+// Lexes and parses input that arrives a piece at a time (e.g. from a pipe or socket), instead of all at once as with `eexpr_parse`.
+// Pass the pieces in order with `eexpr_parseFeed`, then call `eexpr_parseFinish` once there is no more input.
+// Pieces may be split anywhere, even in the middle of a token or utf8 sequence; each piece is copied, so it need not be kept.
+// Top-level eexprs are output as soon as enough input has arrived to be sure they are complete
+//   (roughly, once the next top-level line has started), so only about one top-level eexpr's worth of input is held at a time.
+// After each call, `.eexprs` holds just those eexprs completed during that call (`NULL` if none), and belongs to the caller as usual.
+//   (If `.onEexpr` is set, they are passed to it instead.)
+//   The previous array is overwritten, not freed, so take it before the next call.
+// Errors and warnings accumulate over all calls, as with `eexpr_parse`, and once there is an error, the parser refuses to continue.
+//   However, errors are only reported a top-level eexpr at a time, so parsing stops at the first eexpr with errors,
+//   where `eexpr_parse` would have reported the errors of the whole input.
+//   For the same reason, warnings are ordered by position in the input, rather than grouped by stage of parsing.
+// Tokens are not output, and `.pauseAt`, `.borrowInput` and `.lazyNumbers` are ignored.
+// Arena mode works as usual: all the output eexprs from all calls are in the one `.arena`.
+// Returns true if there have been no errors so far.
+// Do not mix these with `eexpr_parse` on the same parser; when done, `eexpr_parser_deinit` it as usual.
+bool eexpr_parseFeed(eexpr_parser* parser, size_t nBytes, const uint8_t* chunk);
+bool eexpr_parseFinish(eexpr_parser* parser);
+
+// One input of a batch to be parsed with `eexpr_parseBatch`, along with the results of parsing it.
+typedef struct eexpr_batchDoc {
+  // Input member: the number of bytes of input
+  size_t nBytes;
+  // Input member: pointer to the utf8-encoded input, which is borrowed as by `eexpr_parse`
+  uint8_t* utf8Input;
+  // Output member: whether the input parsed without errors, as returned from `eexpr_parse`
+  bool ok;
+  // Output members: these are exactly as the members of the same name in `eexpr_parser` would be after `eexpr_parse`
+  //   (set to `NULL` or zero where `eexpr_parse` would not have set them), and likewise belong to the caller.
+  size_t nEexprs;
+  eexpr** eexprs;
+  size_t nErrors;
+  eexpr_error* errors;
+  size_t nWarnings;
+  eexpr_error* warnings;
+  eexpr_arena* arena;
+} eexpr_batchDoc;
+
+// Parse many separate inputs, as if each were passed to `eexpr_parse` on a fresh parser configured like `config`.
+// The inputs are shared out over `nWorkers` threads (including the calling thread) by work stealing,
+//   and each thread re-uses its parser's internal buffers from one input to the next, which saves most of the setup for small inputs.
+// The results of each input go into its own `eexpr_batchDoc`, so they come out in input order no matter which thread parsed them.
+// Only the options of `config` are used: `.isError`, `.useArena`, `.borrowInput` and `.lazyNumbers`;
+//   the rest (callbacks, `.pauseAt`, `.nThreads` and `.pipeline`) are ignored, and `config` itself is not touched.
+// Returns true if every input parsed without errors.
+bool eexpr_parseBatch(const eexpr_parser* config, unsigned nWorkers, size_t nDocs, eexpr_batchDoc* docs);
+
+// Parse a fragment holding a single expression, such as a line typed into a REPL or an expression spliced into a template.
+// The fragment is parsed as one semicolon-level expression, as if it were a top-level line of a file, except that:
+//   * no trailing newline is needed, and space, comments and blank lines around the expression are ignored without complaint,
+//   * a colon at the very end is kept as part of the expression (as it would be before a close paren), since no indented block can follow,
+//   * anything left over after the expression (e.g. a second line, or an unmatched close wrap) is an error.
+// This skips the set-up of a whole parser, and the passes over the input that only matter for whole files:
+//   a fragment without newlines is never checked for blank lines or indentation,
+//   and the tokens of a short fragment are kept on the stack rather than the heap.
+// Only the options of `config` are used: `.isError`, `.borrowInput` and `.lazyNumbers`; `config` itself is not touched.
+// On success, returns true and sets `*out` to the expression (or `NULL` for a blank fragment), which belongs to the caller.
+// Otherwise, returns false, sets `*out` to `NULL`, and stores the first error in `*err` (unless `err` is `NULL`).
+// Warnings are not reported.
+bool eexpr_parseExpr(const eexpr_parser* config, size_t nBytes, uint8_t* utf8Input, eexpr** out, eexpr_error* err);
+
 
 // Deallocate internal data structures used by a `eexpr_parser`.
-// This does not free memory used by `.eexprs`, `.errors`, or `.warnings`.
+// This does not free memory used by `.eexprs`, `.flat`, `.errors`, or `.warnings`.
 // Calling this multiple times is idempotent.
 void eexpr_parser_deinit(eexpr_parser* parser);
 
+// Ready a parser to `eexpr_parse` another input, keeping the memory it built up for the last one.
+// This is like `eexpr_parser_deinit` followed by parsing with a fresh parser (the options may be changed in between),
+//   but saves setting up and tearing down the parser's internal state, which dominates the cost of parsing small inputs:
+//   * The internal buffers are kept at whatever size they have grown to.
+//     The token buffer is also grown ahead of time to fit the next input, judging by how many tokens per byte the last input had.
+//   * The `.errors`, `.warnings` and `.tokens` arrays are kept to be filled again, so take a copy of anything still needed from them first.
+//     (Set any of them to `NULL` beforehand to keep that array; it then belongs to the caller as usual.)
+//   * The `.eexprs` array is kept in the same way, but the eexprs in it are not: they (and the `.arena`, if any)
+//     still belong to the caller.
+// Once reset, the parser must be passed a new input by `eexpr_parse` (not `eexpr_parseFeed`), or else deinitialized.
+// Resetting a parser that has not been used yet is a no-op.
+void eexpr_parser_reset(eexpr_parser* parser);
+
+// Bring the output of the last `eexpr_parse` (or `eexpr_reparse`) up to date with an edit to its input,
+//   in which the `oldLen` bytes starting `editStart` bytes in were replaced by `newLen` bytes.
+// `utf8Input` is the whole input after the edit (`nBytes` long), and is borrowed from then on in place of the old one.
+// It may be the old input edited in place, or a fresh copy; either way, the old input need not hold anything in particular any more.
+// Rather than parse the whole input again, this only lexes and parses a region around the edit,
+//   running from the start of a top-level line before it to the start of one after it,
+//   where the lines have to start with a symbol, number, string or open wrap (as for `.nThreads`).
+// The eexprs from that region take the place of the old ones in `.eexprs` (which are freed, except in arena mode),
+//   and every eexpr after it is kept as it is, only moved to its new location.
+// Likewise, the warnings from the region take the place of the old ones, and the rest are kept.
+// The output is exactly the same as from parsing the edited input afresh.
+// If the region turns out not to parse on its own just as it would as part of the whole input
+//   (e.g. the edit opens a wrap that is only closed further on, or the last parse had errors),
+//   the old eexprs are freed (along with the `.arena` in arena mode), and the whole input is parsed again as by `eexpr_parse`.
+// The same goes for an edit that does not fit the last input: one that runs past its end,
+//   or where `nBytes` is not the length of the last input with `oldLen` bytes taken out and `newLen` put in.
+// In arena mode, the eexprs from the region are added to the same `.arena`, and the old ones stay in it until it is released.
+// The region is parsed in one go, whatever the `.budget`, but parsing the whole input again can stop early as `eexpr_parse` does;
+//   if `.interrupted` is set, carry on with `eexpr_parse(&parser, 0, NULL)`.
+// The parser must not have been reset since the last parse, which must have run to the end (`.pauseAt` is not before parsing),
+//   and must have left its output in `.eexprs`, so this does not work with `.flatOutput`, `.onEexpr` or `.events`.
+// The `.eexprs` and `.warnings` arrays may be reallocated.
+// Returns true if the edited input parsed without errors.
+bool eexpr_reparse(eexpr_parser* parser, size_t editStart, size_t oldLen, size_t newLen, size_t nBytes, uint8_t* utf8Input);
+
 
 //////////////////////////////////// Consuming Eexprs ////////////////////////////////////
 
 
-// Recursively free this eexpr and all its data.
+// Free this eexpr along with all its subexprs and data.
+// Not to be used on eexprs produced in arena mode.
 void eexpr_del(eexpr* self);
 
-// Recursively frees data used by the given eexpr, but does not free the eexpr itself.
+// Frees all subexprs and data used by the given eexpr, but does not free the eexpr itself.
+// This does not recurse, so even very deeply nested eexprs can be freed without running out of stack.
+// Not to be used on eexprs produced in arena mode.
 void eexpr_deinit(eexpr* self);
 
+// Free every eexpr produced by a parse in arena mode, along with all their data, in one go.
+// Pointers to any of those eexprs (or their data) become invalid.
+// Passing `NULL` is a no-op.
+void eexpr_arenaRelease(eexpr_arena* arena);
+
 
 typedef enum eexpr_type {
   EEXPR_SYMBOL,
@@ -201,6 +403,7 @@ The `eexpr_as*` functions follow a common pattern:
     (except location, see `eexpr_locate`).
 
 Note that the pointers returned from these functions are owned by the eexpr, and are never referenced from another eexpr.
+(The exception is text borrowed from the input, see `eexpr_parser.borrowInput`.)
 Only *you* have the power to prevent forest fires^W^W^W alias these pointers.
 
 Unless otherwise noted, the pointers input to or output from these functions are non-null.
@@ -223,6 +426,7 @@ typedef struct eexpr_number {
   // E.g. if `.nBigDigits == 2`, then the magnitude of the significand is represented is `2^32 * .bigDigits[1] + .bigDigits[0]`.
   // The smallest possible number of big digits is used. I.e. `.bigDigits[.nBigDigits - 1] != 0`.
   // If `.nBigDigits` is zero, then `.bigDigits` is `NULL`.
+  // A single digit may be stored inside the eexpr itself, so `.bigDigits` lives exactly as long as the eexpr it came from.
   uint32_t* bigDigits;
   // The base that the significand was represented with in the source code.
   // If there is no fractional or exponential part, then this field has only aesthetic value.
@@ -301,6 +505,31 @@ bool eexpr_asComma(const eexpr* self, size_t* nSubexprs, eexpr*** subexprs);
 bool eexpr_asSemicolon(const eexpr* self, size_t* nSubexprs, eexpr*** subexprs);
 
 
+// What a walk should do after a callback (see `eexpr_walk`).
+typedef enum eexpr_walkStep {
+  EEXPR_WALK_CONTINUE,
+  EEXPR_WALK_SKIP, // only from `enter`: do not walk the subexprs of this eexpr (but still call `exit` on it)
+  EEXPR_WALK_STOP // end the walk right away, without calling any more callbacks
+} eexpr_walkStep;
+
+typedef struct eexpr_walker {
+  // passed as the first argument to every callback
+  void* ctx;
+  // called on each eexpr before any of its subexprs (preorder)
+  // `depth` is zero for the eexpr the walk started at, one for its subexprs, and so on
+  eexpr_walkStep (*enter)(void* ctx, const eexpr* self, size_t depth);
+  // called on each eexpr after all of its subexprs (postorder), with the same arguments as the matching `enter`
+  eexpr_walkStep (*exit)(void* ctx, const eexpr* self, size_t depth);
+} eexpr_walker;
+
+// Walk depth-first through `root` and all its subexprs, in the order they appear in the source.
+// Missing subexprs (see the `eexpr_as*` functions which may output `NULL`) are passed over, and either callback may be `NULL`.
+// The walk does not recurse, and only allocates if the eexpr is nested more deeply than a few dozen levels,
+//   so it is cheap enough to run many times over the same eexprs.
+// Returns false if a callback stopped the walk early.
+bool eexpr_walk(const eexpr* root, const eexpr_walker* walker);
+
+
 
 // I do not report filenames as part of a location.
 // For one thing, the input may not be from a file (e.g. instead drawn from terminal input).
@@ -330,6 +559,66 @@ typedef struct eexpr_loc {
 eexpr_loc eexpr_locate(const eexpr* self);
 
 
+/*
+A flat forest holds a whole array of eexprs in one contiguous block of memory, rather than as a graph of pointers.
+The eexprs are laid out one node after another in preorder, and their text and bignum digits are kept in a side buffer after the nodes.
+Nodes refer to their subexprs and data only by 32-bit relative offsets, so the block can be copied with `memcpy` as it is,
+  and read-only passes over the eexprs run straight through memory.
+A flat forest is read-only, so it can also be read from multiple threads at once.
+
+The `eexpr_flatAs*` functions mirror the `eexpr_as*` functions, except that subexprs are given as nodes, and lists of subexprs are
+  given as their first node, from which the rest are reached with `eexpr_flatNext`.
+Their outputs point into the flat forest, and live exactly as long as it does.
+*/
+
+// Copy an array of eexprs (none of them `NULL`) into a new flat forest; the eexprs themselves are left as they were.
+// Returns `NULL` if the forest would be too large for 32-bit offsets (about 4GiB in all).
+eexpr_flat* eexpr_flatten(size_t nEexprs, eexpr* const* eexprs);
+
+// Free a flat forest (a no-op for `NULL`).
+void eexpr_flatDel(eexpr_flat* flat);
+
+// The size of a flat forest in bytes; this much memory starting at `flat` is all there is to it.
+size_t eexpr_flatSize(const eexpr_flat* flat);
+
+// The number of (top-level) eexprs in a flat forest.
+size_t eexpr_flatCount(const eexpr_flat* flat);
+
+// The node of the first eexpr in a flat forest, or `NULL` if there are none.
+const eexpr_flatNode* eexpr_flatFirst(const eexpr_flat* flat);
+
+// The node after `self` and all of its subexprs: that is, its next sibling (or the next top-level eexpr).
+// This is only meaningful if `self` is not the last of its siblings, so it should be used along with a count of them.
+const eexpr_flatNode* eexpr_flatNext(const eexpr_flatNode* self);
+
+eexpr_type eexpr_flatGetType(const eexpr_flatNode* self);
+
+eexpr_loc eexpr_flatLocate(const eexpr_flatNode* self);
+
+bool eexpr_flatAsSymbol(const eexpr_flatNode* self, size_t* nBytes, const uint8_t** utf8str);
+
+bool eexpr_flatAsNumber(const eexpr_flatNode* self, eexpr_number* value);
+
+// `nSubexprs` counts the parts after the head; get at each of them with `eexpr_flatStringPart`.
+bool eexpr_flatAsString(const eexpr_flatNode* self, size_t* nBytes, const uint8_t** utf8str, size_t* nSubexprs);
+
+// The `i`th part of a string after its head, which must be less than the `nSubexprs` from `eexpr_flatAsString`.
+// The output subexpr is `NULL` if it is missing, as with `eexpr_strTemplate.subexpr`.
+void eexpr_flatStringPart(const eexpr_flatNode* self, size_t i, const eexpr_flatNode** subexpr, size_t* nBytes, const uint8_t** utf8str);
+
+bool eexpr_flatAsParen(const eexpr_flatNode* self, const eexpr_flatNode** subexpr);
+bool eexpr_flatAsBrack(const eexpr_flatNode* self, const eexpr_flatNode** subexpr);
+bool eexpr_flatAsBrace(const eexpr_flatNode* self, const eexpr_flatNode** subexpr);
+bool eexpr_flatAsBlock(const eexpr_flatNode* self, size_t* nSubexprs, const eexpr_flatNode** first);
+bool eexpr_flatAsPredot(const eexpr_flatNode* self, const eexpr_flatNode** subexpr);
+bool eexpr_flatAsChain(const eexpr_flatNode* self, size_t* nSubexprs, const eexpr_flatNode** first);
+bool eexpr_flatAsSpace(const eexpr_flatNode* self, size_t* nSubexprs, const eexpr_flatNode** first);
+bool eexpr_flatAsEllipsis(const eexpr_flatNode* self, const eexpr_flatNode** before, const eexpr_flatNode** after);
+bool eexpr_flatAsColon(const eexpr_flatNode* self, const eexpr_flatNode** before, const eexpr_flatNode** after);
+bool eexpr_flatAsComma(const eexpr_flatNode* self, size_t* nSubexprs, const eexpr_flatNode** first);
+bool eexpr_flatAsSemicolon(const eexpr_flatNode* self, size_t* nSubexprs, const eexpr_flatNode** first);
+
+
 //////////////////////////////////// Parse Errors ////////////////////////////////////
 
 typedef enum eexpr_errorType {
@@ -364,7 +653,8 @@ typedef enum eexpr_errorType {
   EEXPR_ERR_UNBALANCED_WRAP,
   EEXPR_ERR_EXPECTING_NEWLINE_OR_DEDENT,
   EEXPR_ERR_MISSING_TEMPLATE_EXPR,
-  EEXPR_ERR_MISSING_CLOSE_TEMPLATE
+  EEXPR_ERR_MISSING_CLOSE_TEMPLATE,
+  EEXPR_ERR_EXPECTING_END_OF_FRAGMENT // only from `eexpr_parseExpr`
 } eexpr_errorType;
 
 typedef enum eexpr_wrapType {
@@ -402,6 +692,100 @@ struct eexpr_error {
 };
 
 
+//////////////////////////////////// Serialized Eexprs ////////////////////////////////////
+
+/*
+The results of a parse can be saved in a compact binary form, to be loaded back later without parsing (or even reading) the input again.
+The binary form holds the eexprs as a flat forest (see `eexpr_flatten`), along with the errors and warnings of the parse.
+Since a flat forest holds no pointers, loading only has to map the file into memory, and the forest is then read right where it lies,
+  with its pages read in from disk only as they are touched.
+
+The format is versioned by `EEXPR_SERIAL_VERSION`, which changes whenever the layout does.
+Files of any other version, or written on a machine with another byte order, are refused when loading.
+So are files that have been truncated or corrupted in any way that would lead the `eexpr_flat*` functions astray,
+  which takes a single pass over the forest as it is loaded.
+Where a file is known to have been written by `eexpr_serialize` and left alone since, that pass can be skipped with `eexpr_mapFileTrusted`.
+*/
+
+#define EEXPR_SERIAL_VERSION 1
+
+// Encode a flat forest (or `NULL` for no eexprs) along with the errors and warnings of its parse.
+// Returns a `malloc`d buffer of `*nBytes` bytes, ready to be written to a file,
+//   or `NULL` if the locations of the errors or warnings are too large for 32 bits.
+uint8_t* eexpr_serialize
+  ( const eexpr_flat* flat
+  , size_t nErrors, const eexpr_error* errors
+  , size_t nWarnings, const eexpr_error* warnings
+  , size_t* nBytes
+  );
+
+// A file written by `eexpr_serialize`, loaded by `eexpr_mapFile`.
+typedef struct eexpr_mapping {
+  // The eexprs, which are read straight from the mapped file.
+  const eexpr_flat* flat;
+  // The errors and warnings, which are decoded into `malloc`d arrays (or `NULL` if there are none) as the file is loaded.
+  size_t nErrors;
+  eexpr_error* errors;
+  size_t nWarnings;
+  eexpr_error* warnings;
+  // pointer to implementation
+  eexpr_mappingInternal* impl;
+} eexpr_mapping;
+
+// Load a file written by `eexpr_serialize`, mapping it into memory where the platform allows (and otherwise reading it all in).
+// Returns false if the file cannot be read, is not of this version of the format, or is not well-formed.
+bool eexpr_mapFile(const char* filename, eexpr_mapping* out);
+
+// Like `eexpr_mapFile`, but only the header is checked, so loading takes no time at all no matter how large the file.
+// Only use this on files that are known to have been written by `eexpr_serialize` and left alone since:
+//   reading a corrupt file loaded this way is undefined behavior.
+bool eexpr_mapFileTrusted(const char* filename, eexpr_mapping* out);
+
+// Release a loaded file; `.flat` and everything read from it become invalid.
+// Calling this multiple times is idempotent.
+void eexpr_unmapFile(eexpr_mapping* mapping);
+
+
+//////////////////////////////////// Event-Driven Parsing ////////////////////////////////////
+
+/*
+Callbacks to report eexprs as a depth-first sequence of events, rather than as a tree of `eexpr`s (see `eexpr_parser.events`).
+This suits consumers that translate eexprs straight into their own data structures.
+Each eexpr is still built up internally (the grammar needs lookahead to know what sort of node it is in),
+  but only a top-level eexpr at a time, in memory that is re-used from one to the next, so no memory is allocated per node.
+Any pointers passed to a callback are only valid until it returns.
+Any callback may be `NULL`, in which case those events are skipped.
+The events are reported without recursion, so eexprs nested as deeply as the parser allows are reported as well.
+
+The events for each type of eexpr are:
+  * symbol: `symbol`
+  * number: `number`
+  * string: `begin`, then `stringPart` for the first text part,
+      then for each further part, the events for its spliced subexpr (or `absent`) followed by `stringPart`,
+      and finally `end`
+  * paren, brack, brace: `begin`, the events for its subexpr (or `absent` if empty), `end`
+  * predot: `begin`, the events for its subexpr, `end`
+  * block, chain, space, comma, semicolon: `begin`, the events for each subexpr in order, `end`
+  * colon: `begin`, the events for the subexprs before and after, `end`
+  * ellipsis: `begin`, the events for the subexprs before and after (either of which may be `absent`), `end`
+*/
+struct eexpr_events {
+  // passed as the first argument to every callback
+  void* ctx;
+  // start/finish an eexpr with subexprs; `end` is passed the same arguments as the matching `begin`
+  void (*begin)(void* ctx, eexpr_type type, eexpr_loc loc);
+  void (*end)(void* ctx, eexpr_type type, eexpr_loc loc);
+  void (*symbol)(void* ctx, eexpr_loc loc, size_t nBytes, const uint8_t* utf8str);
+  void (*number)(void* ctx, eexpr_loc loc, const eexpr_number* value);
+  void (*stringPart)(void* ctx, size_t nBytes, const uint8_t* utf8str);
+  // stands in for a subexpr that is allowed to be missing
+  void (*absent)(void* ctx);
+  // reports each error (it is also added to `eexpr_parser.errors` as usual)
+  // errors are reported once the top-level eexprs around them have been parsed, so may follow the events of later eexprs
+  void (*error)(void* ctx, const eexpr_error* err);
+};
+
+
 //////////////////////////////////// Tokens ////////////////////////////////////
 
 typedef enum eexpr_tokenType {
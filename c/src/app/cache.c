@@ -0,0 +1,238 @@
+// directory listing, file times and the process id are POSIX, not standard C, so they must be asked for before anything is included
+#define _POSIX_C_SOURCE 200809L
+
+#include "cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+#define ENTRY_MAGIC "e2jcache"
+#define ENTRY_VERSION 2
+#define ENTRY_SUFFIX ".cache"
+#define ENTRY_NAME_LEN (16 + sizeof(ENTRY_SUFFIX) - 1)
+#define ABSENT_PART UINT64_MAX
+
+/*
+An entry file is laid out as (with numbers in native byte order, since a cache is never moved between machines):
+  * the magic bytes, then the version, the length of the config, the length of the input, the exit code, and the number of parts, as `uint64_t`s,
+  * the length of each part as a `uint64_t`, or `ABSENT_PART`,
+  * the config, the input, then each part's bytes in turn.
+*/
+
+// 64-bit FNV-1a, which only has to spread entries over names; the entry itself says what it is for
+static
+uint64_t hashBytes(uint64_t h, str bytes) {
+  for (size_t i = 0; i < bytes.len; ++i) {
+    h ^= bytes.bytes[i];
+    h *= UINT64_C(0x100000001b3);
+  }
+  return h;
+}
+
+bool cache_openDir(const char* dir) {
+  if (mkdir(dir, 0777) == 0) { return true; }
+  struct stat info;
+  // another invocation may have just created it
+  return errno == EEXIST && stat(dir, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+cacheEntry cache_entry(const char* dir, uint64_t maxBytes, str config, str input) {
+  uint64_t h = UINT64_C(0xcbf29ce484222325);
+  h = hashBytes(h, config);
+  h = hashBytes(h, input);
+  cacheEntry self = {.dir = dir, .maxBytes = maxBytes, .config = config, .input = input};
+  size_t len = strlen(dir) + 1 + ENTRY_NAME_LEN + 1;
+  self.path = malloc(len);
+  if (self.path != NULL) {
+    snprintf(self.path, len, "%s/%016llx" ENTRY_SUFFIX, dir, (unsigned long long)h);
+  }
+  return self;
+}
+
+void cache_entryDel(cacheEntry* self) {
+  free(self->path);
+  self->path = NULL;
+}
+
+static
+uint64_t readU64(const uint8_t* bytes) {
+  uint64_t n;
+  memcpy(&n, bytes, sizeof(uint64_t));
+  return n;
+}
+
+bool cache_load(const cacheEntry* self, cached* out) {
+  out->exitcode = 0;
+  out->nParts = 0;
+  if (self->path == NULL) { return false; }
+  str entry = readFile(self->path);
+  if (entry.bytes == NULL) { return false; }
+  const size_t nHeader = 6 * sizeof(uint64_t);
+  if (entry.len < nHeader || memcmp(entry.bytes, ENTRY_MAGIC, 8) != 0) { goto miss; }
+  uint64_t version = readU64(&entry.bytes[8]);
+  uint64_t configLen = readU64(&entry.bytes[16]);
+  uint64_t inputLen = readU64(&entry.bytes[24]);
+  uint64_t exitcode = readU64(&entry.bytes[32]);
+  uint64_t nParts = readU64(&entry.bytes[40]);
+  if ( version != ENTRY_VERSION
+    || configLen != self->config.len
+    || inputLen != self->input.len
+    || nParts > CACHE_MAX_PARTS
+    || entry.len < nHeader + nParts * sizeof(uint64_t) + configLen + inputLen
+     ) {
+    goto miss;
+  }
+  size_t at = nHeader + nParts * sizeof(uint64_t);
+  if (memcmp(&entry.bytes[at], self->config.bytes, configLen) != 0) { goto miss; }
+  at += configLen;
+  if (inputLen != 0 && memcmp(&entry.bytes[at], self->input.bytes, inputLen) != 0) { goto miss; }
+  at += inputLen;
+  for (size_t i = 0; i < nParts; ++i) {
+    uint64_t len = readU64(&entry.bytes[nHeader + i * sizeof(uint64_t)]);
+    if (len == ABSENT_PART) { continue; }
+    if (len > entry.len - at) { goto miss; }
+    at += len;
+  }
+  if (at != entry.len) { goto miss; }
+
+  at = nHeader + nParts * sizeof(uint64_t) + configLen + inputLen;
+  out->exitcode = exitcode;
+  out->nParts = nParts;
+  for (size_t i = 0; i < nParts; ++i) {
+    uint64_t len = readU64(&entry.bytes[nHeader + i * sizeof(uint64_t)]);
+    out->parts[i].len = 0;
+    out->parts[i].bytes = NULL;
+    if (len == ABSENT_PART) { continue; }
+    out->parts[i].bytes = malloc(len == 0 ? 1 : len);
+    if (out->parts[i].bytes == NULL) {
+      out->nParts = i;
+      cached_deinit(out);
+      goto miss;
+    }
+    memcpy(out->parts[i].bytes, &entry.bytes[at], len);
+    out->parts[i].len = len;
+    at += len;
+  }
+  free(entry.bytes);
+  // mark the entry as recently used, so that it is among the last to be evicted
+  utimensat(AT_FDCWD, self->path, NULL, 0);
+  return true;
+
+  miss: {
+    free(entry.bytes);
+    return false;
+  }
+}
+
+static
+bool writeU64(FILE* fp, uint64_t n) {
+  return fwrite(&n, sizeof(uint64_t), 1, fp) == 1;
+}
+
+typedef struct evictable {
+  char* path; // owned
+  uint64_t size;
+  struct timespec used;
+} evictable;
+
+static
+int compareUsed(const void* a_, const void* b_) {
+  const evictable* a = a_;
+  const evictable* b = b_;
+  if (a->used.tv_sec != b->used.tv_sec) { return a->used.tv_sec < b->used.tv_sec ? -1 : 1; }
+  if (a->used.tv_nsec != b->used.tv_nsec) { return a->used.tv_nsec < b->used.tv_nsec ? -1 : 1; }
+  return 0;
+}
+
+// Remove the least recently used entries until the total size of those left is within `self->maxBytes`.
+// Another invocation may be evicting at the same time; an entry it has already removed is simply skipped.
+static
+void evict(const cacheEntry* self) {
+  DIR* dir = opendir(self->dir);
+  if (dir == NULL) { return; }
+  size_t len = 0, cap = 0;
+  evictable* all = NULL;
+  uint64_t total = 0;
+  for (struct dirent* ent = readdir(dir); ent != NULL; ent = readdir(dir)) {
+    size_t nameLen = strlen(ent->d_name);
+    // only whole entries are counted, not temporary files still being written
+    if (nameLen != ENTRY_NAME_LEN || strcmp(&ent->d_name[16], ENTRY_SUFFIX) != 0) { continue; }
+    size_t pathLen = strlen(self->dir) + 1 + nameLen + 1;
+    char* path = malloc(pathLen);
+    if (path == NULL) { break; }
+    snprintf(path, pathLen, "%s/%s", self->dir, ent->d_name);
+    struct stat info;
+    if (stat(path, &info) != 0) { free(path); continue; }
+    if (len == cap) {
+      size_t newCap = cap == 0 ? 16 : 2 * cap;
+      evictable* newAll = realloc(all, newCap * sizeof(evictable));
+      if (newAll == NULL) { free(path); break; }
+      all = newAll; cap = newCap;
+    }
+    all[len++] = (evictable){.path = path, .size = info.st_size, .used = info.st_mtim};
+    total += info.st_size;
+  }
+  closedir(dir);
+  if (total > self->maxBytes) {
+    qsort(all, len, sizeof(evictable), compareUsed);
+    for (size_t i = 0; i < len && total > self->maxBytes; ++i) {
+      remove(all[i].path);
+      total -= all[i].size;
+    }
+  }
+  for (size_t i = 0; i < len; ++i) {
+    free(all[i].path);
+  }
+  free(all);
+}
+
+void cache_store(const cacheEntry* self, const cached* outputs) {
+  if (self->path == NULL) { return; }
+  size_t tmpLen = strlen(self->path) + 32;
+  char* tmp = malloc(tmpLen);
+  if (tmp == NULL) { return; }
+  // the process id keeps parallel invocations writing the same entry out of each other's way
+  snprintf(tmp, tmpLen, "%s.%ld.tmp", self->path, (long)getpid());
+  FILE* fp = fopen(tmp, "wb");
+  if (fp == NULL) { free(tmp); return; }
+  bool ok = fwrite(ENTRY_MAGIC, 1/*byte per element*/, 8/*elements*/, fp) == 8
+         && writeU64(fp, ENTRY_VERSION)
+         && writeU64(fp, self->config.len)
+         && writeU64(fp, self->input.len)
+         && writeU64(fp, outputs->exitcode)
+         && writeU64(fp, outputs->nParts)
+          ;
+  for (size_t i = 0; ok && i < outputs->nParts; ++i) {
+    ok = writeU64(fp, outputs->parts[i].bytes == NULL ? ABSENT_PART : outputs->parts[i].len);
+  }
+  ok = ok && fwrite(self->config.bytes, 1/*byte per element*/, self->config.len/*elements*/, fp) == self->config.len;
+  ok = ok && fwrite(self->input.bytes, 1/*byte per element*/, self->input.len/*elements*/, fp) == self->input.len;
+  for (size_t i = 0; ok && i < outputs->nParts; ++i) {
+    str part = outputs->parts[i];
+    if (part.bytes == NULL) { continue; }
+    ok = fwrite(part.bytes, 1/*byte per element*/, part.len/*elements*/, fp) == part.len;
+  }
+  ok = fclose(fp) == 0 && ok;
+  // readers only ever see a whole entry: either the one before the rename or the one after
+  if (!ok || rename(tmp, self->path) != 0) {
+    remove(tmp);
+  }
+  free(tmp);
+  if (ok) { evict(self); }
+}
+
+void cached_deinit(cached* self) {
+  for (size_t i = 0; i < self->nParts; ++i) {
+    free(self->parts[i].bytes);
+    self->parts[i].len = 0;
+    self->parts[i].bytes = NULL;
+  }
+  self->nParts = 0;
+}
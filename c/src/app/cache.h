@@ -0,0 +1,58 @@
+/*
+A cache of eexpr2json's outputs, kept as a directory of files, one per entry.
+Entries are named by a hash of the input and of a description of the options that affect the output,
+  so an unchanged input run with unchanged options is answered from the cache without being parsed again.
+The description and the input are stored in the entry as well, and compared in full on a hit,
+  so inputs whose hashes collide are never answered with each other's outputs (they only take turns at the entry).
+
+Entries are written to a temporary file and renamed into place, so parallel invocations sharing a cache directory
+  never see each other's half-written entries (at worst, they both parse the input and one entry replaces the other).
+Entries are touched whenever they are used, and once the directory grows beyond its bound,
+  the least recently used entries are removed until it fits again.
+*/
+#ifndef APP_CACHE_H
+#define APP_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "strstuff.h"
+
+
+#define CACHE_MAX_PARTS 8
+
+// The outputs of one run: the exit code, and the contents of a few outputs, such as stdout or dump files.
+typedef struct cached {
+  int exitcode;
+  size_t nParts;
+  str parts[CACHE_MAX_PARTS]; // `.bytes == NULL` for an output that was not written
+} cached;
+
+typedef struct cacheEntry {
+  const char* dir;
+  uint64_t maxBytes; // bound on the total size of the entries in `dir`
+  char* path; // owned
+  str config; // borrowed
+  str input; // borrowed
+} cacheEntry;
+
+// Make sure the cache directory exists, creating it (but not any missing parents) if need be.
+// Returns false if it does not exist and could not be created.
+bool cache_openDir(const char* dir);
+
+// The entry for `input` under the options described by `config`.
+cacheEntry cache_entry(const char* dir, uint64_t maxBytes, str config, str input);
+
+void cache_entryDel(cacheEntry* self);
+
+// Returns false if there is no usable entry; otherwise, `out` is filled with freshly `malloc`d outputs.
+bool cache_load(const cacheEntry* self, cached* out);
+
+// Write the entry, then evict entries if the directory has grown too large.
+// Failures are silently ignored; the outputs are simply not cached.
+void cache_store(const cacheEntry* self, const cached* outputs);
+
+void cached_deinit(cached* self);
+
+
+#endif
@@ -219,6 +219,38 @@ void fdumpToken(FILE* fp, const eexpr_token* tok) {
   fprintf(fp, "}");
 }
 
+// the members of a number's json object, which are the same for flat and ordinary eexprs
+void fdumpNumber(FILE* fp, int indent, const eexpr_number* num) {
+  {
+    bigint mantissa = {.pos = num->isPositive, .len = num->nBigDigits, .buf = num->bigDigits};
+    str tmp = bigint_toDecimal(mantissa);
+    fprintf( fp, "\n%*s, \"type\":\"number\",\"%s\":"
+           , indent, ""
+           , num->nFracDigits == 0 ? "value" : "mantissa");
+    fdumpStr(fp, tmp);
+    free(tmp.bytes);
+  }
+  if (num->radix != 10) {
+    fprintf(fp, ",\"radix\":%d", num->radix);
+  }
+  if (num->nFracDigits != 0 || num->nBigDigits_exp != 0) {
+    fprintf(fp, ",\"exponent\":{");
+    bool needsComma = false;
+    if (num->nFracDigits != 0) {
+      fprintf(fp, "%s\"fractional\":-%"PRIu32, needsComma ? "," : "", num->nFracDigits);
+      needsComma = true;
+    }
+    if (num->nBigDigits_exp != 0) {
+      bigint exponent = {.pos = num->isPositive_exp, .len = num->nBigDigits_exp, .buf = num->bigDigits_exp};
+      str tmp = bigint_toDecimal(exponent);
+      fprintf(fp, "%s\"explicit\":", needsComma ? "," : "");
+      fdumpStr(fp, tmp);
+      free(tmp.bytes);
+    }
+    fprintf(fp, "}");
+  }
+}
+
 void fdumpEexpr(FILE* fp, int indent, const eexpr* x) {
   eexpr_loc loc = eexpr_locate(x);
   fprintf(fp, "{ \"loc\":{\"from\":{\"line\":%zu,\"col\":%zu},\"to\":{\"line\":%zu,\"col\":%zu}}"
@@ -236,34 +268,7 @@ void fdumpEexpr(FILE* fp, int indent, const eexpr* x) {
     }; break;
     case EEXPR_NUMBER: {
       eexpr_number num; eexpr_asNumber(x, &num);
-      {
-        bigint mantissa = {.pos = num.isPositive, .len = num.nBigDigits, .buf = num.bigDigits};
-        str tmp = bigint_toDecimal(mantissa);
-        fprintf( fp, "\n%*s, \"type\":\"number\",\"%s\":"
-               , indent, ""
-               , num.nFracDigits == 0 ? "value" : "mantissa");
-        fdumpStr(fp, tmp);
-        free(tmp.bytes);
-      }
-      if (num.radix != 10) {
-        fprintf(fp, ",\"radix\":%d", num.radix);
-      }
-      if (num.nFracDigits != 0 || num.nBigDigits_exp != 0) {
-        fprintf(fp, ",\"exponent\":{");
-        bool needsComma = false;
-        if (num.nFracDigits != 0) {
-          fprintf(fp, "%s\"fractional\":-%"PRIu32, needsComma ? "," : "", num.nFracDigits);
-          needsComma = true;
-        }
-        if (num.nBigDigits_exp != 0) {
-          bigint exponent = {.pos = num.isPositive_exp, .len = num.nBigDigits_exp, .buf = num.bigDigits_exp};
-          str tmp = bigint_toDecimal(exponent);
-          fprintf(fp, "%s\"explicit\":", needsComma ? "," : "");
-          fdumpStr(fp, tmp);
-          free(tmp.bytes);
-        }
-        fprintf(fp, "}");
-      }
+      fdumpNumber(fp, indent, &num);
     }; break;
     case EEXPR_STRING: {
       eexpr_string s; eexpr_asString(x, &s);
@@ -384,6 +389,146 @@ void fdumpEexpr(FILE* fp, int indent, const eexpr* x) {
   fprintf(fp, "\n%*s}", indent, "");
 }
 
+// Exactly as `fdumpEexpr`, but for a node of a flat forest (see `eexpr_flatten`).
+void fdumpFlatEexpr(FILE* fp, int indent, const eexpr_flatNode* x) {
+  eexpr_loc loc = eexpr_flatLocate(x);
+  fprintf(fp, "{ \"loc\":{\"from\":{\"line\":%zu,\"col\":%zu},\"to\":{\"line\":%zu,\"col\":%zu}}"
+         , loc.start.line + 1
+         , loc.start.col + 1
+         , loc.end.line + 1
+         , loc.end.col + 1
+         );
+  eexpr_type type = eexpr_flatGetType(x);
+  switch (type) {
+    case EEXPR_SYMBOL: {
+      size_t n; const uint8_t* s; eexpr_flatAsSymbol(x, &n, &s);
+      fprintf(fp, "\n%*s, \"type\":\"symbol\",\"text\":", indent, "");
+      fdumpStrn(fp, n, (uint8_t*)s);
+    }; break;
+    case EEXPR_NUMBER: {
+      eexpr_number num; eexpr_flatAsNumber(x, &num);
+      fdumpNumber(fp, indent, &num);
+    }; break;
+    case EEXPR_STRING: {
+      size_t n; const uint8_t* s; size_t nSubexprs; eexpr_flatAsString(x, &n, &s, &nSubexprs);
+      fprintf(fp, "\n%*s, \"type\":\"string\"", indent, "");
+      if (nSubexprs == 0) {
+        fprintf(fp, ",\"text\":");
+        fdumpStrn(fp, n, (uint8_t*)s);
+      }
+      else {
+        fprintf(fp, ",\"template\":\n%*s[ ", indent+2, "");
+        fdumpStrn(fp, n, (uint8_t*)s);
+        for (size_t i = 0; i < nSubexprs; ++i) {
+          const eexpr_flatNode* y; eexpr_flatStringPart(x, i, &y, &n, &s);
+          fprintf(fp, "\n%*s, ", indent+2, "");
+          if (y != NULL) {
+            fdumpFlatEexpr(fp, indent+4, y);
+          }
+          else {
+            fprintf(fp, "null");
+          }
+          fprintf(fp, "\n%*s, ", indent+2, "");
+          fdumpStrn(fp, n, (uint8_t*)s);
+        }
+        fprintf(fp, "\n%*s]", indent+2, "");
+      }
+    }; break;
+    case EEXPR_PAREN: {
+      const eexpr_flatNode* y; eexpr_flatAsParen(x, &y);
+      fprintf(fp, "\n%*s, \"type\":\"paren\"", indent, "");
+      if (y == NULL) {
+        fprintf(fp, ",\"subexpr\":null");
+      }
+      else {
+        fprintf(fp, ",\"subexpr\":\n%*s  ", indent, "");
+        fdumpFlatEexpr(fp, indent+2, y);
+      }
+    }; break;
+    case EEXPR_BRACK: {
+      const eexpr_flatNode* y; eexpr_flatAsBrack(x, &y);
+      fprintf(fp, "\n%*s, \"type\":\"bracket\"", indent, "");
+      if (y == NULL) {
+        fprintf(fp, ",\"subexpr\":null");
+      }
+      else {
+        fprintf(fp, ",\"subexpr\":\n%*s  ", indent, "");
+        fdumpFlatEexpr(fp, indent+2, y);
+      }
+    }; break;
+    case EEXPR_BRACE: {
+      const eexpr_flatNode* y; eexpr_flatAsBrace(x, &y);
+      fprintf(fp, "\n%*s, \"type\":\"brace\"", indent, "");
+      if (y == NULL) {
+        fprintf(fp, ",\"subexpr\":null");
+      }
+      else {
+        fprintf(fp, ",\"subexpr\":\n%*s  ", indent, "");
+        fdumpFlatEexpr(fp, indent+2, y);
+      }
+    }; break;
+    case EEXPR_BLOCK: {
+      size_t n; const eexpr_flatNode* first; eexpr_flatAsBlock(x, &n, &first);
+      fprintf(fp, "\n%*s, \"type\":\"block\",\"subexprs\":", indent, "");
+      fdumpFlatEexprArray(fp, indent+2, n, first);
+    }; break;
+    case EEXPR_PREDOT: {
+      const eexpr_flatNode* y; eexpr_flatAsPredot(x, &y);
+      fprintf(fp, "\n%*s, \"type\":\"predot\",\"subexpr\":", indent, "");
+      fdumpFlatEexpr(fp, indent+2, y);
+    }; break;
+    case EEXPR_CHAIN: {
+      size_t n; const eexpr_flatNode* first; eexpr_flatAsChain(x, &n, &first);
+      fprintf(fp, "\n%*s, \"type\":\"chain\",\"subexprs\":", indent, "");
+      fdumpFlatEexprArray(fp, indent+2, n, first);
+    }; break;
+    case EEXPR_SPACE: {
+      size_t n; const eexpr_flatNode* first; eexpr_flatAsSpace(x, &n, &first);
+      fprintf(fp, "\n%*s, \"type\":\"space\",\"subexprs\":", indent, "");
+      fdumpFlatEexprArray(fp, indent+2, n, first);
+    }; break;
+    case EEXPR_ELLIPSIS: {
+      const eexpr_flatNode* before, *after; eexpr_flatAsEllipsis(x, &before, &after);
+      fprintf(fp, "\n%*s, \"type\":\"ellipsis\"", indent, "");
+      fprintf(fp, "\n%*s, \"before\":", indent, "");
+      if (before == NULL) {
+        fprintf(fp, "null");
+      }
+      else {
+        fprintf(fp, "\n%*s", indent+2, "");
+        fdumpFlatEexpr(fp, indent+2, before);
+      }
+      fprintf(fp, "\n%*s, \"after\":", indent, "");
+      if (after == NULL) {
+        fprintf(fp, "null");
+      }
+      else {
+        fprintf(fp, "\n%*s", indent+2, "");
+        fdumpFlatEexpr(fp, indent+2, after);
+      }
+    }; break;
+    case EEXPR_COLON: {
+      const eexpr_flatNode* before, *after; eexpr_flatAsColon(x, &before, &after);
+      fprintf(fp, "\n%*s, \"type\":\"colon\",\"subexprs\":\n%*s[ ", indent, "", indent+2, "");
+      fdumpFlatEexpr(fp, indent+4, before);
+      fprintf(fp, "\n%*s, ", indent+2, "");
+      fdumpFlatEexpr(fp, indent+4, after);
+      fprintf(fp, "\n%*s]", indent+2, "");
+    }; break;
+    case EEXPR_COMMA: {
+      size_t n; const eexpr_flatNode* first; eexpr_flatAsComma(x, &n, &first);
+      fprintf(fp, "\n%*s, \"type\":\"comma\",\"subexprs\":", indent, "");
+      fdumpFlatEexprArray(fp, indent+2, n, first);
+    }; break;
+    case EEXPR_SEMICOLON: {
+      size_t n; const eexpr_flatNode* first; eexpr_flatAsSemicolon(x, &n, &first);
+      fprintf(fp, "\n%*s, \"type\":\"semicolon\",\"subexprs\":", indent, "");
+      fdumpFlatEexprArray(fp, indent+2, n, first);
+    }; break;
+  }
+  fprintf(fp, "\n%*s}", indent, "");
+}
+
 void fdumpError(FILE* fp, const eexpr_error* err) {
   fprintf(fp, "{\"loc\":{\"from\":{\"line\":%zu,\"col\":%zu},\"to\":{\"line\":%zu,\"col\":%zu}}"
          , err->loc.start.line + 1
@@ -507,6 +652,9 @@ void fdumpError(FILE* fp, const eexpr_error* err) {
     case EEXPR_ERR_MISSING_CLOSE_TEMPLATE: {
       fprintf(fp, ",\"type\":\"missing-close-template\"");
     }; break;
+    case EEXPR_ERR_EXPECTING_END_OF_FRAGMENT: {
+      fprintf(fp, ",\"type\":\"expect-end-of-fragment\"");
+    }; break;
   }
   fprintf(fp, "}");
 }
@@ -541,6 +689,23 @@ void fdumpEexprArray(FILE* fp, int indent, size_t n, eexpr** xs) {
   }
 }
 
+void fdumpFlatEexprArray(FILE* fp, int indent, size_t n, const eexpr_flatNode* first) {
+  if (n == 0) {
+    fprintf(fp, "[]");
+  }
+  else {
+    char* separator = "[ ";
+    const eexpr_flatNode* x = first;
+    for (size_t i = 0; i < n; ++i) {
+      if (i != 0) { x = eexpr_flatNext(x); }
+      fprintf(fp, "\n%*s%s", indent, "", separator);
+      fdumpFlatEexpr(fp, indent + 2, x);
+      separator = ", ";
+    }
+    fprintf(fp, "\n%*s]", indent, "");
+  }
+}
+
 void fdumpErrorArray(FILE* fp, const char* indent, size_t n, eexpr_error* arr) {
   if (n == 0) {
     fprintf(fp, " []");
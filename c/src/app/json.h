@@ -16,6 +16,7 @@ void fdumpError(FILE* fp, const eexpr_error* err);
 
 void fdumpTokenArray(FILE* fp, const char* indent, size_t n, eexpr_token** arr);
 void fdumpEexprArray(FILE* fp, int indent, size_t n, eexpr** xs);
+void fdumpFlatEexprArray(FILE* fp, int indent, size_t n, const eexpr_flatNode* first);
 void fdumpErrorArray(FILE* fp, const char* indent, size_t n, eexpr_error* arr);
 
 
@@ -1,7 +1,12 @@
 #include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "bigint.h"
+#include "cache.h"
 #include "json.h"
 
 void die(const char* msg) {
@@ -16,11 +21,42 @@ typedef enum level {
 } level;
 typedef struct options {
   char* inFilename;
+  // when more than one input file is given, they are parsed as a batch (see `eexpr_parseBatch`), and this is all of them
+  size_t nBatch;
+  char** batch;
+  size_t streamChunk; // when non-zero, feed the input to the parser in pieces of this many bytes
+  bool eachEexpr; // receive eexprs one at a time through `eexpr_parser.onEexpr`
+  bool events; // print parse events (see `eexpr_parser.events`) one per line instead of json
+  bool walk; // print a walk over the parsed eexprs (see `eexpr_walk`) one step per line instead of json
+  bool arena; // parse in arena mode (see `eexpr_parser.useArena`)
+  bool borrow; // let the eexprs borrow their text from the input rather than copy it (see `eexpr_parser.borrowInput`)
+  unsigned nThreads; // parse on up to this many threads (see `eexpr_parser.nThreads`)
+  bool pipeline; // run the stages of parsing on their own threads (see `eexpr_parser.pipeline`)
+  bool fragment; // parse the input as a single expression (see `eexpr_parseExpr`)
+  bool flat; // output the eexprs as a flat forest, and print them from that (see `eexpr_parser.flatOutput`)
+  char* binary; // also write the parse in binary form to this file (see `eexpr_serialize`); implies `flat`
+  bool mapped; // the input is a binary parse to load and print, rather than a file to parse (see `eexpr_mapFile`)
+  bool trusted; // with `mapped`, load the binary parse without checking it (see `eexpr_mapFileTrusted`)
+  size_t budget; // when non-zero, parse in slices of about this many tokens, resuming after each (see `eexpr_parser.budget`)
+  long deadlineMs; // when non-negative, give each call to the parser a deadline this many milliseconds away, resuming after each (see `eexpr_parser.deadline`)
+  size_t stopAt; // when non-zero, have the parser stop the time it asks whether to for this time, then resume it (see `eexpr_parser.shouldStop`)
+  struct {
+    // when set, the input is parsed, then edited by replacing `oldLen` bytes from `start` with the contents of this file,
+    //   and the edited input is reparsed (see `eexpr_reparse`) and reported on instead
+    char* file;
+    size_t start;
+    size_t oldLen;
+  } edit;
+  struct {
+    char* dir; // when set, outputs are looked up in and saved to this directory (see `cache.h`)
+    uint64_t maxBytes; // the size the cache directory is kept within
+  } cache;
   struct {
     char* original;
     char* rawTokens;
     char* tokens;
     char* eexprs;
+    char* stops; // how many times the parser stopped early
   } dump;
   struct {
     level mixedSpace;
@@ -32,8 +68,19 @@ typedef struct options {
 } options;
 
 
-void dumpLexer(char* filename, const eexpr_parser* parser, const options* opts) {
-  if (filename == NULL) { return; }
+// Print the output eexprs of a parse, whether they are ordinary or flat.
+void dumpEexprs(FILE* fp, const eexpr_parser* parser) {
+  if (parser->flat != NULL) {
+    fdumpFlatEexprArray(fp, 2, eexpr_flatCount(parser->flat), eexpr_flatFirst(parser->flat));
+  }
+  else {
+    fdumpEexprArray(fp, 2, parser->nEexprs, parser->eexprs);
+  }
+}
+
+// Returns whether the dump was asked for (and so written).
+bool dumpLexer(char* filename, const eexpr_parser* parser, const options* opts) {
+  if (filename == NULL) { return false; }
   FILE* fp = fopen(filename, "w");
   fprintf(fp, "{ \"filename\": ");
   fdumpCStr(fp, opts->inFilename);
@@ -45,30 +92,60 @@ void dumpLexer(char* filename, const eexpr_parser* parser, const options* opts)
   fdumpErrorArray(fp, "  ", parser->nErrors, parser->errors);
   fprintf(fp, "\n}\n");
   fclose(fp);
+  return true;
 }
-void dumpParser(char* filename, const eexpr_parser* parser, const options* opts) {
-  if (filename == NULL) { return; }
+bool dumpParser(char* filename, const eexpr_parser* parser, const options* opts) {
+  if (filename == NULL) { return false; }
   FILE* fp = fopen(filename, "w");
   fprintf(fp, "{ \"filename\": ");
   fdumpCStr(fp, opts->inFilename);
   fprintf(fp, "\n, \"eexprs\":");
-  fdumpEexprArray(fp, 2, parser->nEexprs, parser->eexprs);
+  dumpEexprs(fp, parser);
   fprintf(fp, "\n, \"warnings\":");
   fdumpErrorArray(fp, "  ", parser->nWarnings, parser->warnings);
   fprintf(fp, "\n, \"errors\":");
   fdumpErrorArray(fp, "  ", parser->nErrors, parser->errors);
   fprintf(fp, "\n}\n");
   fclose(fp);
+  return true;
 }
 
 options parseOpts(int argc, char** argv) {
   options opts =
     { .inFilename = NULL
+    , .nBatch = 0
+    , .batch = NULL
+    , .streamChunk = 0
+    , .eachEexpr = false
+    , .events = false
+    , .walk = false
+    , .arena = false
+    , .borrow = false
+    , .nThreads = 1
+    , .pipeline = false
+    , .fragment = false
+    , .flat = false
+    , .binary = NULL
+    , .mapped = false
+    , .trusted = false
+    , .budget = 0
+    , .deadlineMs = -1
+    , .stopAt = 0
+    , .edit =
+      { .file = NULL
+      , .start = 0
+      , .oldLen = 0
+      }
+    , .cache =
+      { .dir = NULL
+      , .maxBytes = UINT64_C(64) << 20
+      }
     , .dump =
       { .original = NULL
       , .rawTokens = NULL
       , .tokens = NULL
       , .eexprs = NULL
+      , .stops = NULL
       }
     , .levels =
       // NOTE I decide default levels based on whether it's possible for a script to automatically fix things.
@@ -105,6 +182,7 @@ options parseOpts(int argc, char** argv) {
       // , .expectingNewlineOrDedent = ERROR
       // , .missingTemplateExpr = ERROR
       // , .missingCloseTemplate = ERROR
+      // , .expectingEndOfFragment = ERROR
       }
     };
   for (int i = 1; i < argc; ++i) {
@@ -124,6 +202,92 @@ options parseOpts(int argc, char** argv) {
         }
         goto setInputFile;
       }
+      else if (!strcmp(argv[i], "-s")) {
+        ++i; if (i >= argc) { die("missing chunk size"); }
+        char* end;
+        opts.streamChunk = strtoul(argv[i], &end, 10);
+        if (*end != '\0' || opts.streamChunk == 0) { die("chunk size must be a positive number of bytes"); }
+      }
+      else if (!strcmp(argv[i], "-e")) {
+        opts.eachEexpr = true;
+      }
+      else if (!strcmp(argv[i], "-v")) {
+        opts.events = true;
+      }
+      else if (!strcmp(argv[i], "-w")) {
+        opts.walk = true;
+      }
+      else if (!strcmp(argv[i], "-a")) {
+        opts.arena = true;
+      }
+      else if (!strcmp(argv[i], "-k")) {
+        opts.borrow = true;
+      }
+      else if (!strcmp(argv[i], "-p")) {
+        opts.pipeline = true;
+      }
+      else if (!strcmp(argv[i], "-x")) {
+        opts.fragment = true;
+      }
+      else if (!strcmp(argv[i], "-f")) {
+        opts.flat = true;
+      }
+      else if (!strcmp(argv[i], "-b")) {
+        ++i; if (i >= argc) { die("missing binary output file"); }
+        opts.binary = argv[i];
+        opts.flat = true;
+      }
+      else if (!strcmp(argv[i], "-m")) {
+        opts.mapped = true;
+      }
+      else if (!strcmp(argv[i], "-M")) {
+        opts.mapped = true;
+        opts.trusted = true;
+      }
+      else if (!strcmp(argv[i], "-q")) {
+        ++i; if (i >= argc) { die("missing budget"); }
+        char* end;
+        opts.budget = strtoul(argv[i], &end, 10);
+        if (*end != '\0' || opts.budget == 0) { die("budget must be a positive number of tokens"); }
+      }
+      else if (!strcmp(argv[i], "-t")) {
+        ++i; if (i >= argc) { die("missing deadline"); }
+        char* end;
+        opts.deadlineMs = strtol(argv[i], &end, 10);
+        if (*end != '\0' || end == argv[i] || opts.deadlineMs < 0) { die("deadline must be a number of milliseconds"); }
+      }
+      else if (!strcmp(argv[i], "-z")) {
+        ++i; if (i >= argc) { die("missing stop"); }
+        char* end;
+        opts.stopAt = strtoul(argv[i], &end, 10);
+        if (*end != '\0' || opts.stopAt == 0) { die("stop must be a positive number of times asked"); }
+      }
+      else if (!strcmp(argv[i], "-r")) {
+        ++i; if (i >= argc) { die("missing edit"); }
+        char* end;
+        opts.edit.start = strtoul(argv[i], &end, 10);
+        if (*end != ':') { die("edit must be given as START:LENGTH:FILE"); }
+        opts.edit.oldLen = strtoul(end + 1, &end, 10);
+        if (*end != ':' || end[1] == '\0') { die("edit must be given as START:LENGTH:FILE"); }
+        opts.edit.file = end + 1;
+      }
+      else if (!strcmp(argv[i], "-c")) {
+        ++i; if (i >= argc) { die("missing cache directory"); }
+        opts.cache.dir = argv[i];
+      }
+      else if (!strcmp(argv[i], "-C")) {
+        ++i; if (i >= argc) { die("missing cache size"); }
+        char* end;
+        opts.cache.maxBytes = strtoull(argv[i], &end, 10);
+        if (*end != '\0' || opts.cache.maxBytes == 0) { die("cache size must be a positive number of bytes"); }
+      }
+      else if (!strcmp(argv[i], "-j")) {
+        ++i; if (i >= argc) { die("missing number of threads"); }
+        char* end;
+        unsigned long n = strtoul(argv[i], &end, 10);
+        if (*end != '\0' || n == 0 || n > 1024) { die("number of threads must be between 1 and 1024"); }
+        opts.nThreads = n;
+      }
       else if (argv[i][2] == 'd') {
         argv[i] = &argv[i][2];
         char** filename_p = NULL;
@@ -132,6 +296,7 @@ options parseOpts(int argc, char** argv) {
         else if (!strcmp(argv[i], "dumpRawTokens")) { filename_p = &opts.dump.rawTokens; }
         else if (!strcmp(argv[i], "dumpTokens")) { filename_p = &opts.dump.tokens; }
         else if (!strcmp(argv[i], "dumpEexprs")) { filename_p = &opts.dump.eexprs; }
+        else if (!strcmp(argv[i], "dumpStops")) { filename_p = &opts.dump.stops; }
         else {
           fprintf(stderr, "unrecognized dump stage %s\n", argv[i]);
           exit(1);
@@ -167,19 +332,591 @@ options parseOpts(int argc, char** argv) {
       }
     }
     else setInputFile: {
-      if (opts.inFilename != NULL) { die("only one input file is supported"); }
-      opts.inFilename = argv[i];
+      if (opts.batch == NULL) {
+        opts.batch = malloc(argc * sizeof(char*));
+        if (opts.batch == NULL) { die("out of memory"); }
+      }
+      opts.batch[opts.nBatch++] = argv[i];
+      if (opts.inFilename == NULL) { opts.inFilename = argv[i]; }
     }
   }
   if (opts.inFilename == NULL) { die("no input file"); }
+  if (opts.nBatch > 1) {
+    if ( opts.streamChunk != 0 || opts.eachEexpr || opts.events || opts.walk || opts.pipeline || opts.fragment || opts.flat || opts.mapped || opts.cache.dir != NULL
+      || opts.edit.file != NULL || opts.budget != 0 || opts.deadlineMs >= 0 || opts.stopAt != 0
+      || opts.dump.original != NULL || opts.dump.rawTokens != NULL || opts.dump.tokens != NULL || opts.dump.eexprs != NULL || opts.dump.stops != NULL
+       ) {
+      die("several input files can only be parsed as a plain batch");
+    }
+  }
+  else {
+    free(opts.batch);
+    opts.batch = NULL;
+    opts.nBatch = 0;
+  }
+  if (opts.flat && (opts.streamChunk != 0 || opts.eachEexpr || opts.events || opts.walk || opts.fragment)) {
+    die("flat output is only for parsing a whole file at once");
+  }
+  if (opts.mapped) {
+    if ( opts.streamChunk != 0 || opts.eachEexpr || opts.events || opts.walk || opts.nThreads > 1 || opts.pipeline || opts.fragment || opts.flat
+      || opts.dump.original != NULL || opts.dump.rawTokens != NULL || opts.dump.tokens != NULL || opts.dump.eexprs != NULL
+       ) {
+      die("a binary parse can only be printed");
+    }
+  }
+  if (opts.budget != 0 && (opts.streamChunk != 0 || opts.eachEexpr || opts.events || opts.fragment || opts.mapped)) {
+    die("a budget only applies to parsing a whole file at once");
+  }
+  if ((opts.deadlineMs >= 0 || opts.stopAt != 0 || opts.dump.stops != NULL) && (opts.fragment || opts.mapped)) {
+    die("only a parse of a whole file can be stopped early");
+  }
+  if (opts.edit.file != NULL) {
+    if ( opts.streamChunk != 0 || opts.eachEexpr || opts.events || opts.walk || opts.fragment || opts.flat || opts.mapped || opts.cache.dir != NULL
+      || opts.dump.original != NULL || opts.dump.rawTokens != NULL || opts.dump.tokens != NULL
+       ) {
+      die("only a plain parse of a single file can be edited and reparsed");
+    }
+  }
+  if (opts.cache.dir != NULL) {
+    if (opts.streamChunk != 0 || opts.eachEexpr || opts.events || opts.walk || opts.fragment || opts.binary != NULL || opts.dump.stops != NULL) {
+      die("only plain parses of a single file can be cached");
+    }
+  }
   return opts;
 }
 
+// Eexprs gathered up from several batches of output (or one at a time with `collectEexpr`).
+typedef struct collected {
+  size_t len;
+  size_t cap;
+  eexpr** eexprs;
+} collected;
+
+bool collectEexpr(void* ctx, eexpr* expr) {
+  collected* all = ctx;
+  if (all->len == all->cap) {
+    all->cap = all->cap < 8 ? 8 : 2 * all->cap;
+    all->eexprs = realloc(all->eexprs, all->cap * sizeof(eexpr*));
+    if (all->eexprs == NULL) { die("out of memory"); }
+  }
+  all->eexprs[all->len++] = expr;
+  return true;
+}
+
+// Free the output eexprs of a parse: all at once with their arena in arena mode, otherwise one by one.
+void freeEexprs(eexpr_arena* arena, size_t n, eexpr** eexprs) {
+  if (arena != NULL) {
+    eexpr_arenaRelease(arena);
+    return;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    eexpr_del(eexprs[i]);
+  }
+}
+
+//////////////////////////////////// Event Trace ////////////////////////////////////
+
+// Each event is printed on its own line, indented by how many eexprs it is nested in.
+// The indent stops growing this many levels in, so the trace of a deeply nested input stays in proportion to it.
+#define TRACE_MAX_INDENT 64
+
+typedef struct eventTrace {
+  FILE* fp;
+  int depth;
+} eventTrace;
+
+const char* eexprTypeName(eexpr_type type) {
+  switch (type) {
+    case EEXPR_SYMBOL: return "symbol";
+    case EEXPR_NUMBER: return "number";
+    case EEXPR_STRING: return "string";
+    case EEXPR_PAREN: return "paren";
+    case EEXPR_BRACK: return "bracket";
+    case EEXPR_BRACE: return "brace";
+    case EEXPR_BLOCK: return "block";
+    case EEXPR_PREDOT: return "predot";
+    case EEXPR_CHAIN: return "chain";
+    case EEXPR_SPACE: return "space";
+    case EEXPR_ELLIPSIS: return "ellipsis";
+    case EEXPR_COLON: return "colon";
+    case EEXPR_COMMA: return "comma";
+    case EEXPR_SEMICOLON: return "semicolon";
+  }
+  assert(false);
+  return NULL;
+}
+
+void traceLine(eventTrace* trace, const char* event, const eexpr_loc* loc) {
+  int indent = trace->depth < TRACE_MAX_INDENT ? trace->depth : TRACE_MAX_INDENT;
+  fprintf(trace->fp, "%*s%s", 2 * indent, "", event);
+  if (loc != NULL) {
+    fprintf( trace->fp, " %zu:%zu-%zu:%zu"
+           , loc->start.line + 1, loc->start.col + 1
+           , loc->end.line + 1, loc->end.col + 1
+           );
+  }
+}
+
+void traceBegin(void* ctx, eexpr_type type, eexpr_loc loc) {
+  eventTrace* trace = ctx;
+  traceLine(trace, "begin", &loc);
+  fprintf(trace->fp, " %s\n", eexprTypeName(type));
+  trace->depth += 1;
+}
+void traceEnd(void* ctx, eexpr_type type, eexpr_loc loc) {
+  eventTrace* trace = ctx;
+  trace->depth -= 1;
+  traceLine(trace, "end", &loc);
+  fprintf(trace->fp, " %s\n", eexprTypeName(type));
+}
+void traceSymbol(void* ctx, eexpr_loc loc, size_t nBytes, const uint8_t* utf8str) {
+  eventTrace* trace = ctx;
+  traceLine(trace, "symbol", &loc);
+  str text = {.len = nBytes, .bytes = (uint8_t*)utf8str};
+  fprintf(trace->fp, " ");
+  fdumpStr(trace->fp, text);
+  fprintf(trace->fp, "\n");
+}
+void traceNumber(void* ctx, eexpr_loc loc, const eexpr_number* num) {
+  eventTrace* trace = ctx;
+  traceLine(trace, "number", &loc);
+  bigint mantissa = {.pos = num->isPositive, .len = num->nBigDigits, .buf = num->bigDigits};
+  str tmp = bigint_toDecimal(mantissa);
+  fprintf(trace->fp, " %.*s", (int)tmp.len, (char*)tmp.bytes);
+  free(tmp.bytes);
+  if (num->radix != 10) { fprintf(trace->fp, " radix=%d", num->radix); }
+  if (num->nFracDigits != 0) { fprintf(trace->fp, " frac=%"PRIu32, num->nFracDigits); }
+  if (num->nBigDigits_exp != 0) {
+    bigint exponent = {.pos = num->isPositive_exp, .len = num->nBigDigits_exp, .buf = num->bigDigits_exp};
+    str tmp = bigint_toDecimal(exponent);
+    fprintf(trace->fp, " exp=%.*s", (int)tmp.len, (char*)tmp.bytes);
+    free(tmp.bytes);
+  }
+  fprintf(trace->fp, "\n");
+}
+void traceStringPart(void* ctx, size_t nBytes, const uint8_t* utf8str) {
+  eventTrace* trace = ctx;
+  traceLine(trace, "text", NULL);
+  str text = {.len = nBytes, .bytes = (uint8_t*)utf8str};
+  fprintf(trace->fp, " ");
+  fdumpStr(trace->fp, text);
+  fprintf(trace->fp, "\n");
+}
+void traceAbsent(void* ctx) {
+  traceLine(ctx, "absent", NULL);
+  fprintf(((eventTrace*)ctx)->fp, "\n");
+}
+void traceError(void* ctx, const eexpr_error* err) {
+  eventTrace* trace = ctx;
+  traceLine(trace, "error", NULL);
+  fprintf(trace->fp, " ");
+  fdumpError(trace->fp, err);
+  fprintf(trace->fp, "\n");
+}
+
+eexpr_walkStep traceEnter(void* ctx, const eexpr* self, size_t depth) {
+  eventTrace* trace = ctx;
+  trace->depth = depth;
+  eexpr_loc loc = eexpr_locate(self);
+  traceLine(trace, "enter", &loc);
+  fprintf(trace->fp, " %s", eexprTypeName(eexpr_getType(self)));
+  size_t nBytes; uint8_t* utf8str;
+  if (eexpr_asSymbol(self, &nBytes, &utf8str)) {
+    str text = {.len = nBytes, .bytes = utf8str};
+    fprintf(trace->fp, " ");
+    fdumpStr(trace->fp, text);
+  }
+  fprintf(trace->fp, "\n");
+  return EEXPR_WALK_CONTINUE;
+}
+eexpr_walkStep traceExit(void* ctx, const eexpr* self, size_t depth) {
+  eventTrace* trace = ctx;
+  trace->depth = depth;
+  eexpr_loc loc = eexpr_locate(self);
+  traceLine(trace, "exit", &loc);
+  fprintf(trace->fp, " %s\n", eexprTypeName(eexpr_getType(self)));
+  return EEXPR_WALK_CONTINUE;
+}
+
+
+// How the parser is made to stop early with `-t` and `-z`, and how many times it has.
+typedef struct stopping {
+  long deadlineMs; // as in `options`
+  size_t stopAt; // as in `options`
+  atomic_size_t asked; // how many times the parser has asked whether to stop (possibly from several threads)
+  size_t stops;
+} stopping;
+
+bool stopWhenAsked(void* ctx) {
+  stopping* stop = ctx;
+  return atomic_fetch_add(&stop->asked, 1) + 1 == stop->stopAt;
+}
+
+// Give the call to the parser about to be made its own deadline.
+void setDeadline(eexpr_parser* parser, const stopping* stop) {
+  if (stop->deadlineMs < 0) { return; }
+  struct timespec at;
+  timespec_get(&at, TIME_UTC);
+  at.tv_sec += stop->deadlineMs / 1000;
+  at.tv_nsec += (stop->deadlineMs % 1000) * 1000000;
+  if (at.tv_nsec >= 1000000000) {
+    at.tv_sec += 1;
+    at.tv_nsec -= 1000000000;
+  }
+  parser->deadline = at;
+}
+
+// Parse the input file by feeding it to the parser a few bytes at a time, as if it were arriving through a pipe.
+// The eexprs from every piece are gathered into `all`.
+void streamFile(eexpr_parser* parser, stopping* stop, const options* opts, collected* all) {
+  FILE* fp = fopen(opts->inFilename, "rb");
+  if (fp == NULL) {
+    die("error opening input file for reading");
+  }
+  uint8_t* chunk = malloc(opts->streamChunk);
+  if (chunk == NULL) { die("out of memory"); }
+  while (true) {
+    size_t len = fread(chunk, 1/*byte per element*/, opts->streamChunk/*elements*/, fp);
+    setDeadline(parser, stop);
+    bool ok = len != 0
+            ? eexpr_parseFeed(parser, len, chunk)
+            : eexpr_parseFinish(parser);
+    while (true) {
+      for (size_t i = 0; i < parser->nEexprs; ++i) {
+        collectEexpr(all, parser->eexprs[i]);
+      }
+      free(parser->eexprs);
+      if (!parser->interrupted) { break; }
+      stop->stops += 1;
+      // the next piece carries on from where this one stopped, but after the last, there is only `eexpr_parseFinish` to carry on with
+      if (len != 0) { break; }
+      setDeadline(parser, stop);
+      ok = eexpr_parseFinish(parser);
+    }
+    if (!ok || len == 0) { break; }
+  }
+  free(chunk);
+  fclose(fp);
+}
+
+// Print the eexprs from one input (if they were parsed without errors) to `out`, and any warnings and errors to `err`.
+void report(FILE* out, FILE* err, char* filename, bool parsed, const eexpr_parser* parser) {
+  if (parsed && parser->nErrors == 0) {
+    fprintf(out, "{ \"filename\": ");
+    fdumpCStr(out, filename);
+    fprintf(out, "\n, \"eexprs\":");
+    dumpEexprs(out, parser);
+    if (parser->nWarnings != 0) {
+      fprintf(out, "\n, \"warnings\":");
+      fdumpErrorArray(out, "  ", parser->nWarnings, parser->warnings);
+    }
+    fprintf(out, "\n}\n");
+  }
+  if (parser->nErrors != 0 || parser->nWarnings != 0) {
+    fprintf(err, "{ \"filename\": ");
+    fdumpCStr(err, filename);
+    fprintf(err, "\n, \"warnings\":");
+    fdumpErrorArray(err, "  ", parser->nWarnings, parser->warnings);
+    if (parser->nErrors != 0) {
+      fprintf(err, "\n, \"errors\":");
+      fdumpErrorArray(err, "  ", parser->nErrors, parser->errors);
+    }
+    fprintf(err, "\n}\n");
+  }
+}
+
+// Parse all the input files together on `opts->nThreads` threads, then report on each in the order they were given.
+// Returns the exit code.
+int parseBatch(const options* opts) {
+  eexpr_parser config; eexpr_parserInitDefault(&config);
+  config.useArena = opts->arena;
+  config.borrowInput = opts->borrow; // the inputs are only freed once we're done with the eexprs
+  str* inputs = malloc(opts->nBatch * sizeof(str));
+  eexpr_batchDoc* docs = malloc(opts->nBatch * sizeof(eexpr_batchDoc));
+  if (inputs == NULL || docs == NULL) { die("out of memory"); }
+  for (size_t i = 0; i < opts->nBatch; ++i) {
+    inputs[i] = readFile(opts->batch[i]);
+    if (inputs[i].bytes == NULL) {
+      die("error opening input file for reading");
+    }
+    docs[i].nBytes = inputs[i].len;
+    docs[i].utf8Input = inputs[i].bytes;
+  }
+  bool ok = eexpr_parseBatch(&config, opts->nThreads, opts->nBatch, docs);
+  for (size_t i = 0; i < opts->nBatch; ++i) {
+    eexpr_parser result = config;
+    result.nEexprs = docs[i].nEexprs; result.eexprs = docs[i].eexprs;
+    result.nErrors = docs[i].nErrors; result.errors = docs[i].errors;
+    result.nWarnings = docs[i].nWarnings; result.warnings = docs[i].warnings;
+    report(stdout, stderr, opts->batch[i], true, &result);
+    freeEexprs(docs[i].arena, docs[i].nEexprs, docs[i].eexprs);
+    free(docs[i].eexprs);
+    free(docs[i].errors);
+    free(docs[i].warnings);
+    free(inputs[i].bytes);
+  }
+  free(docs);
+  free(inputs);
+  return ok ? 0 : 1;
+}
+
+// Parse the input file as a single expression, then report on it as if it were a file holding just that expression.
+// Returns the exit code.
+int parseFragment(const options* opts) {
+  str input = readFile(opts->inFilename);
+  if (input.bytes == NULL) {
+    die("error opening input file for reading");
+  }
+  eexpr_parser config; eexpr_parserInitDefault(&config);
+  config.borrowInput = opts->borrow; // the input is only freed once we're done with the eexpr
+  eexpr* expr;
+  eexpr_error err;
+  bool ok = eexpr_parseExpr(&config, input.len, input.bytes, &expr, &err);
+  eexpr_parser result = config;
+  result.nEexprs = expr == NULL ? 0 : 1; result.eexprs = &expr;
+  result.nErrors = ok ? 0 : 1; result.errors = &err;
+  report(stdout, stderr, opts->inFilename, true, &result);
+  if (expr != NULL) { eexpr_del(expr); }
+  free(input.bytes);
+  return ok ? 0 : 1;
+}
+
+// Write the parse to `opts->binary` in binary form (see `eexpr_serialize`).
+void writeBinary(const eexpr_parser* parser, const options* opts) {
+  size_t nBytes;
+  uint8_t* bytes = eexpr_serialize(parser->flat, parser->nErrors, parser->errors, parser->nWarnings, parser->warnings, &nBytes);
+  if (bytes == NULL) { die("parse too large to write in binary form"); }
+  FILE* fp = fopen(opts->binary, "wb");
+  if (fp == NULL) { die("error opening binary output file for writing"); }
+  fwrite(bytes, 1/*byte per element*/, nBytes/*elements*/, fp);
+  fclose(fp);
+  free(bytes);
+}
+
+// Load a binary parse from the input file, then report on it just as if the parse had only now been done.
+// Returns the exit code.
+int loadBinary(const options* opts) {
+  eexpr_mapping mapping;
+  bool loaded = opts->trusted
+              ? eexpr_mapFileTrusted(opts->inFilename, &mapping)
+              : eexpr_mapFile(opts->inFilename, &mapping);
+  if (!loaded) {
+    die("error loading binary parse from input file");
+  }
+  eexpr_parser result; eexpr_parserInitDefault(&result);
+  result.flat = (eexpr_flat*)mapping.flat; // only read from
+  result.nErrors = mapping.nErrors; result.errors = mapping.errors;
+  result.nWarnings = mapping.nWarnings; result.warnings = mapping.warnings;
+  report(stdout, stderr, opts->inFilename, true, &result);
+  int ec = mapping.nErrors == 0 ? 0 : 1;
+  eexpr_unmapFile(&mapping);
+  return ec;
+}
+
+// Parse as `eexpr_parse` does, but if the parser stops early (to stay within its budget, or as `stop` says), keep resuming it until it is done.
+bool parseToEnd(eexpr_parser* parser, stopping* stop, size_t nBytes, uint8_t* utf8Input) {
+  setDeadline(parser, stop);
+  bool ok = eexpr_parse(parser, nBytes, utf8Input);
+  while (parser->interrupted) {
+    stop->stops += 1;
+    setDeadline(parser, stop);
+    ok = eexpr_parse(parser, 0, NULL);
+  }
+  return ok;
+}
+
+// Edit the input as `opts->edit` says, then bring the parse up to date with it.
+// The input is replaced with the edited one.
+// Returns whether the edited input parsed without errors.
+bool reparseEdit(eexpr_parser* parser, stopping* stop, str* input, const options* opts) {
+  str insert = readFile(opts->edit.file);
+  if (insert.bytes == NULL) {
+    die("error opening edit file for reading");
+  }
+  if (opts->edit.start > input->len || opts->edit.oldLen > input->len - opts->edit.start) {
+    die("edit is out of bounds of the input");
+  }
+  str edited = {.len = input->len - opts->edit.oldLen + insert.len};
+  edited.bytes = malloc(edited.len == 0 ? 1 : edited.len);
+  if (edited.bytes == NULL) { die("out of memory"); }
+  size_t tail = opts->edit.start + opts->edit.oldLen;
+  memcpy(edited.bytes, input->bytes, opts->edit.start);
+  memcpy(&edited.bytes[opts->edit.start], insert.bytes, insert.len);
+  memcpy(&edited.bytes[opts->edit.start + insert.len], &input->bytes[tail], input->len - tail);
+  setDeadline(parser, stop);
+  bool ok = eexpr_reparse(parser, opts->edit.start, opts->edit.oldLen, insert.len, edited.len, edited.bytes);
+  if (parser->interrupted) {
+    stop->stops += 1;
+    ok = parseToEnd(parser, stop, 0, NULL);
+  }
+  // when borrowing, the eexprs borrow from the edited input now
+  free(input->bytes);
+  *input = edited;
+  free(insert.bytes);
+  return ok;
+}
+
+// The outputs saved in the cache, in order (the original input is not saved, as it is already at hand on a hit).
+enum cachedPart {
+  CACHED_STDOUT,
+  CACHED_STDERR,
+  CACHED_RAW_TOKENS,
+  CACHED_TOKENS,
+  CACHED_EEXPRS,
+  N_CACHED_PARTS
+};
+
+// Whether the parse pauses after each stage, which the token dumps are written at.
+// With several threads, a pipeline or an edit, there are no stages to pause at in between (and with an edit,
+//   they would be of the input from before it), so only the eexprs can be dumped.
+bool pausesBetweenStages(const options* opts) {
+  return opts->nThreads <= 1 && !opts->pipeline && opts->edit.file == NULL;
+}
+
+// Describe everything besides the input that affects the outputs, so that it can be part of the cache key.
+// Options such as `-j` or `-f` make no difference to the outputs themselves, so only which dumps they let be written is described.
+str describeOptions(const options* opts) {
+  bool staged = pausesBetweenStages(opts);
+  const char* fmt =
+    "eexpr2json %d.%d.%d built " __DATE__ " " __TIME__ "\n"
+    "file %s\n"
+    "levels %d %d %d %d %d\n"
+    "dumps %d %d %d %d\n";
+  #define DESCRIBE_ARGS \
+    EEXPR_VERSION_MAJOR, EEXPR_VERSION_MINOR, EEXPR_VERSION_PATCH, \
+    opts->inFilename, \
+    opts->levels.mixedSpace, opts->levels.mixedNewlines, opts->levels.badDigitSeparator, opts->levels.trailingSpace, opts->levels.noTrailingNewline, \
+    opts->dump.original != NULL, staged && opts->dump.rawTokens != NULL, staged && opts->dump.tokens != NULL, opts->dump.eexprs != NULL
+  int len = snprintf(NULL, 0, fmt, DESCRIBE_ARGS);
+  if (len < 0) { die("error describing options"); }
+  str out = {.len = len, .bytes = malloc(len + 1)};
+  if (out.bytes == NULL) { die("out of memory"); }
+  snprintf((char*)out.bytes, len + 1, fmt, DESCRIBE_ARGS);
+  #undef DESCRIBE_ARGS
+  return out;
+}
+
+// Read back everything written to a temporary file.
+str slurpTmp(FILE* fp) {
+  str out = {.len = 0, .bytes = NULL};
+  if (fseek(fp, 0, SEEK_END) != 0) { die("error reading temporary file"); }
+  long len = ftell(fp);
+  if (len < 0 || fseek(fp, 0, SEEK_SET) != 0) { die("error reading temporary file"); }
+  out.len = len;
+  out.bytes = malloc(len == 0 ? 1 : len);
+  if (out.bytes == NULL) { die("out of memory"); }
+  if (fread(out.bytes, 1/*byte per element*/, out.len/*elements*/, fp) != out.len) { die("error reading temporary file"); }
+  return out;
+}
+
+void writeDump(const char* filename, str contents) {
+  if (filename == NULL || contents.bytes == NULL) { return; }
+  FILE* fp = fopen(filename, "w");
+  fwrite(contents.bytes, 1/*byte per element*/, contents.len/*elements*/, fp);
+  fclose(fp);
+}
+
+// Produce the outputs of a cache hit just as the parse would have: stdout, stderr and whichever dumps were written.
+// Returns the exit code.
+int replayCached(const cached* hit, str input, const options* opts) {
+  fwrite(hit->parts[CACHED_STDOUT].bytes, 1/*byte per element*/, hit->parts[CACHED_STDOUT].len/*elements*/, stdout);
+  fwrite(hit->parts[CACHED_STDERR].bytes, 1/*byte per element*/, hit->parts[CACHED_STDERR].len/*elements*/, stderr);
+  writeDump(opts->dump.original, input);
+  writeDump(opts->dump.rawTokens, hit->parts[CACHED_RAW_TOKENS]);
+  writeDump(opts->dump.tokens, hit->parts[CACHED_TOKENS]);
+  writeDump(opts->dump.eexprs, hit->parts[CACHED_EEXPRS]);
+  return hit->exitcode;
+}
 
 int main(int argc, char** argv) {
   options opts = parseOpts(argc, argv);
+  if (opts.nBatch != 0) {
+    int ec = parseBatch(&opts);
+    free(opts.batch);
+    return ec;
+  }
+  if (opts.fragment) {
+    return parseFragment(&opts);
+  }
+  if (opts.mapped) {
+    return loadBinary(&opts);
+  }
+
+  // with a cache, the input is read up front so that it can be looked up, and the report is held back to be saved
+  str input = {.len = 0, .bytes = NULL};
+  str config = {.len = 0, .bytes = NULL};
+  cacheEntry entry;
+  FILE* out = stdout;
+  FILE* err = stderr;
+  struct { bool rawTokens; bool tokens; bool eexprs; } dumped = {false, false, false};
+  if (opts.cache.dir != NULL) {
+    input = readFile(opts.inFilename);
+    if (input.bytes == NULL) {
+      die("error opening input file for reading");
+    }
+    if (!cache_openDir(opts.cache.dir)) {
+      die("error creating cache directory");
+    }
+    config = describeOptions(&opts);
+    entry = cache_entry(opts.cache.dir, opts.cache.maxBytes, config, input);
+    cached hit;
+    if (cache_load(&entry, &hit)) {
+      bool usable = hit.nParts == N_CACHED_PARTS && hit.parts[CACHED_STDOUT].bytes != NULL && hit.parts[CACHED_STDERR].bytes != NULL;
+      int ec = usable ? replayCached(&hit, input, &opts) : -1;
+      cached_deinit(&hit);
+      if (ec >= 0) {
+        cache_entryDel(&entry);
+        free(config.bytes);
+        free(input.bytes);
+        return ec;
+      }
+    }
+    out = tmpfile();
+    err = tmpfile();
+    if (out == NULL || err == NULL) { die("error opening temporary file"); }
+  }
+
+  bool parsed = false;
+  eexpr_parser parser; eexpr_parserInitDefault(&parser);
+  parser.useArena = opts.arena;
+  parser.flatOutput = opts.flat;
+  parser.budget = opts.budget;
+  stopping stop = {.deadlineMs = opts.deadlineMs, .stopAt = opts.stopAt, .stops = 0};
+  atomic_init(&stop.asked, 0);
+  if (opts.stopAt != 0) {
+    parser.shouldStop = stopWhenAsked;
+    parser.shouldStopCtx = &stop;
+  }
+
+  collected all = {.len = 0, .cap = 0, .eexprs = NULL};
+  if (opts.eachEexpr) {
+    parser.onEexpr = collectEexpr;
+    parser.onEexprCtx = &all;
+  }
+  eventTrace trace = {.fp = stdout, .depth = 0};
+  eexpr_events events =
+    { .ctx = &trace
+    , .begin = traceBegin
+    , .end = traceEnd
+    , .symbol = traceSymbol
+    , .number = traceNumber
+    , .stringPart = traceStringPart
+    , .absent = traceAbsent
+    , .error = traceError
+    };
+  if (opts.events) {
+    parser.events = &events;
+  }
 
-  str input = readFile(opts.inFilename);
+  if (opts.streamChunk != 0) {
+    streamFile(&parser, &stop, &opts, &all);
+    if (opts.events) { goto finish; }
+    goto gathered;
+  }
+
+  if (input.bytes == NULL) {
+    input = readFile(opts.inFilename);
+  }
   if (input.bytes == NULL) {
     die("error opening input file for reading");
   }
@@ -189,56 +926,91 @@ int main(int argc, char** argv) {
     fclose(fp);
   }
 
-  bool parsed = false;
-  eexpr_parser parser; eexpr_parserInitDefault(&parser);
+  parser.borrowInput = opts.borrow; // the input is only freed once we're done with the eexprs
+  if (opts.events) {
+    // the events have already been printed, so only the warnings and errors are left to report
+    parseToEnd(&parser, &stop, input.len, input.bytes);
+    goto finish;
+  }
+  if (opts.eachEexpr) {
+    parseToEnd(&parser, &stop, input.len, input.bytes);
+    goto gathered;
+  }
+  if (opts.walk) {
+    // only the warnings and errors are reported as usual, after the walks
+    parseToEnd(&parser, &stop, input.len, input.bytes);
+    eexpr_walker walker = {.ctx = &trace, .enter = traceEnter, .exit = traceExit};
+    for (size_t i = 0; i < parser.nEexprs; ++i) {
+      eexpr_walk(parser.eexprs[i], &walker);
+    }
+    goto finish;
+  }
+  if (!pausesBetweenStages(&opts)) {
+    parser.nThreads = opts.nThreads;
+    parser.pipeline = opts.pipeline;
+    parsed = parseToEnd(&parser, &stop, input.len, input.bytes);
+    if (opts.edit.file != NULL) { parsed = reparseEdit(&parser, &stop, &input, &opts); }
+    dumped.eexprs = dumpParser(opts.dump.eexprs, &parser, &opts);
+    goto finish;
+  }
 
   parser.pauseAt = EEXPR_PAUSE_AFTER_RAWLEX;
-  eexpr_parse(&parser, input.len, input.bytes);
-  dumpLexer(opts.dump.rawTokens, &parser, &opts);
+  parseToEnd(&parser, &stop, input.len, input.bytes);
+  dumped.rawTokens = dumpLexer(opts.dump.rawTokens, &parser, &opts);
   if (parser.nErrors != 0) { goto finish; }
 
   parser.pauseAt = EEXPR_PAUSE_AFTER_COOKLEX;
-  eexpr_parse(&parser, 0, NULL);
-  dumpLexer(opts.dump.tokens, &parser, &opts);
+  parseToEnd(&parser, &stop, 0, NULL);
+  dumped.tokens = dumpLexer(opts.dump.tokens, &parser, &opts);
   if (parser.nErrors != 0) { goto finish; }
 
   parser.pauseAt = EEXPR_DO_NOT_PAUSE;
-  eexpr_parse(&parser, 0, NULL);
+  parseToEnd(&parser, &stop, 0, NULL);
+  parsed = true;
+  dumped.eexprs = dumpParser(opts.dump.eexprs, &parser, &opts);
+  goto finish;
+
+  // eexprs handed over piecemeal are reported all together, just as `eexpr_parse` would have left them
+  gathered:
   parsed = true;
+  parser.nEexprs = all.len;
+  parser.eexprs = all.eexprs;
   dumpParser(opts.dump.eexprs, &parser, &opts);
 
   // report warnings and errors, exiting if there are any errors
   finish:
-  if (parsed && parser.nErrors == 0) {
-    fprintf(stdout, "{ \"filename\": ");
-    fdumpCStr(stdout, opts.inFilename);
-    fprintf(stdout, "\n, \"eexprs\":");
-    fdumpEexprArray(stdout, 2, parser.nEexprs, parser.eexprs);
-    if (parser.nWarnings != 0) {
-      fprintf(stdout, "\n, \"warnings\":");
-      fdumpErrorArray(stdout, "  ", parser.nWarnings, parser.warnings);
-    }
-    fprintf(stdout, "\n}\n");
-  }
-  if (parser.nErrors != 0 || parser.nWarnings != 0) {
-    fprintf(stderr, "{ \"filename\": ");
-    fdumpCStr(stderr, opts.inFilename);
-    fprintf(stderr, "\n, \"warnings\":");
-    fdumpErrorArray(stderr, "  ", parser.nWarnings, parser.warnings);
-    if (parser.nErrors != 0) {
-      fprintf(stderr, "\n, \"errors\":");
-      fdumpErrorArray(stderr, "  ", parser.nErrors, parser.errors);
-    }
-    fprintf(stderr, "\n}\n");
+  if (opts.binary != NULL) { writeBinary(&parser, &opts); }
+  if (opts.dump.stops != NULL) {
+    FILE* fp = fopen(opts.dump.stops, "w");
+    fprintf(fp, "%zu\n", stop.stops);
+    fclose(fp);
   }
-  eexpr_parser_deinit(&parser);
-  for (size_t i = 0; i < parser.nEexprs; ++i) {
-    eexpr_deinit(parser.eexprs[i]);
-    free(parser.eexprs[i]);
+  report(out, err, opts.inFilename, parsed, &parser);
+  int ec = parser.nErrors == 0 ? 0 : 1;
+  if (opts.cache.dir != NULL) {
+    cached outputs = {.exitcode = ec, .nParts = N_CACHED_PARTS};
+    outputs.parts[CACHED_STDOUT] = slurpTmp(out);
+    outputs.parts[CACHED_STDERR] = slurpTmp(err);
+    fclose(out);
+    fclose(err);
+    fwrite(outputs.parts[CACHED_STDOUT].bytes, 1/*byte per element*/, outputs.parts[CACHED_STDOUT].len/*elements*/, stdout);
+    fwrite(outputs.parts[CACHED_STDERR].bytes, 1/*byte per element*/, outputs.parts[CACHED_STDERR].len/*elements*/, stderr);
+    // dumps are read back from where they were written
+    str none = {.len = 0, .bytes = NULL};
+    outputs.parts[CACHED_RAW_TOKENS] = dumped.rawTokens ? readFile(opts.dump.rawTokens) : none;
+    outputs.parts[CACHED_TOKENS] = dumped.tokens ? readFile(opts.dump.tokens) : none;
+    outputs.parts[CACHED_EEXPRS] = dumped.eexprs ? readFile(opts.dump.eexprs) : none;
+    cache_store(&entry, &outputs);
+    cached_deinit(&outputs);
+    cache_entryDel(&entry);
+    free(config.bytes);
   }
+  eexpr_parser_deinit(&parser);
+  freeEexprs(parser.arena, parser.nEexprs, parser.eexprs);
+  eexpr_flatDel(parser.flat);
   free(parser.eexprs);
   free(parser.errors);
   free(parser.warnings);
   free(input.bytes);
-  return parser.nErrors == 0 ? 0 : 1;
+  return ec;
 }
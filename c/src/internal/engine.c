@@ -8,18 +8,19 @@
 
 //////////////////////////////////// General Functions ////////////////////////////////////
 
+// set up everything but the buffers, as for a fresh input
 static
-void engine_init(engine* it) {
+void engine_clear(engine* it) {
   str emptyStr = {.len = 0, .bytes = NULL};
   {
     it->rest = emptyStr;
+    it->cleanEnd = NULL;
     it->loc.line = 0;
     it->loc.col = 0;
     it->loc.byte = 0;
   }
   {
-    dynarr_init_eexpr_p(&it->eexprStream, 64);
-    it->tokStream = dllist_empty_eexpr_token();
+    it->parsePos = 0;
     it->errStream = dllist_empty_eexpr_error();
     it->fatal.type = EEXPR_ERR_NOERROR;
   }
@@ -27,43 +28,371 @@ void engine_init(engine* it) {
     it->discoveredNewline = NEWLINE_NONE;
     it->indent.type = EEXPR_INDENT_NULL;
     it->indent.knownMixed = false;
-    dynarr_init_openWrap(&it->wrapStack, 30);
+  }
+  {
+    it->arena = NULL;
+    it->borrowInput = false;
+    it->lazyNumbers = false;
+    it->fragment = false;
+    it->onEexpr = NULL;
+    it->onEexprCtx = NULL;
+  }
+  {
+    struct timespec noDeadline = {.tv_sec = 0, .tv_nsec = 0};
+    engine_setBudget(it, 0, noDeadline, NULL, NULL);
+    it->cooking = NULL;
+  }
+  {
+    it->feed.active = false;
+    it->feed.final = false;
+    it->feed.buf.len = 0;
+    it->feed.buf.cap = 0;
+    it->feed.buf.bytes = NULL;
+    it->feed.bufStart = 0;
+    it->feed.retryLen = 0;
+    it->feed.scanned = 0;
+    it->feed.depth = 0;
+    it->feed.lastType = EEXPR_TOK_NONE;
+    it->feed.atLineStart = true;
   }
 }
 
+static
+void engine_init(engine* it, size_t tokCap) {
+  engine_clear(it);
+  dynarr_init_eexpr_p(&it->eexprStream, 64);
+  dynarr_init_eexpr_token(&it->tokStream, tokCap);
+  it->lentToks = NULL;
+  dynarr_init_openWrap(&it->wrapStack, 30);
+  dynarr_init_parseFrame(&it->parseStack, 16);
+  it->scratch = strBuilder_new(128);
+}
+
+static
+engine engine_new(size_t n, uint8_t* input, size_t tokCap) {
+  engine out;
+  engine_init(&out, tokCap);
+  out.rest.len = n;
+  out.rest.bytes = input;
+  if (n != 0) {
+    out.cleanEnd = input + validUtf8Prefix(out.rest);
+  }
+  return out;
+}
+
 engine engine_newFromStrn(size_t n, uint8_t* input) {
+  return engine_new(n, input, 1024);
+}
+
+engine engine_newForLiteral(str src) {
+  return engine_new(src.len, src.bytes, 2);
+}
+
+engine engine_newForFragment(size_t n, uint8_t* input, eexpr_token* toks, size_t nToks) {
   engine out;
-  engine_init(&out);
+  engine_clear(&out);
+  out.fragment = true;
+  out.tokStream.cap = nToks;
+  out.tokStream.len = 0;
+  out.tokStream.data = toks;
+  out.lentToks = toks;
+  // a fragment yields at most one expression, which is not kept in here, and many fragments have no wraps
+  out.eexprStream.cap = out.eexprStream.len = 0;
+  out.eexprStream.data = NULL;
+  out.wrapStack.cap = out.wrapStack.len = 0;
+  out.wrapStack.data = NULL;
+  out.parseStack.cap = out.parseStack.len = 0;
+  out.parseStack.data = NULL;
+  out.scratch = strBuilder_new(32);
   out.rest.len = n;
   out.rest.bytes = input;
+  if (n != 0) {
+    out.cleanEnd = input + validUtf8Prefix(out.rest);
+  }
+  return out;
+}
+
+engine engine_newForPiece(size_t n, uint8_t* input, size_t offset) {
+  engine out;
+  engine_init(&out, 1024);
+  out.rest.len = n;
+  out.rest.bytes = input;
+  out.cleanEnd = input; // so the first `lexer_peekUchar` validates the input
+  out.loc.byte = offset;
+  return out;
+}
+
+engine engine_newForFeed(void) {
+  engine out;
+  engine_init(&out, 1024);
+  out.feed.active = true;
+  out.feed.buf = strBuilder_new(4096);
+  out.rest.bytes = out.feed.buf.bytes;
+  out.cleanEnd = out.rest.bytes;
+  return out;
+}
+
+engine engine_newForSegments(size_t n, uint8_t* input) {
+  engine out = engine_new(n, input, 1024);
+  out.feed.active = true;
+  out.feed.final = true;
   return out;
 }
 
 
 void engine_deinit(engine* it) {
+  engine_cookDrop(it);
   // .rest should aliased another string anyway
   it->rest.bytes = NULL;
   it->rest.len = 0;
   dynarr_deinit_openWrap(&it->wrapStack);
+  dynarr_deinit_parseFrame(&it->parseStack);
   // WARNING I'm assuming there's no owned pointer data in error
   it->fatal.type = EEXPR_ERR_NOERROR;
   dllist_del_eexpr_error(&it->errStream);
 
-  for (dllistNode_eexpr_token* node = it->tokStream.start; node != NULL; node = node->next) {
-    token_deinit(&node->here);
+  // tokens before the parser's position have either been destroyed or had their data moved into eexprs
+  for (size_t i = it->parsePos; i < it->tokStream.len; ++i) {
+    engine_tokDeinit(it, &it->tokStream.data[i]);
   }
-  dllist_del_eexpr_token(&it->tokStream);
+  if (it->tokStream.data == it->lentToks) {
+    // the buffer belongs to whoever lent it
+    it->tokStream.data = NULL;
+  }
+  dynarr_deinit_eexpr_token(&it->tokStream);
 
-  for (size_t i = 0; i < it->eexprStream.len; ++i) {
-    eexpr_deinit(it->eexprStream.data[i]);
-    free(it->eexprStream.data[i]);
+  if (it->arena == NULL) {
+    for (size_t i = 0; i < it->eexprStream.len; ++i) {
+      eexpr_deinit(it->eexprStream.data[i]);
+      free(it->eexprStream.data[i]);
+    }
   }
   dynarr_deinit_eexpr_p(&it->eexprStream);
+  free(it->scratch.bytes);
+  it->scratch.bytes = NULL;
+  free(it->feed.buf.bytes);
+  it->feed.buf.bytes = NULL;
+  // the arena (if any) is not freed here, since its contents may already belong to the user
+  it->arena = NULL;
+}
+
+void engine_reuse(engine* it, size_t n, uint8_t* input, bool segments) {
+  engine_cookDrop(it);
+  for (size_t i = it->parsePos; i < it->tokStream.len; ++i) {
+    engine_tokDeinit(it, &it->tokStream.data[i]);
+  }
+  it->tokStream.len = 0;
+  if (it->eexprStream.data == NULL) {
+    // the last output was handed over to the user along with its array
+    dynarr_init_eexpr_p(&it->eexprStream, 64);
+  }
+  else if (it->arena == NULL) {
+    for (size_t i = 0; i < it->eexprStream.len; ++i) {
+      eexpr_deinit(it->eexprStream.data[i]);
+      free(it->eexprStream.data[i]);
+    }
+  }
+  it->eexprStream.len = 0;
+  it->wrapStack.len = 0;
+  it->parseStack.len = 0;
+  it->scratch.len = 0;
+  dllist_del_eexpr_error(&it->errStream);
+  free(it->feed.buf.bytes);
+  engine_clear(it);
+  it->rest.len = n;
+  it->rest.bytes = input;
+  if (n != 0) {
+    it->cleanEnd = input + validUtf8Prefix(it->rest);
+  }
+  it->feed.active = segments;
+  it->feed.final = segments;
+}
+
+
+static
+void shiftLoc(eexpr_loc* loc, size_t lines) {
+  loc->start.line += lines;
+  loc->end.line += lines;
+}
+
+void engine_shiftLines(engine* st, size_t lines) {
+  for (size_t i = 0; i < st->tokStream.len; ++i) {
+    shiftLoc(&st->tokStream.data[i].loc, lines);
+  }
+  for (dllistNode_eexpr_error* node = st->errStream.start; node != NULL; node = node->next) {
+    eexpr_error* err = &node->here;
+    shiftLoc(&err->loc, lines);
+    switch (err->type) {
+      case EEXPR_ERR_MIXED_INDENTATION: shiftLoc(&err->as.mixedIndentation.establishedAt, lines); break;
+      case EEXPR_ERR_UNBALANCED_WRAP: shiftLoc(&err->as.unbalancedWrap.loc, lines); break;
+      default: break;
+    }
+  }
+  if (st->fatal.type != EEXPR_ERR_NOERROR) {
+    shiftLoc(&st->fatal.loc, lines);
+  }
+  st->loc.line += lines;
+}
+
+
+//////////////////////////////////// Work Budget ////////////////////////////////////
+
+// how many tokens may be spent between looks at the deadline and callback
+#define BUDGET_CHECK_INTERVAL 256
+
+static
+bool hasDeadline(const engine_budget* b) {
+  return b->deadline.tv_sec != 0 || b->deadline.tv_nsec != 0;
+}
+
+// move the next stretch of tokens to spend out of `left` and into `untilCheck`
+static
+void refillBudget(engine_budget* b) {
+  size_t stretch = b->left;
+  if ((b->shouldStop != NULL || hasDeadline(b)) && stretch > BUDGET_CHECK_INTERVAL) {
+    stretch = BUDGET_CHECK_INTERVAL;
+  }
+  b->untilCheck = stretch;
+  b->left -= stretch;
+}
+
+void engine_setBudget(engine* st, size_t tokens, struct timespec deadline, bool (*shouldStop)(void*), void* shouldStopCtx) {
+  engine_budget* b = &st->budget;
+  b->left = tokens == 0 ? SIZE_MAX : tokens;
+  b->deadline = deadline;
+  b->shouldStop = shouldStop;
+  b->shouldStopCtx = shouldStopCtx;
+  b->exhausted = false;
+  refillBudget(b);
+}
+
+bool engine_spendChecked(engine* st, size_t n) {
+  engine_budget* b = &st->budget;
+  // whatever was spent beyond the last stretch comes out of the tokens left after it
+  size_t over = n - b->untilCheck;
+  b->untilCheck = 0;
+  b->left = over < b->left ? b->left - over : 0;
+  if (b->left == 0 || engine_pollStop(st)) {
+    b->exhausted = true;
+    return true;
+  }
+  refillBudget(b);
+  return false;
+}
+
+bool engine_pollStop(engine* st) {
+  engine_budget* b = &st->budget;
+  bool stop = b->shouldStop != NULL && b->shouldStop(b->shouldStopCtx);
+  if (!stop && hasDeadline(b)) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    stop = now.tv_sec > b->deadline.tv_sec
+        || (now.tv_sec == b->deadline.tv_sec && now.tv_nsec >= b->deadline.tv_nsec);
+  }
+  if (stop) { b->exhausted = true; }
+  return stop;
+}
+
+
+//////////////////////////////////// Allocation Helper Functions ////////////////////////////////////
+
+void* engine_alloc(engine* st, size_t bytes) {
+  if (st->arena != NULL) {
+    return arena_alloc(&st->arena->mem, bytes);
+  }
+  void* out = malloc(bytes);
+  checkOom(out);
+  return out;
+}
+
+str engine_keepStr(engine* st, str text) {
+  str out = {.len = text.len, .bytes = NULL};
+  if (text.len != 0) {
+    out.bytes = engine_alloc(st, text.len);
+    memcpy(out.bytes, text.bytes, text.len);
+  }
+  return out;
+}
+
+str engine_keepTokText(engine* st, eexpr_token* tok, str text, const uint8_t* from) {
+  if (st->borrowInput && text.len != 0) {
+    const uint8_t* inputEnd = st->rest.bytes + st->rest.len;
+    if ( text.len <= (size_t)(inputEnd - from)
+      && (text.bytes == from || memcmp(text.bytes, from, text.len) == 0)
+       ) {
+      tok->borrowedText = true;
+      str out = {.len = text.len, .bytes = (uint8_t*)from};
+      return out;
+    }
+  }
+  tok->borrowedText = false;
+  return engine_keepStr(st, text);
+}
+
+bigint engine_keepBigint(engine* st, bigint num) {
+  if (st->arena == NULL || num.buf == NULL) { return num; }
+  uint32_t* heapBuf = num.buf;
+  num.buf = arena_alloc(&st->arena->mem, num.len * sizeof(uint32_t));
+  memcpy(num.buf, heapBuf, num.len * sizeof(uint32_t));
+  free(heapBuf);
+  return num;
+}
+
+void engine_growTokens(engine* st, size_t cap) {
+  dynarr_eexpr_token* strm = &st->tokStream;
+  if (cap <= strm->cap) { return; }
+  if (strm->data == NULL || strm->data != st->lentToks) {
+    dynarr_reserve_eexpr_token(strm, cap);
+    return;
+  }
+  eexpr_token* data = malloc(cap * sizeof(eexpr_token));
+  checkOom(data);
+  memcpy(data, strm->data, strm->len * sizeof(eexpr_token));
+  strm->data = data;
+  strm->cap = cap;
+}
+
+void engine_tokDeinit(engine* st, eexpr_token* tok) {
+  if (st->arena == NULL) { token_deinit(tok); }
+}
+
+static
+void rehomeBigint(engine* st, bigint* num) {
+  if (num->buf == NULL) { return; }
+  uint32_t* buf = engine_alloc(st, num->len * sizeof(uint32_t));
+  memcpy(buf, num->buf, num->len * sizeof(uint32_t));
+  num->buf = buf;
+}
+
+void engine_tokRehome(engine* st, eexpr_token* tok) {
+  switch (tok->type) {
+    case EEXPR_TOK_SYMBOL: {
+      if (!tok->borrowedText) { tok->as.symbol.text = engine_keepStr(st, tok->as.symbol.text); }
+    }; break;
+    case EEXPR_TOK_STRING: {
+      if (!tok->borrowedText) { tok->as.string.text = engine_keepStr(st, tok->as.string.text); }
+    }; break;
+    case EEXPR_TOK_NUMBER: {
+      assert(!tok->undecoded);
+      rehomeBigint(st, &tok->as.number.mantissa);
+      rehomeBigint(st, &tok->as.number.exponent);
+    }; break;
+    default: break;
+  }
 }
 
 
 //////////////////////////////////// Lexer/Postlexer Helper Functions ////////////////////////////////////
 
+size_t lexer_peekUcharChecked(engine* st, char32_t* out) {
+  size_t adv = peekUchar(out, st->rest);
+  // we're past the invalid bytes (if there were any), so find out how far the input is valid from here
+  if (*out != UCHAR_NULL) {
+    st->cleanEnd = st->rest.bytes + validUtf8Prefix(st->rest);
+  }
+  return adv;
+}
+
 void lexer_advance(engine* st, size_t bytes, size_t cols) {
   st->rest.len -= bytes;
   st->rest.bytes += bytes;
@@ -79,50 +408,32 @@ void lexer_incLine(engine* st, size_t bytes) {
 }
 
 void lexer_addTok(engine* st, const eexpr_token* tok) {
-  dllistNode_eexpr_token* node = dllist_insertAfter_eexpr_token(&st->tokStream, NULL, tok);
-  node->here.transparent = false;
-}
-
-void lexer_insertBefore(engine* st, const eexpr_token* t, dllistNode_eexpr_token* node) {
-  dllistNode_eexpr_token* new = dllist_insertBefore_eexpr_token(&st->tokStream, t, node);
-  new->here.transparent = false;
+  if (st->tokStream.len == st->tokStream.cap) {
+    engine_growTokens(st, st->tokStream.cap < 4 ? 4 : 2 * st->tokStream.cap);
+  }
+  dynarr_push_eexpr_token(&st->tokStream, tok);
+  dynarr_peek_eexpr_token(&st->tokStream)->transparent = false;
 }
 
 void lexer_delTok(engine* st) {
-  if (st->tokStream.end != NULL) { token_deinit(&st->tokStream.end->here); }
-  dllist_popEnd_eexpr_token(&st->tokStream, NULL);
+  eexpr_token* tok = dynarr_pop_eexpr_token(&st->tokStream);
+  if (tok != NULL) { engine_tokDeinit(st, tok); }
 }
 
 
 //////////////////////////////////// Parser Helper Functions ////////////////////////////////////
 
 eexpr_token* parser_peek(engine* st) {
-  dllistNode_eexpr_token* node = st->tokStream.start;
-  while (node != NULL) {
-    if (node->here.transparent) {
-      token_deinit(&node->here);
-      dllist_popStart_eexpr_token(&st->tokStream, NULL);
-      node = st->tokStream.start;
-    }
-    else {
-      return &node->here;
-    }
+  while (st->parsePos < st->tokStream.len) {
+    eexpr_token* tok = &st->tokStream.data[st->parsePos];
+    if (!tok->transparent) { return tok; }
+    engine_tokDeinit(st, tok);
+    st->parsePos += 1;
   }
   return NULL;
 }
 
 void parser_pop(engine* st) {
-  dllistNode_eexpr_token* node = st->tokStream.start;
-  while (node != NULL) {
-    if (node->here.transparent) {
-      token_deinit(&node->here);
-      dllist_popStart_eexpr_token(&st->tokStream, NULL);
-      node = st->tokStream.start;
-    }
-    else {
-      dllist_popStart_eexpr_token(&st->tokStream, NULL);
-      return;
-    }
-  }
-  assert(false);
+  if (parser_peek(st) == NULL) { assert(false); return; }
+  st->parsePos += 1;
 }
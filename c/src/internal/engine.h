@@ -1,16 +1,61 @@
 #ifndef INTERNAL_ENGINE_H
 #define INTERNAL_ENGINE_H
 
+#include <time.h>
+
+#include "arena.h"
 #include "types.h"
 #include "parameters.h"
 
 #define TYPE eexpr_token
-#include "dllist.h"
+#include "dynarr.h"
 
 #define TYPE eexpr_error
 #include "dllist.h"
 
 
+//////////////////////////////////// Parser State ////////////////////////////////////
+
+// Binding strength of the operators, from loosest to tightest.
+// An operand at one level is an expression at the next level up; chains are made of atomic expressions.
+typedef enum parseLevel {
+  LEVEL_NONE, // for tokens that are not an operator (see `operatorLevel`)
+  LEVEL_SEMICOLON,
+  LEVEL_COMMA,
+  LEVEL_COLON,
+  LEVEL_ELLIPSIS,
+  LEVEL_SPACE,
+  LEVEL_CHAIN,
+  LEVEL_ATOMIC
+} parseLevel;
+
+// The parser keeps its own stack rather than recursing, so that deeply nested input cannot overflow the C stack.
+// There is a frame for each operator level that has found its operator (or a leading one), and for each open wrap or string template.
+typedef enum parseFrameType {
+  FRAME_SEMICOLON = LEVEL_SEMICOLON,
+  FRAME_COMMA = LEVEL_COMMA,
+  FRAME_COLON = LEVEL_COLON,
+  FRAME_ELLIPSIS = LEVEL_ELLIPSIS,
+  FRAME_SPACE = LEVEL_SPACE,
+  FRAME_CHAIN = LEVEL_CHAIN,
+  FRAME_WRAP, // parens, brackets and braces
+  FRAME_BLOCK, // indented blocks
+  FRAME_TEMPLATE
+} parseFrameType;
+
+typedef struct parseFrame {
+  parseFrameType type;
+  parseLevel child; // the level that the operand currently being parsed for this frame started at
+  bool hasFirst; // whether the first operand has been taken into `expr1`
+  eexpr* out; // the list/wrap being built, or for a chain, its predot (if any)
+  eexpr* expr1; // the first operand, or for a chain, the chain so far
+  eexpr_loc loc; // location of the colon or ellipsis operator
+} parseFrame;
+
+#define TYPE parseFrame
+#include "dynarr.h"
+
+
 //////////////////////////////////// Lexer State ////////////////////////////////////
 
 typedef struct openWrap {
@@ -21,10 +66,28 @@ typedef struct openWrap {
 #define TYPE openWrap
 #include "dynarr.h"
 
+// Bounds on how much work the stages may do before stopping early (see `engine_spend`).
+typedef struct engine_budget {
+  size_t left; // how many tokens may still be spent after `untilCheck` runs out
+  size_t untilCheck; // how many tokens may be spent before the bounds are next checked
+  struct timespec deadline; // no deadline if zero
+  bool (*shouldStop)(void* ctx); // nullable
+  void* shouldStopCtx;
+  bool exhausted; // set once a stage has stopped early
+} engine_budget;
+
+// Backing memory for all token and eexpr data produced while the parser is in arena mode.
+struct eexpr_arena {
+  arena mem;
+};
+
 typedef struct engine {
   str rest; // borrowed pointer to input
+  const uint8_t* cleanEnd; // aliased, the input from `rest` up to here is known to be valid utf8 (see `lexer_peekUchar`)
   struct eexpr_locPoint loc; // use zero-indexed line/col and only translate to 1-indexd for human consumption
-  dllist_eexpr_token tokStream; //owned
+  dynarr_eexpr_token tokStream; // owned, unless its data is still `lentToks`
+  eexpr_token* lentToks; // non-null when the token stream started out in a buffer lent by the caller (see `engine_newForFragment`)
+  size_t parsePos; // index of the next token in `tokStream` for the parser to look at
   dynarr_eexpr_p eexprStream; //owned
   dllist_eexpr_error errStream; // owned
   eexpr_error fatal; // use EEXPRERR_NOERROR for no error
@@ -35,6 +98,31 @@ typedef struct engine {
     eexpr_loc established;
   } indent;
   dynarr_openWrap wrapStack;
+  dynarr_parseFrame parseStack; // owned, only holds anything while an expression is being parsed
+  eexpr_arena* arena; // NULL unless in arena mode; ownership is managed by the api (it is eventually handed to the user)
+  strBuilder scratch; // owned, re-used to accumulate the text of string literals
+  engine_budget budget;
+  struct cooker* cooking; // owned, non-null while the postlexer has stopped early partway through the token stream
+  bool borrowInput; // whether token text may alias the input (see `engine_keepTokText`)
+  bool lazyNumbers; // whether to leave the digits of numbers undecoded (see `lazyNumber`)
+  bool fragment; // whether the input is a fragment holding a single expression rather than a whole file (see `engine_parseFragment`)
+  // when set, each top-level eexpr is handed to this as soon as it is parsed, instead of going into `eexprStream`
+  // it returns whether it took ownership of the eexpr
+  bool (*onEexpr)(void* ctx, eexpr* expr);
+  void* onEexprCtx;
+  // only used when the input arrives piecemeal (see `engine_newForFeed`)
+  struct lexer_feed {
+    bool active;
+    bool final; // set once all the input has arrived
+    strBuilder buf; // owned, input from the start of the first token not yet split off (see `engine_splitSegment`)
+    size_t bufStart; // byte offset in the whole input of `buf.bytes[0]`
+    size_t retryLen; // how many bytes of unlexed input must be available before lexing is worth trying again
+    // state of the scan for places the token stream can be split (see `engine_findCut`)
+    size_t scanned; // index of the next token to scan
+    size_t depth; // number of open wraps and string templates
+    eexpr_tokenType lastType; // type of the last token scanned, ignoring spaces, newlines and comments
+    bool atLineStart; // whether the last token scanned ended a top-level line
+  } feed;
 } engine;
 
 //////////////////////////////////// General Functions ////////////////////////////////////
@@ -42,24 +130,185 @@ typedef struct engine {
 // Initialize from a sized string.
 engine engine_newFromStrn(size_t n, uint8_t* input);
 
+// Initialize for lexing a single literal, which needs far less room than a whole input.
+engine engine_newForLiteral(str src);
+
+// Initialize for a (borrowed) fragment holding a single expression, to be parsed with `engine_parseFragment`.
+// The token stream starts out in `toks`, a buffer of `nToks` tokens lent by the caller (usually on its stack),
+//   and is only moved to the heap if it outgrows that buffer (see `engine_growTokens`).
+// The other buffers start out empty, so that a fragment which doesn't need them doesn't allocate them.
+engine engine_newForFragment(size_t n, uint8_t* input, eexpr_token* toks, size_t nToks);
+
+// Initialize for a (borrowed) piece of a larger input, which starts at the beginning of a line `offset` bytes into the whole.
+// Lines are counted from the start of the piece (see `engine_shiftLines`),
+//   and checking the piece for valid utf8 is left until it is lexed, so that it can be done on the lexing thread.
+engine engine_newForPiece(size_t n, uint8_t* input, size_t offset);
+
 
 // free all internal data structures of the passed engine
 void engine_deinit(engine* st);
 
+// Start over on a fresh (borrowed) input, as `engine_newFromStrn` (or with `segments`, `engine_newForSegments`) would,
+//   but keep the buffers already grown for the last one.
+// Whatever the engine still owns from the last input is freed, except its arena (if any), which is left to the caller.
+void engine_reuse(engine* st, size_t n, uint8_t* input, bool segments);
+
 void engine_rawLex(engine* st);
 void engine_cookLex(engine* st);
 void engine_parse(engine* st);
 
+// Parse the tokens of a fragment as exactly one semicolon-level expression, which must take up the whole fragment.
+// Returns NULL if the fragment is blank.
+// Anything left over after the expression is an error, but the expression is still returned, as `engine_parse` would keep it.
+// The postlexer treats a fragment differently from a whole file in a few ways:
+//   there is no need for a trailing newline, leading and trailing space is ignored without complaint,
+//   a colon at the very end does not try to open an indented block (which could never follow),
+//   and when there are no newlines at all, the stages that only deal with newlines and indentation are skipped altogether.
+eexpr* engine_parseFragment(engine* st);
+
+// The postlexer runs in this many stages, and reports all the errors from each stage before those of the next.
+#define ENGINE_N_COOK_STAGES 8
+// Like `engine_cookLex`, but leave the errors from each stage in `stageErrs` (an array of `ENGINE_N_COOK_STAGES` lists),
+//   rather than appending them all to `st->errStream`.
+// If it stops early (see `engine_spend`), `stageErrs` is left untouched until the call that finishes.
+void engine_cookLexApart(engine* st, dllist_eexpr_error* stageErrs);
+
+// add `lines` to the line numbers of every token and error so far
+void engine_shiftLines(engine* st, size_t lines);
+
+
+//////////////////////////////////// Work Budget ////////////////////////////////////
+
+/*
+Each of `engine_rawLex`, `engine_cookLex` and `engine_parse` spends the budget as it goes:
+  a token for every token lexed, pulled into the postlexer, or taken by the parser.
+Once the tokens run out, the deadline passes, or the `shouldStop` callback says so, the stage stops at the next point it can pick up from
+  (after a token, a batch of tokens, or a top-level line respectively) and sets `budget.exhausted`.
+Calling the same stage again (after `engine_setBudget`) carries on from there; its output is only whole once it finishes.
+The deadline and callback are only looked at every few hundred tokens, so that the clock is not read for every token.
+Work that does not go through these stages (such as splitting off segments) can look at them straight away with `engine_pollStop`.
+A fresh engine has no bounds at all.
+*/
+
+// Set the bounds for the stages to follow: at most `tokens` tokens (zero for no bound),
+//   stopping at `deadline` (as from `timespec_get(…, TIME_UTC)`, or zero for none), or once `shouldStop(shouldStopCtx)` returns true (if non-null).
+void engine_setBudget(engine* st, size_t tokens, struct timespec deadline, bool (*shouldStop)(void*), void* shouldStopCtx);
+
+// Return whether the deadline has passed or the callback says to stop (whatever tokens are left), setting `budget.exhausted` if so.
+bool engine_pollStop(engine* st);
+
+// Spend `n` tokens, then return whether the stage should stop early.
+static inline bool engine_spend(engine* st, size_t n);
+// the slow path of `engine_spend`
+bool engine_spendChecked(engine* st, size_t n);
+
+// Throw away the state of a postlexer that stopped early (a no-op if there is none), leaving the token stream whole.
+void engine_cookDrop(engine* st);
+
+
+//////////////////////////////////// Incremental Lexing ////////////////////////////////////
+
+/*
+When input arrives piecemeal, the engine keeps its own copy of the input, and the stages run on one segment of it at a time:
+  1. `engine_feed` the next piece of input,
+  2. `engine_rawLexSome` to lex as far as the input so far allows,
+  3. `engine_findCut` to find where the tokens lexed so far can be split between top-level lines,
+  4. `engine_splitSegment` to move the tokens before that point into an engine of their own,
+  5. cook and parse that engine as usual.
+Once all input has been fed, `engine_feedEnd`, then keep lexing and splitting until the EOF token has been split off.
+An input that is already whole can skip the feeding (see `engine_newForSegments`).
+A whole input can also be cut into pieces up front, guessing at split points from the raw bytes, and each piece lexed on its own;
+  `engine_startsAtCut` and `engine_endsAtCut` then check the guesses were right (see `engine_newForPiece`).
+The token stream is only split before a line which starts with a symbol, number, string or open wrap in the first column
+  after a newline that is not in any wrap, string template, or colon block.
+Such a line always begins a new top-level eexpr, and the postlexer/parser see exactly the same tokens either side of the split,
+  so parsing the segments one after another gives the same eexprs as parsing the whole input at once.
+*/
+
+// Initialize for input to be passed in with `engine_feed`.
+// Token text is always copied, since the input buffer is reused.
+engine engine_newForFeed(void);
+
+// Initialize for a (borrowed) whole input to be processed a segment at a time, as if it had all been fed already.
+engine engine_newForSegments(size_t n, uint8_t* input);
+
+// append input
+void engine_feed(engine* st, str chunk);
+// mark that no more input will be fed
+void engine_feedEnd(engine* st);
+
+// Like `engine_rawLex`, but stops short of any token that more input could still change.
+// Once all input has arrived, it instead stops after a batch of tokens, so that a large input is not lexed all at once;
+//   call it again until the token stream ends with an EOF token.
+void engine_rawLexSome(engine* st);
+
+// Return the index of the last token before which the token stream can be split, or zero if there is none yet.
+size_t engine_findCut(engine* st);
+
+// Whether a whole piece of input, once lexed, begins with a token that the stream can be split before.
+bool engine_startsAtCut(const engine* st);
+// Whether a whole piece of input, once lexed, ends (just before its EOF token) where the stream could be split,
+//   i.e. the next piece can be split off if it starts with the right sort of token.
+bool engine_endsAtCut(engine* st);
+
+// Move the first `cut` tokens (and the errors that precede them) into a fresh engine, ended with an EOF token.
+// If `cut` is all the tokens, they must already end with an EOF token.
+// The fresh engine shares the arena (if any), but nothing else.
+engine engine_splitSegment(engine* st, size_t cut);
+
+// Decode a lazy number by lexing its source text again, this time in full.
+eexprNumber engine_forceNumber(lazyNumber lazy);
+
+
+//////////////////////////////////// Allocation Helper Functions ////////////////////////////////////
+
+// These allocate from the arena when in arena mode, and otherwise from the heap.
+// Either way, the results are owned by whatever token/eexpr they are placed into.
+
+void* engine_alloc(engine* st, size_t bytes);
+
+// copy the given bytes into fresh memory
+str engine_keepStr(engine* st, str text);
+
+// Keep the text of a symbol/string token, as `engine_keepStr` would.
+// However, in borrowed-input mode, when the input starting at `from` holds exactly the same bytes,
+//   the text is instead taken from there and the token is marked as borrowing it.
+str engine_keepTokText(engine* st, eexpr_token* tok, str text, const uint8_t* from);
+
+// move the digits of a bigint (which must have been built on the heap) into fresh memory
+bigint engine_keepBigint(engine* st, bigint num);
+
+// Grow the token stream to hold at least `cap` tokens, moving it to the heap if it is still in a lent buffer.
+void engine_growTokens(engine* st, size_t cap);
+
+// free the data owned by a token (a no-op in arena mode)
+void engine_tokDeinit(engine* st, eexpr_token* tok);
+
+// Copy the data owned by a token into fresh memory, leaving the old copy where it is.
+// This is for moving tokens out of an arena that is about to be reset.
+void engine_tokRehome(engine* st, eexpr_token* tok);
+
 
 //////////////////////////////////// Lexer/Postlexer Helper Functions ////////////////////////////////////
 
+// Decode codepoints at the start of the remaining input, as `peekUchar(out, st->rest)` and `peekUchars(out, n, st->rest)` would.
+// Input is checked for valid utf8 in bulk ahead of time (see `validUtf8Prefix`), so most codepoints can be decoded without checks.
+// After a run of invalid bytes, the check is picked up again where valid input resumes.
+static inline size_t lexer_peekUchar(engine* st, char32_t* out);
+static inline size_t lexer_peekUchars(engine* st, char32_t* out, size_t n);
+// the slow path of `lexer_peekUchar`
+size_t lexer_peekUcharChecked(engine* st, char32_t* out);
+
 void lexer_advance(engine* st, size_t bytes, size_t cols);
 
+// Advance past ascii bytes up to (not including) the first non-ascii byte or byte in the given `stopBytes` class.
+// Returns the number of bytes (equivalently, columns) advanced.
+static inline size_t lexer_skipAsciiUntil(engine* st, uint8_t stopClass);
+
 void lexer_incLine(engine* st, size_t bytes);
 
-// `lexer_addTok` and `lexer_insertBefore` ensure that added tokens are non-transparent
+// ensures that the added token is non-transparent
 void lexer_addTok(engine* st, const eexpr_token* t);
-void lexer_insertBefore(engine* st, const eexpr_token* t, dllistNode_eexpr_token* point);
 
 // remove the last token (useful for re-using standard `take*` procedures as part of others)
 // ensures the memory used by that token is also deallocated
@@ -69,15 +318,58 @@ void lexer_delTok(engine* st);
 //////////////////////////////////// Parser Helper Functions ////////////////////////////////////
 
 
-// both `parser_peek` and `parser_pop` destroy transparent tokens from the start of the token stream, along with their token data.
+// both `parser_peek` and `parser_pop` step past (and destroy the data of) transparent tokens at the parser's position.
 
 // returns a borrowed pointer to the first non-transparent token
 eexpr_token* parser_peek(engine* st);
 
-// Removes the first non-transparent token from the stream.
+// Steps the parser past the first non-transparent token in the stream.
 // It does not free any token data, so you must assume ownership of the popped token's data before popping.
 // For the foreseeable future, this should be easy, since the `malloc`d data of a token is needed to populate the data of an eexpr.
 void parser_pop(engine* st);
 
 
+//////////////////////////////////// Inline Definitions ////////////////////////////////////
+
+static inline
+bool engine_spend(engine* st, size_t n) {
+  if (n < st->budget.untilCheck) {
+    st->budget.untilCheck -= n;
+    return false;
+  }
+  return engine_spendChecked(st, n);
+}
+
+static inline
+size_t lexer_peekUchar(engine* st, char32_t* out) {
+  if (st->rest.bytes < st->cleanEnd) {
+    return decodeUcharUnchecked(out, st->rest.bytes);
+  }
+  return lexer_peekUcharChecked(st, out);
+}
+
+static inline
+size_t lexer_peekUchars(engine* st, char32_t* out, size_t n) {
+  if (n == 0) { return 0; }
+  size_t adv = lexer_peekUchar(st, &out[0]);
+  str in = {.len = st->rest.len - adv, .bytes = st->rest.bytes + adv};
+  for (size_t i = 1; i < n; ++i) {
+    size_t adv1 = in.bytes < st->cleanEnd
+                ? decodeUcharUnchecked(&out[i], in.bytes)
+                : peekUchar(&out[i], in);
+    in.bytes += adv1;
+    in.len -= adv1;
+    adv += adv1;
+  }
+  return adv;
+}
+
+static inline
+size_t lexer_skipAsciiUntil(engine* st, uint8_t stopClass) {
+  size_t n = asciiRunUntil(st->rest.bytes, st->rest.len, stopClass);
+  lexer_advance(st, n, n);
+  return n;
+}
+
+
 #endif
@@ -6,6 +6,9 @@
 #include "engine.h"
 #include "parameters.h"
 
+#define TYPE uint32_t
+#include "dynarr.h"
+
 
 //////////////////////////////////// Helper Consumers ////////////////////////////////////
 
@@ -49,7 +52,7 @@ static
 bool takeCharEscape(engine* st, char32_t* out) {
   char32_t c;
   size_t adv;
-  adv = peekUchar(&c, st->rest);
+  adv = lexer_peekUchar(st, &c);
   // standard escapes
   for (size_t i = 0; commonEscapes[i].source != UCHAR_NULL; ++i) {
     if (c == commonEscapes[i].source) {
@@ -63,7 +66,7 @@ bool takeCharEscape(engine* st, char32_t* out) {
   if (c == twoHexEscapeLeader) {
     lexer_advance(st, adv, 1);
     decodeError.loc.start = st->loc;
-    adv = peekUchars(&digits[4], 2, st->rest);
+    adv = lexer_peekUchars(st, &digits[4], 2);
     lexer_advance(st, adv, 2);
     if (!decodeUnihex(&c, 2, &digits[4])) {
       decodeError.loc.end = st->loc;
@@ -79,7 +82,7 @@ bool takeCharEscape(engine* st, char32_t* out) {
   else if (c == fourHexEscapeLeader) {
     lexer_advance(st, adv, 1);
     decodeError.loc.start = st->loc;
-    adv = peekUchars(&digits[2], 4, st->rest);
+    adv = lexer_peekUchars(st, &digits[2], 4);
     lexer_advance(st, adv, 4);
     if (!decodeUnihex(&c, 4, &digits[2])) {
       decodeError.loc.end = st->loc;
@@ -95,7 +98,7 @@ bool takeCharEscape(engine* st, char32_t* out) {
   else if (c == sixHexEscapeLeader) {
     lexer_advance(st, adv, 1);
     decodeError.loc.start = st->loc;
-    adv = peekUchars(digits, 6, st->rest);
+    adv = lexer_peekUchars(st, digits, 6);
     lexer_advance(st, adv, 6);
     if (!decodeUnihex(&c, 6, digits)) {
       decodeError.loc.end = st->loc;
@@ -130,12 +133,12 @@ static
 bool takeNullEscape(engine* st) {
   char32_t c;
   size_t adv;
-  adv = peekUchar(&c, st->rest);
+  adv = lexer_peekUchar(st, &c);
   if (isNewlineChar(c)) {
     assert(takeNewline(st));
     lexer_delTok(st);
     if (takeWhitespace(st)) { lexer_delTok(st); }
-    adv = peekUchar(&c, st->rest);
+    adv = lexer_peekUchar(st, &c);
     if (c == escapeLeader) {
       lexer_advance(st, adv, 1);
     }
@@ -154,11 +157,11 @@ bool takeNullEscape(engine* st) {
 
 static
 void tryBadBytes(engine* st, bool fatal) {
-  char32_t c; size_t adv = peekUchar(&c, st->rest);
+  char32_t c; size_t adv = lexer_peekUchar(st, &c);
   if (c != UCHAR_NULL || adv == 0) { return; }
   eexpr_error err = {.loc = {.start = st->loc}, .type = EEXPR_ERR_BAD_BYTES};
   while (true) {
-    adv = peekUchar(&c, st->rest);
+    adv = lexer_peekUchar(st, &c);
     if (c != UCHAR_NULL || adv == 0) { break; }
     lexer_advance(st, adv, 0);
   }
@@ -182,24 +185,27 @@ static
 bool takeWhitespace(engine* st) {
   {
     char32_t lookahead;
-    peekUchar(&lookahead, st->rest);
+    lexer_peekUchar(st, &lookahead);
     if (!isSpaceChar(lookahead)) { return false; }
   }
   eexpr_token tok = {.loc = {.start = st->loc}, .type = EEXPR_TOK_UNKNOWN_SPACE};
   {
-    char32_t c0; peekUchar(&c0, st->rest);
+    char32_t c0; lexer_peekUchar(st, &c0);
     tok.as.unknownSpace.type = decodeSpaceChar(c0);
   }
   size_t advChars = 0;
   while (true) {
-    char32_t c; size_t adv = peekUchar(&c, st->rest);
+    char32_t c; lexer_peekUchar(st, &c);
     if (isSpaceChar(c)) {
       eexpr_spaceType newWs = decodeSpaceChar(c);
       if (newWs != tok.as.unknownSpace.type) {
         tok.as.unknownSpace.type = EEXPR_WSMIXED;
       }
-      lexer_advance(st, adv, 1);
-      advChars += 1;
+      // space characters are ascii, so take the whole run of this one at once
+      size_t n = 0;
+      while (n < st->rest.len && st->rest.bytes[n] == c) { ++n; }
+      lexer_advance(st, n, n);
+      advChars += n;
     }
     else {
       break;
@@ -228,7 +234,7 @@ bool takeLineContinue(engine* st) {
     };
   {
     char32_t lookahead;
-    size_t adv = peekUchar(&lookahead, st->rest);
+    size_t adv = lexer_peekUchar(st, &lookahead);
     if (lookahead != escapeLeader) { return false; }
     lexer_advance(st, adv, 1);
     tok.loc.end = st->loc;
@@ -240,7 +246,7 @@ bool takeLineContinue(engine* st) {
     bool trailingSpace = false;
     while (true) {
       char32_t c;
-      size_t adv = peekUchar(&c, st->rest);
+      size_t adv = lexer_peekUchar(st, &c);
       if (isSpaceChar(c)) {
         lexer_advance(st, adv, 1);
         trailingSpace = true;
@@ -282,7 +288,7 @@ bool takeNewline(engine* st) {
   newlineType type;
   {
     char32_t lookahead[2];
-    peekUchars(lookahead, 2, st->rest);
+    lexer_peekUchars(st, lookahead, 2);
     type = decodeNewline(lookahead);
     if (type == NEWLINE_NONE) { return false; }
   }
@@ -311,7 +317,7 @@ bool takeNewline(engine* st) {
 static
 bool takeEof(engine* st) {
   char32_t c;
-  size_t adv = peekUchar(&c, st->rest);
+  size_t adv = lexer_peekUchar(st, &c);
   if (adv != 0) {
     return false;
   }
@@ -334,7 +340,7 @@ static
 bool takeComment(engine* st) {
   {
     char32_t lookahead;
-    peekUchar(&lookahead, st->rest);
+    lexer_peekUchar(st, &lookahead);
     if (lookahead != commentChar) { return false; }
   }
   eexpr_token tok = {.loc = {.start = st->loc}, .type = EEXPR_TOK_COMMENT};
@@ -346,6 +352,15 @@ bool takeComment(engine* st) {
   return true;
 }
 
+// agrees with `isSymbolChar` on ascii bytes, and is false for the rest
+static inline
+bool isAsciiSymbolByte(uint8_t b) {
+  switch (leadClasses[b]) {
+    case LEAD_SYMBOL: case LEAD_SIGN: case LEAD_DIGIT: case LEAD_SQUOTE: return true;
+    default: return false;
+  }
+}
+
 /*
 Symbols are simply one or more symbol characters.
   `[:symbolChar1:][:symbolChar:]* - ([+-]?[:digit:][:symbolChar:]*)`
@@ -354,14 +369,20 @@ static
 bool takeSymbol(engine* st) {
   {
     char32_t lookahead[2];
-    peekUchars(lookahead, 2, st->rest);
+    lexer_peekUchars(st, lookahead, 2);
     if (!isSymbolStart(lookahead)) { return false; }
   }
   str text = { .len = 0, .bytes = st->rest.bytes };
   eexpr_token tok = {.loc = {.start = st->loc}, .type = EEXPR_TOK_SYMBOL};
   while (true) {
+    { // skip ascii symbol characters in bulk
+      size_t n = 0;
+      while (n < st->rest.len && isAsciiSymbolByte(st->rest.bytes[n])) { ++n; }
+      text.len += n;
+      lexer_advance(st, n, n);
+    }
     char32_t c;
-    size_t adv = peekUchar(&c, st->rest);
+    size_t adv = lexer_peekUchar(st, &c);
     if (isSymbolChar(c)) {
       text.len += adv;
       lexer_advance(st, adv, 1);
@@ -372,7 +393,7 @@ bool takeSymbol(engine* st) {
   }
   assert(text.len != 0);
   tok.loc.end = st->loc;
-  tok.as.symbol.text = str_clone(text);
+  tok.as.symbol.text = engine_keepTokText(st, &tok, text, text.bytes);
   lexer_addTok(st, &tok);
   return true;
 }
@@ -380,7 +401,7 @@ bool takeSymbol(engine* st) {
 static
 void checkDigitSepContext(const radixParams* radix, struct eexpr_locPoint start, bool alwaysError, engine* st) {
   char32_t lookahead;
-  peekUchar(&lookahead, st->rest);
+  lexer_peekUchar(st, &lookahead);
   if ( alwaysError
     || (!isDigit(radix, lookahead) && lookahead != digitSep)
      ) {
@@ -388,6 +409,67 @@ void checkDigitSepContext(const radixParams* radix, struct eexpr_locPoint start,
     dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
   }
 }
+/*
+Accumulates the digits of a number into a bigint.
+Digits go into a machine word for as long as it can hold the whole value, so typical numbers never touch the heap.
+Only after that overflows are digits batched into chunks (as many digits as fit in 32 bits, e.g. nine decimal digits),
+  which are handed to `bigint_fromChunks` all at once, so that even enormous literals are converted in subquadratic time.
+*/
+typedef struct digitAcc {
+  uint8_t radix;
+  bool spilled; // whether `.chunks` has been started
+  uint64_t word; // before spilling: the whole value; after: the digits of the current chunk
+  uint32_t chunkScale; // after spilling: `radix` to the power of the number of digits in the current chunk
+  uint32_t chunkBase; // the value of `chunkScale` once a chunk is full
+  dynarr_uint32_t chunks; // full chunks, most significant first
+} digitAcc;
+
+static
+digitAcc accNew(uint8_t radix) {
+  digitAcc out = {.radix = radix, .spilled = false, .word = 0, .chunkScale = 1, .chunkBase = 1};
+  while (out.chunkBase <= UINT32_MAX / radix) { out.chunkBase *= radix; }
+  return out;
+}
+
+static
+void accPush(digitAcc* acc, uint8_t digit) {
+  if (!acc->spilled) {
+    if (acc->word <= (UINT64_MAX - digit) / acc->radix) {
+      acc->word = acc->word * acc->radix + digit;
+      return;
+    }
+    // re-express the word in chunks; any leading zero chunks are harmless
+    dynarr_init_uint32_t(&acc->chunks, 16);
+    uint32_t split[3]; // 2^64 < (2^28)^3, and every radix has a `chunkBase` of at least 2^28
+    size_t nSplit = 0;
+    for (; acc->word != 0; acc->word /= acc->chunkBase) { split[nSplit++] = acc->word % acc->chunkBase; }
+    while (nSplit > 0) { dynarr_push_uint32_t(&acc->chunks, &split[--nSplit]); }
+    acc->spilled = true;
+    acc->chunkScale = 1;
+  }
+  if (acc->chunkScale == acc->chunkBase) {
+    uint32_t chunk = (uint32_t)acc->word;
+    dynarr_push_uint32_t(&acc->chunks, &chunk);
+    acc->word = 0;
+    acc->chunkScale = 1;
+  }
+  acc->word = acc->word * acc->radix + digit;
+  acc->chunkScale *= acc->radix;
+}
+
+static
+bigint accFinish(digitAcc* acc) {
+  if (!acc->spilled) {
+    return bigint_fromU64(acc->word);
+  }
+  bigint out = bigint_fromChunks(acc->chunks.data, acc->chunks.len, acc->chunkBase);
+  dynarr_deinit_uint32_t(&acc->chunks);
+  if (acc->chunkScale != 1) {
+    bigint_mulAdd(&out, acc->chunkScale, (uint32_t)acc->word);
+  }
+  return out;
+}
+
 /*
 Numbers can be integers or fractionals; fractionals are distinguished by having a decimal point.
 They start with an optional sign, then an optional radix specification (specs exist for bases 2, 8, 12, 16; default 10).
@@ -404,17 +486,20 @@ Then, if the exponent letter was generic, a radix specificaion may be given (jus
 static
 bool takeNumber(engine* st) {
   eexpr_token tok = {.loc = {.start = st->loc}, .type = EEXPR_TOK_NUMBER};
+  const uint8_t* src = st->rest.bytes;
+  // when lazy, the digits are still checked, but not accumulated
+  bool decode = !st->lazyNumbers;
   ////// gather sign (or early exit) //////
   bool neg;
   {
     char32_t lookahead[2];
-    size_t adv = peekUchars(lookahead, 1, st->rest);
+    size_t adv = lexer_peekUchars(st, lookahead, 1);
     if (isDigit(defaultRadix, lookahead[0])) {
       neg = false;
     }
     else if (isSign(lookahead[0])) {
       neg = lookahead[0] == negativeSign;
-      peekUchars(lookahead, 2, st->rest);
+      lexer_peekUchars(st, lookahead, 2);
       if (isDigit(defaultRadix, lookahead[1])) {
         lexer_advance(st, adv, 1);
       }
@@ -426,7 +511,7 @@ bool takeNumber(engine* st) {
   const radixParams* radix = NULL;
   {
     char32_t lookahead[2];
-    size_t adv = peekUchars(lookahead, 2, st->rest);
+    size_t adv = lexer_peekUchars(st, lookahead, 2);
     if (lookahead[0] == defaultRadix->digits[0]) {
       radix = decodeRadix(lookahead[1]);
       if (radix != NULL) {
@@ -438,16 +523,16 @@ bool takeNumber(engine* st) {
     }
   }
   ////// gather integer part //////
-  bigint mantissa = bigint_new();
+  digitAcc mantissaAcc = accNew(radix->radix);
   {
     uint32_t integerDigits = 0;
     while (true) {
       char32_t c;
-      size_t adv = peekUchar(&c, st->rest);
-      if (isDigit(radix, c)) {
+      size_t adv = lexer_peekUchar(st, &c);
+      int digit = digitValue(radix, c);
+      if (digit >= 0) {
         lexer_advance(st, adv, 1);
-        bigint_scale(&mantissa, radix->radix);
-        bigint_inc(&mantissa, decodeDigit(radix, c));
+        if (decode) { accPush(&mantissaAcc, digit); }
         integerDigits += 1;
       }
       else if (c == digitSep) {
@@ -462,17 +547,17 @@ bool takeNumber(engine* st) {
   uint32_t fractionalDigits = 0;
   { // decimal point
     char32_t lookahead[2];
-    size_t adv = peekUchar(lookahead, st->rest);
-    peekUchars(lookahead, 2, st->rest);
+    size_t adv = lexer_peekUchar(st, lookahead);
+    lexer_peekUchars(st, lookahead, 2);
     if (lookahead[0] == digitPoint && isDigit(radix, lookahead[1])) {
       lexer_advance(st, adv, 1);
       while (true) {
         char32_t c;
-        size_t adv = peekUchar(&c, st->rest);
-        if (isDigit(radix, c)) {
+        size_t adv = lexer_peekUchar(st, &c);
+        int digit = digitValue(radix, c);
+        if (digit >= 0) {
           lexer_advance(st, adv, 1);
-          bigint_scale(&mantissa, radix->radix);
-          bigint_inc(&mantissa, decodeDigit(radix, c));
+          if (decode) { accPush(&mantissaAcc, digit); }
           fractionalDigits += 1;
         }
         else if (c == digitSep) {
@@ -493,7 +578,7 @@ bool takeNumber(engine* st) {
     bool expRadixMayDiffer;
     {
       char32_t lookahead;
-      size_t adv = peekUchar(&lookahead, st->rest);
+      size_t adv = lexer_peekUchar(st, &lookahead);
       if (ucharElem(lookahead, radix->exponentLetters)) {
         lexer_advance(st, adv, 1);
         expPresent = true;
@@ -512,7 +597,7 @@ bool takeNumber(engine* st) {
       ////// gather exponent sign //////
       {
         char32_t lookahead;
-        size_t adv = peekUchar(&lookahead, st->rest);
+        size_t adv = lexer_peekUchar(st, &lookahead);
         if (isSign(lookahead)) {
           expNeg = lookahead == negativeSign;
           if (fractionalDigits) {
@@ -536,7 +621,7 @@ bool takeNumber(engine* st) {
       }
       else {
         char32_t lookahead[2];
-        size_t adv = peekUchars(lookahead, 2, st->rest);
+        size_t adv = lexer_peekUchars(st, lookahead, 2);
         if (lookahead[0] == defaultRadix->digits[0]) {
           expRadix = decodeRadix(lookahead[1]);
           if (expRadix != NULL) {
@@ -549,16 +634,17 @@ bool takeNumber(engine* st) {
       }
       ////// gather exponent digits //////
       {
+        digitAcc exponentAcc = accNew(expRadix->radix);
         // ensure exponent has at least one digit
         uint32_t expDigits = 0;
         while (true) {
           char32_t c;
-          size_t adv = peekUchar(&c, st->rest);
-          if (isDigit(expRadix, c)) {
+          size_t adv = lexer_peekUchar(st, &c);
+          int digit = digitValue(expRadix, c);
+          if (digit >= 0) {
             expDigits += 1;
             lexer_advance(st, adv, 1);
-            bigint_scale(&exponent, expRadix->radix);
-            bigint_inc(&exponent, decodeDigit(expRadix, c));
+            if (decode) { accPush(&exponentAcc, digit); }
           }
           else if (c == digitSep) {
             struct eexpr_locPoint loc0 = st->loc;
@@ -567,6 +653,7 @@ bool takeNumber(engine* st) {
           }
           else { break; }
         }
+        if (decode) { exponent = accFinish(&exponentAcc); }
         if (expDigits == 0) {
           eexpr_error err = {.loc = tok.loc, .type = EEXPR_ERR_MISSING_EXPONENT};
           dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
@@ -575,12 +662,21 @@ bool takeNumber(engine* st) {
     }
   }
   tok.loc.end = st->loc;
+  if (!decode) {
+    tok.undecoded = true;
+    tok.as.lazyNumber.src.len = st->rest.bytes - src;
+    tok.as.lazyNumber.src.bytes = (uint8_t*)src;
+    tok.as.lazyNumber.arena = st->arena;
+    lexer_addTok(st, &tok);
+    return true;
+  }
+  bigint mantissa = accFinish(&mantissaAcc);
   if (mantissa.len != 0) { mantissa.pos = !neg; }  // finally make use of the sign we may have parsed at the beginning
-  tok.as.number.mantissa = mantissa;
+  tok.as.number.mantissa = engine_keepBigint(st, mantissa);
   tok.as.number.radix = radix->radix;
   tok.as.number.fractionalDigits = fractionalDigits;
   if (exponent.len != 0) { exponent.pos = !expNeg; }
-  tok.as.number.exponent = exponent;
+  tok.as.number.exponent = engine_keepBigint(st, exponent);
   lexer_addTok(st, &tok);
   return true;
 }
@@ -597,30 +693,32 @@ static
 bool takeString(engine* st) {
   eexpr_token tok = {.loc = {.start = st->loc}, .type = EEXPR_TOK_STRING};
   char32_t open; {
-    size_t adv = peekUchar(&open, st->rest);
+    size_t adv = lexer_peekUchar(st, &open);
     if (!isStringDelim(open)) { return false; }
     lexer_advance(st, adv, 1);
   }
-  strBuilder buf = strBuilder_new(128);
+  const uint8_t* body = st->rest.bytes;
+  strBuilder* buf = &st->scratch; buf->len = 0;
   for (bool more = true; more; ) {
     more = false;
     { // standard characters
       str tmp = {.len = 0, .bytes = st->rest.bytes};
       while (true) {
+        tmp.len += lexer_skipAsciiUntil(st, STOP_STRING);
         char32_t c;
-        size_t adv = peekUchar(&c, st->rest);
+        size_t adv = lexer_peekUchar(st, &c);
         if (!isStringChar(c)) { break; }
         lexer_advance(st, adv, 1);
         tmp.len += adv;
       }
       if (tmp.len != 0) {
         more = true;
-        strBuilder_append(&buf, tmp);
+        strBuilder_append(buf, tmp);
       }
     }
     { // escape sequences
       char32_t c;
-      size_t adv = peekUchar(&c, st->rest);
+      size_t adv = lexer_peekUchar(st, &c);
       if (c == escapeLeader) {
         lexer_advance(st, adv, 1);
         more = true;
@@ -629,14 +727,14 @@ bool takeString(engine* st) {
           if (decoded != UCHAR_NULL) {
             utf8Char encoded = encodeUchar(decoded);
             str tmp = {.len = encoded.nbytes, .bytes = encoded.codeunits};
-            strBuilder_append(&buf, tmp);
+            strBuilder_append(buf, tmp);
           }
         }
         else if (takeNullEscape(st)) { // found a null escape
           // do nothing
         }
         else {
-          adv = peekUchar(&c, st->rest);
+          adv = lexer_peekUchar(st, &c);
           if (adv == 0) {
             // if it was end of file, let the next stage deal with it
           }
@@ -656,7 +754,7 @@ bool takeString(engine* st) {
     }
     {
       char32_t c;
-      size_t adv = peekUchar(&c, st->rest);
+      size_t adv = lexer_peekUchar(st, &c);
       // stop at close delimiter or end of line/file
       if ( adv == 0
         || isStringDelim(c)
@@ -671,7 +769,7 @@ bool takeString(engine* st) {
     }
   }
   char32_t close; {
-    size_t adv = peekUchar(&close, st->rest);
+    size_t adv = lexer_peekUchar(st, &close);
     if (isStringDelim(close)) {
       lexer_advance(st, adv, 1);
     }
@@ -681,8 +779,8 @@ bool takeString(engine* st) {
     }
   }
   tok.loc.end = st->loc;
-  tok.as.string.text.len = buf.len;
-  tok.as.string.text.bytes = realloc(buf.bytes, buf.len);
+  str text = {.len = buf->len, .bytes = buf->bytes};
+  tok.as.string.text = engine_keepTokText(st, &tok, text, body);
   tok.as.string.splice = spliceType(open, close);
   lexer_addTok(st, &tok);
   return true;
@@ -695,35 +793,41 @@ They are any characters enclosed in single-quotes, where single-quotes can be em
   `'([^']|'')*'`
 */
 bool takeSqlString(engine* st) {
-  char32_t c; size_t adv = peekUchar(&c, st->rest);
+  char32_t c; size_t adv = lexer_peekUchar(st, &c);
   if (c != sqlStringDelim) { return false; }
   eexpr_token tok = {.loc = {.start = st->loc}, .type = EEXPR_TOK_STRING};
   lexer_advance(st, adv, 1);
-  strBuilder buf = strBuilder_new(128);
+  const uint8_t* body = st->rest.bytes;
+  strBuilder* buf = &st->scratch; buf->len = 0;
   while (true) {
-    adv = peekUchar(&c, st->rest);
+    { // plain ascii characters in bulk
+      str run = {.len = 0, .bytes = st->rest.bytes};
+      run.len = lexer_skipAsciiUntil(st, STOP_SQL_STRING);
+      strBuilder_append(buf, run);
+    }
+    adv = lexer_peekUchar(st, &c);
     str tmp = {.len = adv, .bytes = st->rest.bytes};
     if (isNewlineChar(c)) {
       if (takeNewline(st)) {
         lexer_delTok(st);
         tmp.len = st->rest.bytes - tmp.bytes;
-        strBuilder_append(&buf, tmp);
+        strBuilder_append(buf, tmp);
       }
       else {
         goto unclosed;
       }
     }
     else if (c == sqlStringDelim) {
-      char32_t lookahead[2]; size_t bigAdv = peekUchars(lookahead, 2, st->rest);
+      char32_t lookahead[2]; size_t bigAdv = lexer_peekUchars(st, lookahead, 2);
       if (lookahead[1] == sqlStringDelim) {
-        strBuilder_append(&buf, tmp);
+        strBuilder_append(buf, tmp);
         lexer_advance(st, bigAdv, 1);
       }
       else {
         lexer_advance(st, adv, 1);
         tok.loc.end = st->loc;
-        tok.as.string.text.len = buf.len;
-        tok.as.string.text.bytes = realloc(buf.bytes, buf.len);
+        str text = {.len = buf->len, .bytes = buf->bytes};
+        tok.as.string.text = engine_keepTokText(st, &tok, text, body);
         tok.as.string.splice = EEXPR_STRPLAIN;
         lexer_addTok(st, &tok);
         return true;
@@ -731,8 +835,8 @@ bool takeSqlString(engine* st) {
     }
     else if (adv == 0) unclosed: {
       tok.loc.end = st->loc;
-      tok.as.string.text.len = buf.len;
-      tok.as.string.text.bytes = realloc(buf.bytes, buf.len);
+      str text = {.len = buf->len, .bytes = buf->bytes};
+      tok.as.string.text = engine_keepTokText(st, &tok, text, body);
       tok.as.string.splice = EEXPR_STRCORRUPT;
       lexer_addTok(st, &tok);
       eexpr_error err =
@@ -747,7 +851,7 @@ bool takeSqlString(engine* st) {
     }
     else {
       lexer_advance(st, adv, 1);
-      strBuilder_append(&buf, tmp);
+      strBuilder_append(buf, tmp);
     }
   }
 }
@@ -774,7 +878,7 @@ bool takeHeredoc(engine* st) {
   eexpr_token tok = {.loc = {.start = st->loc}, .type = EEXPR_TOK_STRING};
   {
     char32_t lookahead[3];
-    size_t adv = peekUchars(lookahead, 3, st->rest);
+    size_t adv = lexer_peekUchars(st, lookahead, 3);
     if ( lookahead[0] != plainStringDelim
       || lookahead[1] != plainStringDelim
       || lookahead[2] != plainStringDelim
@@ -788,7 +892,7 @@ bool takeHeredoc(engine* st) {
     str delimName = {.len = 0, .bytes = st->rest.bytes};
     while (true) {
       char32_t c;
-      size_t adv = peekUchar(&c, st->rest);
+      size_t adv = lexer_peekUchar(st, &c);
       if (isSymbolChar(c)) {
         delimName.len += adv;
         lexer_advance(st, adv, 1);
@@ -812,21 +916,21 @@ bool takeHeredoc(engine* st) {
     eexpr_error err = {.loc = {.start = st->loc}, .type = EEXPR_ERR_TRAILING_SPACE};
     bool trailingSpace = false;
     while (true) {
-      char32_t c; size_t adv = peekUchar(&c, st->rest);
+      char32_t c; size_t adv = lexer_peekUchar(st, &c);
       if (isSpaceChar(c)) {
         lexer_advance(st, adv, 1);
         trailingSpace = true;
       }
       else { break; }
     }
-    char32_t lookahead; size_t adv = peekUchar(&lookahead, st->rest);
+    char32_t lookahead; size_t adv = lexer_peekUchar(st, &lookahead);
     if (lookahead == escapeLeader) {
       trailingSpace = false;
       indented = true;
       lexer_advance(st, adv, 1);
       err.loc.start = st->loc;
       while (true) {
-        char32_t c; size_t adv = peekUchar(&c, st->rest);
+        char32_t c; size_t adv = lexer_peekUchar(st, &c);
         if (isSpaceChar(c)) {
           lexer_advance(st, adv, 1);
           trailingSpace = true;
@@ -857,7 +961,7 @@ bool takeHeredoc(engine* st) {
     if (indented) {
       // determine indentation character
       struct eexpr_locPoint indentPosStart = st->loc;
-      char32_t c; size_t adv = peekUchar(&c, st->rest);
+      char32_t c; size_t adv = lexer_peekUchar(st, &c);
       if (isSpaceChar(c)) {
         lexer_advance(st, adv, 1);
         indentChar = c;
@@ -868,7 +972,7 @@ bool takeHeredoc(engine* st) {
       }
       // count indentation depth
       while (true) {
-        char32_t c; size_t adv = peekUchar(&c, st->rest);
+        char32_t c; size_t adv = lexer_peekUchar(st, &c);
         if (c == indentChar) {
           lexer_advance(st, adv, 1);
           indentNChars += 1;
@@ -878,7 +982,7 @@ bool takeHeredoc(engine* st) {
           indentNChars += 1;
           if (indentChar == tabChar) {
             // tab-based indentation needs an alignment tab after the closing backslash
-            char32_t c; size_t adv = peekUchar(&c, st->rest);
+            char32_t c; size_t adv = lexer_peekUchar(st, &c);
             if (c == tabChar) {
               lexer_advance(st, adv, 1);
             }
@@ -919,20 +1023,22 @@ bool takeHeredoc(engine* st) {
     }
   }
   // accumulate lines until end marker
-  strBuilder textBuf = strBuilder_new(256);
+  const uint8_t* body = st->rest.bytes;
+  strBuilder* textBuf = &st->scratch; textBuf->len = 0;
   while (true) {
     { // consume line
       str tmp = {.len = 0, .bytes = st->rest.bytes};
       while (true) {
-        char32_t c; size_t adv = peekUchar(&c, st->rest);
+        tmp.len += lexer_skipAsciiUntil(st, STOP_EOL);
+        char32_t c; size_t adv = lexer_peekUchar(st, &c);
         if ( adv == 0
           || isNewlineChar(c)
            ) {
-          strBuilder_append(&textBuf, tmp);
+          strBuilder_append(textBuf, tmp);
           break;
         }
         else if (c == UCHAR_NULL) {
-          strBuilder_append(&textBuf, tmp);
+          strBuilder_append(textBuf, tmp);
           tryBadBytes(st, false);
           tmp.len = 0; tmp.bytes = st->rest.bytes;
         }
@@ -951,8 +1057,8 @@ bool takeHeredoc(engine* st) {
       else {
         free(ender.bytes);
         tok.loc.end = st->loc;
-        tok.as.string.text.len = textBuf.len;
-        tok.as.string.text.bytes = textBuf.bytes;
+        str text = {.len = textBuf->len, .bytes = textBuf->bytes};
+        tok.as.string.text = engine_keepTokText(st, &tok, text, body);
         lexer_addTok(st, &tok);
         st->fatal.type = EEXPR_ERR_UNCLOSED_MULTILINE_STRING;
         st->fatal.loc = tok.loc;
@@ -962,7 +1068,7 @@ bool takeHeredoc(engine* st) {
     { // consume indentation
       eexpr_error err = {.loc = {.start = st->loc}, .type = EEXPR_ERR_HEREDOC_BAD_INDENTATION};
       for (size_t i = 0; i < indentNChars; ++i) {
-        char32_t c; size_t adv = peekUchar(&c, st->rest);
+        char32_t c; size_t adv = lexer_peekUchar(st, &c);
         if (isSpaceChar(c) && decodeIndentChar(c) == indentType) {
           lexer_advance(st, adv, 1);
         }
@@ -987,14 +1093,14 @@ bool takeHeredoc(engine* st) {
         break;
       }
       else {
-        strBuilder_append(&textBuf, nlText);
+        strBuilder_append(textBuf, nlText);
       }
     }
   }
   free(ender.bytes);
   tok.loc.end = st->loc;
-  tok.as.string.text.len = textBuf.len;
-  tok.as.string.text.bytes = textBuf.bytes;
+  str text = {.len = textBuf->len, .bytes = textBuf->bytes};
+  tok.as.string.text = engine_keepTokText(st, &tok, text, body);
   lexer_addTok(st, &tok);
   return true;
 }
@@ -1006,7 +1112,7 @@ Wraps are parens, brackets, and braces.
 static
 bool takeWrap(engine* st) {
   char32_t lookahead;
-  size_t adv = peekUchar(&lookahead, st->rest);
+  size_t adv = lexer_peekUchar(st, &lookahead);
   eexpr_wrapType type = isWrapChar(lookahead);
   if (type == EEXPR_WRAP_NULL) { return false; }
   eexpr_token tok = {.loc = {.start = st->loc}, .type = EEXPR_TOK_WRAP};
@@ -1029,7 +1135,7 @@ bool takeSplitter(engine* st) {
   splitter info;
   {
     char32_t lookahead[2];
-    peekUchars(lookahead, 2, st->rest);
+    lexer_peekUchars(st, lookahead, 2);
     info = decodeSplitter(lookahead);
     if (info.type == SPLITTER_NONE) { return false; }
   }
@@ -1052,7 +1158,7 @@ bool takeSplitter(engine* st) {
 static
 bool takeUnexpected(engine* st) {
   char32_t c;
-  size_t adv = peekUchar(&c, st->rest);
+  size_t adv = lexer_peekUchar(st, &c);
   if (c == UCHAR_NULL && adv != 0) {
     tryBadBytes(st, false);
     return true;
@@ -1069,21 +1175,229 @@ bool takeUnexpected(engine* st) {
 
 //////////////////////////////////// Main Lexer Functions ////////////////////////////////////
 
+// Try only those consumers which could accept a token starting with the next byte (see `leadClasses`).
+// Returns false if there is no such shortcut (or every candidate declined), in which case every consumer should be tried in turn.
+static
+bool takeByLeadByte(engine* st) {
+  if (st->rest.len == 0) { return false; }
+  switch ((leadClass)leadClasses[st->rest.bytes[0]]) {
+    case LEAD_SPACE: return takeWhitespace(st);
+    case LEAD_NEWLINE: return takeNewline(st);
+    case LEAD_COMMENT: return takeComment(st);
+    case LEAD_SYMBOL: return takeSymbol(st);
+    case LEAD_SIGN: return takeSymbol(st) || takeNumber(st);
+    case LEAD_DIGIT: return takeNumber(st);
+    case LEAD_DQUOTE: return takeHeredoc(st) || takeString(st);
+    case LEAD_BACKTICK: return takeString(st);
+    case LEAD_SQUOTE: return takeSqlString(st);
+    case LEAD_SPLITTER: return takeSplitter(st);
+    case LEAD_WRAP: return takeWrap(st);
+    case LEAD_BACKSLASH: return takeLineContinue(st);
+    case LEAD_OTHER: return false;
+  }
+  return false;
+}
+
+eexprNumber engine_forceNumber(lazyNumber lazy) {
+  engine st = engine_newForLiteral(lazy.src);
+  st.arena = lazy.arena;
+  if (!takeNumber(&st)) { assert(false); }
+  eexprNumber out = st.tokStream.data[0].as.number;
+  st.tokStream.len = 0; // the digits are ours now
+  engine_deinit(&st);
+  return out;
+}
+
+// Take the next token (or error), trying consumers in turn.
+// Returns false once the end of input has been reached.
+static
+bool takeNext(engine* st) {
+  if (takeByLeadByte(st)) { return true; }
+  // slow path: non-ascii, unexpected characters, and end-of-file
+  if (takeWhitespace(st)) { return true; }
+  if (takeNewline(st)) { return true; }
+  if (takeComment(st)) { return true; }
+  if (takeSymbol(st)) { return true; }
+  if (takeNumber(st)) { return true; }
+  if (takeHeredoc(st)) { return true; }
+  if (takeString(st)) { return true; }
+  if (takeSqlString(st)) { return true; }
+  if (takeSplitter(st)) { return true; }
+  if (takeWrap(st)) { return true; }
+  if (takeLineContinue(st)) { return true; }
+  if (takeEof(st)) { return false; }
+  if (takeUnexpected(st)) { return true; }
+  assert(false);
+  return false;
+}
+
 void engine_rawLex(engine* st) {
   while (st->fatal.type == EEXPR_ERR_NOERROR) {
-    if (takeWhitespace(st)) { continue; }
-    if (takeNewline(st)) { continue; }
-    if (takeComment(st)) { continue; }
-    if (takeSymbol(st)) { continue; }
-    if (takeNumber(st)) { continue; }
-    if (takeHeredoc(st)) { continue; }
-    if (takeString(st)) { continue; }
-    if (takeSqlString(st)) { continue; }
-    if (takeSplitter(st)) { continue; }
-    if (takeWrap(st)) { continue; }
-    if (takeLineContinue(st)) { continue; }
-    if (takeEof(st)) { break; }
-    if (takeUnexpected(st)) { continue; }
-    assert(false);
+    if (!takeNext(st)) { break; }
+    // the lexer keeps all its state in the engine, so it can stop after any token
+    if (engine_spend(st, 1)) { return; }
+  }
+}
+
+
+//////////////////////////////////// Incremental Lexing ////////////////////////////////////
+
+// No consumer looks further than this many bytes past the end of the token it takes.
+// So, once a token ends at least this far before the end of the input received so far, more input cannot change it.
+#define FEED_LOOKAHEAD 16
+// Once all input has arrived, how many tokens to lex before giving the parser a chance to catch up.
+#define FEED_BATCH 4096
+
+void engine_feed(engine* st, str chunk) {
+  assert(st->feed.active && !st->feed.final);
+  strBuilder* buf = &st->feed.buf;
+  size_t restOff = st->rest.bytes - buf->bytes;
+  size_t cleanOff = st->cleanEnd - buf->bytes;
+  strBuilder_append(buf, chunk);
+  st->rest.bytes = buf->bytes + restOff;
+  st->rest.len = buf->len - restOff;
+  st->cleanEnd = buf->bytes + cleanOff;
+}
+
+void engine_feedEnd(engine* st) {
+  assert(st->feed.active);
+  st->feed.final = true;
+}
+
+/*
+A token taken near the end of the input so far may be cut short (a symbol or string continues in the next piece of input),
+  or may have been taken differently (an unclosed heredoc is a fatal error, but it may yet be closed).
+So, such a token is retracted, along with any errors it raised, and it is lexed again once more input has arrived.
+To keep an enormous token (e.g. a heredoc spanning the whole input) from being re-lexed over and over as each small piece arrives,
+  the next attempt waits until the unlexed input has doubled.
+*/
+void engine_rawLexSome(engine* st) {
+  if (st->feed.final) {
+    for (size_t i = 0; i < FEED_BATCH && st->fatal.type == EEXPR_ERR_NOERROR; ++i) {
+      if (!takeNext(st)) { break; }
+    }
+    return;
+  }
+  if (st->rest.len < st->feed.retryLen) { return; }
+  while (st->fatal.type == EEXPR_ERR_NOERROR) {
+    str rest = st->rest;
+    const uint8_t* cleanEnd = st->cleanEnd;
+    struct eexpr_locPoint loc = st->loc;
+    size_t nToks = st->tokStream.len;
+    dllistNode_eexpr_error* lastErr = st->errStream.end;
+    newlineType discoveredNewline = st->discoveredNewline;
+    struct lexer_indent indent = st->indent;
+    takeNext(st);
+    if (st->rest.len < FEED_LOOKAHEAD) {
+      st->rest = rest;
+      st->cleanEnd = cleanEnd;
+      st->loc = loc;
+      while (st->tokStream.len > nToks) { lexer_delTok(st); }
+      while (st->errStream.end != lastErr) { dllist_popEnd_eexpr_error(&st->errStream, NULL); }
+      st->fatal.type = EEXPR_ERR_NOERROR;
+      st->discoveredNewline = discoveredNewline;
+      st->indent = indent;
+      st->feed.retryLen = 2 * rest.len + FEED_LOOKAHEAD;
+      return;
+    }
+  }
+}
+
+// Whether a token, if it is the first on a line, must start a new eexpr.
+static
+bool startsEexpr(const eexpr_token* tok) {
+  switch (tok->type) {
+    case EEXPR_TOK_SYMBOL: return true;
+    case EEXPR_TOK_NUMBER: return true;
+    case EEXPR_TOK_STRING: {
+      return tok->as.string.splice == EEXPR_STRPLAIN || tok->as.string.splice == EEXPR_STROPEN;
+    }
+    case EEXPR_TOK_WRAP: return tok->as.wrap.isOpen;
+    default: return false;
+  }
+}
+
+size_t engine_findCut(engine* st) {
+  struct lexer_feed* feed = &st->feed;
+  size_t cut = 0;
+  for (; feed->scanned < st->tokStream.len; ++feed->scanned) {
+    const eexpr_token* tok = &st->tokStream.data[feed->scanned];
+    if (feed->atLineStart && startsEexpr(tok)) {
+      cut = feed->scanned;
+    }
+    switch (tok->type) {
+      case EEXPR_TOK_UNKNOWN_NEWLINE: {
+        // a line ending in a colon is continued by an indented block
+        feed->atLineStart = feed->depth == 0 && feed->lastType != EEXPR_TOK_UNKNOWN_COLON;
+      }; break;
+      case EEXPR_TOK_UNKNOWN_SPACE: case EEXPR_TOK_COMMENT: {
+        feed->atLineStart = false;
+      }; break;
+      default: {
+        feed->atLineStart = false;
+        feed->lastType = tok->type;
+        bool opens = (tok->type == EEXPR_TOK_WRAP && tok->as.wrap.isOpen)
+                  || (tok->type == EEXPR_TOK_STRING && tok->as.string.splice == EEXPR_STROPEN);
+        bool closes = (tok->type == EEXPR_TOK_WRAP && !tok->as.wrap.isOpen)
+                   || (tok->type == EEXPR_TOK_STRING && tok->as.string.splice == EEXPR_STRCLOSE);
+        if (opens) { feed->depth += 1; }
+        else if (closes && feed->depth != 0) { feed->depth -= 1; }
+      }; break;
+    }
+  }
+  return cut;
+}
+
+bool engine_startsAtCut(const engine* st) {
+  return st->tokStream.len != 0 && startsEexpr(&st->tokStream.data[0]);
+}
+
+bool engine_endsAtCut(engine* st) {
+  assert(st->tokStream.len != 0 && st->tokStream.data[st->tokStream.len - 1].type == EEXPR_TOK_EOF);
+  // scan up to, but not including, the EOF token
+  st->tokStream.len -= 1;
+  engine_findCut(st);
+  st->tokStream.len += 1;
+  return st->feed.depth == 0 && st->feed.atLineStart;
+}
+
+engine engine_splitSegment(engine* st, size_t cut) {
+  assert(0 < cut && cut <= st->tokStream.len);
+  engine seg = engine_newFromStrn(0, NULL);
+  seg.arena = st->arena;
+  for (size_t i = 0; i < cut; ++i) {
+    lexer_addTok(&seg, &st->tokStream.data[i]);
+  }
+  if (cut == st->tokStream.len) {
+    assert(st->tokStream.data[cut - 1].type == EEXPR_TOK_EOF);
+    seg.errStream = st->errStream;
+    st->errStream = dllist_empty_eexpr_error();
+    st->tokStream.len = 0;
+    st->feed.scanned = 0;
+    return seg;
+  }
+  struct eexpr_locPoint at = st->tokStream.data[cut].loc.start;
+  { // the segment ends where the next begins
+    eexpr_token eof = {.loc = {.start = at, .end = at}, .type = EEXPR_TOK_EOF};
+    lexer_addTok(&seg, &eof);
+  }
+  while (st->errStream.start != NULL && st->errStream.start->here.loc.start.byte < at.byte) {
+    dllist_moveAfter_eexpr_error(&seg.errStream, seg.errStream.end, &st->errStream, st->errStream.start);
+  }
+  { // drop the tokens that were split off
+    st->tokStream.len -= cut;
+    memmove(st->tokStream.data, &st->tokStream.data[cut], st->tokStream.len * sizeof(eexpr_token));
+    st->feed.scanned -= cut;
+  }
+  if (st->feed.buf.bytes != NULL) { // and the input they came from, unless it is borrowed
+    strBuilder* buf = &st->feed.buf;
+    size_t drop = at.byte - st->feed.bufStart;
+    buf->len -= drop;
+    memmove(buf->bytes, &buf->bytes[drop], buf->len);
+    st->feed.bufStart = at.byte;
+    if (st->cleanEnd < st->rest.bytes) { st->cleanEnd = st->rest.bytes; }
+    st->rest.bytes -= drop;
+    st->cleanEnd -= drop;
   }
+  return seg;
 }
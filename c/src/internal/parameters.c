@@ -9,20 +9,24 @@
 // base 2
 char32_t _leader2[] = {'b','B',UCHAR_NULL};
 char32_t _digits2[] = {'0','1',UCHAR_NULL};
+static const uint8_t _ascii2[128] = { ['0'] = 1, ['1'] = 2 };
 char32_t _exp2[] = {'b','B',UCHAR_NULL};
 // base 8
 char32_t _leader8[] = {'o','O',UCHAR_NULL};
 char32_t _digits8[] = {'0','1','2','3','4','5','6','7',UCHAR_NULL};
+static const uint8_t _ascii8[128] = { ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8 };
 char32_t _exp8[] = {UCHAR_NULL}; // I don't know of any widespread agreement
 // base 10
 char32_t _leader10[] = {UCHAR_NULL};
 char32_t _digits10[] = {'0','1','2','3','4','5','6','7','8','9',UCHAR_NULL};
+static const uint8_t _ascii10[128] = { ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10 };
 char32_t _exp10[] = {'e','E',UCHAR_NULL};
 // base 12
 char32_t _leader12[] = {'z','Z',UCHAR_NULL}; // as in doZenal
 char32_t _digits12[] = { '0','1','2','3','4','5','6','7','8','9',0x218A/*↊*/,0x218B/*↋*/
                        , '0','1','2','3','4','5','6','7','8','9','X','E' // after the usage of the Dozenal Society of America when they use ASCII
                        , UCHAR_NULL};
+static const uint8_t _ascii12[128] = { ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10, ['X'] = 11, ['E'] = 12 }; // ↊ and ↋ are not ascii
 char32_t _exp12[] = {UCHAR_NULL}; // I don't know of any widespread agreement
 // base 16
 char32_t _leader16[] = {'x','X',UCHAR_NULL};
@@ -30,6 +34,11 @@ char32_t _digits16[] = { '0','1','2','3','4','5','6','7','8','9','a','b','c','d'
                        , '0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F'
                        , UCHAR_NULL
                        };
+static const uint8_t _ascii16[128] =
+  { ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10
+  , ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+  , ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16
+  };
 char32_t _exp16[] = {'h','H',UCHAR_NULL};
 // base 62, base64(url) are not included, since they aren't easily understood by humans. instead, interpret a string (preferrably at compiletime)
 
@@ -38,26 +47,31 @@ const radixParams radices[] =
   { { .radix = 10
     , .leaderLetters = _leader10
     , .digits = _digits10
+    , .asciiDigits = _ascii10
     , .exponentLetters = _exp10
     }
   , { .radix = 16
     , .leaderLetters = _leader16
     , .digits = _digits16
+    , .asciiDigits = _ascii16
     , .exponentLetters = _exp16
     }
   , { .radix = 2
     , .leaderLetters = _leader2
     , .digits = _digits2
+    , .asciiDigits = _ascii2
     , .exponentLetters = _exp2
     }
   , { .radix = 8
     , .leaderLetters = _leader8
     , .digits = _digits8
+    , .asciiDigits = _ascii8
     , .exponentLetters = _exp8
     }
   , { .radix = 12
     , .leaderLetters = _leader12
     , .digits = _digits12
+    , .asciiDigits = _ascii12
     , .exponentLetters = _exp12
     }
   , { .radix = 0 }
@@ -66,6 +80,7 @@ const radixParams radices[] =
 const radixParams* defaultRadix = &radices[0];
 
 bool isDigit(const radixParams* radix, char32_t c) {
+  if (c < 128) { return radix->asciiDigits[c] != 0; }
   return ucharElem(c, radix->digits);
 }
 
@@ -92,11 +107,17 @@ const radixParams* decodeRadix(char32_t c) {
 
 uint8_t decodeDigit(const radixParams* radix, char32_t c) {
   assert(isDigit(radix, c));
+  if (c < 128) { return radix->asciiDigits[c] - 1; }
   size_t amt = ucharFind(c, radix->digits);
   while (amt > radix->radix) { amt -= radix->radix; }
   return amt;
 }
 
+int digitValue(const radixParams* radix, char32_t c) {
+  if (c < 128) { return (int)radix->asciiDigits[c] - 1; }
+  return isDigit(radix, c) ? decodeDigit(radix, c) : -1;
+}
+
 
 //////////////////////////////////// Symbols ////////////////////////
 
@@ -271,6 +292,13 @@ const char* encodeNewline(newlineType nl) {
 struct untilEol untilEol(str in) {
   struct untilEol out = { .bytes = 0, .chars = 0 };
   while (true) {
+    { // skip ascii in bulk
+      size_t n = asciiRunUntil(in.bytes, in.len, STOP_EOL);
+      in.bytes += n;
+      in.len -= n;
+      out.bytes += n;
+      out.chars += n;
+    }
     char32_t c;
     size_t adv = peekUchar(&c, in);
     in.bytes += adv;
@@ -351,3 +379,85 @@ bool isSeparateChar(char32_t c) {
 //////////////////////////////////// Miscellaneous ////////////////////////
 
 const char32_t commentChar = '#';
+
+
+//////////////////////////////////// Lexer Dispatch ////////////////////////
+
+const uint8_t leadClasses[256] =
+  { [' '] = LEAD_SPACE, ['\t'] = LEAD_SPACE
+  , ['\n'] = LEAD_NEWLINE, ['\r'] = LEAD_NEWLINE, ['\x1E'] = LEAD_NEWLINE
+  , ['#'] = LEAD_COMMENT
+  , ['a'] = LEAD_SYMBOL, ['b'] = LEAD_SYMBOL, ['c'] = LEAD_SYMBOL, ['d'] = LEAD_SYMBOL, ['e'] = LEAD_SYMBOL, ['f'] = LEAD_SYMBOL, ['g'] = LEAD_SYMBOL
+  , ['h'] = LEAD_SYMBOL, ['i'] = LEAD_SYMBOL, ['j'] = LEAD_SYMBOL, ['k'] = LEAD_SYMBOL, ['l'] = LEAD_SYMBOL, ['m'] = LEAD_SYMBOL, ['n'] = LEAD_SYMBOL
+  , ['o'] = LEAD_SYMBOL, ['p'] = LEAD_SYMBOL, ['q'] = LEAD_SYMBOL, ['r'] = LEAD_SYMBOL, ['s'] = LEAD_SYMBOL, ['t'] = LEAD_SYMBOL, ['u'] = LEAD_SYMBOL
+  , ['v'] = LEAD_SYMBOL, ['w'] = LEAD_SYMBOL, ['x'] = LEAD_SYMBOL, ['y'] = LEAD_SYMBOL, ['z'] = LEAD_SYMBOL
+  , ['A'] = LEAD_SYMBOL, ['B'] = LEAD_SYMBOL, ['C'] = LEAD_SYMBOL, ['D'] = LEAD_SYMBOL, ['E'] = LEAD_SYMBOL, ['F'] = LEAD_SYMBOL, ['G'] = LEAD_SYMBOL
+  , ['H'] = LEAD_SYMBOL, ['I'] = LEAD_SYMBOL, ['J'] = LEAD_SYMBOL, ['K'] = LEAD_SYMBOL, ['L'] = LEAD_SYMBOL, ['M'] = LEAD_SYMBOL, ['N'] = LEAD_SYMBOL
+  , ['O'] = LEAD_SYMBOL, ['P'] = LEAD_SYMBOL, ['Q'] = LEAD_SYMBOL, ['R'] = LEAD_SYMBOL, ['S'] = LEAD_SYMBOL, ['T'] = LEAD_SYMBOL, ['U'] = LEAD_SYMBOL
+  , ['V'] = LEAD_SYMBOL, ['W'] = LEAD_SYMBOL, ['X'] = LEAD_SYMBOL, ['Y'] = LEAD_SYMBOL, ['Z'] = LEAD_SYMBOL
+  , ['_'] = LEAD_SYMBOL
+  , ['+'] = LEAD_SIGN, ['-'] = LEAD_SIGN
+  , ['0'] = LEAD_DIGIT, ['1'] = LEAD_DIGIT, ['2'] = LEAD_DIGIT, ['3'] = LEAD_DIGIT, ['4'] = LEAD_DIGIT
+  , ['5'] = LEAD_DIGIT, ['6'] = LEAD_DIGIT, ['7'] = LEAD_DIGIT, ['8'] = LEAD_DIGIT, ['9'] = LEAD_DIGIT
+  , ['\"'] = LEAD_DQUOTE
+  , ['`'] = LEAD_BACKTICK
+  , ['\''] = LEAD_SQUOTE
+  , [':'] = LEAD_SPLITTER, ['.'] = LEAD_SPLITTER, [';'] = LEAD_SPLITTER, [','] = LEAD_SPLITTER
+  , ['('] = LEAD_WRAP, [')'] = LEAD_WRAP, ['['] = LEAD_WRAP, [']'] = LEAD_WRAP, ['{'] = LEAD_WRAP, ['}'] = LEAD_WRAP
+  , ['\\'] = LEAD_BACKSLASH
+  };
+
+const uint8_t stopBytes[256] =
+  { ['\n'] = STOP_EOL | STOP_STRING | STOP_SQL_STRING
+  , ['\r'] = STOP_EOL | STOP_STRING | STOP_SQL_STRING
+  , ['\x1E'] = STOP_EOL | STOP_STRING | STOP_SQL_STRING
+  , ['\"'] = STOP_STRING, ['`'] = STOP_STRING, ['\\'] = STOP_STRING
+  , ['\''] = STOP_SQL_STRING
+  // the remaining control characters are not valid in strings
+  , [0x00] = STOP_STRING, [0x01] = STOP_STRING, [0x02] = STOP_STRING, [0x03] = STOP_STRING, [0x04] = STOP_STRING, [0x05] = STOP_STRING, [0x06] = STOP_STRING, [0x07] = STOP_STRING
+  , [0x08] = STOP_STRING, [0x09] = STOP_STRING, [0x0B] = STOP_STRING, [0x0C] = STOP_STRING, [0x0E] = STOP_STRING, [0x0F] = STOP_STRING, [0x10] = STOP_STRING, [0x11] = STOP_STRING
+  , [0x12] = STOP_STRING, [0x13] = STOP_STRING, [0x14] = STOP_STRING, [0x15] = STOP_STRING, [0x16] = STOP_STRING, [0x17] = STOP_STRING, [0x18] = STOP_STRING, [0x19] = STOP_STRING
+  , [0x1A] = STOP_STRING, [0x1B] = STOP_STRING, [0x1C] = STOP_STRING, [0x1D] = STOP_STRING, [0x1F] = STOP_STRING
+  };
+
+// Non-zero exactly when some byte of `word` is `c`.
+// (Which bits are set is only reliable up to the first such byte, but `stopsInWord` only needs to know whether there is one.)
+static inline
+uint64_t bytesEqual(uint64_t word, uint8_t c) {
+  uint64_t x = word ^ (UINT64_C(0x0101010101010101) * c);
+  return (x - UINT64_C(0x0101010101010101)) & ~x & UINT64_C(0x8080808080808080);
+}
+
+// Like `bytesEqual`, but for bytes less than `c` (which must be at most 0x80).
+static inline
+uint64_t bytesLess(uint64_t word, uint8_t c) {
+  return (word - UINT64_C(0x0101010101010101) * c) & ~word & UINT64_C(0x8080808080808080);
+}
+
+// Whether any of the eight bytes in `word` is non-ascii or in the given `stopBytes` class.
+// This must agree with the `stopBytes` table.
+static inline
+bool stopsInWord(uint64_t word, uint8_t stopClass) {
+  uint64_t hits = word & UINT64_C(0x8080808080808080);
+  if (stopClass & (STOP_EOL | STOP_SQL_STRING)) {
+    hits |= bytesEqual(word, '\n') | bytesEqual(word, '\r') | bytesEqual(word, '\x1E');
+  }
+  if (stopClass & STOP_STRING) {
+    // all the control characters, which takes in the newlines as well
+    hits |= bytesLess(word, 0x20) | bytesEqual(word, '\"') | bytesEqual(word, '`') | bytesEqual(word, '\\');
+  }
+  if (stopClass & STOP_SQL_STRING) {
+    hits |= bytesEqual(word, '\'');
+  }
+  return hits != 0;
+}
+
+size_t asciiRunUntil(const uint8_t* bytes, size_t n, uint8_t stopClass) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t word; memcpy(&word, &bytes[i], 8);
+    if (stopsInWord(word, stopClass)) { break; }
+  }
+  while (i < n && bytes[i] < 0x80 && !(stopBytes[bytes[i]] & stopClass)) { ++i; }
+  return i;
+}
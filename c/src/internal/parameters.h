@@ -17,6 +17,9 @@ typedef struct radixParams {
   // this way, we can use `ucharElem`, but also know exactly what weight each digit carries
   // it may require duplicating digits, but that's fine
   char32_t* digits;
+  // the same digits, as a table indexed by ascii codepoint, holding the digit's value plus one (so zero means "not a digit")
+  // non-ascii digits only appear in `.digits`
+  const uint8_t* asciiDigits;
   // base-sepcific exponent notation retains the base from the significand/mantissa
   // also exponent notation can be accessed with `qwerty^asdf` with qwerty in any base and asdf also in any base (default 10 for both)
   char32_t* exponentLetters;
@@ -42,6 +45,9 @@ const radixParams* decodeRadix(char32_t c);
 
 uint8_t decodeDigit(const radixParams* radix, char32_t c);
 
+// combines `isDigit` and `decodeDigit`: returns the value of the digit, or -1 if it is not a digit
+int digitValue(const radixParams* radix, char32_t c);
+
 
 //////////////////////////////////// Symbols ////////////////////////
 
@@ -138,4 +144,51 @@ splitter decodeSplitter(char32_t c[2]);
 extern const char32_t commentChar;
 
 
+//////////////////////////////////// Lexer Dispatch ////////////////////////
+
+/*
+A summary of the character classes above, indexed by the first byte of a token.
+This lets the lexer go straight to the consumer(s) that could accept a token, instead of trying each in turn.
+It is only a shortcut: `LEAD_OTHER` (which includes all non-ascii bytes) means "try everything",
+  so the table only needs to be correct for the bytes it does classify.
+*/
+typedef enum leadClass {
+  LEAD_OTHER = 0,
+  LEAD_SPACE,
+  LEAD_NEWLINE,
+  LEAD_COMMENT,
+  LEAD_SYMBOL, // letters and underscore
+  LEAD_SIGN, // can start either a symbol or a number
+  LEAD_DIGIT,
+  LEAD_DQUOTE, // can start either a heredoc or a string
+  LEAD_BACKTICK,
+  LEAD_SQUOTE,
+  LEAD_SPLITTER,
+  LEAD_WRAP,
+  LEAD_BACKSLASH
+} leadClass;
+
+extern const uint8_t leadClasses[256];
+
+/*
+Bytes that can end a run of plain text inside a token, as bit flags.
+Consumers skip ascii text in bulk up to the next such byte (or the next non-ascii byte, which they decode normally).
+Since the skipped bytes are ascii, they each take up exactly one column.
+*/
+enum stopClass {
+  STOP_EOL = 1, // ends comments and the lines of a heredoc
+  STOP_STRING = 2, // ends the plain characters of a double-quote/backtick string
+  STOP_SQL_STRING = 4 // ends the plain characters of a single-quote string
+};
+
+extern const uint8_t stopBytes[256];
+
+// The number of ascii bytes at the start of `bytes` (of which there are `n`) before the first one in the given `stopBytes` class.
+// Bytes are classified eight at a time (see `stopsInWord` for the word-at-a-time version of `stopBytes`),
+//   and `stopBytes` is only consulted to find the exact stopping byte within a word.
+// Only the long runs of text inside strings, comments and heredocs are worth skipping this way;
+//   the symbols and whitespace between tokens are mostly a few bytes long, and are cheaper to walk as they are.
+size_t asciiRunUntil(const uint8_t* bytes, size_t n, uint8_t stopClass);
+
+
 #endif
@@ -7,6 +7,69 @@
 
 //////////////////////////////////// Helper Procedures ////////////////////////////////////
 
+// In arena mode, lists of subexprs (and template parts) are grown in the arena rather than on the heap.
+// `dynarr_push_*` only reallocates when the array is full, so making room beforehand is enough to redirect it.
+
+static
+void listInit(engine* st, dynarr_eexpr_p* list, size_t cap0) {
+  if (st->arena == NULL) {
+    dynarr_init_eexpr_p(list, cap0);
+  }
+  else {
+    list->data = arena_alloc(&st->arena->mem, cap0 * sizeof(eexpr_p));
+    list->cap = cap0;
+    list->len = 0;
+  }
+}
+static
+void listPush(engine* st, dynarr_eexpr_p* list, eexpr* elem) {
+  if (st->arena != NULL && list->len == list->cap) {
+    size_t cap = list->cap == 0 ? 4 : 2 * list->cap;
+    list->data = arena_realloc(&st->arena->mem, list->data, list->cap * sizeof(eexpr_p), cap * sizeof(eexpr_p));
+    list->cap = cap;
+  }
+  dynarr_push_eexpr_p(list, &elem);
+}
+
+static
+void partsInit(engine* st, dynarr_strTemplPart* parts, size_t cap0) {
+  if (st->arena == NULL) {
+    dynarr_init_strTemplPart(parts, cap0);
+  }
+  else {
+    parts->data = arena_alloc(&st->arena->mem, cap0 * sizeof(strTemplPart));
+    parts->cap = cap0;
+    parts->len = 0;
+  }
+}
+static
+void partsPush(engine* st, dynarr_strTemplPart* parts, const strTemplPart* part) {
+  if (st->arena != NULL && parts->len == parts->cap) {
+    size_t cap = parts->cap == 0 ? 4 : 2 * parts->cap;
+    parts->data = arena_realloc(&st->arena->mem, parts->data, parts->cap * sizeof(strTemplPart), cap * sizeof(strTemplPart));
+    parts->cap = cap;
+  }
+  dynarr_push_strTemplPart(parts, part);
+}
+
+// A string eexpr records whether its text is borrowed from the input once, for all its parts together.
+// So, when the ownership of a new part disagrees with the parts before it, copy whichever side is borrowed.
+static
+str templPartText(engine* st, eexpr* out, const eexpr_token* tok) {
+  str text = tok->as.string.text;
+  // nothing is freed individually in arena mode, so there is no need to agree
+  if (st->arena != NULL || tok->borrowedText == out->borrowedText) { return text; }
+  if (tok->borrowedText) { return engine_keepStr(st, text); }
+  out->as.string.text1 = engine_keepStr(st, out->as.string.text1);
+  for (size_t i = 0; i < out->as.string.parts.len; ++i) {
+    strTemplPart* part = &out->as.string.parts.data[i];
+    str partText = {.len = part->nBytes, .bytes = part->utf8str};
+    part->utf8str = engine_keepStr(st, partText).bytes;
+  }
+  out->borrowedText = false;
+  return text;
+}
+
 static
 void mkUnbalanceError(engine* st) {
   if (st->fatal.type != EEXPR_ERR_NOERROR) { return; }
@@ -24,563 +87,521 @@ void mkUnbalanceError(engine* st) {
 }
 
 
-//////////////////////////////////// Individual Expression Parsers ////////////////////////////////////
-
-static eexpr* parseSemicolon(engine* st);
-static eexpr* parseSpace(engine* st);
+//////////////////////////////////// Expression Parser ////////////////////////////////////
 
 /*
 ```
+semicolonExpr ::= ';'? commaExpr (';' commaExpr)* ';'?
+commaExpr ::= ','? colonExpr (',' colonExpr)* ','?
+colonExpr ::= ellipsisExpr (':' ellipsisExpr?)?
+ellipsisExpr ::= spaceExpr? ('..' spaceExpr?)?
+spaceExpr ::= chainExpr (whitespace chainExpr)*
+
+chainExpr ::= predot? atomicExpr chainTail*
+chainTail
+  ::= chainDot atomicExpr
+   |  wrapExpr
+   |  stringTemplate
+
+atomicExpr
+  ::= symbol
+   |  number
+   |  codepoint
+   |  stringTemplate
+   |  wrapExpr
+
 wrapExpr
   ::= '(' semicolonExpr? ')'
    |  '[' semicolonExpr? ']'
    |  '{' semicolonExpr? '}'
    |  indent semicolonExpr (newline semicolonExpr)* dedent
+
+stringTemplate
+  ::= string.plain
+   |  string.open spaceExpr (string.middle spaceExpr)* string.close
 ```
+Note that `stringTemplate strTemplPart` is not a chainExpr, since the postlexer should already have detected it as crammed tokens.
+
+Rather than a parsing function per level that calls the next level up (which costs a call and a lookahead per level for every operand),
+  the whole grammar is parsed in one loop over an explicit stack (see `parseFrame`), by precedence climbing:
+  * to parse an operand, skip straight up to an atomic expression, only stopping at levels that have a leading operator,
+  * then, with the operand in hand, look up the level of the operator after it (if any) in a table:
+    if that level is still open (it is above the innermost frame, and below any frame that has just finished),
+      it gets a frame to gather its operands, and otherwise the operand is handed to the innermost frame.
+The levels an operand passes through without meeting their operator would only have returned it unchanged.
 */
+
+// Tokens that act as an operator at some level when they follow an operand.
+// Wraps and strings only continue a chain when they open (see `operatorLevel`).
+static const parseLevel operatorLevels[EEXPR_TOK_NONE + 1] =
+  { [EEXPR_TOK_SEMICOLON] = LEVEL_SEMICOLON
+  , [EEXPR_TOK_COMMA] = LEVEL_COMMA
+  , [EEXPR_TOK_COLON] = LEVEL_COLON
+  , [EEXPR_TOK_ELLIPSIS] = LEVEL_ELLIPSIS
+  , [EEXPR_TOK_SPACE] = LEVEL_SPACE
+  , [EEXPR_TOK_CHAIN] = LEVEL_CHAIN
+  , [EEXPR_TOK_WRAP] = LEVEL_CHAIN
+  , [EEXPR_TOK_STRING] = LEVEL_CHAIN
+  };
+
+// The level of the operator `tok` (if any) that could take `operand` (which may be missing) as its left-hand side.
+static inline
+parseLevel operatorLevel(const eexpr_token* tok, const eexpr* operand) {
+  // only an ellipsis may have nothing before it
+  if (operand == NULL) { return tok->type == EEXPR_TOK_ELLIPSIS ? LEVEL_ELLIPSIS : LEVEL_NONE; }
+  parseLevel level = operatorLevels[tok->type];
+  if (level == LEVEL_CHAIN) {
+    if (tok->type == EEXPR_TOK_WRAP && !tok->as.wrap.isOpen) { return LEVEL_NONE; }
+    if ( tok->type == EEXPR_TOK_STRING
+      && tok->as.string.splice != EEXPR_STRPLAIN
+      && tok->as.string.splice != EEXPR_STROPEN
+       ) { return LEVEL_NONE; }
+  }
+  return level;
+}
+
+static inline
+parseFrame* pushFrame(engine* st, parseFrameType type) {
+  parseFrame frame = {.type = type, .child = LEVEL_NONE, .hasFirst = false, .out = NULL, .expr1 = NULL};
+  dynarr_push_parseFrame(&st->parseStack, &frame);
+  return dynarr_peek_parseFrame(&st->parseStack);
+}
+
+static inline
+eexpr* newList(engine* st, eexpr_loc loc) {
+  eexpr* out = engine_alloc(st, sizeof(eexpr));
+  listInit(st, &out->as.list, 4);
+  out->loc = loc;
+  return out;
+}
+
 static
-eexpr* parseWrap(engine* st) {
-  eexpr_token* open = parser_peek(st);
-  if ( open->type != EEXPR_TOK_WRAP
-    || !open->as.wrap.isOpen
-     ) { return NULL; }
-  eexpr* out = malloc(sizeof(eexpr));
-  checkOom(out);
-  {
-    openWrap openInfo = {.loc = open->loc, .type = open->as.wrap.type};
-    switch (open->as.wrap.type) {
-      case EEXPR_WRAP_NULL: assert(false);
-      case EEXPR_WRAP_PAREN: {
-        dynarr_push_openWrap(&st->wrapStack, &openInfo);
-        out->type = EEXPR_PAREN;
-        goto nonIndent;
+eexpr* parseSemicolon(engine* st) {
+  dynarr_parseFrame* stack = &st->parseStack;
+  const size_t bottom = stack->len;
+  parseFrame* top = NULL; // the innermost frame, once there is one
+  parseLevel low = LEVEL_SEMICOLON; // the level the next operand starts at (the lowest level without a frame inside the innermost one)
+  eexpr* operand = NULL; // the expression most recently parsed
+  parseLevel high; // the highest level which can still take `operand` as its left-hand side
+  eexpr_token* tok;
+  descend: { // parse an operand, starting at level `low`
+    tok = parser_peek(st);
+    if (low <= LEVEL_SEMICOLON && tok->type == EEXPR_TOK_SEMICOLON) { // optional initial semicolon
+      top = pushFrame(st, FRAME_SEMICOLON);
+      top->out = newList(st, tok->loc);
+      top->child = low = LEVEL_COMMA;
+      parser_pop(st);
+      tok = parser_peek(st);
+    }
+    if (low <= LEVEL_COMMA && tok->type == EEXPR_TOK_COMMA) { // optional initial comma
+      top = pushFrame(st, FRAME_COMMA);
+      top->out = newList(st, tok->loc);
+      top->child = low = LEVEL_COLON;
+      parser_pop(st);
+      tok = parser_peek(st);
+    }
+    if (low <= LEVEL_SPACE && tok->type == EEXPR_TOK_SPACE) { // leading space
+      parser_pop(st);
+      tok = parser_peek(st);
+    }
+    if (low <= LEVEL_CHAIN && tok->type == EEXPR_TOK_PREDOT) {
+      top = pushFrame(st, FRAME_CHAIN);
+      top->out = engine_alloc(st, sizeof(eexpr));
+      top->out->type = EEXPR_PREDOT;
+      top->out->loc.start = tok->loc.start;
+      top->child = low = LEVEL_ATOMIC;
+      parser_pop(st);
+      tok = parser_peek(st);
+    }
+    switch (tok->type) {
+      case EEXPR_TOK_SYMBOL: {
+        operand = engine_alloc(st, sizeof(eexpr));
+        operand->loc = tok->loc;
+        operand->type = EEXPR_SYMBOL;
+        operand->borrowedText = tok->borrowedText;
+        operand->as.symbol = tok->as.symbol;
+        parser_pop(st);
       }; break;
-      case EEXPR_WRAP_BRACK: {
-        dynarr_push_openWrap(&st->wrapStack, &openInfo);
-        out->type = EEXPR_BRACK;
-        goto nonIndent;
+      case EEXPR_TOK_NUMBER: {
+        operand = engine_alloc(st, sizeof(eexpr));
+        operand->loc = tok->loc;
+        operand->type = EEXPR_NUMBER;
+        operand->undecoded = tok->undecoded;
+        if (tok->undecoded) {
+          operand->as.lazyNumber = tok->as.lazyNumber;
+        }
+        else {
+          operand->as.number = tok->as.number;
+        }
+        parser_pop(st);
       }; break;
-      case EEXPR_WRAP_BRACE: {
-        dynarr_push_openWrap(&st->wrapStack, &openInfo);
-        out->type = EEXPR_BRACE;
-        goto nonIndent;
+      case EEXPR_TOK_STRING: {
+        if (tok->as.string.splice == EEXPR_STRPLAIN) {
+          operand = engine_alloc(st, sizeof(eexpr));
+          operand->loc = tok->loc;
+          operand->type = EEXPR_STRING;
+          operand->borrowedText = tok->borrowedText;
+          operand->as.string.text1 = tok->as.string.text;
+          operand->as.string.parts.cap = 0;
+          operand->as.string.parts.len = 0;
+          operand->as.string.parts.data = NULL;
+          parser_pop(st);
+        }
+        else if (tok->as.string.splice == EEXPR_STROPEN) {
+          top = pushFrame(st, FRAME_TEMPLATE);
+          eexpr* out = top->out = engine_alloc(st, sizeof(eexpr));
+          out->loc = tok->loc;
+          out->type = EEXPR_STRING;
+          out->borrowedText = tok->borrowedText;
+          out->as.string.text1 = tok->as.string.text;
+          partsInit(st, &out->as.string.parts, 2);
+          openWrap info = {.loc = tok->loc, .type = '\"'};
+          dynarr_push_openWrap(&st->wrapStack, &info);
+          parser_pop(st);
+          goto templatePart;
+        }
+        else {
+          mkUnbalanceError(st);
+          operand = NULL;
+        }
       }; break;
-      case EEXPR_WRAP_BLOCK: {
+      case EEXPR_TOK_WRAP: {
+        if (!tok->as.wrap.isOpen) {
+          operand = NULL;
+          break;
+        }
+        openWrap openInfo = {.loc = tok->loc, .type = tok->as.wrap.type};
         dynarr_push_openWrap(&st->wrapStack, &openInfo);
-        out->type = EEXPR_BLOCK;
-        goto indent;
+        top = pushFrame(st, tok->as.wrap.type == EEXPR_WRAP_BLOCK ? FRAME_BLOCK : FRAME_WRAP);
+        eexpr* out = top->out = engine_alloc(st, sizeof(eexpr));
+        switch (tok->as.wrap.type) {
+          case EEXPR_WRAP_NULL: assert(false); break;
+          case EEXPR_WRAP_PAREN: out->type = EEXPR_PAREN; break;
+          case EEXPR_WRAP_BRACK: out->type = EEXPR_BRACK; break;
+          case EEXPR_WRAP_BRACE: out->type = EEXPR_BRACE; break;
+          case EEXPR_WRAP_BLOCK: {
+            out->type = EEXPR_BLOCK;
+            listInit(st, &out->as.list, 4);
+          }; break;
+        }
+        out->loc.start = tok->loc.start;
+        top->child = low = LEVEL_SEMICOLON;
+        parser_pop(st);
+        goto descend;
+      }; break;
+      default: {
+        operand = NULL;
       }; break;
     }
+    high = LEVEL_CHAIN;
+    goto ascend;
   } assert(false);
-  nonIndent: {
-    out->loc.start = open->loc.start;
-    parser_pop(st);
-    out->as.wrap = parseSemicolon(st);
-    eexpr_token* close = parser_peek(st);
-    if ( st->wrapStack.len != 0
-      && close->type == EEXPR_TOK_WRAP
-      && !close->as.wrap.isOpen
-      && close->as.wrap.type == dynarr_peek_openWrap(&st->wrapStack)->type
+  templatePart: { // `top` is a template, which needs an expression before its next part
+    // but if the next part comes without an expr, we can do some error recovery later
+    // we flag that recovery is needed by handing the template a NULL expr
+    tok = parser_peek(st);
+    if ( tok->type != EEXPR_TOK_STRING
+      || (tok->as.string.splice != EEXPR_STRMIDDLE && tok->as.string.splice != EEXPR_STRCLOSE)
        ) {
-      dynarr_pop_openWrap(&st->wrapStack);
-      out->loc.end = close->loc.end;
-      parser_pop(st);
+      top->child = low = LEVEL_SPACE;
+      goto descend;
+    }
+    operand = NULL;
+    goto resume;
+  } assert(false);
+  ascend: { // hand `operand` to the operator after it, or else to the innermost frame
+    tok = parser_peek(st);
+    parseLevel level = operatorLevel(tok, operand);
+    if (low <= level && level <= high) {
+      top = pushFrame(st, (parseFrameType)level);
+    }
+    else if (stack->len == bottom) {
+      return operand;
     }
     else {
-      out->loc.end = close->loc.start;
-      mkUnbalanceError(st);
+      top = dynarr_peek_parseFrame(stack);
     }
-    return out;
+    goto resume;
   } assert(false);
-  indent: {
-    out->loc.start = open->loc.start;
-    parser_pop(st);
-    dynarr_init_eexpr_p(&out->as.list, 4);
-    while (true) {
-      eexpr* subexpr = parseSemicolon(st);
-      if (subexpr != NULL) {
-        dynarr_push_eexpr_p(&out->as.list, &subexpr);
+  resume: switch (top->type) { // `top` takes `operand`, with `tok` just after it
+    case FRAME_SEMICOLON:
+    case FRAME_COMMA: {
+      eexpr_tokenType sep = top->type == FRAME_SEMICOLON ? EEXPR_TOK_SEMICOLON : EEXPR_TOK_COMMA;
+      eexpr* out = top->out;
+      if (operand == NULL) { // no further sub-expressions
+        if (out != NULL) {
+          out->type = top->type == FRAME_SEMICOLON ? EEXPR_SEMICOLON : EEXPR_COMMA;
+        }
+        operand = out;
+        goto finish;
       }
-      eexpr_token* lookahead = parser_peek(st);
-      if (lookahead->type == EEXPR_TOK_WRAP) {
-        if ( st->wrapStack.len != 0
-          && !lookahead->as.wrap.isOpen
-          && lookahead->as.wrap.type == dynarr_peek_openWrap(&st->wrapStack)->type
-           ) {
-          dynarr_pop_openWrap(&st->wrapStack);
-          out->loc.end = lookahead->loc.end;
+      else if (out != NULL) { // found a sub-expression, and we already have evidence of a separator
+        listPush(st, &out->as.list, operand);
+        if (tok->type == sep) { // there's also a separator afterwards to be consumed
+          out->loc.end = tok->loc.end;
           parser_pop(st);
         }
         else {
-          out->loc.end = lookahead->loc.start;
-          mkUnbalanceError(st);
+          out->loc.end = operand->loc.end;
         }
-        return out;
       }
-      else if (lookahead->type == EEXPR_TOK_NEWLINE) {
+      else if (tok->type == sep) { // found a sub-expression, and the first evidence of a separator
+        out = top->out = newList(st, operand->loc);
+        listPush(st, &out->as.list, operand);
+        out->loc.end = tok->loc.end;
         parser_pop(st);
       }
-      else {
-        eexpr_error err = {.loc = lookahead->loc, .type = EEXPR_ERR_EXPECTING_NEWLINE_OR_DEDENT};
-        dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
-        return out;
+      else { // found a sub-expression, with no evidence of a separator before, and no evidence of a separator after
+        goto finish;
       }
-    }
-  }; assert(false);
-}
-
-/*
-```
-stringTemplate
-  ::= string.plain
-   |  string.open spaceExpr (string.middle spaceExpr)* string.close
-```
-*/
-static
-eexpr* parseTemplate(engine* st) {
-  eexpr_token* tok = parser_peek(st);
-  if (tok->type != EEXPR_TOK_STRING) { return NULL; }
-  switch (tok->as.string.splice) {
-    case EEXPR_STRPLAIN: {
-      eexpr* out = malloc(sizeof(eexpr));
-      checkOom(out);
-      out->loc = tok->loc;
-      out->type = EEXPR_STRING;
-      out->as.string.text1 = tok->as.string.text;
-      out->as.string.parts.cap = 0;
-      out->as.string.parts.len = 0;
-      out->as.string.parts.data = NULL;
-      parser_pop(st);
-      return out;
+      top->child = low = (parseLevel)(top->type + 1);
+      goto descend;
     }; break;
-    case EEXPR_STROPEN: {
-      eexpr* out = malloc(sizeof(eexpr));
-      checkOom(out);
-      { // initialize output buffer
-        out->loc = tok->loc;
-        out->type = EEXPR_STRING;
-        out->as.string.text1 = tok->as.string.text;
-        dynarr_init_strTemplPart(&out->as.string.parts, 2);
-      }
-      { // push to wrapStack
-        openWrap info = {.loc = tok->loc, .type = '\"'};
-        dynarr_push_openWrap(&st->wrapStack, &info);
+    case FRAME_COLON: {
+      if (!top->hasFirst) {
+        top->hasFirst = true;
+        top->expr1 = operand;
+        top->loc = tok->loc;
+        top->child = low = LEVEL_ELLIPSIS;
+        parser_pop(st);
+        goto descend;
       }
-      parser_pop(st);
-      while (true) {
-        strTemplPart part;
-        { // we need an expr before the next part of the template
-          // but if the next part comes without an expr, we can do some error recovery later
-          // we flag that recovery is needed by setting part.expr to NULL
-          eexpr_token* lookahead = parser_peek(st);
-          if ( lookahead->type != EEXPR_TOK_STRING
-            || (lookahead->as.string.splice != EEXPR_STRMIDDLE && lookahead->as.string.splice != EEXPR_STRCLOSE)
-             ) {
-            part.subexpr = parseSpace(st);
-          }
-          else {
-            part.subexpr = NULL;
-          }
-        }
-        eexpr_token* lookahead = parser_peek(st);
-        if (part.subexpr != NULL) {
-          out->loc.end = part.subexpr->loc.end;
-        }
-        else {
-          eexpr_error err =
-            { .loc = {.start = out->loc.end, .end = lookahead->loc.start}
-            , .type = EEXPR_ERR_MISSING_TEMPLATE_EXPR
-            };
-          if ( lookahead->type == EEXPR_TOK_STRING
-            && (lookahead->as.string.splice == EEXPR_STRMIDDLE || lookahead->as.string.splice == EEXPR_STRCLOSE)
-             ) {
-            dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
-          }
-          else {
-            st->fatal = err;
-            return out;
-          }
-        }
-        if (lookahead->type == EEXPR_TOK_STRING) {
-          { // append last template part
-            part.nBytes = lookahead->as.string.text.len;
-            part.utf8str = lookahead->as.string.text.bytes;
-            dynarr_push_strTemplPart(&out->as.string.parts, &part);
-            out->loc.end = lookahead->loc.end;
-          }
-          // ensure we are expecting a close string
-          if (st->wrapStack.len == 0 || dynarr_peek_openWrap(&st->wrapStack)->type != '\"') {
-            out->loc.end = lookahead->loc.start;
-            mkUnbalanceError(st);
-            return out;
-          }
-          else { // ensure the splice type makes sense
-            if (lookahead->as.string.splice == EEXPR_STRCLOSE) {
-              dynarr_pop_openWrap(&st->wrapStack);
-              parser_pop(st);
-              return out;
-            }
-            else if (lookahead->as.string.splice == EEXPR_STRMIDDLE) {
-              parser_pop(st);
-            }
-            else { assert(false); }
-          }
-        }
-        else {
-          if (part.subexpr != NULL) {
-            part.nBytes = 0; part.utf8str = NULL;
-            dynarr_push_strTemplPart(&out->as.string.parts, &part);
-          }
-          eexpr_error err =
-            { .loc = {.start = out->loc.end, .end = lookahead->loc.start}
-            , .type = EEXPR_ERR_MISSING_CLOSE_TEMPLATE
-            };
-          dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
-          return out;
-        }
+      eexpr* expr1 = top->expr1;
+      if (operand == NULL) {
+        expr1->loc.end = top->loc.end;
+        operand = expr1;
+        goto finish;
       }
-      assert(false);
-    }; break;
-    default: {
-      mkUnbalanceError(st);
-      return NULL;
-    }; break;
-  }
-}
-
-/*
-```
-atomicExpr
-  ::= symbol
-   |  number
-   |  codepoint
-   |  stringTemplate
-   |  wrapExpr
-```
-*/
-static
-eexpr* parseAtomic(engine* st) {
-  eexpr_token* tok = parser_peek(st);
-  switch (tok->type) {
-    case EEXPR_TOK_SYMBOL: {
-      eexpr* out = malloc(sizeof(eexpr));
-      checkOom(out);
-      out->loc = tok->loc;
-      out->type = EEXPR_SYMBOL;
-      out->as.symbol = tok->as.symbol;
-      parser_pop(st);
-      return out;
+      eexpr* out = engine_alloc(st, sizeof(eexpr));
+      out->type = EEXPR_COLON;
+      out->loc.start = expr1->loc.start;
+      out->loc.end = operand->loc.end;
+      out->as.pair[0] = expr1;
+      out->as.pair[1] = operand;
+      operand = out;
+      goto finish;
     }; break;
-    case EEXPR_TOK_NUMBER: {
-      eexpr* out = malloc(sizeof(eexpr));
-      checkOom(out);
-      out->loc = tok->loc;
-      out->type = EEXPR_NUMBER;
-      out->as.number = tok->as.number;
-      parser_pop(st);
-      return out;
-    }; break;
-    case EEXPR_TOK_STRING: {
-      return parseTemplate(st);
-    }; break;
-    case EEXPR_TOK_WRAP: {
-      return parseWrap(st);
+    case FRAME_ELLIPSIS: {
+      if (!top->hasFirst) {
+        top->hasFirst = true;
+        top->expr1 = operand;
+        top->loc = tok->loc;
+        top->child = low = LEVEL_SPACE;
+        parser_pop(st);
+        goto descend;
+      }
+      eexpr* out = engine_alloc(st, sizeof(eexpr));
+      out->type = EEXPR_ELLIPSIS;
+      out->loc.start = (top->expr1 == NULL ? top->loc : top->expr1->loc).start;
+      out->loc.end = (operand == NULL ? top->loc : operand->loc).end;
+      out->as.ellipsis[0] = top->expr1;
+      out->as.ellipsis[1] = operand;
+      operand = out;
+      goto finish;
     }; break;
-    default: {
-      return NULL;
-    }
-  }
-}
-
-/*
-```
-chainExpr ::= atomicExpr chainTail*
-chainTail
-  ::= chainDot atomicExpr
-   |  wrapExpr
-   |  stringTemplate
-```
-Note that `stringTemplate strTemplPart` is not a chainExpr, since the postlexer should already have detected it as crammed tokens.
-*/
-static
-eexpr* parseChain(engine* st) {
-  eexpr* predot = NULL;
-  { // check if this is a predot expression
-    eexpr_token* lookahead = parser_peek(st);
-    if (lookahead->type == EEXPR_TOK_PREDOT) {
-      predot = malloc(sizeof(eexpr));
-      checkOom(predot);
-      predot->type = EEXPR_PREDOT;
-      predot->loc.start = lookahead->loc.start;
-      parser_pop(st);
-    }
-  }
-  eexpr* chain = NULL;
-  {
-    { // get the first expression and look for a following dot
-      eexpr* expr1 = parseAtomic(st);
-      if (expr1 == NULL) {
+    case FRAME_SPACE: {
+      // the output is only allocated once we know there is more than one subexpr
+      if (!top->hasFirst) {
+        top->hasFirst = true;
+        top->expr1 = operand;
+      }
+      else if (operand != NULL) {
+        if (top->out == NULL) {
+          top->out = newList(st, top->expr1->loc);
+          top->out->type = EEXPR_SPACE;
+          listPush(st, &top->out->as.list, top->expr1);
+        }
+        listPush(st, &top->out->as.list, operand);
+        top->out->loc.end = operand->loc.end;
+      }
+      if (operand == NULL || tok->type != EEXPR_TOK_SPACE) {
+        // TODO shrink the list? and all other lists generated by the parser?
+        operand = top->out != NULL ? top->out : top->expr1;
         goto finish;
       }
-      eexpr_token* lookahead = parser_peek(st);
-      if ( lookahead->type == EEXPR_TOK_CHAIN
-        || (lookahead->type == EEXPR_TOK_WRAP && lookahead->as.wrap.isOpen)
-        || ( lookahead->type == EEXPR_TOK_STRING
-          && (lookahead->as.string.splice == EEXPR_STRPLAIN || lookahead->as.string.splice == EEXPR_STROPEN)
-           )
-         ) {
-        chain = malloc(sizeof(eexpr));
-        checkOom(chain);
+      top->child = low = LEVEL_CHAIN;
+      parser_pop(st);
+      goto descend;
+    }; break;
+    case FRAME_CHAIN: {
+      eexpr* chain = top->expr1;
+      if (operand == NULL) { goto chainDone; }
+      if (!top->hasFirst) { // look for a following dot
+        if (operatorLevel(tok, operand) != LEVEL_CHAIN) {
+          chain = operand;
+          goto chainDone;
+        }
+        top->hasFirst = true;
+        chain = top->expr1 = engine_alloc(st, sizeof(eexpr));
         chain->type = EEXPR_CHAIN;
-        chain->loc = expr1->loc;
-        if (lookahead->type == EEXPR_TOK_CHAIN) {
-          chain->loc.end = lookahead->loc.end;
+        chain->loc = operand->loc;
+        if (tok->type == EEXPR_TOK_CHAIN) {
+          chain->loc.end = tok->loc.end;
           parser_pop(st);
         }
-        dynarr_init_eexpr_p(&chain->as.list, 4);
-        dynarr_push_eexpr_p(&chain->as.list, &expr1);
+        listInit(st, &chain->as.list, 4);
+        listPush(st, &chain->as.list, operand);
       }
       else {
-        chain = expr1;
-        goto finish;
-      }
-    }
-    while (true) { // get further chained expressions
-      eexpr* next = parseAtomic(st);
-      if (next == NULL) { goto finish; }
-      dynarr_push_eexpr_p(&chain->as.list, &next);
-      eexpr_token* lookahead = parser_peek(st);
-      if (lookahead->type == EEXPR_TOK_CHAIN) {
-        // continue the chain when there's another chain dot
-        chain->loc.end = lookahead->loc.end;
-        parser_pop(st);
-      }
-      else if (lookahead->type == EEXPR_TOK_WRAP && lookahead->as.wrap.isOpen) {
-        // continue the chain when there's an open paren/brace/brack/indent
-        chain->loc.end = next->loc.end;
-      }
-      else if ( lookahead->type == EEXPR_TOK_STRING
-             && (lookahead->as.string.splice == EEXPR_STRPLAIN || lookahead->as.string.splice == EEXPR_STROPEN)
-              ) {
-        // continue the chain when there's the start of a string
-        chain->loc.end = next->loc.end;
+        listPush(st, &chain->as.list, operand);
+        if (tok->type == EEXPR_TOK_CHAIN) {
+          // continue the chain when there's another chain dot
+          chain->loc.end = tok->loc.end;
+          parser_pop(st);
+        }
+        else {
+          // or continue the chain when there's an open paren/brace/brack/indent or the start of a string
+          chain->loc.end = operand->loc.end;
+          if (operatorLevel(tok, operand) != LEVEL_CHAIN) { goto chainDone; }
+        }
       }
-      else {
-        chain->loc.end = next->loc.end;
+      top->child = low = LEVEL_ATOMIC;
+      goto descend;
+      chainDone: {
+        eexpr* predot = top->out;
+        if (predot == NULL) {
+          operand = chain;
+        }
+        else {
+          predot->loc.end = chain->loc.end;
+          predot->as.wrap = chain;
+          operand = predot;
+        }
         goto finish;
       }
-    }
-  } assert(false);
-  finish: {
-    if (predot == NULL && chain == NULL) {
-      return NULL;
-    }
-    else if (predot == NULL) {
-      return chain;
-    }
-    else {
-      predot->loc.end = chain->loc.end;
-      predot->as.wrap = chain;
-      return predot;
-    }
-  } assert(false);
-}
-
-/*
-spaceExpr ::= chainExpr (whitespace chainExpr)*
-*/
-static
-eexpr* parseSpace(engine* st) {
-  if (parser_peek(st)->type == EEXPR_TOK_SPACE) {
-    parser_pop(st);
-  }
-  eexpr* expr1 = parseChain(st);
-  if (expr1 == NULL) { return NULL; }
-  eexpr* out = malloc(sizeof(eexpr));
-  { // prepare the output
-    checkOom(out);
-    out->loc.start = expr1->loc.start;
-    out->loc.end = expr1->loc.end;
-    out->type = EEXPR_SPACE;
-    dynarr_init_eexpr_p(&out->as.list, 4);
-    dynarr_push_eexpr_p(&out->as.list, &expr1);
-  }
-  while (true) {
-    eexpr_token* lookahead = parser_peek(st);
-    if (lookahead->type == EEXPR_TOK_SPACE) {
-      parser_pop(st);
-      eexpr* next = parseChain(st);
-      if (next != NULL) {
-        dynarr_push_eexpr_p(&out->as.list, &next);
-        out->loc.end = next->loc.end;
+    }; break;
+    case FRAME_WRAP: {
+      eexpr* out = top->out;
+      out->as.wrap = operand;
+      if ( st->wrapStack.len != 0
+        && tok->type == EEXPR_TOK_WRAP
+        && !tok->as.wrap.isOpen
+        && tok->as.wrap.type == dynarr_peek_openWrap(&st->wrapStack)->type
+         ) {
+        dynarr_pop_openWrap(&st->wrapStack);
+        out->loc.end = tok->loc.end;
+        parser_pop(st);
       }
       else {
-        goto output;
+        out->loc.end = tok->loc.start;
+        mkUnbalanceError(st);
       }
-    }
-    else{
-      goto output;
-    }
-  } assert(false);
-  output: {
-    if (out->as.list.len == 1) {
-      dynarr_deinit_eexpr_p(&out->as.list);
-      free(out);
-      return expr1;
-    }
-    else {
-      // TODO shrink the list? and all other lists generated by the parser?
-      return out;
-    }
-  } assert(false);
-}
-
-static
-eexpr* parseEllipsis(engine* st) {
-  eexpr* expr1 = parseSpace(st);
-  eexpr_token* lookahead = parser_peek(st);
-  if (lookahead->type == EEXPR_TOK_ELLIPSIS) {
-    eexpr_loc dotsLoc = lookahead->loc;
-    parser_pop(st);
-    eexpr* expr2 = parseSpace(st);
-    eexpr* out = malloc(sizeof(eexpr));
-    checkOom(out);
-    out->type = EEXPR_ELLIPSIS;
-    out->loc.start = (expr1 == NULL ? dotsLoc : expr1->loc).start;
-    out->loc.end = (expr2 == NULL ? dotsLoc : expr2->loc).end;
-    out->as.ellipsis[0] = expr1;
-    out->as.ellipsis[1] = expr2;
-    return out;
-  }
-  else {
-    return expr1;
-  }
-}
-
-static
-eexpr* parseColon(engine* st) {
-  eexpr* expr1 = parseEllipsis(st);
-  eexpr_token* colon = parser_peek(st);
-  if (colon->type != EEXPR_TOK_COLON) {
-    return expr1;
-  }
-  else {
-    eexpr_loc colonLoc = colon->loc;
-    parser_pop(st);
-    eexpr* expr2 = parseEllipsis(st);
-    if (expr2 == NULL) {
-      expr1->loc.end = colonLoc.end;
-      return expr1;
-    }
-    eexpr* out = malloc(sizeof(eexpr));
-    checkOom(out);
-    out->type = EEXPR_COLON;
-    out->loc.start = expr1->loc.start;
-    out->loc.end = expr2->loc.end;
-    out->as.pair[0] = expr1;
-    out->as.pair[1] = expr2;
-    return out;
-  }
-}
-
-static
-eexpr* parseComma(engine* st) {
-  eexpr* out = NULL;
-  { // optional initial comma
-    eexpr_token* maybeComma = parser_peek(st);
-    if (maybeComma->type == EEXPR_TOK_COMMA) {
-      out = malloc(sizeof(eexpr));
-      checkOom(out);
-      dynarr_init_eexpr_p(&out->as.list, 4);
-      out->loc = maybeComma->loc;
-      parser_pop(st);
-    }
-  }
-  while (true) {
-    eexpr* tmp = parseColon(st);
-    eexpr_token* lookahead = parser_peek(st);
-    if (tmp == NULL) { // no further sub-expressions
-      if (out != NULL) {
-        out->type = EEXPR_COMMA;
-        return out;
+      operand = out;
+      goto finish;
+    }; break;
+    case FRAME_BLOCK: {
+      eexpr* out = top->out;
+      if (operand != NULL) {
+        listPush(st, &out->as.list, operand);
       }
-      else {
-        return NULL;
+      if (tok->type == EEXPR_TOK_WRAP) {
+        if ( st->wrapStack.len != 0
+          && !tok->as.wrap.isOpen
+          && tok->as.wrap.type == dynarr_peek_openWrap(&st->wrapStack)->type
+           ) {
+          dynarr_pop_openWrap(&st->wrapStack);
+          out->loc.end = tok->loc.end;
+          parser_pop(st);
+        }
+        else {
+          out->loc.end = tok->loc.start;
+          mkUnbalanceError(st);
+        }
       }
-    }
-    else if (out != NULL) { // found a sub-expression, and we already have evidence of a comma
-      dynarr_push_eexpr_p(&out->as.list, &tmp);
-      if (lookahead->type == EEXPR_TOK_COMMA) { // there's also comma afterwards to be consumed
-        out->loc.end = lookahead->loc.end;
+      else if (tok->type == EEXPR_TOK_NEWLINE) {
         parser_pop(st);
+        goto descend;
       }
       else {
-        out->loc.end = tmp->loc.end;
+        out->loc.end = tok->loc.start;
+        eexpr_error err = {.loc = tok->loc, .type = EEXPR_ERR_EXPECTING_NEWLINE_OR_DEDENT};
+        dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
       }
-    }
-    else if (lookahead->type == EEXPR_TOK_COMMA) { // found a sub-expression, and the first evidence of a comma
-      out = malloc(sizeof(eexpr));
-      checkOom(out);
-      dynarr_init_eexpr_p(&out->as.list, 4);
-      dynarr_push_eexpr_p(&out->as.list, &tmp);
-      out->loc.start = tmp->loc.start;
-      out->loc.end = lookahead->loc.end;
-      parser_pop(st);
-    }
-    else { // found a sub-expression, with no evidence of a comma before, and no evidence of a comma after
-      return tmp;
-    }
-  }
-}
-
-static
-eexpr* parseSemicolon(engine* st) {
-  eexpr* out = NULL;
-  { // optional initial semicolon
-    eexpr_token* maybeSemi = parser_peek(st);
-    if (maybeSemi->type == EEXPR_TOK_SEMICOLON) {
-      out = malloc(sizeof(eexpr));
-      checkOom(out);
-      dynarr_init_eexpr_p(&out->as.list, 4);
-      out->loc = maybeSemi->loc;
-      parser_pop(st);
-    }
-  }
-  while (true) {
-    eexpr* tmp = parseComma(st);
-    eexpr_token* lookahead = parser_peek(st);
-    if (tmp == NULL) { // no further sub-expressions
-      if (out != NULL) {
-        out->type = EEXPR_SEMICOLON;
-        return out;
+      operand = out;
+      goto finish;
+    }; break;
+    case FRAME_TEMPLATE: {
+      eexpr* out = top->out;
+      strTemplPart part = {.subexpr = operand};
+      if (part.subexpr != NULL) {
+        out->loc.end = part.subexpr->loc.end;
       }
       else {
-        return NULL;
+        eexpr_error err =
+          { .loc = {.start = out->loc.end, .end = tok->loc.start}
+          , .type = EEXPR_ERR_MISSING_TEMPLATE_EXPR
+          };
+        if ( tok->type == EEXPR_TOK_STRING
+          && (tok->as.string.splice == EEXPR_STRMIDDLE || tok->as.string.splice == EEXPR_STRCLOSE)
+           ) {
+          dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
+        }
+        else {
+          st->fatal = err;
+          operand = out;
+          goto finish;
+        }
       }
-    }
-    else if (out != NULL) { // found a sub-expression, and we already have evidence of a semicolon
-      dynarr_push_eexpr_p(&out->as.list, &tmp);
-      if (lookahead->type == EEXPR_TOK_SEMICOLON) { // there's also semicolon afterwards to be consumed
-        out->loc.end = lookahead->loc.end;
-        parser_pop(st);
+      if (tok->type == EEXPR_TOK_STRING) {
+        { // append last template part
+          str text = templPartText(st, out, tok);
+          part.nBytes = text.len;
+          part.utf8str = text.bytes;
+          partsPush(st, &out->as.string.parts, &part);
+          out->loc.end = tok->loc.end;
+        }
+        operand = out;
+        // ensure we are expecting a close string
+        if (st->wrapStack.len == 0 || dynarr_peek_openWrap(&st->wrapStack)->type != '\"') {
+          // the token is not popped, but its text now belongs to `out`
+          tok->as.string.text.bytes = NULL;
+          out->loc.end = tok->loc.start;
+          mkUnbalanceError(st);
+          goto finish;
+        }
+        else { // ensure the splice type makes sense
+          if (tok->as.string.splice == EEXPR_STRCLOSE) {
+            dynarr_pop_openWrap(&st->wrapStack);
+            parser_pop(st);
+            goto finish;
+          }
+          else if (tok->as.string.splice == EEXPR_STRMIDDLE) {
+            parser_pop(st);
+          }
+          else { assert(false); }
+          goto templatePart;
+        }
       }
       else {
-        out->loc.end = tmp->loc.end;
+        if (part.subexpr != NULL) {
+          part.nBytes = 0; part.utf8str = NULL;
+          partsPush(st, &out->as.string.parts, &part);
+        }
+        eexpr_error err =
+          { .loc = {.start = out->loc.end, .end = tok->loc.start}
+          , .type = EEXPR_ERR_MISSING_CLOSE_TEMPLATE
+          };
+        dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
+        operand = out;
+        goto finish;
       }
+    }; break;
+  } assert(false);
+  finish: { // `operand` is the result of `top`, which is done
+    // an operator level is done once the token after it is not one of its own, so only the levels below it can still take the result
+    // whereas wraps and templates are atomic expressions, which may be followed by an operator at any level
+    high = top->type <= FRAME_CHAIN ? (parseLevel)(top->type - 1) : LEVEL_CHAIN;
+    dynarr_pop_parseFrame(stack);
+    if (stack->len == bottom) {
+      top = NULL;
+      low = LEVEL_SEMICOLON;
     }
-    else if (lookahead->type == EEXPR_TOK_SEMICOLON) { // found a sub-expression, and the first evidence of a semicolon
-      out = malloc(sizeof(eexpr));
-      checkOom(out);
-      dynarr_init_eexpr_p(&out->as.list, 4);
-      dynarr_push_eexpr_p(&out->as.list, &tmp);
-      out->loc.start = tmp->loc.start;
-      out->loc.end = lookahead->loc.end;
-      parser_pop(st);
-    }
-    else { // found a sub-expression, with no evidence of a semicolon before, and no evidence of a semicolon after
-      return tmp;
+    else {
+      top = dynarr_peek_parseFrame(stack);
+      low = top->child;
     }
-  }
+    goto ascend;
+  } assert(false);
 }
 
 //////////////////////////////////// Main Parser ////////////////////////////////////
@@ -589,7 +610,12 @@ static
 void parseLine(engine* st) {
   eexpr* line = parseSemicolon(st);
   if (line != NULL) {
+    if (st->onEexpr == NULL) {
       dynarr_push_eexpr_p(&st->eexprStream, &line);
+    }
+    else if (!st->onEexpr(st->onEexprCtx, line) && st->arena == NULL) {
+      eexpr_del(line);
+    }
   }
   else {
     size_t depth = 0; { // count up how many dedents we currently expect, then reset the wrapStack
@@ -641,8 +667,10 @@ void parseLine(engine* st) {
 }
 
 void engine_parse(engine* st) {
-  bool atStart = true;
+  // the parser only ever stops early after a line, so if it has taken any tokens, it has already parsed the first line
+  bool atStart = st->parsePos == 0;
   while (st->fatal.type == EEXPR_ERR_NOERROR) {
+    size_t from = st->parsePos;
     eexpr_token* lookahead = parser_peek(st);
     switch (lookahead->type) {
       case EEXPR_TOK_NEWLINE: {
@@ -668,5 +696,23 @@ void engine_parse(engine* st) {
         }
       } break;
     }
+    // between top-level lines, the parse stack is empty, so this is a fine place to stop
+    if (engine_spend(st, st->parsePos - from)) { return; }
+  }
+}
+
+eexpr* engine_parseFragment(engine* st) {
+  eexpr* out = parseSemicolon(st);
+  if (st->fatal.type != EEXPR_ERR_NOERROR) { return out; }
+  eexpr_token* lookahead = parser_peek(st);
+  if (lookahead->type == EEXPR_TOK_EOF) { return out; }
+  if (lookahead->type == EEXPR_TOK_WRAP && !lookahead->as.wrap.isOpen) {
+    mkUnbalanceError(st);
+  }
+  else {
+    // e.g. a second line, or a comma or semicolon that nothing can follow
+    eexpr_error err = {.loc = lookahead->loc, .type = EEXPR_ERR_EXPECTING_END_OF_FRAGMENT};
+    dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
   }
+  return out;
 }
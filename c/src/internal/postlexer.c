@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "common.h"
 #include "engine.h"
@@ -7,38 +9,191 @@
 #define TYPE size_t
 #include "dynarr.h"
 
+/*
+The postlexer is a sequence of rewrite stages, but rather than have each stage walk the whole token stream in turn,
+  all stages run together in a single forward sweep.
+The sweep works in place: raw tokens are pulled from the lexer's token stream into the cooked prefix of that same array,
+  and each stage keeps a cursor into the cooked prefix which trails the cursor of the stage before it.
+A stage only steps over a token once the previous stage has finished with everything the step needs to look at,
+  which is at most a couple of non-transparent tokens ahead (plus whatever transparent tokens lie between).
+Thus, each stage sees exactly the token stream it would have seen if the stages had been run one after another,
+  but the working set is a small window at the end of the cooked prefix rather than the whole file.
+
+Some consequences of this arrangement that the stages rely on:
+  - a stage never modifies a token behind its own cursor, with the exception of `ignoreTrailingStuff`,
+      which modifies the token just before its cursor; it is held back by one token for that reason,
+  - so, the previous non-transparent token that a stage saw can be remembered (`cookStage.prevType`) instead of searched for,
+  - tokens are only ever inserted at or after the cursor of the inserting stage, and before the cursors of the stages before it.
+*/
+
+// The stages, in the order that they see each token.
+// `ensureTrailingNewline` isn't in here because it only needs to look at the raw token stream once.
+typedef enum cookStageId {
+  IGNORE_TRAILING_STUFF,
+  IGNORE_BLANK_LINES,
+  DISAMBIGUATE_COLONS,
+  DETECT_INDENTATION,
+  DISAMBIGUATE_SPACES,
+  IGNORE_WRAPPED_SPACES,
+  DISAMBIGUATE_DOTS,
+  DETECT_CRAMMING,
+  N_COOK_STAGES
+} cookStageId;
+_Static_assert(N_COOK_STAGES == ENGINE_N_COOK_STAGES, "engine.h is out of step with the postlexer stages");
+
+// results of `lookNext`
+#define LOOK_WAIT SIZE_MAX // the next non-transparent token is not yet available to the stage
+#define LOOK_NONE (SIZE_MAX - 1) // there is no next non-transparent token
+
+typedef struct cookStage {
+  size_t pos; // index in the output of the next token this stage will step over
+  bool done; // set once the stage has stepped over every token
+  bool skip; // set when the stage could not change anything, so it just passes each token on as soon as it is available
+  eexpr_tokenType prevType; // type of the last non-transparent token stepped over, or EEXPR_TOK_NONE at start of file
+  // When a step has to wait for more input, remember how far ahead it has already scanned,
+  //   so that waiting on a long run of transparent tokens doesn't make the sweep quadratic.
+  // A step may look ahead from at most two different tokens, hence two entries.
+  struct lookMemo {
+    size_t from; // the index lookahead started after, or SIZE_MAX when unused
+    size_t upTo; // every token in (from, upTo) is known to be transparent
+  } memo[2];
+  dllist_eexpr_error errs; // owned, errors are collected per-stage so that they come out in the same order as separate passes would produce
+} cookStage;
+
+// The token stream is laid out as `[cooked tokens][gap][raw tokens not yet pulled]`.
+// Inserting a token uses up the gap; when the gap is empty, the remaining raw tokens are shifted further back to make more.
+typedef struct cooker {
+  engine* st;
+  eexpr_token* toks; // aliases `st->tokStream.data`, but changes whenever that array is reallocated
+  size_t outLen; // number of cooked tokens
+  size_t nPulled; // index of the first raw token not yet pulled
+  cookStage stages[N_COOK_STAGES];
+  dynarr_size_t depths; // owned, the indentation stack for `detectIndentation`
+} cooker;
+
+// how many raw tokens to pull before giving every stage a chance to catch up
+#define COOK_PULL_BATCH 64
+
+
+//////////////////////////////////// Stage Bookkeeping ////////////////////////////////////
+
+static
+bool upstreamDone(const cooker* ck, cookStageId k) {
+  return k == 0
+       ? ck->nPulled == ck->st->tokStream.len
+       : ck->stages[k-1].done
+       ;
+}
+
+// Every token before the returned index is finished with by stage `k`.
+static
+size_t released(const cooker* ck, cookStageId k) {
+  const cookStage* sg = &ck->stages[k];
+  if (sg->done) { return ck->outLen; }
+  // `ignoreTrailingStuff` may still modify the token just before its cursor
+  if (k == IGNORE_TRAILING_STUFF) { return sg->pos == 0 ? 0 : sg->pos - 1; }
+  return sg->pos;
+}
+
+// the tokens stage `k` is allowed to look at are those before this index
 static
-dllistNode_eexpr_token* getPrev(dllistNode_eexpr_token* tok) {
-  if (tok == NULL) { return NULL; }
-  do {
-    tok = tok->prev;
-  } while (tok != NULL && tok->here.transparent);
-  return tok;
+size_t available(const cooker* ck, cookStageId k) {
+  return k == 0 ? ck->outLen : released(ck, k-1);
+}
+
+static
+void clearMemos(cookStage* sg) {
+  sg->memo[0].from = SIZE_MAX;
+  sg->memo[1].from = SIZE_MAX;
+}
+
+// Find the index of the first non-transparent token after index `i`, as seen by stage `k`.
+// Returns `LOOK_WAIT` if that can't be known until earlier stages have made more progress.
+static
+size_t lookNext(cooker* ck, cookStageId k, size_t i) {
+  cookStage* sg = &ck->stages[k];
+  struct lookMemo* memo = NULL;
+  for (int m = 0; m < 2; ++m) {
+    if (sg->memo[m].from == i) { memo = &sg->memo[m]; }
+  }
+  size_t j = memo == NULL ? i + 1 : memo->upTo;
+  size_t end = available(ck, k);
+  for (; j < end; ++j) {
+    if (!ck->toks[j].transparent) { return j; }
+  }
+  if (upstreamDone(ck, k)) { return LOOK_NONE; }
+  if (memo == NULL) {
+    memo = sg->memo[0].from == SIZE_MAX ? &sg->memo[0] : &sg->memo[1];
+    memo->from = i;
+  }
+  memo->upTo = j;
+  return LOOK_WAIT;
+}
+
+static
+void makeGap(cooker* ck) {
+  dynarr_eexpr_token* strm = &ck->st->tokStream;
+  size_t nRaw = strm->len - ck->nPulled;
+  // growing the gap in proportion to what's left means the raw tokens are only shifted a few times in total
+  size_t gap = nRaw / 8 + 16;
+  if (strm->len + gap > strm->cap) {
+    engine_growTokens(ck->st, strm->len + gap);
+    ck->toks = strm->data;
+  }
+  memmove(&ck->toks[ck->nPulled + gap], &ck->toks[ck->nPulled], nRaw * sizeof(eexpr_token));
+  ck->nPulled += gap;
+  strm->len += gap;
+}
+
+// Insert a token into the cooked tokens just before index `point`, on behalf of stage `k`.
+// Any pointers into the token stream are invalidated.
+static
+void insertBefore(cooker* ck, cookStageId k, size_t point, const eexpr_token* tok) {
+  assert(point <= ck->outLen);
+  if (ck->outLen == ck->nPulled) { makeGap(ck); }
+  memmove(&ck->toks[point + 1], &ck->toks[point], (ck->outLen - point) * sizeof(eexpr_token));
+  ck->outLen += 1;
+  ck->toks[point] = *tok;
+  ck->toks[point].transparent = false;
+  // the inserting stage, and the (further ahead) stages before it, must not see the insertion shift their tokens out from under them
+  // the stages after it are all at or before `point`, and will step over the new token in due course
+  for (cookStageId j = 0; j <= k; ++j) {
+    cookStage* sg = &ck->stages[j];
+    if (sg->pos >= point) { sg->pos += 1; }
+    for (int m = 0; m < 2; ++m) {
+      if (sg->memo[m].from == SIZE_MAX) { continue; }
+      if (sg->memo[m].from >= point) { sg->memo[m].from += 1; }
+      if (sg->memo[m].upTo >= point) { sg->memo[m].upTo += 1; }
+    }
+  }
 }
 
 static
-dllistNode_eexpr_token* getNext(dllistNode_eexpr_token* tok) {
-  if (tok == NULL) { return NULL; }
-  do {
-    tok = tok->next;
-  } while (tok != NULL && tok->here.transparent);
-  return tok;
+void addError(cooker* ck, cookStageId k, eexpr_error err) {
+  dllist_insertAfter_eexpr_error(&ck->stages[k].errs, NULL, &err);
 }
 
+
+//////////////////////////////////// Stages ////////////////////////////////////
+
+// Each stage is a step function, which looks at the token at index `i` of the output.
+// A step either does all of its work and returns true,
+//   or does nothing at all and returns false to wait until the stages before it have caught up.
+
 /*
   `^(newline | start-of-file) end-of-file --> error`
 */
 static
-void ensureTrailingNewline(engine* st) {
-  dllistNode_eexpr_token* ultimate = st->tokStream.end;
-  assert(ultimate != NULL);
-  assert(ultimate->here.type == EEXPR_TOK_EOF);
-  dllistNode_eexpr_token* penultimate = getPrev(ultimate);
-  if ( penultimate != NULL
-    && penultimate->here.type != EEXPR_TOK_UNKNOWN_NEWLINE
+void ensureTrailingNewline(engine* st, dllist_eexpr_error* errs) {
+  assert(st->tokStream.len != 0);
+  eexpr_token* ultimate = &st->tokStream.data[st->tokStream.len - 1];
+  assert(ultimate->type == EEXPR_TOK_EOF);
+  // raw tokens are all non-transparent
+  if ( st->tokStream.len >= 2
+    && ultimate[-1].type != EEXPR_TOK_UNKNOWN_NEWLINE
      ) {
-    eexpr_error err = {.loc = ultimate->here.loc, .type = EEXPR_ERR_NO_TRAILING_NEWLINE};
-    dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
+    eexpr_error err = {.loc = ultimate->loc, .type = EEXPR_ERR_NO_TRAILING_NEWLINE};
+    dllist_insertAfter_eexpr_error(errs, NULL, &err);
   }
 }
 
@@ -48,94 +203,71 @@ void ensureTrailingNewline(engine* st) {
   `line-continue space -> space`
 */
 static
-void ignoreTrailingStuff(engine* st) {
-  for (dllistNode_eexpr_token* strm = st->tokStream.start; strm != NULL; strm = strm->next) {
-    if (strm->here.transparent) { continue; }
-    // ignore (and create errors for) whitespace at the end of lines
-    if (strm->here.type == EEXPR_TOK_UNKNOWN_SPACE) {
-      assert(strm->next != NULL);
-      if ( strm->next->here.type == EEXPR_TOK_UNKNOWN_NEWLINE
-        || strm->next->here.type == EEXPR_TOK_EOF
-         ) {
-        strm->here.transparent = true;
-        eexpr_error err = {.loc = strm->here.loc, .type = EEXPR_ERR_TRAILING_SPACE};
-        dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
+bool ignoreTrailingStuff(cooker* ck, size_t i) {
+  eexpr_token* strm = &ck->toks[i];
+  if (strm->transparent) { return true; }
+  // ignore (and create errors for) whitespace at the end of lines
+  if (strm->type == EEXPR_TOK_UNKNOWN_SPACE) {
+    if (i + 1 == ck->outLen) {
+      assert(!upstreamDone(ck, IGNORE_TRAILING_STUFF));
+      return false;
+    }
+    // nothing after the cursor has been touched yet, so the next token is also the next non-transparent one
+    eexpr_token* next = strm + 1;
+    if (ck->st->fragment && (i == 0 || next->type == EEXPR_TOK_EOF)) {
+      // space around a fragment is not part of any line
+      strm->transparent = true;
+    }
+    else if ( next->type == EEXPR_TOK_UNKNOWN_NEWLINE
+           || next->type == EEXPR_TOK_EOF
+            ) {
+      strm->transparent = true;
+      eexpr_error err = {.loc = strm->loc, .type = EEXPR_ERR_TRAILING_SPACE};
+      addError(ck, IGNORE_TRAILING_STUFF, err);
+    }
+    else if (strm->as.unknownSpace.type == EEXPR_WSLINECONTINUE) {
+      // If the previous token is transparent, it's a line-continue that was hidden because this one follows it,
+      //   and that line-continue already hid any space before itself.
+      if (i != 0 && !strm[-1].transparent && strm[-1].type == EEXPR_TOK_UNKNOWN_SPACE) {
+        strm[-1].transparent = true;
       }
-      else if (strm->here.as.unknownSpace.type == EEXPR_WSLINECONTINUE) {
-        dllistNode_eexpr_token* prev = getPrev(strm);
-        if (prev->here.type == EEXPR_TOK_UNKNOWN_SPACE) {
-          prev->here.transparent = true;
-        }
-        dllistNode_eexpr_token* next = getNext(strm);
-        if (next->here.type == EEXPR_TOK_UNKNOWN_SPACE) {
-          strm->here.transparent = true;
-        }
+      if (next->type == EEXPR_TOK_UNKNOWN_SPACE) {
+        strm->transparent = true;
       }
     }
-    // ignore comments and any whitespace that precedes them
-    else if (strm->here.type == EEXPR_TOK_COMMENT) {
-      strm->here.transparent = true;
-      if (strm->prev != NULL && strm->prev->here.type == EEXPR_TOK_UNKNOWN_SPACE) {
-        strm->prev->here.transparent = true;
-      }
+  }
+  // ignore comments and any whitespace that precedes them
+  else if (strm->type == EEXPR_TOK_COMMENT) {
+    strm->transparent = true;
+    if (i != 0 && strm[-1].type == EEXPR_TOK_UNKNOWN_SPACE) {
+      strm[-1].transparent = true;
     }
   }
+  return true;
 }
 
 /*
   `newline end-of-line --> end-of-line`
 */
 static
-void ignoreBlankLines(engine* st) {
-  for (dllistNode_eexpr_token* strm = st->tokStream.start; strm != NULL; strm = strm->next) {
-    if (strm->here.transparent) { continue; }
-    if (strm->here.type == EEXPR_TOK_UNKNOWN_NEWLINE) {
-      dllistNode_eexpr_token* next = getNext(strm);
-      if ( next->here.type == EEXPR_TOK_UNKNOWN_NEWLINE
-        || next->here.type == EEXPR_TOK_EOF
-         ) {
-        strm->here.transparent = true;
-      }
-      else if (getPrev(strm) == NULL) {
-        strm->here.transparent = true;
-      }
+bool ignoreBlankLines(cooker* ck, size_t i) {
+  eexpr_token* strm = &ck->toks[i];
+  if (strm->transparent) { return true; }
+  if (strm->type == EEXPR_TOK_UNKNOWN_NEWLINE) {
+    size_t j = lookNext(ck, IGNORE_BLANK_LINES, i);
+    if (j == LOOK_WAIT) { return false; }
+    assert(j != LOOK_NONE);
+    eexpr_token* next = &ck->toks[j];
+    if ( next->type == EEXPR_TOK_UNKNOWN_NEWLINE
+      || next->type == EEXPR_TOK_EOF
+       ) {
+      strm->transparent = true;
     }
-  }
-}
-
-/*
-  `^(space | start-of-line)_1 unknown-dot ^(space | end-of-line)_2 --> \1 chain \2`
-  `space_1 unknown-dot ^(space | end-of-line)_2 --> \1 predot \2`
-  `unknown-dot --> error`
-*/
-static
-void disambiguateDots(engine* st) {
-  for (dllistNode_eexpr_token* strm = st->tokStream.start; strm != NULL; strm = strm->next) {
-    if (strm->here.transparent) { continue; }
-    if (strm->here.type == EEXPR_TOK_UNKNOWN_DOT) {
-      dllistNode_eexpr_token* prev = getPrev(strm);
-      bool spaceBefore = prev            == NULL
-                      || prev->here.type == EEXPR_TOK_NEWLINE
-                      || prev->here.type == EEXPR_TOK_SPACE
-                       ;
-      bool trueSpaceBefore = prev != NULL && prev->here.type == EEXPR_TOK_SPACE;
-      dllistNode_eexpr_token* next = getNext(strm);
-      bool spaceAfter = next->here.type == EEXPR_TOK_EOF
-                     || next->here.type == EEXPR_TOK_NEWLINE
-                     || next->here.type == EEXPR_TOK_SPACE
-                      ;
-      if (!spaceBefore && !spaceAfter) {
-        strm->here.type = EEXPR_TOK_CHAIN;
-      }
-      else if (trueSpaceBefore && !spaceAfter) {
-        strm->here.type = EEXPR_TOK_PREDOT;
-      }
-      else {
-        eexpr_error err = {.loc = strm->here.loc, .type = EEXPR_ERR_BAD_DOT};
-        dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
-      }
+    else if (ck->stages[IGNORE_BLANK_LINES].prevType == EEXPR_TOK_NONE) {
+      strm->transparent = true;
     }
   }
+  return true;
 }
 
 /*
@@ -144,55 +276,68 @@ void disambiguateDots(engine* st) {
   `unknown-colon ^end-of-line --> colon`
 */
 static
-void disambiguateColons(engine* st) {
-  for (dllistNode_eexpr_token* strm = st->tokStream.start; strm != NULL; strm = strm->next) {
-    if (strm->here.transparent) { continue; }
-    if (strm->here.type == EEXPR_TOK_UNKNOWN_COLON) {
-      dllistNode_eexpr_token* next = getNext(strm);
-      if (next->here.type == EEXPR_TOK_UNKNOWN_NEWLINE) {
-        dllistNode_eexpr_token* ws = getNext(next);
-        strm->here.type = EEXPR_TOK_INDENT;
-        strm->here.as.indent.depth
-          = ws->here.type == EEXPR_TOK_UNKNOWN_SPACE ? ws->here.as.unknownSpace.size : 0;
-        next->here.transparent = true;
-        if (ws->here.type == EEXPR_TOK_UNKNOWN_SPACE) {
-          ws->here.transparent = true;
-        }
-        // insert space before indented block
-        dllistNode_eexpr_token* prev = getPrev(strm);
-        if ( prev->here.type != EEXPR_TOK_UNKNOWN_NEWLINE
-          && prev->here.type != EEXPR_TOK_UNKNOWN_SPACE
-          && prev->here.type != EEXPR_TOK_UNKNOWN_DOT
-          ) {
-          eexpr_token synthSpace =
-            { .loc = { .start = strm->here.loc.start, .end = strm->here.loc.start }
-            , .type = EEXPR_TOK_SPACE
-            , .transparent = false
-            };
-          dllist_insertBefore_eexpr_token(&st->tokStream, &synthSpace, strm);
-        }
+bool disambiguateColons(cooker* ck, size_t i) {
+  eexpr_token* strm = &ck->toks[i];
+  if (strm->transparent) { return true; }
+  if (strm->type == EEXPR_TOK_UNKNOWN_COLON) {
+    size_t j = lookNext(ck, DISAMBIGUATE_COLONS, i);
+    if (j == LOOK_WAIT) { return false; }
+    assert(j != LOOK_NONE);
+    eexpr_token* next = &ck->toks[j];
+    if (next->type == EEXPR_TOK_UNKNOWN_NEWLINE) {
+      size_t k = lookNext(ck, DISAMBIGUATE_COLONS, j);
+      if (k == LOOK_WAIT) { return false; }
+      assert(k != LOOK_NONE);
+      eexpr_token* ws = &ck->toks[k];
+      strm->type = EEXPR_TOK_INDENT;
+      strm->as.indent.depth
+        = ws->type == EEXPR_TOK_UNKNOWN_SPACE ? ws->as.unknownSpace.size : 0;
+      next->transparent = true;
+      if (ws->type == EEXPR_TOK_UNKNOWN_SPACE) {
+        ws->transparent = true;
       }
-      else if (next->here.type == EEXPR_TOK_EOF) {
-        strm->here.type = EEXPR_TOK_INDENT;
-        strm->here.as.indent.depth = 0;
-      }
-      else {
-        strm->here.type = EEXPR_TOK_COLON;
+      // insert space before indented block
+      eexpr_tokenType prevType = ck->stages[DISAMBIGUATE_COLONS].prevType;
+      if ( prevType != EEXPR_TOK_NONE
+        && prevType != EEXPR_TOK_UNKNOWN_NEWLINE
+        && prevType != EEXPR_TOK_UNKNOWN_SPACE
+        && prevType != EEXPR_TOK_UNKNOWN_DOT
+        ) {
+        eexpr_token synthSpace =
+          { .loc = { .start = strm->loc.start, .end = strm->loc.start }
+          , .type = EEXPR_TOK_SPACE
+          , .transparent = false
+          };
+        insertBefore(ck, DISAMBIGUATE_COLONS, i, &synthSpace);
       }
     }
-    else if (strm->here.type == EEXPR_TOK_WRAP && strm->here.as.wrap.isOpen) {
-      dllistNode_eexpr_token* newline = getNext(strm);
-      if (newline->here.type == EEXPR_TOK_UNKNOWN_NEWLINE) {
-        dllistNode_eexpr_token* ws = getNext(newline);
-        newline->here.type = EEXPR_TOK_INDENT;
-        newline->here.as.indent.depth
-          = ws->here.type == EEXPR_TOK_UNKNOWN_SPACE ? ws->here.as.unknownSpace.size : 0;
-        if (ws->here.type == EEXPR_TOK_UNKNOWN_SPACE) {
-          ws->here.transparent = true;
-        }
+    else if (next->type == EEXPR_TOK_EOF && !ck->st->fragment) {
+      strm->type = EEXPR_TOK_INDENT;
+      strm->as.indent.depth = 0;
+    }
+    else {
+      strm->type = EEXPR_TOK_COLON;
+    }
+  }
+  else if (strm->type == EEXPR_TOK_WRAP && strm->as.wrap.isOpen) {
+    size_t j = lookNext(ck, DISAMBIGUATE_COLONS, i);
+    if (j == LOOK_WAIT) { return false; }
+    assert(j != LOOK_NONE);
+    eexpr_token* newline = &ck->toks[j];
+    if (newline->type == EEXPR_TOK_UNKNOWN_NEWLINE) {
+      size_t k = lookNext(ck, DISAMBIGUATE_COLONS, j);
+      if (k == LOOK_WAIT) { return false; }
+      assert(k != LOOK_NONE);
+      eexpr_token* ws = &ck->toks[k];
+      newline->type = EEXPR_TOK_INDENT;
+      newline->as.indent.depth
+        = ws->type == EEXPR_TOK_UNKNOWN_SPACE ? ws->as.unknownSpace.size : 0;
+      if (ws->type == EEXPR_TOK_UNKNOWN_SPACE) {
+        ws->transparent = true;
       }
     }
   }
+  return true;
 }
 
 static
@@ -205,61 +350,71 @@ size_t indentState_pop(dynarr_size_t* st) {
 }
 
 static
-bool insertDedents(engine* st, dynarr_size_t* depths, dllistNode_eexpr_token* endOfLine) {
+bool insertDedents(cooker* ck, size_t endOfLine) {
+  dynarr_size_t* depths = &ck->depths;
+  eexpr_token* eol = &ck->toks[endOfLine];
   size_t newDepth;
-  dllistNode_eexpr_token* insertPoint;
-  if (endOfLine->here.type == EEXPR_TOK_UNKNOWN_NEWLINE) {
-    dllistNode_eexpr_token* maybeSpace = getNext(endOfLine);
-    endOfLine->here.transparent = true;
-    if (maybeSpace->here.type == EEXPR_TOK_UNKNOWN_SPACE) {
-      newDepth = maybeSpace->here.as.unknownSpace.size;
+  size_t insertPoint;
+  if (eol->type == EEXPR_TOK_UNKNOWN_NEWLINE) {
+    size_t j = lookNext(ck, DETECT_INDENTATION, endOfLine);
+    if (j == LOOK_WAIT) { return false; }
+    assert(j != LOOK_NONE);
+    eexpr_token* maybeSpace = &ck->toks[j];
+    if (maybeSpace->type == EEXPR_TOK_UNKNOWN_SPACE) {
+      newDepth = maybeSpace->as.unknownSpace.size;
       if (newDepth > indentState_peek(depths)) {
         // keep the whitespace, but not the newline
         // no change to the depth stack
+        eol->transparent = true;
         return true;
       }
-      maybeSpace->here.transparent = true;
-      insertPoint = getNext(maybeSpace);
+      insertPoint = lookNext(ck, DETECT_INDENTATION, j);
+      if (insertPoint == LOOK_WAIT) { return false; }
+      assert(insertPoint != LOOK_NONE);
+      maybeSpace->transparent = true;
     }
     else {
       newDepth = 0;
-      insertPoint = maybeSpace;
+      insertPoint = j;
     }
+    eol->transparent = true;
   }
-  else if (endOfLine->here.type == EEXPR_TOK_EOF) {
+  else if (eol->type == EEXPR_TOK_EOF) {
     newDepth = 0;
     insertPoint = endOfLine;
   }
-  else { assert(false); }
+  else { assert(false); return true; }
   eexpr_loc loc =
-    { .start = {.line = insertPoint->here.loc.start.line, .col = 0}
-    , .end = insertPoint->here.loc.start
+    { .start = {.line = ck->toks[insertPoint].loc.start.line, .col = 0}
+    , .end = ck->toks[insertPoint].loc.start
     };
   assert(newDepth <= indentState_peek(depths)); // this should have been handled above, before the newline and whitespace was ignored
   while (true) {
     size_t depth = indentState_peek(depths);
     if (newDepth < depth) {
       eexpr_token tok = {.loc = loc, .type = EEXPR_TOK_WRAP, .as.wrap = {.type = EEXPR_WRAP_BLOCK, .isOpen = false}};
-      lexer_insertBefore(st, &tok, insertPoint);
+      insertBefore(ck, DETECT_INDENTATION, insertPoint, &tok);
+      insertPoint += 1;
       indentState_pop(depths);
     }
     else if (newDepth == depth) {
-      if (insertPoint->here.type == EEXPR_TOK_WRAP && !insertPoint->here.as.wrap.isOpen) {
+      eexpr_token* here = &ck->toks[insertPoint];
+      if (here->type == EEXPR_TOK_WRAP && !here->as.wrap.isOpen) {
         // do nothing: supress newline between dedent and close wrap
       }
-      else if (insertPoint->here.type == EEXPR_TOK_EOF) {
+      else if (here->type == EEXPR_TOK_EOF) {
         // do nothing: no need to insert a newline when we're at the end of the file
       }
       else {
         eexpr_token tok = {.loc = loc, .type = EEXPR_TOK_NEWLINE};
-        lexer_insertBefore(st, &tok, insertPoint);
+        insertBefore(ck, DETECT_INDENTATION, insertPoint, &tok);
       }
       return true;
     }
     else {
       eexpr_error err = {.loc = loc, .type = EEXPR_ERR_OFFSIDES};
-      dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
-      return false;
+      addError(ck, DETECT_INDENTATION, err);
+      return true;
     }
   }
 }
@@ -283,71 +438,58 @@ Note that whereas the colon is consumed by the indentation, the open wrap is not
 */
 // Detecting open indents is done by `disambiguateColons`, even though the name implies it's only worried about colons.
 static
-bool detectIndentation(engine* st) {
-  bool success = false;
-  dynarr_size_t depths; dynarr_init_size_t(&depths, 30);
-  for (dllistNode_eexpr_token* strm = st->tokStream.start; strm != NULL; strm = strm->next) {
-    if (strm->here.transparent) { continue; }
-    if (strm->here.type == EEXPR_TOK_INDENT) {
-      dllistNode_eexpr_token* next = getNext(strm);
-      eexpr_loc loc =
-        { .start = {.line = next->here.loc.start.line, .col = 0}
-        , .end = next->here.loc.start
-        };
-      size_t depth = strm->here.as.indent.depth;
-      size_t depth0 = indentState_peek(&depths);
-      if (depth > depth0) {
-        dynarr_push_size_t(&depths, &depth);
-        eexpr_token tok = {.loc = loc, .type = EEXPR_TOK_WRAP, .as.wrap = {.type = EEXPR_WRAP_BLOCK, .isOpen = true}};
-        lexer_insertBefore(st, &tok, next);
-        strm->here.transparent = true;
-        success = true;
-      }
-      else {
-        eexpr_error err = {.loc = loc, .type = EEXPR_ERR_SHALLOW_INDENT};
-        dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
-        success = false;
-      }
+bool detectIndentation(cooker* ck, size_t i) {
+  eexpr_token* strm = &ck->toks[i];
+  if (strm->transparent) { return true; }
+  if (strm->type == EEXPR_TOK_INDENT) {
+    size_t j = lookNext(ck, DETECT_INDENTATION, i);
+    if (j == LOOK_WAIT) { return false; }
+    assert(j != LOOK_NONE);
+    eexpr_token* next = &ck->toks[j];
+    eexpr_loc loc =
+      { .start = {.line = next->loc.start.line, .col = 0}
+      , .end = next->loc.start
+      };
+    size_t depth = strm->as.indent.depth;
+    size_t depth0 = indentState_peek(&ck->depths);
+    if (depth > depth0) {
+      dynarr_push_size_t(&ck->depths, &depth);
+      strm->transparent = true;
+      eexpr_token tok = {.loc = loc, .type = EEXPR_TOK_WRAP, .as.wrap = {.type = EEXPR_WRAP_BLOCK, .isOpen = true}};
+      insertBefore(ck, DETECT_INDENTATION, j, &tok);
     }
-    else if ( strm->here.type == EEXPR_TOK_UNKNOWN_NEWLINE
-           || strm->here.type == EEXPR_TOK_EOF
-            ) {
-      success = insertDedents(st, &depths, strm);
+    else {
+      eexpr_error err = {.loc = loc, .type = EEXPR_ERR_SHALLOW_INDENT};
+      addError(ck, DETECT_INDENTATION, err);
     }
   }
-  dynarr_deinit_size_t(&depths);
-  return success;
+  else if ( strm->type == EEXPR_TOK_UNKNOWN_NEWLINE
+         || strm->type == EEXPR_TOK_EOF
+          ) {
+    return insertDedents(ck, i);
+  }
+  return true;
 }
 
 // This really just checks that newlines and inline space have all been handled.
 static
-void disambiguateSpaces(engine* st) {
-  for (dllistNode_eexpr_token* strm = st->tokStream.start; strm != NULL; strm = strm->next) {
-    if (strm->here.transparent) { continue; }
-    // all newlines should already have been handled
-    assert (strm->here.type != EEXPR_TOK_UNKNOWN_NEWLINE);
-    if (strm->here.type == EEXPR_TOK_UNKNOWN_SPACE) {
-      // we (should already) know this is inline space
-      strm->here.type = EEXPR_TOK_SPACE;
-      // we should already have merged adjacent spaces
-      {
-        dllistNode_eexpr_token* prev = getPrev(strm);
-        assert(prev->here.type != EEXPR_TOK_SPACE);
-      }
-      // space at start of a line should already have been handled
-      {
-        dllistNode_eexpr_token* prev = getPrev(strm);
-        assert(prev != NULL);
-        assert(prev->here.type != EEXPR_TOK_NEWLINE);
-      }
-      // space at end of line should already have been handled
-      {
-        dllistNode_eexpr_token* next = getPrev(strm);
-        assert(next->here.type != EEXPR_TOK_NEWLINE);
-        assert(next->here.type != EEXPR_TOK_EOF);
-      }
-    }
+bool disambiguateSpaces(cooker* ck, size_t i) {
+  eexpr_token* strm = &ck->toks[i];
+  if (strm->transparent) { return true; }
+  // all newlines should already have been handled
+  assert (strm->type != EEXPR_TOK_UNKNOWN_NEWLINE);
+  if (strm->type == EEXPR_TOK_UNKNOWN_SPACE) {
+    // we (should already) know this is inline space
+    strm->type = EEXPR_TOK_SPACE;
+    eexpr_tokenType prevType = ck->stages[DISAMBIGUATE_SPACES].prevType;
+    // we should already have merged adjacent spaces
+    assert(prevType != EEXPR_TOK_SPACE);
+    // space at start of a line should already have been handled
+    assert(prevType != EEXPR_TOK_NONE);
+    assert(prevType != EEXPR_TOK_NEWLINE);
+    (void)prevType;
   }
+  return true;
 }
 
 /*
@@ -355,34 +497,76 @@ void disambiguateSpaces(engine* st) {
   `space (wrap.close | string.close | string.middle)^1 --> \1`
 */
 static
-void ignoreWrappedSpaces(engine* st) {
-  for (dllistNode_eexpr_token* strm = st->tokStream.start; strm != NULL; strm = strm->next) {
-    if (strm->here.transparent) { continue; }
-    if ( (strm->here.type == EEXPR_TOK_WRAP && strm->here.as.wrap.isOpen)
-      || (strm->here.type == EEXPR_TOK_STRING
-        && ( strm->here.as.string.splice == EEXPR_STROPEN
-          || strm->here.as.string.splice == EEXPR_STRMIDDLE
+bool ignoreWrappedSpaces(cooker* ck, size_t i) {
+  eexpr_token* strm = &ck->toks[i];
+  if (strm->transparent) { return true; }
+  if ( (strm->type == EEXPR_TOK_WRAP && strm->as.wrap.isOpen)
+    || (strm->type == EEXPR_TOK_STRING
+      && ( strm->as.string.splice == EEXPR_STROPEN
+        || strm->as.string.splice == EEXPR_STRMIDDLE
+         )
+       )
+     ) {
+    size_t j = lookNext(ck, IGNORE_WRAPPED_SPACES, i);
+    if (j == LOOK_WAIT) { return false; }
+    if (j != LOOK_NONE && ck->toks[j].type == EEXPR_TOK_SPACE) {
+      ck->toks[j].transparent = true;
+    }
+  }
+  else if (strm->type == EEXPR_TOK_SPACE) {
+    size_t j = lookNext(ck, IGNORE_WRAPPED_SPACES, i);
+    if (j == LOOK_WAIT) { return false; }
+    assert(j != LOOK_NONE);
+    eexpr_token* next = &ck->toks[j];
+    if ( (next->type == EEXPR_TOK_WRAP && !next->as.wrap.isOpen)
+      || (next->type == EEXPR_TOK_STRING
+        && ( next->as.string.splice == EEXPR_STRCLOSE
+          || next->as.string.splice == EEXPR_STRMIDDLE
            )
          )
        ) {
-      dllistNode_eexpr_token* next = getNext(strm);
-      if (next != NULL && next->here.type == EEXPR_TOK_SPACE) {
-        next->here.transparent = true;
-      }
+      strm->transparent = true;
     }
-    else if (strm->here.type == EEXPR_TOK_SPACE) {
-      dllistNode_eexpr_token* next = getNext(strm);
-      if ( (next->here.type == EEXPR_TOK_WRAP && !next->here.as.wrap.isOpen)
-        || (next->here.type == EEXPR_TOK_STRING
-          && ( next->here.as.string.splice == EEXPR_STRCLOSE
-            || next->here.as.string.splice == EEXPR_STRMIDDLE
-             )
-           )
-         ) {
-        strm->here.transparent = true;
-      }
+  }
+  return true;
+}
+
+/*
+  `^(space | start-of-line)_1 unknown-dot ^(space | end-of-line)_2 --> \1 chain \2`
+  `space_1 unknown-dot ^(space | end-of-line)_2 --> \1 predot \2`
+  `unknown-dot --> error`
+*/
+static
+bool disambiguateDots(cooker* ck, size_t i) {
+  eexpr_token* strm = &ck->toks[i];
+  if (strm->transparent) { return true; }
+  if (strm->type == EEXPR_TOK_UNKNOWN_DOT) {
+    size_t j = lookNext(ck, DISAMBIGUATE_DOTS, i);
+    if (j == LOOK_WAIT) { return false; }
+    assert(j != LOOK_NONE);
+    eexpr_tokenType prevType = ck->stages[DISAMBIGUATE_DOTS].prevType;
+    bool spaceBefore = prevType == EEXPR_TOK_NONE
+                    || prevType == EEXPR_TOK_NEWLINE
+                    || prevType == EEXPR_TOK_SPACE
+                     ;
+    bool trueSpaceBefore = prevType == EEXPR_TOK_SPACE;
+    eexpr_token* next = &ck->toks[j];
+    bool spaceAfter = next->type == EEXPR_TOK_EOF
+                   || next->type == EEXPR_TOK_NEWLINE
+                   || next->type == EEXPR_TOK_SPACE
+                    ;
+    if (!spaceBefore && !spaceAfter) {
+      strm->type = EEXPR_TOK_CHAIN;
+    }
+    else if (trueSpaceBefore && !spaceAfter) {
+      strm->type = EEXPR_TOK_PREDOT;
+    }
+    else {
+      eexpr_error err = {.loc = strm->loc, .type = EEXPR_ERR_BAD_DOT};
+      addError(ck, DISAMBIGUATE_DOTS, err);
     }
   }
+  return true;
 }
 
 /*
@@ -392,49 +576,176 @@ void ignoreWrappedSpaces(engine* st) {
   `string.(close | plain) string.(open | plain) --> error`
 */
 static
-void detectCramming(engine* st) {
-  for (dllistNode_eexpr_token* strm = st->tokStream.start; strm != NULL; strm = strm->next) {
-    if (strm->here.transparent) { continue; }
-    if (strm->here.type == EEXPR_TOK_EOF) { continue; }
-    eexpr_tokenType hereType = strm->here.type;
-    bool hereIsDotLike = hereType == EEXPR_TOK_ELLIPSIS || hereType == EEXPR_TOK_CHAIN || hereType == EEXPR_TOK_PREDOT;
-    dllistNode_eexpr_token* next = getNext(strm);
-    eexpr_tokenType nextType = next->here.type;
-    bool nextIsDotLike = nextType == EEXPR_TOK_ELLIPSIS || nextType == EEXPR_TOK_CHAIN || nextType == EEXPR_TOK_PREDOT;
-    eexpr_loc loc = {.start = strm->here.loc.start, .end = next->here.loc.end};
-    eexpr_error err = {.loc = loc, .type = EEXPR_ERR_CRAMMED_TOKENS};
-    if (hereIsDotLike && nextIsDotLike) {
-      dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
-    }
-    else if (hereType == EEXPR_TOK_NUMBER && nextType == EEXPR_TOK_CHAIN) {
-      dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
-    }
-    else if (hereType == EEXPR_TOK_SYMBOL || hereType == EEXPR_TOK_NUMBER) {
-      if (nextType == EEXPR_TOK_SYMBOL || nextType == EEXPR_TOK_NUMBER) {
-        dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
-      }
+bool detectCramming(cooker* ck, size_t i) {
+  eexpr_token* strm = &ck->toks[i];
+  if (strm->transparent) { return true; }
+  if (strm->type == EEXPR_TOK_EOF) { return true; }
+  size_t j = lookNext(ck, DETECT_CRAMMING, i);
+  if (j == LOOK_WAIT) { return false; }
+  assert(j != LOOK_NONE);
+  eexpr_tokenType hereType = strm->type;
+  bool hereIsDotLike = hereType == EEXPR_TOK_ELLIPSIS || hereType == EEXPR_TOK_CHAIN || hereType == EEXPR_TOK_PREDOT;
+  eexpr_token* next = &ck->toks[j];
+  eexpr_tokenType nextType = next->type;
+  bool nextIsDotLike = nextType == EEXPR_TOK_ELLIPSIS || nextType == EEXPR_TOK_CHAIN || nextType == EEXPR_TOK_PREDOT;
+  eexpr_loc loc = {.start = strm->loc.start, .end = next->loc.end};
+  eexpr_error err = {.loc = loc, .type = EEXPR_ERR_CRAMMED_TOKENS};
+  if (hereIsDotLike && nextIsDotLike) {
+    addError(ck, DETECT_CRAMMING, err);
+  }
+  else if (hereType == EEXPR_TOK_NUMBER && nextType == EEXPR_TOK_CHAIN) {
+    addError(ck, DETECT_CRAMMING, err);
+  }
+  else if (hereType == EEXPR_TOK_SYMBOL || hereType == EEXPR_TOK_NUMBER) {
+    if (nextType == EEXPR_TOK_SYMBOL || nextType == EEXPR_TOK_NUMBER) {
+      addError(ck, DETECT_CRAMMING, err);
     }
-    else if (hereType == EEXPR_TOK_STRING && nextType == EEXPR_TOK_STRING) {
-      bool hereStringClosed = strm->here.as.string.splice == EEXPR_STRPLAIN || strm->here.as.string.splice == EEXPR_STRCLOSE;
-      bool nextStringOpen = strm->here.as.string.splice == EEXPR_STRPLAIN || strm->here.as.string.splice == EEXPR_STROPEN;
-      if (hereStringClosed && nextStringOpen) {
-        dllist_insertAfter_eexpr_error(&st->errStream, NULL, &err);
-      }
+  }
+  else if (hereType == EEXPR_TOK_STRING && nextType == EEXPR_TOK_STRING) {
+    bool hereStringClosed = strm->as.string.splice == EEXPR_STRPLAIN || strm->as.string.splice == EEXPR_STRCLOSE;
+    bool nextStringOpen = strm->as.string.splice == EEXPR_STRPLAIN || strm->as.string.splice == EEXPR_STROPEN;
+    if (hereStringClosed && nextStringOpen) {
+      addError(ck, DETECT_CRAMMING, err);
     }
   }
+  return true;
+}
+
+
+//////////////////////////////////// Driver ////////////////////////////////////
+
+static inline
+bool step(cooker* ck, cookStageId k, size_t i) {
+  switch (k) {
+    case IGNORE_TRAILING_STUFF: return ignoreTrailingStuff(ck, i);
+    case IGNORE_BLANK_LINES: return ignoreBlankLines(ck, i);
+    case DISAMBIGUATE_COLONS: return disambiguateColons(ck, i);
+    case DETECT_INDENTATION: return detectIndentation(ck, i);
+    case DISAMBIGUATE_SPACES: return disambiguateSpaces(ck, i);
+    case IGNORE_WRAPPED_SPACES: return ignoreWrappedSpaces(ck, i);
+    case DISAMBIGUATE_DOTS: return disambiguateDots(ck, i);
+    case DETECT_CRAMMING: return detectCramming(ck, i);
+    default: assert(false); return true;
+  }
+}
+
+// step stage `k` as far as it can go with what the stages before it have released
+static inline
+void runStage(cooker* ck, cookStageId k) {
+  cookStage* sg = &ck->stages[k];
+  if (sg->done) { return; }
+  if (sg->skip) {
+    sg->pos = available(ck, k);
+    sg->done = upstreamDone(ck, k);
+    return;
+  }
+  while (sg->pos < available(ck, k)) {
+    if (!step(ck, k, sg->pos)) { return; }
+    // a step may have inserted tokens before the cursor, but `sg->pos` has been kept pointing at the same token
+    eexpr_token* here = &ck->toks[sg->pos];
+    if (!here->transparent) { sg->prevType = here->type; }
+    clearMemos(sg);
+    sg->pos += 1;
+  }
+  if (upstreamDone(ck, k)) { sg->done = true; }
 }
 
 void engine_cookLex(engine* st) {
-  ensureTrailingNewline(st);
-  ignoreTrailingStuff(st);
-  ignoreBlankLines(st);
-  disambiguateColons(st);
-  if (!detectIndentation(st)) { return; }
-  disambiguateSpaces(st);
-  ignoreWrappedSpaces(st);
-  disambiguateDots(st);
-  detectCramming(st);
+  dllist_eexpr_error stageErrs[N_COOK_STAGES];
+  engine_cookLexApart(st, stageErrs);
+  if (st->cooking != NULL) { return; }
+  for (cookStageId k = 0; k < N_COOK_STAGES; ++k) {
+    st->errStream = dllist_cat_eexpr_error(&st->errStream, &stageErrs[k]);
+  }
+}
+
+static
+cooker* startCooking(engine* st) {
+  cooker* ck = malloc(sizeof(cooker));
+  checkOom(ck);
+  ck->st = st;
+  ck->toks = st->tokStream.data;
+  ck->outLen = 0;
+  ck->nPulled = 0;
+  for (cookStageId k = 0; k < N_COOK_STAGES; ++k) {
+    cookStage* sg = &ck->stages[k];
+    sg->pos = 0;
+    sg->done = false;
+    sg->skip = false;
+    sg->prevType = EEXPR_TOK_NONE;
+    clearMemos(sg);
+    sg->errs = dllist_empty_eexpr_error();
+  }
+  if (!st->fragment) {
+    // this check is reported along with the first stage
+    ensureTrailingNewline(st, &ck->stages[0].errs);
+  }
+  else if (st->discoveredNewline == NEWLINE_NONE) {
+    // with no newlines, there are no blank lines, and no indentation (a fragment's final colon opens no block)
+    ck->stages[IGNORE_BLANK_LINES].skip = true;
+    ck->stages[DETECT_INDENTATION].skip = true;
+  }
+  if (ck->stages[DETECT_INDENTATION].skip) {
+    ck->depths.cap = ck->depths.len = 0;
+    ck->depths.data = NULL;
+  }
+  else {
+    dynarr_init_size_t(&ck->depths, 30);
+  }
+  return ck;
+}
+
+// The sweep can stop between batches, since it keeps all its state in the cooker.
+// The stream is then left with a gap in it though, so the cooker must be kept until the sweep finishes, or else dropped.
+void engine_cookLexApart(engine* st, dllist_eexpr_error* stageErrs) {
+  if (st->cooking == NULL) {
+    st->cooking = startCooking(st);
+  }
+  cooker* ck = st->cooking;
+  while (!ck->stages[N_COOK_STAGES - 1].done) {
+    size_t nPull = st->tokStream.len - ck->nPulled;
+    if (nPull > COOK_PULL_BATCH) { nPull = COOK_PULL_BATCH; }
+    if (ck->outLen != ck->nPulled) {
+      memmove(&ck->toks[ck->outLen], &ck->toks[ck->nPulled], nPull * sizeof(eexpr_token));
+    }
+    ck->outLen += nPull;
+    ck->nPulled += nPull;
+    // written out in full so that each stage's loop is specialized
+    runStage(ck, IGNORE_TRAILING_STUFF);
+    runStage(ck, IGNORE_BLANK_LINES);
+    runStage(ck, DISAMBIGUATE_COLONS);
+    runStage(ck, DETECT_INDENTATION);
+    runStage(ck, DISAMBIGUATE_SPACES);
+    runStage(ck, IGNORE_WRAPPED_SPACES);
+    runStage(ck, DISAMBIGUATE_DOTS);
+    runStage(ck, DETECT_CRAMMING);
+    if (!ck->stages[N_COOK_STAGES - 1].done && engine_spend(st, nPull)) { return; }
+  }
+  // drop the (now empty) gap
+  st->tokStream.len = ck->outLen;
+
+  for (cookStageId k = 0; k < N_COOK_STAGES; ++k) {
+    stageErrs[k] = ck->stages[k].errs;
+  }
+  dynarr_deinit_size_t(&ck->depths);
+  free(ck);
+  st->cooking = NULL;
   // TODO detect mixed indentation
   // TODO detect mixed newlines
   // TODO create error if file starts with indent
 }
+
+void engine_cookDrop(engine* st) {
+  cooker* ck = st->cooking;
+  if (ck == NULL) { return; }
+  // close the gap, so that every token is where the engine expects to find it
+  size_t nRaw = st->tokStream.len - ck->nPulled;
+  memmove(&ck->toks[ck->outLen], &ck->toks[ck->nPulled], nRaw * sizeof(eexpr_token));
+  st->tokStream.len = ck->outLen + nRaw;
+  for (cookStageId k = 0; k < N_COOK_STAGES; ++k) {
+    dllist_del_eexpr_error(&ck->stages[k].errs);
+  }
+  dynarr_deinit_size_t(&ck->depths);
+  free(ck);
+  st->cooking = NULL;
+}
@@ -7,12 +7,13 @@ void token_deinit(eexpr_token* tok) {
   if (tok == NULL) { return; }
   switch (tok->type) {
     case EEXPR_TOK_STRING: {
-      if (tok->as.string.text.bytes != NULL) { free(tok->as.string.text.bytes); }
+      if (tok->as.string.text.bytes != NULL && !tok->borrowedText) { free(tok->as.string.text.bytes); }
     }; break;
     case EEXPR_TOK_SYMBOL: {
-      if (tok->as.symbol.text.bytes != NULL) { free(tok->as.symbol.text.bytes); }
+      if (tok->as.symbol.text.bytes != NULL && !tok->borrowedText) { free(tok->as.symbol.text.bytes); }
     }; break;
     case EEXPR_TOK_NUMBER: {
+      if (tok->undecoded) { break; }
       if (tok->as.number.mantissa.buf != NULL) { free(tok->as.number.mantissa.buf); }
       if (tok->as.number.exponent.buf != NULL) { free(tok->as.number.exponent.buf); }
     }; break;
@@ -20,6 +20,13 @@ typedef struct eexprNumber {
   bigint exponent; // owned
 } eexprNumber;
 
+// A number which has only been checked, not decoded (see `eexpr_parser.lazyNumbers`).
+// It is decoded from its source text on first access, see `engine_forceNumber`.
+typedef struct lazyNumber {
+  str src; // borrowed from the input
+  eexpr_arena* arena; // where the decoded digits are to be allocated, or NULL for the heap
+} lazyNumber;
+
 typedef struct eexpr_strTemplate strTemplPart;
 #define TYPE strTemplPart
 #include "dynarr.h"
@@ -37,11 +44,17 @@ typedef eexpr* eexpr_p;
 //////////////////////////////////// Eexprs ////////////////////////
 
 struct eexpr {
-  eexpr_loc loc;
+  union {
+    eexpr_loc loc;
+    eexpr* nextDoomed; // only while waiting to be freed, when the location is no longer needed (see `eexpr_deinit`)
+  };
   eexpr_type type;
+  bool borrowedText; // for symbols and strings: the text aliases the parser's input, and so is not freed along with this eexpr
+  bool undecoded; // for numbers: the payload is still in `.as.lazyNumber` rather than `.as.number`
   union eexprData {
     eexprSymbol symbol;
     eexprNumber number;
+    lazyNumber lazyNumber;
     eexprStrTempl string;
     eexpr* wrap; // paren, bracket, brace, predot
     dynarr_eexpr_p list; // chain, space, comma, semicolon, block
@@ -51,6 +64,56 @@ struct eexpr {
 };
 
 
+//////////////////////////////////// Flat Eexprs ////////////////////////
+
+// A node of a flat forest (see below).
+// Its subexprs follow it directly, each one's subtree after the last's, so its first subexpr (if any) is the very next node.
+struct eexpr_flatNode {
+  uint8_t type; // an `eexpr_type`
+  uint8_t absent; // for ellipses: bit 0 is set if there is nothing before it, bit 1 if nothing after
+  uint32_t nSubexprs; // not counting missing subexprs
+  uint32_t next; // offset in nodes from this node to its next sibling (i.e. the size of its subtree)
+  uint32_t data; // for symbols, numbers and strings: offset in bytes from this node to its record in the side buffer
+  uint32_t loc[6]; // start line, col and byte, then end line, col and byte
+};
+
+// A flat forest is a single block of memory: this header, then the nodes in preorder, then a side buffer of node data.
+// Every offset within it is relative, so the block can be copied (or mapped) anywhere as is.
+struct eexpr_flat {
+  uint32_t nRoots;
+  uint32_t nNodes;
+  uint32_t nBytes; // the size of the whole block
+  eexpr_flatNode nodes[];
+};
+
+// Records in the side buffer are all 4-byte aligned, so that bignum digits can be read in place.
+typedef struct flatSymbol {
+  uint32_t nBytes;
+  uint8_t text[];
+} flatSymbol;
+
+typedef struct flatNumber {
+  uint8_t radix;
+  bool isPositive;
+  bool isPositive_exp;
+  uint32_t nFracDigits;
+  uint32_t nBigDigits;
+  uint32_t nBigDigits_exp;
+  uint32_t digits[]; // the significand's digits, then the exponent's
+} flatNumber;
+
+typedef struct flatStrPart {
+  uint32_t subexpr; // offset in nodes from the string's node to this part's subexpr, or zero if it is missing (always zero for the head)
+  uint32_t text; // offset in bytes from the start of the string's record
+  uint32_t nBytes;
+} flatStrPart;
+
+typedef struct flatString {
+  uint32_t nSubexprs; // counting missing subexprs
+  flatStrPart parts[]; // the head, then one for each subexpr; the text of every part comes after them
+} flatString;
+
+
 //////////////////////////////////// Tokens ////////////////////////
 
 struct eexpr_token {
@@ -63,6 +126,7 @@ struct eexpr_token {
       size_t size;
     } unknownSpace;
     eexprNumber number;
+    lazyNumber lazyNumber;
     struct token_string {
       str text; // owned
       eexpr_stringType splice;
@@ -79,6 +143,8 @@ struct eexpr_token {
   // however, for the purposes of outputing colorization data, they should not actually be removed from the token stream.
   // `.transparent` allows these tokens to be flagged so that further lexing/parsing steps ignore them
   bool transparent;
+  bool borrowedText; // for symbols and strings: the text aliases the parser's input, and so is not owned by the token
+  bool undecoded; // for numbers: the payload is still in `.as.lazyNumber` rather than `.as.number`
 };
 
 void token_deinit(eexpr_token* tok);
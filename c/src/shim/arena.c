@@ -0,0 +1,111 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+
+#define ARENA_ALIGN 8
+_Static_assert(_Alignof(void*) <= ARENA_ALIGN, "arena alignment too small for pointers");
+_Static_assert(_Alignof(size_t) <= ARENA_ALIGN, "arena alignment too small for size_t");
+_Static_assert(_Alignof(uint64_t) <= ARENA_ALIGN, "arena alignment too small for uint64_t");
+
+// chunks never grow past this size on their own; only single oversized allocations get bigger chunks
+#define ARENA_MAX_CHUNK ((size_t)1 << 24)
+
+struct arenaChunk {
+  arenaChunk* prev; // owned, null for the first chunk
+  size_t cap; // in bytes
+  size_t used; // in bytes, always a multiple of `ARENA_ALIGN`
+  uint64_t data[];
+};
+
+static inline
+size_t roundUp(size_t bytes) {
+  return (bytes + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+
+void arena_init(arena* self, size_t chunkSize) {
+  self->top = NULL;
+  self->last = NULL;
+  self->chunkSize = chunkSize < 256 ? 256 : roundUp(chunkSize);
+}
+
+void arena_deinit(arena* self) {
+  arenaChunk* chunk = self->top;
+  while (chunk != NULL) {
+    arenaChunk* prev = chunk->prev;
+    free(chunk);
+    chunk = prev;
+  }
+  self->top = NULL;
+  self->last = NULL;
+}
+
+void arena_reset(arena* self) {
+  arenaChunk* top = self->top;
+  if (top == NULL) { return; }
+  arenaChunk* chunk = top->prev;
+  while (chunk != NULL) {
+    arenaChunk* prev = chunk->prev;
+    free(chunk);
+    chunk = prev;
+  }
+  top->prev = NULL;
+  top->used = 0;
+  self->last = NULL;
+}
+
+void arena_adopt(arena* self, arena* other) {
+  if (other->top == NULL) { return; }
+  if (self->top == NULL) {
+    self->top = other->top;
+    self->last = other->last;
+  }
+  else {
+    // slip the other chunks in under the top one, so allocation carries on where it was
+    arenaChunk* bottom = other->top;
+    while (bottom->prev != NULL) { bottom = bottom->prev; }
+    bottom->prev = self->top->prev;
+    self->top->prev = other->top;
+  }
+  other->top = NULL;
+  other->last = NULL;
+}
+
+void* arena_alloc(arena* self, size_t bytes) {
+  bytes = roundUp(bytes);
+  arenaChunk* chunk = self->top;
+  if (chunk == NULL || chunk->cap - chunk->used < bytes) {
+    size_t cap = self->chunkSize;
+    if (cap < bytes) { cap = bytes; }
+    chunk = malloc(sizeof(arenaChunk) + cap);
+    checkOom(chunk);
+    chunk->prev = self->top;
+    chunk->cap = cap;
+    chunk->used = 0;
+    self->top = chunk;
+    if (self->chunkSize < ARENA_MAX_CHUNK) { self->chunkSize *= 2; }
+  }
+  uint8_t* out = (uint8_t*)chunk->data + chunk->used;
+  chunk->used += bytes;
+  self->last = out;
+  return out;
+}
+
+void* arena_realloc(arena* self, void* ptr, size_t oldBytes, size_t newBytes) {
+  if (ptr == NULL) { return arena_alloc(self, newBytes); }
+  if (ptr == self->last) {
+    arenaChunk* chunk = self->top;
+    size_t offset = (uint8_t*)ptr - (uint8_t*)chunk->data;
+    if (chunk->cap - offset >= roundUp(newBytes)) {
+      chunk->used = offset + roundUp(newBytes);
+      return ptr;
+    }
+  }
+  void* out = arena_alloc(self, newBytes);
+  memcpy(out, ptr, oldBytes < newBytes ? oldBytes : newBytes);
+  return out;
+}
@@ -0,0 +1,50 @@
+/*
+A region allocator: many small allocations are carved out of a few large `malloc`d chunks,
+  and all of them are freed together in one go with `arena_deinit`.
+There is no way to free an individual allocation,
+  but the most recent allocation can be resized in place (which is what growing arrays need).
+
+All allocations are aligned suitably for pointers, `size_t`, and 64-bit integers;
+  that's all the eexpr data structures need.
+*/
+#ifndef SHIM_ARENA_H
+#define SHIM_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct arenaChunk arenaChunk;
+
+typedef struct arena {
+  arenaChunk* top; // owned, the chunk currently being allocated from (older chunks are linked from it)
+  uint8_t* last; // aliased, the most recent allocation, or NULL if it can't be resized in place
+  size_t chunkSize; // size of the next chunk to be allocated (grows geometrically)
+} arena;
+
+// initialize an empty arena; no memory is allocated until the first `arena_alloc`
+void arena_init(arena* self, size_t chunkSize);
+
+// free every chunk of the arena at once
+// every pointer obtained from the arena becomes invalid
+void arena_deinit(arena* self);
+
+// Empty the arena for re-use: every pointer obtained from the arena becomes invalid,
+//   but the most recent (and so largest) chunk is kept, so allocations of a similar total size need no further `malloc`s.
+void arena_reset(arena* self);
+
+// Take over all the memory of `other`, which is left empty.
+// Pointers obtained from `other` stay valid, and are now freed along with `self`.
+void arena_adopt(arena* self, arena* other);
+
+// allocate `bytes` of uninitialized memory from the arena
+void* arena_alloc(arena* self, size_t bytes);
+
+// Resize an allocation from `oldBytes` to `newBytes`, returning the new location of the data.
+// If `ptr` is the most recent allocation, and there is room in its chunk, it is resized in place.
+// Otherwise, a fresh allocation is made and the data copied over (the old space is only reclaimed by `arena_deinit`).
+// If `ptr` is NULL, this is just `arena_alloc(self, newBytes)`.
+void* arena_realloc(arena* self, void* ptr, size_t oldBytes, size_t newBytes);
+
+
+#endif
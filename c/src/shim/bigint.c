@@ -19,11 +19,39 @@ void bigint_del(bigint* obj) {
   }
 }
 
+bigint bigint_fromU64(uint64_t val) {
+  bigint new = bigint_new();
+  if (val == 0) { return new; }
+  new.pos = true;
+  if (val <= UINT32_MAX) {
+    new.len = 1;
+    new.small = (uint32_t)val;
+  }
+  else {
+    new.len = 2;
+    new.buf = malloc(2 * sizeof(uint32_t));
+    checkOom(new.buf);
+    new.buf[0] = (uint32_t)val;
+    new.buf[1] = (uint32_t)(val >> 32);
+  }
+  return new;
+}
+
+// move an inline digit onto the heap, so that the arithmetic below only has to deal with `.buf`
+static
+void spill(bigint* a) {
+  if (a->buf != NULL || a->len == 0) { return; }
+  a->buf = malloc(sizeof(uint32_t));
+  checkOom(a->buf);
+  a->buf[0] = a->small;
+}
+
 
 bigint bigint_clone(bigint orig) {
   bigint new = {.len = orig.len, .pos = orig.pos};
+  const uint32_t* digits = bigint_digits(&orig);
   for (; new.len > 0; --new.len) {
-    if (orig.buf[new.len-1] != 0) { break; }
+    if (digits[new.len-1] != 0) { break; }
   }
   if (new.len == 0) {
     new.buf = NULL;
@@ -33,7 +61,7 @@ bigint bigint_clone(bigint orig) {
     new.buf = malloc(new.len * sizeof(uint32_t));
     checkOom(new.buf);
     for (size_t i = 0; i < new.len; ++i) {
-      new.buf[i] = orig.buf[i];
+      new.buf[i] = digits[i];
     }
   }
   return new;
@@ -86,6 +114,7 @@ void subMag(bigint* base, uint32_t amt) {
 }
 
 void bigint_inc(bigint* base, uint32_t amt) {
+  spill(base);
   if (amt == 0) {/* do nothing */}
   else if (base->len == 0) {
     assert(base->buf == NULL);
@@ -108,6 +137,7 @@ void bigint_inc(bigint* base, uint32_t amt) {
 }
 
 void bigint_dec(bigint* base, uint32_t amt) {
+  spill(base);
   if (amt == 0) {/* do nothing */}
   else if (base->len == 0) {
     assert(base->buf == NULL);
@@ -129,6 +159,7 @@ void bigint_dec(bigint* base, uint32_t amt) {
 }
 
 void bigint_scale(bigint* base, uint8_t amt) {
+  spill(base);
   if (base->buf == NULL) { return; }
   if (amt == 0) {
     free(base->buf);
@@ -148,18 +179,330 @@ void bigint_scale(bigint* base, uint8_t amt) {
   }
 }
 
-uint8_t extract(bigint* x) {
-  if (x->len == 0) { return 0; }
+void bigint_mulAdd(bigint* base, uint32_t mul, uint32_t add) {
+  assert(base->pos || base->len == 0);
+  spill(base);
+  uint32_t carry = add;
+  for (size_t i = 0; i < base->len; ++i) {
+    uint64_t c = (uint64_t)base->buf[i] * mul + carry;
+    base->buf[i] = (uint32_t)c;
+    carry = (uint32_t)(c >> 32);
+  }
+  if (carry) {
+    grow(base, carry);
+    base->pos = true;
+  }
+}
+
+
+//////////////////////////////////// Base Conversion ////////////////////////////////////
+
+/*
+Converting between binary and decimal one digit at a time takes quadratic time, which is very noticeable for literals with many thousands of digits.
+Instead, both directions work on whole limbs at once, and split long numbers in half recursively:
+  `hi * B^h + lo` is computed from the separately-converted `hi` and `lo` with one multiplication by a power of `B`.
+With karatsuba multiplication, that makes conversion subquadratic.
+
+The arithmetic below works on bare little-endian limb arrays in either base 2^32 (for bigints) or base 10^9 (for decimal output).
+*/
+#define BASE_BIN ((uint64_t)1 << 32)
+#define BASE_DEC ((uint64_t)1000000000)
+#define KARATSUBA_CUTOFF 40 // limbs; below this, schoolbook multiplication is faster
+#define CONVERT_CUTOFF 64 // limbs; below this, convert directly in quadratic time
+
+// a borrowed or owned array of limbs
+typedef struct limbs {
+  uint32_t* buf;
+  size_t len;
+} limbs;
+
+// the number of limbs after removing leading zeros
+static
+size_t limbsTrim(const uint32_t* x, size_t n) {
+  while (n > 0 && x[n-1] == 0) { --n; }
+  return n;
+}
+
+// `acc += x`; the result must fit in `nacc` limbs
+static
+void limbsAdd(uint32_t* acc, size_t nacc, const uint32_t* x, size_t nx, uint64_t base) {
+  assert(nx <= nacc);
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i < nx; ++i) {
+    uint64_t c = acc[i] + (uint64_t)x[i] + carry;
+    carry = c >= base;
+    acc[i] = (uint32_t)(carry ? c - base : c);
+  }
+  for (; carry && i < nacc; ++i) {
+    uint64_t c = acc[i] + carry;
+    carry = c >= base;
+    acc[i] = (uint32_t)(carry ? c - base : c);
+  }
+  assert(carry == 0);
+}
+
+// `acc -= x`; the result must not be negative
+static
+void limbsSub(uint32_t* acc, size_t nacc, const uint32_t* x, size_t nx, uint64_t base) {
+  assert(nx <= nacc);
+  uint64_t borrow = 0;
+  size_t i = 0;
+  for (; i < nx; ++i) {
+    uint64_t sub = (uint64_t)x[i] + borrow;
+    borrow = acc[i] < sub;
+    acc[i] = (uint32_t)(borrow ? acc[i] + base - sub : acc[i] - sub);
+  }
+  for (; borrow && i < nacc; ++i) {
+    borrow = acc[i] == 0;
+    acc[i] = (uint32_t)(borrow ? base - 1 : acc[i] - 1);
+  }
+  assert(borrow == 0);
+}
+
+// `out = a * b`, where `out` has room for `na + nb` limbs
+// written once for any base so that the callers below get a copy specialized to a constant base
+static inline
+void mulSchoolIn(uint32_t* out, const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint64_t base) {
+  memset(out, 0, (na + nb) * sizeof(uint32_t));
+  for (size_t i = 0; i < na; ++i) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < nb; ++j) {
+      // cannot overflow: (base-1)^2 + 2(base-1) < base^2 <= 2^64
+      uint64_t c = out[i+j] + (uint64_t)a[i] * b[j] + carry;
+      out[i+j] = (uint32_t)(c % base);
+      carry = c / base;
+    }
+    out[i+nb] = (uint32_t)carry;
+  }
+}
+static
+void mulSchool(uint32_t* out, const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint64_t base) {
+  if (base == BASE_BIN) { mulSchoolIn(out, a, na, b, nb, BASE_BIN); }
+  else { assert(base == BASE_DEC); mulSchoolIn(out, a, na, b, nb, BASE_DEC); }
+}
+
+// `out = a * b`, where `out` has room for `na + nb` limbs
+static
+void limbsMul(uint32_t* out, const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint64_t base) {
+  if (na < nb) {
+    const uint32_t* t = a; a = b; b = t;
+    size_t nt = na; na = nb; nb = nt;
+  }
+  if (nb < KARATSUBA_CUTOFF) {
+    mulSchool(out, a, na, b, nb, base);
+  }
+  else if (2 * nb <= na) {
+    // lopsided: multiply `b` by `nb`-sized slices of `a`
+    memset(out, 0, (na + nb) * sizeof(uint32_t));
+    uint32_t* tmp = malloc(2 * nb * sizeof(uint32_t));
+    checkOom(tmp);
+    for (size_t i = 0; i < na; i += nb) {
+      size_t k = na - i < nb ? na - i : nb;
+      limbsMul(tmp, &a[i], k, b, nb, base);
+      limbsAdd(&out[i], na + nb - i, tmp, limbsTrim(tmp, k + nb), base);
+    }
+    free(tmp);
+  }
+  else {
+    // karatsuba: with `a = a1*B^m + a0` and `b = b1*B^m + b0`,
+    //   `a*b = z2*B^2m + ((a0+a1)(b0+b1) - z2 - z0)*B^m + z0` where `z2 = a1*b1`, `z0 = a0*b0`
+    size_t m = na / 2; // so that `0 < nb - m <= na - m`
+    size_t na1 = na - m, nb1 = nb - m;
+    limbsMul(out, a, m, b, m, base);
+    limbsMul(&out[2*m], &a[m], na1, &b[m], nb1, base);
+    size_t nsa = na1 + 1, nsb = (nb1 > m ? nb1 : m) + 1;
+    uint32_t* sa = calloc(nsa + nsb + (nsa + nsb), sizeof(uint32_t));
+    checkOom(sa);
+    uint32_t* sb = &sa[nsa];
+    uint32_t* z1 = &sb[nsb];
+    memcpy(sa, &a[m], na1 * sizeof(uint32_t));
+    limbsAdd(sa, nsa, a, m, base);
+    memcpy(sb, &b[m], nb1 * sizeof(uint32_t));
+    limbsAdd(sb, nsb, b, m, base);
+    nsa = limbsTrim(sa, nsa);
+    nsb = limbsTrim(sb, nsb);
+    size_t nz1 = nsa + nsb;
+    limbsMul(z1, sa, nsa, sb, nsb, base);
+    limbsSub(z1, nz1, out, limbsTrim(out, 2*m), base);
+    limbsSub(z1, nz1, &out[2*m], limbsTrim(&out[2*m], na1 + nb1), base);
+    limbsAdd(&out[m], na + nb - m, z1, limbsTrim(z1, nz1), base);
+    free(sa);
+  }
+}
+
+/*
+Successive squares of some number, computed as they are needed: `pows[k]` holds the number to the power `2^k`.
+The recursive conversions only ever split off a power-of-two number of limbs,
+  so these are all the multipliers they need.
+*/
+typedef struct powerTable {
+  uint64_t base;
+  size_t n;
+  limbs pows[64];
+} powerTable;
+
+static
+powerTable powerTable_new(uint64_t base, uint32_t lo, uint32_t hi) {
+  powerTable out = {.base = base, .n = 1};
+  out.pows[0].buf = malloc(2 * sizeof(uint32_t));
+  checkOom(out.pows[0].buf);
+  out.pows[0].buf[0] = lo;
+  out.pows[0].buf[1] = hi;
+  out.pows[0].len = limbsTrim(out.pows[0].buf, 2);
+  return out;
+}
+
+static
+const limbs* powerTable_get(powerTable* t, size_t k) {
+  while (t->n <= k) {
+    const limbs* prev = &t->pows[t->n - 1];
+    limbs* next = &t->pows[t->n];
+    next->buf = malloc(2 * prev->len * sizeof(uint32_t));
+    checkOom(next->buf);
+    limbsMul(next->buf, prev->buf, prev->len, prev->buf, prev->len, t->base);
+    next->len = limbsTrim(next->buf, 2 * prev->len);
+    t->n += 1;
+  }
+  return &t->pows[k];
+}
+
+static
+void powerTable_deinit(powerTable* t) {
+  for (size_t k = 0; k < t->n; ++k) { free(t->pows[k].buf); }
+  t->n = 0;
+}
+
+// the largest power of two strictly less than `n` (which must be at least two), as an exponent
+static
+size_t splitExp(size_t n) {
+  size_t k = 0;
+  while (((size_t)2 << k) < n) { k += 1; }
+  return k;
+}
+
+// `x = x * mul + add` over the first `*len` limbs of `x`, extending `*len` if there is a carry out
+static
+void limbsMulAdd(uint32_t* x, size_t* len, uint32_t mul, uint32_t add) {
+  uint64_t carry = add;
+  for (size_t i = 0; i < *len; ++i) {
+    uint64_t c = (uint64_t)x[i] * mul + carry;
+    x[i] = (uint32_t)c;
+    carry = c >> 32;
+  }
+  if (carry) { x[(*len)++] = (uint32_t)carry; }
+}
+
+// Write the value of `n` chunks (each a digit in base `pows->pows[0]`, most significant first) into `out[0..n)`.
+// Since each chunk is less than 2^32, `n` limbs are always enough.
+static
+void fromChunksIn(uint32_t* out, const uint32_t* chunks, size_t n, powerTable* pows) {
+  if (n <= CONVERT_CUTOFF) {
+    uint32_t chunkBase = pows->pows[0].buf[0];
+    memset(out, 0, n * sizeof(uint32_t));
+    size_t len = 0;
+    for (size_t i = 0; i < n; ++i) { limbsMulAdd(out, &len, chunkBase, chunks[i]); }
+    return;
+  }
+  size_t k = splitExp(n);
+  size_t h = (size_t)1 << k;
+  size_t nhi = n - h;
+  // low half straight into place, high half scaled by `chunkBase^h` and added in
+  fromChunksIn(out, &chunks[nhi], h, pows);
+  memset(&out[h], 0, nhi * sizeof(uint32_t));
+  const limbs* scale = powerTable_get(pows, k);
+  uint32_t* hi = malloc((nhi + nhi + scale->len) * sizeof(uint32_t));
+  checkOom(hi);
+  uint32_t* prod = &hi[nhi];
+  fromChunksIn(hi, chunks, nhi, pows);
+  size_t nhiTrim = limbsTrim(hi, nhi);
+  if (nhiTrim != 0) {
+    limbsMul(prod, hi, nhiTrim, scale->buf, scale->len, BASE_BIN);
+    limbsAdd(out, n, prod, limbsTrim(prod, nhiTrim + scale->len), BASE_BIN);
+  }
+  free(hi);
+}
+
+bigint bigint_fromChunks(const uint32_t* chunks, size_t n, uint32_t chunkBase) {
+  assert(chunkBase >= 2);
+  bigint out = bigint_new();
+  if (n == 0) { return out; }
+  uint32_t* buf = malloc(n * sizeof(uint32_t));
+  checkOom(buf);
+  powerTable pows = powerTable_new(BASE_BIN, chunkBase, 0);
+  fromChunksIn(buf, chunks, n, &pows);
+  powerTable_deinit(&pows);
+  size_t len = limbsTrim(buf, n);
+  assert(len <= UINT32_MAX);
+  if (len == 0) {
+    free(buf);
+  }
+  else {
+    out.pos = true;
+    out.len = (uint32_t)len;
+    out.buf = buf;
+  }
+  return out;
+}
+
+// divide `x` by a small number in place, returning the remainder
+static
+uint32_t limbsDivSmall(uint32_t* x, size_t n, uint32_t d) {
   uint64_t r = 0;
-  for (size_t i = x->len; i > 0; --i) {
-    uint64_t b = (r << 32) + x->buf[i-1];
-    uint64_t d = b / 10;
-    r = b % 10;
-    x->buf[i-1] = d;
+  for (size_t i = n; i > 0; --i) {
+    uint64_t b = (r << 32) | x[i-1];
+    x[i-1] = (uint32_t)(b / d);
+    r = b % d;
   }
-  if (x->buf[x->len-1] == 0) { x->len -= 1; }
-  return r;
+  return (uint32_t)r;
 }
+
+// an upper bound on the number of base-10^9 limbs needed for `n` base-2^32 limbs
+// (each binary limb is worth log(2^32)/log(10^9) < 1 + 1/14 decimal limbs)
+static
+size_t decCap(size_t n) {
+  return n + n / 14 + 2;
+}
+
+// Write the base-10^9 limbs of the `n` binary limbs in `x` into `out`, which must have room for `decCap(n)` limbs.
+// Returns the number of limbs written (without leading zeros).
+static
+size_t toDecIn(uint32_t* out, const uint32_t* x, size_t n, powerTable* pows) {
+  n = limbsTrim(x, n);
+  if (n <= CONVERT_CUTOFF) {
+    uint32_t tmp[CONVERT_CUTOFF];
+    memcpy(tmp, x, n * sizeof(uint32_t));
+    size_t len = 0;
+    while (n != 0) {
+      out[len++] = limbsDivSmall(tmp, n, BASE_DEC);
+      n = limbsTrim(tmp, n);
+    }
+    return len;
+  }
+  size_t k = splitExp(n);
+  size_t h = (size_t)1 << k;
+  const limbs* scale = powerTable_get(pows, k);
+  size_t capHi = decCap(n - h);
+  uint32_t* hi = malloc((capHi + capHi + scale->len) * sizeof(uint32_t));
+  checkOom(hi);
+  uint32_t* prod = &hi[capHi];
+  size_t nhi = toDecIn(hi, &x[h], n - h, pows);
+  size_t nprod = nhi + scale->len;
+  limbsMul(prod, hi, nhi, scale->buf, scale->len, BASE_DEC);
+  // the product is the larger part, so start from it and add the low half in
+  size_t cap = decCap(n);
+  memset(out, 0, cap * sizeof(uint32_t));
+  nprod = limbsTrim(prod, nprod);
+  memcpy(out, prod, nprod * sizeof(uint32_t));
+  free(hi);
+  uint32_t* lo = malloc(decCap(h) * sizeof(uint32_t));
+  checkOom(lo);
+  size_t nlo = toDecIn(lo, x, h, pows);
+  limbsAdd(out, cap, lo, nlo, BASE_DEC);
+  free(lo);
+  return limbsTrim(out, cap);
+}
+
 str bigint_toDecimal(bigint val) {
   if (val.len == 0) {
     assert(val.buf == NULL);
@@ -169,26 +512,34 @@ str bigint_toDecimal(bigint val) {
     out.bytes[0] = '0';
     return out;
   }
-  bigint tmp = bigint_clone(val);
-  str out; uint8_t* next; {
-    size_t maxBufLen = 1 + 9 * tmp.len;
-    out.bytes = malloc(maxBufLen);
-    checkOom(out.bytes);
-    out.len = 0;
-    next = &out.bytes[maxBufLen];
-  }
-  { // the core algorithm
-    while (tmp.len > 0) {
-      uint8_t d = extract(&tmp);
-      *(--next) = '0' + d;
-      out.len += 1;
-    }
-    if (!tmp.pos) {
-      *(--next) = '-';
-      out.len += 1;
+  // convert to base 10^9, then each limb is nine decimal digits (save the leading limb, which is not zero-padded)
+  uint32_t* dec = malloc(decCap(val.len) * sizeof(uint32_t));
+  checkOom(dec);
+  powerTable pows = powerTable_new(BASE_DEC, (uint32_t)(BASE_BIN % BASE_DEC), (uint32_t)(BASE_BIN / BASE_DEC));
+  size_t ndec = toDecIn(dec, bigint_digits(&val), val.len, &pows);
+  powerTable_deinit(&pows);
+  assert(ndec != 0);
+  uint32_t top = dec[ndec-1];
+  size_t topDigits = 1;
+  for (uint32_t t = top; t >= 10; t /= 10) { topDigits += 1; }
+  str out;
+  out.len = (val.pos ? 0 : 1) + topDigits + 9 * (ndec - 1);
+  out.bytes = malloc(out.len);
+  checkOom(out.bytes);
+  uint8_t* next = &out.bytes[out.len];
+  for (size_t i = 0; i + 1 < ndec; ++i) {
+    uint32_t limb = dec[i];
+    for (int j = 0; j < 9; ++j) {
+      *(--next) = '0' + limb % 10;
+      limb /= 10;
     }
   }
-  memmove(out.bytes, next, out.len);
-  free(tmp.buf);
+  for (size_t j = 0; j < topDigits; ++j) {
+    *(--next) = '0' + top % 10;
+    top /= 10;
+  }
+  if (!val.pos) { *(--next) = '-'; }
+  assert(next == out.bytes);
+  free(dec);
   return out;
 }
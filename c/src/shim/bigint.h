@@ -8,16 +8,26 @@
 
 
 typedef struct bigint {
-  uint32_t* buf; // owned, little-endian
+  uint32_t* buf; // owned, little-endian; NULL when the digits are stored inline
   bool pos; // is false for zero, since then everything will be zero (save `.len`)
-  uint16_t len;
+  uint32_t len;
+  uint32_t small; // the only digit, when it is stored inline (i.e. `.len == 1` and `.buf == NULL`)
 } bigint;
 
+// return the digits, wherever they are stored
+static inline
+const uint32_t* bigint_digits(const bigint* x) {
+  return x->buf != NULL ? x->buf : &x->small;
+}
+
 // malloc a zero bigint with mag zero
 bigint bigint_new();
 // malloc a zero bigint with mag zero
 void bigint_del(bigint* obj);
 
+// create a non-negative bigint, storing it inline (i.e. without allocating) if it fits in one digit
+bigint bigint_fromU64(uint64_t val);
+
 // add a small number
 void bigint_inc(bigint* base, uint32_t amt);
 
@@ -27,7 +37,16 @@ void bigint_dec(bigint* base, uint32_t amt);
 // multiply by a small positive number
 void bigint_scale(bigint* base, uint8_t amt);
 
+// multiply by a small positive number, then add a small number, all in one pass
+// only for non-negative bigints
+void bigint_mulAdd(bigint* base, uint32_t mul, uint32_t add);
+
+// create a non-negative bigint from `n` chunks, most significant first, where each chunk is a digit in base `chunkBase`
+// long inputs are split in half recursively (see "Base Conversion" in the implementation), so this takes subquadratic time
+bigint bigint_fromChunks(const uint32_t* chunks, size_t n, uint32_t chunkBase);
+
 // render in base 10, the str has a malloc'd buf pointer
+// like `bigint_fromChunks`, this takes subquadratic time
 str bigint_toDecimal(bigint val);
 
 #endif
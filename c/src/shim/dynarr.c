@@ -21,6 +21,13 @@ void _dynarr_deinit(_dynarr* arr) {
   }
 }
 
+void _dynarr_reserve(_dynarr* arr, size_t capacity, size_t elemSize) {
+  if (arr->cap >= capacity) { return; }
+  arr->data = realloc(arr->data, capacity * elemSize);
+  checkOom(arr->data);
+  arr->cap = capacity;
+}
+
 void _dynarr_push(_dynarr* arr, const void* elem, size_t elemSize) {
   if (arr->len == arr->cap) {
     if (arr->cap == 0) { arr->cap = 4; }
@@ -37,6 +37,9 @@ void _dynarr_init(_dynarr* arr, size_t initialCapacity, size_t elemSize);
 // makes no attempt to free any pointers owned by the elements
 void _dynarr_deinit(_dynarr* arr);
 
+// grow the capacity (if need be) to at least the given number of elements
+void _dynarr_reserve(_dynarr* arr, size_t capacity, size_t elemSize);
+
 // copies an element to the end of the dynamic array, resizing if necessary
 void _dynarr_push(_dynarr* arr, const void* elem, size_t elemSize);
 
@@ -57,6 +60,7 @@ void* _dynarr_pop(_dynarr* arr, size_t elemSize);
   #define _dynarr_paste(T) dynarr_ ## T
   #define _dynarr_init_paste(T) dynarr_init_ ## T
   #define _dynarr_deinit_paste(T) dynarr_deinit_ ## T
+  #define _dynarr_reserve_paste(T) dynarr_reserve_ ## T
   #define _dynarr_push_paste(T) dynarr_push_ ## T
   #define _dynarr_peek_paste(T) dynarr_peek_ ## T
   #define _dynarr_pop_paste(T) dynarr_pop_ ## T
@@ -64,6 +68,7 @@ void* _dynarr_pop(_dynarr* arr, size_t elemSize);
   #define dynarr(T) _dynarr_paste(T)
   #define dynarr_init(T) _dynarr_init_paste(T)
   #define dynarr_deinit(T) _dynarr_deinit_paste(T)
+  #define dynarr_reserve(T) _dynarr_reserve_paste(T)
   #define dynarr_push(T) _dynarr_push_paste(T)
   #define dynarr_peek(T) _dynarr_peek_paste(T)
   #define dynarr_pop(T) _dynarr_pop_paste(T)
@@ -92,6 +97,11 @@ void dynarr_deinit(TYPE)(dynarr(TYPE)* arr) {
   _dynarr_deinit((_dynarr*)arr);
 }
 
+static inline
+void dynarr_reserve(TYPE)(dynarr(TYPE)* arr, size_t capacity) {
+  _dynarr_reserve((_dynarr*)arr, capacity, sizeof(TYPE));
+}
+
 
 static inline
 void dynarr_push(TYPE)(dynarr(TYPE)* arr, const TYPE* elem) {
@@ -111,12 +121,14 @@ TYPE* dynarr_pop(TYPE)(dynarr(TYPE)* arr) {
   #undef dynarr
   #undef dynarr_init
   #undef dynarr_deinit
+  #undef dynarr_reserve
   #undef dynarr_push
   #undef dynarr_peek
   #undef dynarr_pop
   #undef _dynarr_paste
   #undef _dynarr_init_paste
   #undef _dynarr_deinit_paste
+  #undef _dynarr_reserve_paste
   #undef _dynarr_push_paste
   #undef _dynarr_peek_paste
   #undef _dynarr_pop_paste
@@ -0,0 +1,71 @@
+#if defined(__unix__) || defined(__APPLE__)
+// `mmap` and friends are POSIX, not standard C, so they must be asked for before anything is included
+#define _POSIX_C_SOURCE 200809L
+#define MAPFILE_POSIX
+#endif
+
+#include "mapfile.h"
+
+#include <stdlib.h>
+
+#ifdef MAPFILE_POSIX
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+bool mapFile(const char* filename, mappedFile* out) {
+  out->contents.len = 0;
+  out->contents.bytes = NULL;
+  out->mapped = false;
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) { return false; }
+  struct stat info;
+  bool ok = fstat(fd, &info) == 0 && info.st_size > 0;
+  if (ok) {
+    void* bytes = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ok = bytes != MAP_FAILED;
+    if (ok) {
+      out->contents.len = info.st_size;
+      out->contents.bytes = bytes;
+      out->mapped = true;
+    }
+  }
+  // the mapping stays valid once the file is closed
+  close(fd);
+  return ok;
+}
+
+void unmapFile(mappedFile* file) {
+  if (file->mapped) {
+    munmap(file->contents.bytes, file->contents.len);
+  }
+  else {
+    free(file->contents.bytes);
+  }
+  file->contents.len = 0;
+  file->contents.bytes = NULL;
+  file->mapped = false;
+}
+
+#else
+
+bool mapFile(const char* filename, mappedFile* out) {
+  out->contents = readFile(filename);
+  out->mapped = false;
+  if (out->contents.bytes != NULL && out->contents.len == 0) {
+    free(out->contents.bytes);
+    out->contents.bytes = NULL;
+  }
+  return out->contents.bytes != NULL;
+}
+
+void unmapFile(mappedFile* file) {
+  free(file->contents.bytes);
+  file->contents.len = 0;
+  file->contents.bytes = NULL;
+}
+
+#endif
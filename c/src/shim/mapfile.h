@@ -0,0 +1,26 @@
+/*
+Read-only access to the whole of a file at once.
+Where the platform has POSIX `mmap`, the file is mapped into memory, so its pages are only read in as they are touched
+  (and are shared with any other process mapping the same file).
+Elsewhere, the file is simply read into a buffer.
+*/
+#ifndef SHIM_MAPFILE_H
+#define SHIM_MAPFILE_H
+
+#include <stdbool.h>
+
+#include "strstuff.h"
+
+
+typedef struct mappedFile {
+  str contents; // read-only
+  bool mapped; // whether `contents` is to be unmapped rather than freed
+} mappedFile;
+
+// Returns false if the file could not be opened and read, or is empty.
+bool mapFile(const char* filename, mappedFile* out);
+
+void unmapFile(mappedFile* file);
+
+
+#endif
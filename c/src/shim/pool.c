@@ -0,0 +1,125 @@
+#include "pool.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "common.h"
+
+#ifndef __STDC_NO_THREADS__
+
+#include <threads.h>
+
+
+// the jobs still waiting to run on one worker, numbered from `front` up to (not including) `back`
+typedef struct run {
+  mtx_t lock;
+  size_t front;
+  size_t back;
+} run;
+
+typedef struct pool {
+  unsigned nWorkers;
+  run* runs;
+  void (*job)(void* ctx, unsigned worker, size_t i);
+  void* ctx;
+} pool;
+
+typedef struct worker {
+  pool* pool;
+  unsigned id;
+} worker;
+
+// take the job at the front of a worker's own run
+static
+bool takeOwn(run* own, size_t* i) {
+  mtx_lock(&own->lock);
+  bool ok = own->front < own->back;
+  if (ok) { *i = own->front++; }
+  mtx_unlock(&own->lock);
+  return ok;
+}
+
+// Take the back half of another worker's run, keeping the first job taken to run right away, and the rest as the thief's own run.
+// The thief's own run must be empty, so no other worker can be stealing from it at the time.
+static
+bool steal(pool* p, unsigned thief, size_t* i) {
+  for (unsigned k = 1; k < p->nWorkers; ++k) {
+    run* victim = &p->runs[(thief + k) % p->nWorkers];
+    mtx_lock(&victim->lock);
+    size_t left = victim->back - victim->front;
+    size_t from = victim->back - (left + 1) / 2;
+    size_t to = victim->back;
+    victim->back = from;
+    mtx_unlock(&victim->lock);
+    if (left == 0) { continue; }
+    run* own = &p->runs[thief];
+    mtx_lock(&own->lock);
+    own->front = from + 1;
+    own->back = to;
+    mtx_unlock(&own->lock);
+    *i = from;
+    return true;
+  }
+  return false;
+}
+
+// Run jobs until there are none left anywhere.
+// A job may be in the middle of being stolen when a worker looks for one, but then the thief will run it.
+static
+int work(void* arg) {
+  worker* self = arg;
+  pool* p = self->pool;
+  size_t i;
+  while (takeOwn(&p->runs[self->id], &i) || steal(p, self->id, &i)) {
+    p->job(p->ctx, self->id, i);
+  }
+  return 0;
+}
+
+void pool_run(size_t nJobs, unsigned nWorkers, void (*job)(void* ctx, unsigned worker, size_t i), void* ctx) {
+  if (nWorkers > nJobs) { nWorkers = nJobs; }
+  if (nWorkers <= 1) {
+    for (size_t i = 0; i < nJobs; ++i) { job(ctx, 0, i); }
+    return;
+  }
+  pool p = {.nWorkers = nWorkers, .job = job, .ctx = ctx};
+  p.runs = malloc(nWorkers * sizeof(run));
+  checkOom(p.runs);
+  worker* workers = malloc(nWorkers * sizeof(worker));
+  checkOom(workers);
+  thrd_t* threads = malloc(nWorkers * sizeof(thrd_t));
+  checkOom(threads);
+  bool* started = malloc(nWorkers * sizeof(bool));
+  checkOom(started);
+  for (unsigned w = 0; w < nWorkers; ++w) {
+    mtx_init(&p.runs[w].lock, mtx_plain);
+    p.runs[w].front = nJobs / nWorkers * w + (w < nJobs % nWorkers ? w : nJobs % nWorkers);
+    p.runs[w].back = p.runs[w].front + nJobs / nWorkers + (w < nJobs % nWorkers ? 1 : 0);
+    workers[w].pool = &p;
+    workers[w].id = w;
+  }
+  // a worker whose thread fails to start simply has its jobs stolen by the others
+  for (unsigned w = 1; w < nWorkers; ++w) {
+    started[w] = thrd_create(&threads[w], work, &workers[w]) == thrd_success;
+  }
+  work(&workers[0]);
+  for (unsigned w = 1; w < nWorkers; ++w) {
+    if (started[w]) { thrd_join(threads[w], NULL); }
+  }
+  for (unsigned w = 0; w < nWorkers; ++w) {
+    mtx_destroy(&p.runs[w].lock);
+  }
+  free(started);
+  free(threads);
+  free(workers);
+  free(p.runs);
+}
+
+#else
+
+void pool_run(size_t nJobs, unsigned nWorkers, void (*job)(void* ctx, unsigned worker, size_t i), void* ctx) {
+  (void)nWorkers;
+  for (size_t i = 0; i < nJobs; ++i) { job(ctx, 0, i); }
+}
+
+#endif
@@ -0,0 +1,22 @@
+/*
+Run a number of independent jobs over a few worker threads, sharing them out by work stealing.
+Jobs are numbered from zero, and each worker starts out owning an equal, contiguous run of them,
+  which it works through from the front.
+A worker whose run is used up steals the back half of the run of another worker (taking the next one along that has any jobs left),
+  so workers that happen to get the slow jobs are relieved by the others, but neighbouring jobs still tend to run on the same worker.
+Each run is guarded by its own lock, which is only ever contended while stealing.
+Without thread support, the jobs are simply run in order on the calling thread.
+*/
+#ifndef SHIM_POOL_H
+#define SHIM_POOL_H
+
+#include <stddef.h>
+
+
+// Run `job(ctx, worker, i)` for each `i` from zero up to `nJobs`, on up to `nWorkers` threads (one of which is the calling thread).
+// `worker` is the index of the worker (less than `nWorkers`) running the job, so that workers can keep state of their own in `ctx`.
+// Returns once all jobs are done.
+void pool_run(size_t nJobs, unsigned nWorkers, void (*job)(void* ctx, unsigned worker, size_t i), void* ctx);
+
+
+#endif
@@ -0,0 +1,72 @@
+#include "ring.h"
+
+#ifndef __STDC_NO_THREADS__
+
+
+void ring_init(ring* self) {
+  atomic_init(&self->head, 0);
+  atomic_init(&self->tail, 0);
+  atomic_init(&self->sleeping, false);
+  mtx_init(&self->lock, mtx_plain);
+  cnd_init(&self->wake);
+}
+
+void ring_deinit(ring* self) {
+  cnd_destroy(&self->wake);
+  mtx_destroy(&self->lock);
+}
+
+// Wait until `counter` no longer holds `stuck`; the other side moves it on (and then calls `wakeOther`).
+// The counter and `sleeping` are both accessed sequentially consistently,
+//   so either the waiter sees the counter move before it sleeps, or the other side sees it sleeping and wakes it.
+static
+void waitWhile(ring* self, atomic_size_t* counter, size_t stuck) {
+  for (unsigned i = 0; i < RING_SPINS; ++i) {
+    if (atomic_load(counter) != stuck) { return; }
+    thrd_yield();
+  }
+  mtx_lock(&self->lock);
+  atomic_store(&self->sleeping, true);
+  while (atomic_load(counter) == stuck) {
+    cnd_wait(&self->wake, &self->lock);
+  }
+  atomic_store(&self->sleeping, false);
+  mtx_unlock(&self->lock);
+}
+
+// Wake the other side if it has gone to sleep in `waitWhile`.
+static
+void wakeOther(ring* self) {
+  if (atomic_load(&self->sleeping)) {
+    mtx_lock(&self->lock);
+    cnd_signal(&self->wake);
+    mtx_unlock(&self->lock);
+  }
+}
+
+void ring_push(ring* self, void* item) {
+  size_t tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+  size_t head = atomic_load(&self->head);
+  if (tail - head == RING_CAP) {
+    waitWhile(self, &self->head, head);
+  }
+  self->slots[tail % RING_CAP] = item;
+  // publish the item only once it has been written
+  atomic_store(&self->tail, tail + 1);
+  wakeOther(self);
+}
+
+void* ring_pop(ring* self) {
+  size_t head = atomic_load_explicit(&self->head, memory_order_relaxed);
+  if (atomic_load(&self->tail) == head) {
+    waitWhile(self, &self->tail, head);
+  }
+  void* item = self->slots[head % RING_CAP];
+  // free the slot only once the item has been read out of it
+  atomic_store(&self->head, head + 1);
+  wakeOther(self);
+  return item;
+}
+
+
+#endif
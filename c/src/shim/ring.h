@@ -0,0 +1,45 @@
+/*
+A bounded queue of pointers for handing work from one thread to another, without locks while it is neither full nor empty.
+There must be exactly one thread pushing and one thread popping.
+When the ring is full, the pusher waits for the popper to catch up, so the amount of work in flight stays bounded;
+  when it is empty, the popper waits in turn.
+A waiting thread yields the processor a few times (`RING_SPINS`), in case the other side is about to catch up,
+  then goes to sleep on a condition variable until the other side wakes it, so a stage stuck behind a slow one costs no cpu.
+*/
+#ifndef SHIM_RING_H
+#define SHIM_RING_H
+
+#ifndef __STDC_NO_THREADS__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <threads.h>
+
+
+#define RING_CAP 8
+#define RING_SPINS 64
+
+typedef struct ring {
+  void* slots[RING_CAP];
+  atomic_size_t head; // count of items ever popped, only written by the popping thread
+  atomic_size_t tail; // count of items ever pushed, only written by the pushing thread
+  // set while one side is asleep (or about to be) on `wake`
+  // only one side can be waiting at a time, since the ring cannot be both full and empty
+  atomic_bool sleeping;
+  mtx_t lock;
+  cnd_t wake;
+} ring;
+
+void ring_init(ring* self);
+void ring_deinit(ring* self);
+
+// add an item at the end, waiting until there is room
+void ring_push(ring* self, void* item);
+
+// remove an item from the start, waiting until there is one
+void* ring_pop(ring* self);
+
+
+#endif
+#endif
@@ -152,6 +152,94 @@ size_t peekUchars(char32_t* out, size_t n, str in) {
 }
 
 
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define STRSTUFF_X86 1
+#else
+  #define STRSTUFF_X86 0
+#endif
+
+// return the number of ascii bytes at the start of the given bytes
+static
+size_t asciiPrefix_scalar(const uint8_t* bytes, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t chunk; memcpy(&chunk, &bytes[i], 8);
+    if (chunk & UINT64_C(0x8080808080808080)) { break; }
+  }
+  while (i < n && bytes[i] < 0x80) { ++i; }
+  return i;
+}
+#if STRSTUFF_X86
+__attribute__((target("sse2")))
+static
+size_t asciiPrefix_sse2(const uint8_t* bytes, size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*)&bytes[i]);
+    int highBits = _mm_movemask_epi8(chunk);
+    if (highBits != 0) { return i + __builtin_ctz(highBits); }
+  }
+  return i + asciiPrefix_scalar(&bytes[i], n - i);
+}
+__attribute__((target("avx2")))
+static
+size_t asciiPrefix_avx2(const uint8_t* bytes, size_t n) {
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m256i lo = _mm256_loadu_si256((const __m256i*)&bytes[i]);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)&bytes[i + 32]);
+    if (_mm256_movemask_epi8(_mm256_or_si256(lo, hi)) != 0) { break; }
+  }
+  for (; i + 32 <= n; i += 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i*)&bytes[i]);
+    int highBits = _mm256_movemask_epi8(chunk);
+    if (highBits != 0) { return i + __builtin_ctz(highBits); }
+  }
+  return i + asciiPrefix_scalar(&bytes[i], n - i);
+}
+#endif
+
+static
+size_t asciiPrefix(const uint8_t* bytes, size_t n) {
+  #if STRSTUFF_X86
+    if (__builtin_cpu_supports("avx2")) { return asciiPrefix_avx2(bytes, n); }
+    if (__builtin_cpu_supports("sse2")) { return asciiPrefix_sse2(bytes, n); }
+  #endif
+  return asciiPrefix_scalar(bytes, n);
+}
+
+// the length of the (non-ascii) utf8 sequence at the start of `bytes`, or 0 if `peekUchar` would report an error
+static
+size_t multibyteLen(const uint8_t* bytes, size_t n) {
+  uint8_t b0 = bytes[0];
+  size_t len = !(b0 & 0x40) /* 0b10xxxxxx */ ? 0
+             : !(b0 & 0x20) /* 0b110xxxxx */ ? 2
+             : !(b0 & 0x10) /* 0b1110xxxx */ ? 3
+             : !(b0 & 0x08) /* 0b11110xxx */ ? 4
+             : 0;
+  if (len == 0 || n < len) { return 0; }
+  for (size_t i = 1; i < len; ++i) {
+    if ((bytes[i] & 0xC0) != 0x80) { return 0; }
+  }
+  return len;
+}
+
+size_t validUtf8Prefix(str in) {
+  size_t i = 0;
+  while (i < in.len) {
+    i += asciiPrefix(&in.bytes[i], in.len - i);
+    // non-ascii text tends to come in runs too, so stay out of the vector loop until ascii resumes
+    while (i < in.len && in.bytes[i] >= 0x80) {
+      size_t len = multibyteLen(&in.bytes[i], in.len - i);
+      if (len == 0) { return i; }
+      i += len;
+    }
+  }
+  return in.len;
+}
+
+
 bool ucharElem(char32_t c, const char32_t* set) {
   for (size_t i = 0; set[i] != UCHAR_NULL; ++i) {
     if (set[i] == c) { return true; }
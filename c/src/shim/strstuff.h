@@ -65,6 +65,47 @@ size_t peekUchars(char32_t* out, size_t n, str in);
 // returns 0 for end-of-input
 size_t peekUchar(char32_t* out, str in);
 
+/*
+Return the length in bytes of the longest prefix of `in` that `peekUchar` decodes without error.
+The prefix always ends on a codepoint boundary.
+Like `peekUchar`, this only checks the structure of the encoding (lead byte followed by the right number of continuation bytes);
+  it does not reject overlong encodings, surrogates, and so on.
+Runs of ascii are checked many bytes at a time (with AVX2 or SSE2 when the cpu has them).
+*/
+size_t validUtf8Prefix(str in);
+
+// Decode a single codepoint without any checks, returning its length in bytes.
+// Only call this on input that `validUtf8Prefix` has already vouched for.
+static inline
+size_t decodeUcharUnchecked(char32_t* out, const uint8_t* bytes) {
+  uint8_t b0 = bytes[0];
+  if (b0 < 0x80) {
+    *out = b0;
+    return 1;
+  }
+  else if (b0 < 0xE0) {
+    *out = (char32_t)(b0 & 0x1F)<<6
+         | (char32_t)(bytes[1] & 0x3F)
+         ;
+    return 2;
+  }
+  else if (b0 < 0xF0) {
+    *out = (char32_t)(b0 & 0x0F)<<12
+         | (char32_t)(bytes[1] & 0x3F)<<6
+         | (char32_t)(bytes[2] & 0x3F)
+         ;
+    return 3;
+  }
+  else {
+    *out = (char32_t)(b0 & 0x07)<<18
+         | (char32_t)(bytes[1] & 0x3F)<<12
+         | (char32_t)(bytes[2] & 0x3F)<<6
+         | (char32_t)(bytes[3] & 0x3F)
+         ;
+    return 4;
+  }
+}
+
 /*
 Check if `c` is in the array `set`.
 The `set` must end in `UCHAR_NULL`.
@@ -0,0 +1,36 @@
+#!/bin/bash
+set -e
+
+# Time eexpr2json on files holding a single enormous numeric literal.
+# This exercises both directions of bigint conversion (lexing the digits and rendering the json), so
+#   if conversion is subquadratic, each tenfold increase in digits should cost not much more than tenfold the time.
+# usage: bench/bignum.sh [max digits (default 1000000)]
+
+here="$(dirname "$(realpath "$0")")"
+cmd="$here/../../bin/static/eexpr2json"
+maxDigits="${1:-1000000}"
+
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+
+function timeLiteral() {
+  local prefix="$1" digits="$2" nDigits="$3"
+  local file="$tmp/$nDigits.eexpr"
+  { printf '%s1' "$prefix" ; tr -dc "$digits" </dev/urandom | head -c "$((nDigits - 1))" ; echo ; } >"$file"
+  local start end
+  start="$(date +%s%N)"
+  "$cmd" "$file" >/dev/null
+  end="$(date +%s%N)"
+  printf '%-4s %8d digits %8d ms %8d ns/digit\n' \
+    "${prefix:-dec}" "$nDigits" "$(( (end - start) / 1000000 ))" "$(( (end - start) / nDigits ))"
+}
+
+for radix in "0-9:" "0-9a-f:0x"; do
+  digits="${radix%%:*}"
+  prefix="${radix#*:}"
+  n=1000
+  while [ "$n" -le "$maxDigits" ]; do
+    timeLiteral "$prefix" "$digits" "$n"
+    n=$((n * 10))
+  done
+done
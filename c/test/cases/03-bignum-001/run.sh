@@ -0,0 +1 @@
+../../scripts/parse-ok.sh
\ No newline at end of file
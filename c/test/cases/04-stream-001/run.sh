@@ -0,0 +1 @@
+../../scripts/stream-ok.sh
\ No newline at end of file
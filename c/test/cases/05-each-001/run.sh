@@ -0,0 +1 @@
+../../scripts/each-ok.sh
\ No newline at end of file
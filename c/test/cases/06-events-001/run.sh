@@ -0,0 +1 @@
+../../scripts/events-ok.sh
\ No newline at end of file
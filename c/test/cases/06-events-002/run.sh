@@ -0,0 +1,22 @@
+#!/bin/bash
+set -e
+
+cmd="$(realpath ../../scripts/eexpr2json.sh)"
+
+# report the events of the input nested in two hundred thousand parens,
+#   counting how many there are of each rather than printing them all
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+{ head -c 200000 /dev/zero | tr '\0' '('
+  head -n1 input.eexpr | tr -d '\n'
+  head -c 200000 /dev/zero | tr '\0' ')'
+  echo
+} >"$tmp/deep.eexpr"
+out="$PWD"
+cd "$tmp"
+set +e
+"$cmd" -v deep.eexpr >events
+echo "$?" >"$out/exitcode.output"
+set -e
+sed -n '1p;$p' events
+awk '{print $1, $NF}' events | sort | uniq -c
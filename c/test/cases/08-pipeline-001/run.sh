@@ -0,0 +1 @@
+../../scripts/pipeline-ok.sh
\ No newline at end of file
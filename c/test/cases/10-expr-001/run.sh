@@ -0,0 +1 @@
+../../scripts/expr-ok.sh
\ No newline at end of file
@@ -0,0 +1 @@
+../../scripts/deep-ok.sh
\ No newline at end of file
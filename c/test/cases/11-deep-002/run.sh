@@ -0,0 +1,22 @@
+#!/bin/bash
+set -e
+
+cmd="$(realpath ../../scripts/eexpr2json.sh)"
+
+# nest the middle line of the input a hundred thousand times between its first and last lines,
+#   then walk the eexprs, counting how many times each sort was entered and exited rather than printing them all
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+{ head -n1 input.eexpr | yes "$(cat)" | head -n 100000 | tr -d '\n'
+  sed -n 2p input.eexpr | tr -d '\n'
+  tail -n1 input.eexpr | yes "$(cat)" | head -n 100000 | tr -d '\n'
+  echo
+} >"$tmp/deep.eexpr"
+out="$PWD"
+cd "$tmp"
+set +e
+"$cmd" -w deep.eexpr >walk
+echo "$?" >"$out/exitcode.output"
+set -e
+sed -n '1p;$p' walk
+awk '{print $1, $3}' walk | sort | uniq -c
@@ -0,0 +1 @@
+../../scripts/walk-ok.sh
\ No newline at end of file
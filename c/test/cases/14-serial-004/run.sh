@@ -0,0 +1 @@
+../../scripts/serial-bad.sh
\ No newline at end of file
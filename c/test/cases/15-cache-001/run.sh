@@ -0,0 +1 @@
+../../scripts/compare-ok.sh
\ No newline at end of file
@@ -0,0 +1,30 @@
+#!/bin/bash
+set -e
+
+cmd="$(realpath ../../scripts/eexpr2json.sh)"
+
+# cache the outputs of the first and second lines of the input, each in turn as the same file,
+#   then swap their entries, as though the two had hashed to each other's names, and run them both again:
+#   neither entry may answer for the other line, so each is parsed again
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+head -n1 input.eexpr >"$tmp/first.eexpr"
+tail -n1 input.eexpr >"$tmp/second.eexpr"
+out="$PWD"
+cd "$tmp"
+mkdir cache
+function run() {
+  cp "$1" input.eexpr
+  set +e
+  "$cmd" -c cache input.eexpr
+  echo "$?" >>"$out/exitcode.output"
+  set -e
+}
+run first.eexpr
+run second.eexpr
+entries=(cache/*)
+mv "${entries[0]}" swap
+mv "${entries[1]}" "${entries[0]}"
+mv swap "${entries[1]}"
+run first.eexpr
+run second.eexpr
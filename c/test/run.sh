@@ -10,38 +10,53 @@ function dieUsage() {
   exit 1
 }
 
-function runCase() {
-  local case="$1"
-  local oldWD="$PWD"
-  cd "cases/$case/"
-  echo >&2 "$(tput bold)running test: $case$(tput sgr0) $(head -n1 README.md 2>/dev/null || true)"
-  if [ ! -f "README.md" ]; then
-    echo >&2 "$(tput bold)$(tput setaf 3)[WARNING]$(tput sgr0) no description (README.md) for case $case"
-  fi
-  if [ ! -x "./run.sh" ]; then
-    echo >&2 "$(tput setaf 6)[SKIP]$(tput sgr0) no test (run.sh) for case $case"
-    cd "$oldWD"
-    return 0
-  fi
+# Every case is run once in each of these modes, which are extra options passed to eexpr2json (see `scripts/eexpr2json.sh`).
+# The output of a case is expected to be the same in every mode.
+modes=("" "-a" "-k" "-a -k")
+
+# Run the case in the current directory with the given mode, and compare its outputs to the golden ones.
+function runMode() {
+  local mode="$1"
   for f in ./*.output; do if [ -f "$f" ]; then rm "$f"; fi; done
-  ./run.sh 1>stdout.output 2>stderr.output
+  EEXPR2JSON_MODE="$mode" ./run.sh 1>stdout.output 2>stderr.output
   local ec=0
   local gold out
   for gold in ./*.golden; do
     gold="${gold#./}"
     if [ "$gold" = "*.golden" ]; then continue; fi
     if [ ! -f "${gold%.golden}.output" ]; then
-      echo >&2 "$(tput setaf 1)[FAIL]$(tput sgr0) missing ${gold%.golden}.output"
+      echo >&2 "$(tput setaf 1)[FAIL]$(tput sgr0) missing ${gold%.golden}.output${mode:+ (mode $mode)}"
       ec=1
     fi
   done
   for out in ./*.output; do
     out="${out#./}"
     if ! diff -q 2>/dev/null "${out%.output}.golden" "$out"; then
-      echo >&2 "$(tput setaf 1)[FAIL]$(tput sgr0) output differs from expected: $out"
+      echo >&2 "$(tput setaf 1)[FAIL]$(tput sgr0) output differs from expected: $out${mode:+ (mode $mode)}"
       ec=1
     fi
   done
+  return $ec
+}
+
+function runCase() {
+  local case="$1"
+  local oldWD="$PWD"
+  cd "cases/$case/"
+  echo >&2 "$(tput bold)running test: $case$(tput sgr0) $(head -n1 README.md 2>/dev/null || true)"
+  if [ ! -f "README.md" ]; then
+    echo >&2 "$(tput bold)$(tput setaf 3)[WARNING]$(tput sgr0) no description (README.md) for case $case"
+  fi
+  if [ ! -x "./run.sh" ]; then
+    echo >&2 "$(tput setaf 6)[SKIP]$(tput sgr0) no test (run.sh) for case $case"
+    cd "$oldWD"
+    return 0
+  fi
+  local ec=0
+  local mode
+  for mode in "${modes[@]}"; do
+    runMode "$mode" || { ec=1; break; }
+  done
   cd "$oldWD"
   return $ec
 }
@@ -0,0 +1,108 @@
+#!/bin/bash
+set -e
+
+cmd="$(realpath ../../scripts/eexpr2json.sh)"
+
+# Parse the input with the options on the first line of `variants`, then with those on each of the other lines,
+#   and check that each gives the same output as the first (stdout, stderr and dumps), apart from the filenames printed.
+# In the options, these words stand for:
+#   $input   the input (doubled over as many times as `repeat` says, if there is one, to be large enough to split up)
+#   $edited  the input with the edit in `edit` (START LENGTH) made to it, replacing those bytes with `insert.eexpr`
+#   $edit    that same edit, as `-r` takes it
+#   $docs    the documents the input splits into at each `# ---` line, and $doc each of them in turn (running once for each)
+#   $out     a directory for the line's own dumps, compared with those of the first line
+#            (a dump the first line did not write is reported as is, and one that only the first line wrote as not written)
+#   $cache   a cache directory shared by all the lines, reported on after each line that uses it (or a directory in it)
+# The output of the first line is passed through, unless the input was repeated.
+here="$PWD"
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+cp input.eexpr "$tmp/input.eexpr"
+if [ -f repeat ]; then
+  for i in $(seq "$(cat repeat)"); do
+    cat "$tmp/input.eexpr" "$tmp/input.eexpr" >"$tmp/double.eexpr"
+    mv "$tmp/double.eexpr" "$tmp/input.eexpr"
+  done
+fi
+if [ -f edit ]; then
+  read -r start length <edit
+  cp insert.eexpr "$tmp/insert.eexpr"
+  { head -c "$start" input.eexpr
+    cat insert.eexpr
+    tail -c +"$((start + length + 1))" input.eexpr
+  } >"$tmp/edited.eexpr"
+fi
+csplit --quiet --prefix="$tmp/doc-" --suffix-format='%02d.eexpr' input.eexpr '/^# ---$/' '{*}'
+mkdir "$tmp/cache"
+cd "$tmp"
+
+# Run the options on line `n` (already split into words), with output to `out-$n`.
+function runLine() {
+  local n="$1"; shift
+  local args=() doc arg
+  mkdir "out-$n"
+  for arg in "$@"; do
+    case "$arg" in
+      '$input') args+=(input.eexpr) ;;
+      '$edited') args+=(edited.eexpr) ;;
+      '$edit') args+=("$start:$length:insert.eexpr") ;;
+      '$docs') args+=(doc-*.eexpr) ;;
+      '$doc') args+=('$doc') ;;
+      '$out') args+=("out-$n") ;;
+      '$out/'*) args+=("out-$n/${arg#\$out/}") ;;
+      '$cache') args+=(cache) ;;
+      '$cache/'*) args+=("cache/${arg#\$cache/}") ;;
+      *) args+=("$arg") ;;
+    esac
+  done
+  if [[ " ${args[*]} " = *' $doc '* ]]; then
+    local ec=0
+    for doc in doc-*.eexpr; do
+      "$cmd" "${args[@]/\$doc/$doc}" </dev/null >>"out-$n.stdout" 2>>"out-$n.stderr" || ec=$?
+    done
+    return $ec
+  fi
+  "$cmd" "${args[@]}" </dev/null >"out-$n.stdout" 2>"out-$n.stderr"
+}
+
+# Say whether two outputs are the same, apart from the filenames printed.
+function same() {
+  cmp -s <(grep -v '^{ "filename": ' "$1") <(grep -v '^{ "filename": ' "$2") && echo "same" || echo "differs"
+}
+
+set +e
+exec 3>&1
+n=0
+while read -r line; do
+  entries="$(find cache -type f -printf '%T@ %i %p\n')"
+  runLine "$n" $line
+  echo "$?" >>"$here/exitcode.output"
+  if [ "$n" -eq 0 ]; then
+    if [ ! -f "$here/repeat" ]; then
+      cat >&3 "out-0.stdout"
+      cat >&2 "out-0.stderr"
+    fi
+  else
+    report="$line: stdout $(same out-0.stdout "out-$n.stdout"), stderr $(same out-0.stderr "out-$n.stderr")"
+    for dump in $(ls "out-$n"); do
+      if [ -f "out-0/$dump" ]; then report="$report, $dump $(same "out-0/$dump" "out-$n/$dump")"
+      else report="$report, $dump $(head -n 1 "out-$n/$dump")"
+      fi
+    done
+    for dump in $(ls out-0); do
+      if [ ! -f "out-$n/$dump" ]; then report="$report, $dump not written"; fi
+    done
+    if [[ " $line " = *' $cache '* || " $line " = *' $cache/'* ]]; then
+      # the entry used last is the newest: it was a hit if it was there before and has only been touched since
+      newest="$(find cache -type f -printf '%T@ %i %p\n' | sort -n | tail -n 1)"
+      if [ -z "$newest" ]; then report="$report, cache missed"
+      elif grep -qxF "$newest" <<<"$entries"; then report="$report, cache unused"
+      elif cut -d ' ' -f 2- <<<"$entries" | grep -qxF "${newest#* }"; then report="$report, cache hit"
+      else report="$report, cache stored"
+      fi
+      report="$report ($(find cache -type f | wc -l) entries)"
+    fi
+    echo "$report"
+  fi
+  n=$((n + 1))
+done <"$here/variants" >"$here/compare.output"
@@ -0,0 +1,15 @@
+#!/bin/bash
+set -e
+
+cmd="$(realpath ../../scripts/eexpr2json.sh)"
+
+# nest the first line of the input a hundred thousand times, then close with the rest of the input
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+head -n1 input.eexpr | yes "$(cat)" | head -n 100000 | tr -d '\n' >"$tmp/deep.eexpr"
+tail -n+2 input.eexpr >>"$tmp/deep.eexpr"
+out="$PWD"
+cd "$tmp"
+set +e
+"$cmd" deep.eexpr
+echo "$?" >"$out/exitcode.output"
@@ -0,0 +1,12 @@
+#!/bin/bash
+set -e
+
+cmd=../../scripts/eexpr2json.sh
+
+# receive the eexprs one at a time through a callback
+set +e
+"$cmd" \
+  -e \
+  -ddumpEexprs eexprs.output \
+  input.eexpr
+echo "$?" >exitcode.output
@@ -0,0 +1,4 @@
+#!/bin/bash
+
+# run eexpr2json with the options of the mode that the test runner is going through (see `modes` in `run.sh`)
+exec "$(dirname "$(realpath "$0")")/../../bin/static/eexpr2json" $EEXPR2JSON_MODE "$@"
@@ -0,0 +1,11 @@
+#!/bin/bash
+set -e
+
+cmd=../../scripts/eexpr2json.sh
+
+# report the eexprs as a trace of parse events, without building a tree for the user
+set +e
+"$cmd" \
+  -v \
+  input.eexpr
+echo "$?" >exitcode.output
@@ -0,0 +1,16 @@
+#!/bin/bash
+set -e
+
+cmd="$(realpath ../../scripts/eexpr2json.sh)"
+
+# parse each line of the input on its own as a single expression fragment (with `\n` standing for a line break)
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+out="$PWD"
+cd "$tmp"
+set +e
+while IFS= read -r line; do
+  printf '%b' "$line" >fragment.eexpr
+  "$cmd" -x fragment.eexpr
+  echo "$?" >>"$out/exitcode.output"
+done <"$out/input.eexpr"
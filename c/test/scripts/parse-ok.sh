@@ -1,7 +1,7 @@
 #!/bin/bash
 set -e
 
-cmd=../../../bin/static/eexpr2json
+cmd=../../scripts/eexpr2json.sh
 
 set +e
 "$cmd" \
@@ -0,0 +1,12 @@
+#!/bin/bash
+set -e
+
+cmd=../../scripts/eexpr2json.sh
+
+# run the lexer, postlexer and parser on their own threads
+set +e
+"$cmd" \
+  -p \
+  -ddumpEexprs eexprs.output \
+  input.eexpr
+echo "$?" >exitcode.output
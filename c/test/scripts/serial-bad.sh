@@ -0,0 +1,39 @@
+#!/bin/bash
+set -e
+
+cmd=../../scripts/eexpr2json.sh
+
+# write the parse in binary form, then damage it in many ways and load each one:
+# each must either be refused or (where the damage happens to leave a well-formed file) load, but never crash
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+"$cmd" -b "$tmp/good.bin" input.eexpr >/dev/null 2>&1 || true
+size="$(stat -c %s "$tmp/good.bin")"
+
+# load a binary parse, and say what became of it
+function load() {
+  local ec=0
+  "$cmd" -m "$1" >/dev/null 2>"$tmp/stderr" || ec=$?
+  if [ "$ec" -ge 128 ]; then echo "crashed"
+  elif grep -q "error loading" "$tmp/stderr"; then echo "refused"
+  else echo "loaded"
+  fi
+}
+
+echo "intact: $(load "$tmp/good.bin")"
+for len in 0 8 31 32 44 84 $((size / 2)) $((size - 1)); do
+  head -c "$len" "$tmp/good.bin" >"$tmp/bad.bin"
+  echo "truncated to $len bytes: $(load "$tmp/bad.bin")"
+done
+head -c "$size" /dev/zero >"$tmp/bad.bin"
+echo "zeroed: $(load "$tmp/bad.bin")"
+
+# overwrite each aligned word of the file in turn with all ones, and tally the outcomes
+declare -A tally=([refused]=0 [loaded]=0 [crashed]=0)
+for ((off = 0; off < size; off += 4)); do
+  cp "$tmp/good.bin" "$tmp/bad.bin"
+  printf '\xff\xff\xff\xff' | dd of="$tmp/bad.bin" bs=1 seek="$off" conv=notrunc status=none
+  outcome="$(load "$tmp/bad.bin")"
+  tally[$outcome]=$((tally[$outcome] + 1))
+done
+echo "words overwritten: ${tally[refused]} refused, ${tally[loaded]} loaded, ${tally[crashed]} crashed"
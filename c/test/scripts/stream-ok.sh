@@ -0,0 +1,12 @@
+#!/bin/bash
+set -e
+
+cmd=../../scripts/eexpr2json.sh
+
+# feed the input a few bytes at a time, so that tokens of every kind get split across pieces
+set +e
+"$cmd" \
+  -s 3 \
+  -ddumpEexprs eexprs.output \
+  input.eexpr
+echo "$?" >exitcode.output
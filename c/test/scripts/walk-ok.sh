@@ -0,0 +1,11 @@
+#!/bin/bash
+set -e
+
+cmd=../../scripts/eexpr2json.sh
+
+# walk each parsed eexpr, reporting every step of the walk
+set +e
+"$cmd" \
+  -w \
+  input.eexpr
+echo "$?" >exitcode.output